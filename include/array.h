@@ -31,12 +31,17 @@ typedef struct inst array_iter;
 
 /**
  * Arrays are implemented as AVL trees much like property directories
+ *
+ * Copies of a dictionary share its nodes until they are changed, so a
+ * node may be in more than one tree.  Links counts the trees and parent
+ * nodes pointing to it.
  */
 typedef struct array_tree_t {
     struct array_tree_t *left;      /**< The left child node  */
     struct array_tree_t *right;     /**< The right child node */
     array_iter key;                 /**< Key for this node    */
     array_data data;                /**< Data for this node   */
+    int links;                      /**< Number of pointers to node */
     short height;                   /**< Height of node       */
 } array_tree;
 
@@ -71,6 +76,7 @@ extern stk_array_list *stk_array_active_list;
 typedef struct stk_array_t {
     int links;          /**< number of pointers  to array */
     int items;          /**< number of items in array */
+    int capacity;       /**< number of items a packed array has room for */
     short type;         /**< type of array */
     int pinned;         /**< if pinned, don't dup array on changes */
     union {
@@ -111,6 +117,21 @@ typedef struct stk_array_t {
  */
 int array_appenditem(stk_array **arr, array_data *item);
 
+/**
+ * Append a number of items to the end of an array
+ *
+ * This only works with ARRAY_PACKED arrays.  The items are copied, and the
+ * array grows just once to make room for them.
+ *
+ * @see array_appenditem
+ *
+ * @param harr Pointer to a pointer, the array you wish to operate on.
+ * @param items The items to add to the array.
+ * @param count The number of items.
+ * @return -1 on error, number of items in array on success
+ */
+int array_appenditems(stk_array **harr, array_data *items, int count);
+
 /**
  * Get the number of items in the array.
  *
@@ -128,6 +149,9 @@ int array_count(stk_array *arr);
  * The nomenclature of "decouple" is because it is most often used to
  * copy an unpinned array so that a copy may diverge from the original.
  *
+ * A dictionary's copy shares the original's tree, and each of them copies
+ * only the nodes it changes, as it changes them.
+ *
  * Most of the possible errors here are memory allocation related and will
  * result in an abort(...) call.
  *
@@ -348,6 +372,32 @@ int array_last(stk_array *arr, array_iter *item);
  */
 void array_mash(stk_array *arr_in, stk_array **mash, int value);
 
+/**
+ * Mash several arrays together and demote the result, using a hash table
+ *
+ * This gives the same list as calling array_mash() on each array in turn,
+ * with first_value for the first and value for the rest, and then
+ * array_demote_only() with the threshold.  Rather than building a
+ * dictionary, it counts the values in a hash table, and only sorts the
+ * values that are kept.  Strings are matched without regard to case, as
+ * dictionary keys are, and the first one seen is the one kept.
+ *
+ * It only works when every value in the arrays is an integer, every one
+ * is a dbref, or every one is a string.  Otherwise it returns NULL, and
+ * the caller should use array_mash() instead.
+ *
+ * @param arrs the arrays to mash
+ * @param count the number of arrays
+ * @param first_value the value to add for each item in the first array
+ * @param value the value to add for each item in the other arrays
+ * @param threshold the least total a value needs to be kept
+ * @param pin is pinning turned on?
+ * @return the packed array of values kept, or NULL if the values are not
+ *         all of one type that can be hashed
+ */
+stk_array *array_mash_hashed(stk_array **arrs, int count, int first_value,
+                             int value, int threshold, int pin);
+
 /**
  * Get the next item in a given array with 'item' being the previous item.
  *
@@ -380,6 +430,18 @@ int array_next(stk_array *arr, array_iter *item);
  */
 int array_prev(stk_array *arr, array_iter *item);
 
+/**
+ * Make room in a packed array for a number of items
+ *
+ * This is for code that knows how many items it is about to add, so the
+ * array grows once to just the size needed.  It does nothing to a
+ * dictionary, or to an array that already has the room.
+ *
+ * @param arr the array
+ * @param items the number of items, including those already in the array
+ */
+void array_reserve(stk_array *arr, int items);
+
 /**
  * For a given array and integer key, set value 'val'.
  *
@@ -540,6 +602,15 @@ int array_setitem(stk_array **arr, array_iter *idx, array_data *item);
  */
 int array_setrange(stk_array **arr, array_iter *start, stk_array *inarr);
 
+/**
+ * Give back the unused room in a packed array
+ *
+ * This does nothing to a dictionary.
+ *
+ * @param arr the array
+ */
+void array_shrink(stk_array *arr);
+
 /**
  * Allocate a new dictionary array
  *
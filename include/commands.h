@@ -1196,7 +1196,10 @@ void do_sanfix(dbref player);
  * various static methods in sanity.c -- this mostly involves reference
  * checking and other somewhat basic checks.
  *
- * Prints status for every 10,000 refs.
+ * The objects are split into ranges that are checked on up to
+ * SANITY_THREADS threads.  The problems are printed once all of them are
+ * done, in object order, so the output does not depend on the number of
+ * threads.  Prints status for every 10,000 refs.
  *
  * player can be NOTHING to output to log file, or AMBIGUOUS to output
  * to stderr.  Otherwise, output is sent to the indicated player dbref.
@@ -1205,6 +1208,26 @@ void do_sanfix(dbref player);
  */
 void do_sanity(dbref player);
 
+/**
+ * Implementation of the \@sanity background command
+ *
+ * Defined in sanity.c
+ *
+ * This runs do_sanity in a forked copy of the server, so the game goes on
+ * while the database is checked.  The copy checks the database as it was
+ * when the command ran.  Its output is kept in a temporary file, and sent
+ * to the player by sanity_fork_done once it exits.
+ *
+ * Servers that do not fork for dumps, DISKBASE and Windows ones, say so and
+ * check the database right away instead.  No permission checks are done by
+ * this command.
+ *
+ * @see sanity_fork_done
+ *
+ * @param player the player doing the call
+ */
+void do_sanity_fork(dbref player);
+
 /**
  * Implementation of the say command.
  *
@@ -1398,6 +1421,13 @@ void do_toad(int descr, dbref player, const char *name, const char *recip);
  * 'struct profnode' linked list.  For large numbers of 'arg1', this is
  * really inefficient since its sorting a linked list.
  *
+ * 'pairs' shows the MUF instruction pairs run most often instead, as
+ * counted while the muf_pair_stats tune is on.  'prims' shows the
+ * primitives and other instructions that took the most time, as counted
+ * while the muf_prim_stats tune is on.  'samples' shows the stacks
+ * the profiler sampled most often while the profile_sample_rate tune is
+ * set, and 'samples save' saves them all for a flame graph.
+ *
  * This does not do any permission checking.
  *
  * @param player the player doing the call
@@ -22,6 +22,12 @@
 #define MUF_NOTE_PROP           "_note"             /**< Notes */
 #define MUF_VERSION_PROP        "_version"          /**< Version */
 
+/**
+ * @var IN_DEBUG_LINE
+ *      integer primitive ID for DEBUG_LINE primitive
+ */
+extern int IN_DEBUG_LINE;
+
 /**
  * @var IN_FOR
  *      integer primitive ID for FOR primitive
@@ -52,11 +58,57 @@ extern int IN_FORPOP;
  */
 extern int IN_TRYPOP;
 
+/**
+ * @var MUF_COMPILER_REVISION
+ *      the revision of the code the compiler generates; it must be bumped
+ *      whenever the compiler changes the instructions it generates
+ */
+extern const int MUF_COMPILER_REVISION;
+
+/**
+ * @var program_code_generation
+ *      changes whenever any program's code or publics are freed, so that
+ *      anything remembering a place in a program can tell it might be gone
+ */
+extern unsigned int program_code_generation;
+
+struct publics;
+
 /**
  * Free the memory used by the primitive hash
  */
 void clear_primitives(void);
 
+/**
+ * Match an object named by a compiler directive
+ *
+ * This matches registered names and dbrefs, and "me" if asked to, as
+ * $include, $ifver, $iflib and $ifcancall do.  The matcher's globals are
+ * left as they were.
+ *
+ * @param descr the descriptor of the person compiling
+ * @param player the player compiling
+ * @param name the name to match
+ * @param with_me true to also match "me"
+ * @return the object matched, or NOTHING, AMBIGUOUS or HOME
+ */
+dbref compile_match(int descr, dbref player, const char *name, int with_me);
+
+/**
+ * Compile a program that is needed but not compiled
+ *
+ * This is what runs a program, or a call into one, does when it has no
+ * code.  The program's saved code is loaded if it is still good; if not,
+ * its text is read from disk and compiled as its owner, without showing
+ * any errors.  Either way, the text is not left in memory.
+ *
+ * @see mufcache_load
+ *
+ * @param descr the descriptor of the person who needs the program
+ * @param program the program to compile
+ */
+void compile_on_demand(int descr, dbref program);
+
 /**
  * Compile MUF code associated with a given dbref
  *
@@ -87,6 +139,17 @@ void clear_primitives(void);
 void do_compile(int descr, dbref in_player, dbref in_program,
                 int force_err_disp);
 
+/**
+ * Find a PUBLIC or WIZCALL function in a program by name
+ *
+ * This does not check whether the caller may call it.
+ *
+ * @param program the program, which must be compiled
+ * @param name the function name, which is not case sensitive
+ * @return the public function, or NULL if there is none by that name
+ */
+struct publics *find_public(dbref program, const char *name);
+
 /**
  * Free ("uncompile") unused programs
  *
@@ -98,6 +161,27 @@ void do_compile(int descr, dbref in_player, dbref in_program,
  */
 void free_unused_programs(void);
 
+/**
+ * Turn the common instruction sequences in a program into superinstructions
+ *
+ * Each sequence has its first instruction's type changed to one of the
+ * superinstruction types in inst.h, and is otherwise left alone.  The
+ * interpreter runs the whole sequence at once where it can, and falls back
+ * to running the plain instructions one at a time where it can't, such as
+ * when an argument has an unusual type.  This is why the code saved by the
+ * MUF cache, which is saved before this runs, never has them.
+ *
+ * The sequences were picked with the muf_pair_stats tune, as the pairs run
+ * most often by typical programs that the interpreter can do much more
+ * cheaply together.  A sequence is only fused if nothing jumps into the
+ * middle of it.
+ *
+ * @see unfuse_program
+ *
+ * @param program the program to fuse, which must be compiled
+ */
+void fuse_program(dbref program);
+
 /**
  * Return primitive instruction number
  *
@@ -113,9 +197,9 @@ int get_primitive(const char * token);
  * currently in the primitive hash, then loads all the primitives from
  * base_inst into the hash.
  *
- * This also loads the value of variables IN_FORPOP, IN_FORITER, IN_FOR,
- * IN_FOREACH, and IN_TRYPOP.  The number of primitives is logged via
- * log_status
+ * This also loads the value of variables IN_DEBUG_LINE, IN_FORPOP,
+ * IN_FORITER, IN_FOR, IN_FOREACH, and IN_TRYPOP.  The number of primitives
+ * is logged via log_status
  *
  * @see log_status
  */
@@ -152,4 +236,28 @@ size_t size_prog(dbref prog);
  */
 void uncompile_program(dbref i);
 
+/**
+ * Turn a program's superinstructions back into plain instructions
+ *
+ * The interpreter does this when it has to see every instruction run, as
+ * when a program is being debugged.  The program stays this way until it
+ * is next compiled.
+ *
+ * @see fuse_program
+ *
+ * @param program the program to unfuse
+ */
+void unfuse_program(dbref program);
+
+/**
+ * Get the plain instruction type a superinstruction stands in for
+ *
+ * @see fuse_program
+ *
+ * @param type the instruction type
+ * @return the type the instruction had before it was fused, or type itself
+ *         if it is not a superinstruction
+ */
+int unfused_type(int type);
+
 #endif /* !COMPILE_H */
@@ -110,6 +110,15 @@ typedef int dbref;  /**< Type wrapper for dbref - must support negatives */
 #define MUF_RE_CACHE_ITEMS 64   /**< size of the regex cache */
 #define MATCH_ARR_SIZE 30       /**< size of the matches array */
 
+/* Defines for reflist props */
+#define REFLIST_CACHE_ITEMS 256 /**< size of the reflist index cache */
+
+/* Defines for binary databases */
+#define DBBIN_LOAD_THREADS 8    /**< max threads used to load a binary db */
+
+/* Defines for sanity checks */
+#define SANITY_THREADS 8        /**< max threads used by @sanity */
+
 /* Database and server limits */
 #define MAX_COMMAND_LEN 2048    /**< max process_command arg length */
 #define MAX_COMPLEXITY 18       /**< max nested stackranges (CHECKARGS) */
@@ -58,7 +58,7 @@ extern char match_cmdname[BUFFER_LEN];
  *
  * @param x the dbref to mark dirty
  */
-#define DBDIRTY(x)  {db[x].flags |= OBJECT_CHANGED;}
+#define DBDIRTY(x)  {db_flags[x] |= OBJECT_CHANGED | JOURNAL_CHANGED;}
 
 /**
  * Set a struct field 'y' for object 'x' to 'z' and mark the object dirty
@@ -66,6 +66,9 @@ extern char match_cmdname[BUFFER_LEN];
  * There is no database overrun protection with this call, so make sure
  * x is between 0 and dbtop before trying this.
  *
+ * The hot fields kept outside the struct (@see db_flags) are set through
+ * their own macros instead, followed by DBDIRTY.
+ *
  * @param x the dbref to alter
  * @param y the struct field for the object to modify
  * @param z the value toset on the struct field
@@ -92,7 +95,7 @@ extern char match_cmdname[BUFFER_LEN];
  * @param x the dbref to fetch flags for
  * @return the flags associated with x
  */
-#define FLAGS(x)    (db[x].flags)
+#define FLAGS(x)    (db_flags[x])
 
 /**
  * Get owner of dbref 'x'
@@ -103,7 +106,7 @@ extern char match_cmdname[BUFFER_LEN];
  * @param x the dbref to fetch owner for
  * @return the owner associated with x
  */
-#define OWNER(x)    (db[x].owner)
+#define OWNER(x)    (db_owner[x])
 
 /**
  * Get location of dbref 'x'
@@ -114,7 +117,7 @@ extern char match_cmdname[BUFFER_LEN];
  * @param x the dbref to fetch location for
  * @return the location associated with x
  */
-#define LOCATION(x) (DBFETCH((x))->location)
+#define LOCATION(x) (db_location[x])
 
 /**
  * Get contents of dbref 'x'
@@ -147,7 +150,7 @@ extern char match_cmdname[BUFFER_LEN];
  * @param x the dbref to fetch next field for
  * @return the next field associated with x
  */
-#define NEXTOBJ(x)  (DBFETCH((x))->next)
+#define NEXTOBJ(x)  (db_next[x])
 
 /* defines for possible data access mods. */
 #define MESGPROP_DESC       "_/de"      /**< description prop */
@@ -397,8 +400,7 @@ extern char match_cmdname[BUFFER_LEN];
 #define SMUCKER        0x100000 /**< second programmer bit.  For levels */
 #define INTERACTIVE    0x200000 /**< internal: player in MUF editor */
 #define OBJECT_CHANGED 0x400000 /**< internal: set when an object is dbdirty()ed */
-
-/* 0x800000 available */
+#define JOURNAL_CHANGED 0x800000 /**< internal: dbdirty()ed since the last journal commit */
 
 #define VEHICLE       0x1000000 /**< Vehicle flag */
 #define ZOMBIE        0x2000000 /**< Zombie flag */
@@ -410,7 +412,7 @@ extern char match_cmdname[BUFFER_LEN];
 #define OVERT        0x80000000 /**< Overt flag */
 
 /** what flags to NOT dump to disk. */
-#define DUMP_MASK   (INTERACTIVE | OBJECT_CHANGED | LISTENER | READMODE | SANEBIT)
+#define DUMP_MASK   (INTERACTIVE | OBJECT_CHANGED | JOURNAL_CHANGED | LISTENER | READMODE | SANEBIT)
 
 /**
  * Returns the TYPE_ value of 'x'
@@ -780,7 +782,7 @@ extern char match_cmdname[BUFFER_LEN];
  * @param first the starting dbref
  */
 #define DOLIST(var, first) \
-  for ((var) = (first); (var) != NOTHING; (var) = DBFETCH(var)->next)
+  for ((var) = (first); (var) != NOTHING; (var) = NEXTOBJ(var))
 
 /**
  * This adds 'thing' to 'locative's list, and sets locative equal to 'thing'
@@ -792,7 +794,7 @@ extern char match_cmdname[BUFFER_LEN];
  * @param locative the list to add to
  */
 #define PUSH(thing, locative) \
-    {DBSTORE((thing), next, (locative)); (locative) = (thing);}
+    {NEXTOBJ(thing) = (locative); DBDIRTY(thing); (locative) = (thing);}
 
 typedef long object_flag_type;  /**< Object flag type - need 32+ bits */
 
@@ -810,10 +812,13 @@ struct program_specific {
     struct inst *start;         /**< place to start executing */
     struct line *first;         /**< first line */
     struct publics *pubs;       /**< public subroutine addresses */
+    struct t_hash_entry **pubtab;   /**< pubs hashed by name */
     struct mcp_binding *mcpbinds;   /**< MCP message bindings. */
     struct timeval proftime;    /**< profiling time spent in this program. */
     time_t profstart;           /**< time when profiling started for this prog */
     unsigned int profuses;      /**< \#calls to this program while profiling */
+    unsigned int slice_yields;  /**< \#times made to yield since profstart */
+    unsigned int time_yields;   /**< how many of those were for time */
 };
 
 /**
@@ -835,7 +840,7 @@ struct program_specific {
  * @param x the program to initialize a program specific structure for
  */
 #define ALLOC_PROGRAM_SP(x)     { \
-    PROGRAM_SP(x) = malloc(sizeof(struct program_specific)); \
+    PROGRAM_SP(x) = calloc(1, sizeof(struct program_specific)); \
 }
 
 /**
@@ -975,6 +980,21 @@ struct program_specific {
  */
 #define PROGRAM_PUBS(x)         (PROGRAM_SP(x)->pubs)
 
+/**
+ * Accessor for a program specific field
+ *
+ * The field accessed is obviously named as the section after PROGRAM_
+ * Forgive the generic comment -- there are a million of these and they
+ * all work the same.
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to fetch the field for
+ * @return the contents of the field
+ */
+#define PROGRAM_PUBTAB(x)       (PROGRAM_SP(x)->pubtab)
+
 /**
  * Accessor for a program specific field
  *
@@ -1020,6 +1040,36 @@ struct program_specific {
  */
 #define PROGRAM_PROF_USES(x)    (PROGRAM_SP(x)->profuses)
 
+/**
+ * Accessor for a program specific field
+ *
+ * The field accessed is obviously named as the section after PROGRAM_
+ * Forgive the generic comment -- there are a million of these and they
+ * all work the same.
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to fetch the field for
+ * @return the contents of the field
+ */
+#define PROGRAM_SLICE_YIELDS(x) (PROGRAM_SP(x)->slice_yields)
+
+/**
+ * Accessor for a program specific field
+ *
+ * The field accessed is obviously named as the section after PROGRAM_
+ * Forgive the generic comment -- there are a million of these and they
+ * all work the same.
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to fetch the field for
+ * @return the contents of the field
+ */
+#define PROGRAM_TIME_YIELDS(x)  (PROGRAM_SP(x)->time_yields)
+
 /**
  * Increment the program instance count
  *
@@ -1075,6 +1125,28 @@ struct program_specific {
  */ 
 #define PROGRAM_INC_PROF_USES(x)    (PROGRAM_SP(x)->profuses++)
 
+/**
+ * Increment the count of times the program was made to yield
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to increment
+ * @return the resultant value
+ */ 
+#define PROGRAM_INC_SLICE_YIELDS(x) (PROGRAM_SP(x)->slice_yields++)
+
+/**
+ * Increment the count of times the program was made to yield for time
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to increment
+ * @return the resultant value
+ */ 
+#define PROGRAM_INC_TIME_YIELDS(x)  (PROGRAM_SP(x)->time_yields++)
+
 /**
  * Setter for a program specific field
  *
@@ -1203,6 +1275,19 @@ struct program_specific {
  */
 #define PROGRAM_SET_PUBS(x,y)       (PROGRAM_SP(x)->pubs = y)
 
+/**
+ * Forgive the generic comment -- there are a million of these and they
+ * all work the same.
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to fetch the field for
+ * @param y the value to set
+ * @return the contents of the field
+ */
+#define PROGRAM_SET_PUBTAB(x,y)     (PROGRAM_SP(x)->pubtab = y)
+
 /**
  * Setter for a program specific field
  *
@@ -1252,6 +1337,38 @@ struct program_specific {
  */
 #define PROGRAM_SET_PROF_USES(x,y)  (PROGRAM_SP(x)->profuses = y)
 
+/**
+ * Setter for a program specific field
+ *
+ * The field set is obviously named as the section after PROGRAM_
+ * Forgive the generic comment -- there are a million of these and they
+ * all work the same.
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to fetch the field for
+ * @param y the value to set
+ * @return the contents of the field
+ */
+#define PROGRAM_SET_SLICE_YIELDS(x,y) (PROGRAM_SP(x)->slice_yields = y)
+
+/**
+ * Setter for a program specific field
+ *
+ * The field set is obviously named as the section after PROGRAM_
+ * Forgive the generic comment -- there are a million of these and they
+ * all work the same.
+ *
+ * This does not check for nulls, so it will segfault if the program specific
+ * pointer is NULL.
+ *
+ * @param x the program to fetch the field for
+ * @param y the value to set
+ * @return the contents of the field
+ */
+#define PROGRAM_SET_TIME_YIELDS(x,y)  (PROGRAM_SP(x)->time_yields = y)
+
 /**
  * Accessor for a program specific field
  *
@@ -1760,14 +1877,14 @@ union specific {        /* I've been railroaded! */
 
 /**
  * Database object
+ *
+ * The hot fields -- flags, owner, location, and next -- are not here, but
+ * in arrays alongside the db.  @see db_flags
  */
 struct object {
     const char *name;   /**< Object name */
-    dbref location;     /**< pointer to container */
-    dbref owner;        /**< Object owner */
     dbref contents;     /**< Head of the object's contents db list */
     dbref exits;        /**< Head of the object's exits db list */
-    dbref next;         /**< pointer to next in contents/exits chain */
     struct plist *properties;   /**< Root of properties tree */
 #ifdef DISKBASE
     long propsfpos;     /**< File position for properties in the DB file */
@@ -1775,9 +1892,9 @@ struct object {
     dbref nextold;      /**< Ringqueue for diskbase next db */
     dbref prevold;      /**< Ringqueue for diskbase previous db */
     short propsmode;    /**< State of the props - PROPS_UNLOADED, PROPS_CHANGED */
-    short spacer;       /**< Not used by anything */
+    short propsstale;   /**< If true, propsize needs to be recalculated */
 #endif
-    object_flag_type flags;         /**< Object flags */
+    size_t propsize;    /**< Bytes used by the loaded properties */
     unsigned int mpi_prof_use;      /**< MPI profiler number of uses */
     struct timeval mpi_proftime;    /**< Time spent running MPI */
     time_t ts_created;              /**< Created time */
@@ -1840,6 +1957,40 @@ typedef struct objnode {
  */
 extern struct object *db;
 
+/*
+ * The fields that scans over the whole database look at -- flags (which
+ * hold the type), owner, location, and the next object in a contents or
+ * exits list -- are kept out of struct object, in dense arrays parallel
+ * to 'db'.  A scan then only reads the columns it tests, instead of
+ * pulling every object's cold fields through the cache.  Use FLAGS,
+ * OWNER, LOCATION, and NEXTOBJ rather than these directly.
+ */
+
+/**
+ * @var db_flags
+ *      the flags of every object, indexed by dbref
+ */
+extern object_flag_type *db_flags;
+
+/**
+ * @var db_owner
+ *      the owner of every object, indexed by dbref
+ */
+extern dbref *db_owner;
+
+/**
+ * @var db_location
+ *      the location of every object, indexed by dbref
+ */
+extern dbref *db_location;
+
+/**
+ * @var db_next
+ *      the next object in every object's contents or exits list, indexed
+ *      by dbref
+ */
+extern dbref *db_next;
+
 /**
  * @var forcelist
  *      the things currently being forced.
@@ -1980,6 +2131,16 @@ dbref clone_thing(dbref thing, dbref player, int copy_hidden_props);
  */
 void db_clear_object(dbref i);
 
+/**
+ * Grow the DB to a new size.
+ *
+ * 'newtop' will be the number of elements in the DB.  This won't let you
+ * shrink the DB, 'newtop' must be greater than db_top
+ *
+ * @param newtop the new DB size
+ */
+void db_grow(dbref newtop);
+
 /**
  * Free the memory for the whole database
  *
@@ -2014,10 +2175,19 @@ void db_free_object(dbref i);
  * there is a problem loading the database, chances are it will trigger
  * an abort() as there is no gentle error handling in this process.
  *
+ * Both the text format and the binary format (@see dbbin_read) are
+ * understood; the format is detected from the start of the file.
+ *
+ * If a delta log is given, its changes are replayed over the database
+ * before the recyclable list is built, followed by the journal if one is
+ * given.  @see dbbin_read_deltas @see journal_replay
+ *
  * @param f the file handle to load from
+ * @param deltas the delta log to replay, or NULL
+ * @param journal the journal to replay, or NULL
  * @return the dbtop value or #-1 if the header is invalid
  */
-dbref db_read(FILE * f);
+dbref db_read(FILE * f, FILE * deltas, FILE * journal);
 
 /**
  * Write the database out to a given file handle
@@ -0,0 +1,244 @@
+/** @file dbbin.h
+ *
+ * Header for the binary database format.
+ *
+ * The binary format holds the same data as the text dump written by
+ * db_write, but is laid out so that it can be loaded quickly.  Every object
+ * is a length-prefixed record, strings are stored once in a shared string
+ * table, and an index of record offsets lets the loader split the objects
+ * between several threads.
+ *
+ * The binary format is not available with DISKBASE, which depends on
+ * property offsets into the text database.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#ifndef DBBIN_H
+#define DBBIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "props.h"
+
+/*
+ * The layout of a binary database is:
+ *
+ * * A fixed DBBIN_HEADER_SIZE byte header (see dbbin_write)
+ * * The tune parameters, as text lines (see tune_save_parms_to_file)
+ * * One record per object, from #0 up to db_top - 1
+ * * The string table
+ * * The index: the file offset of each object's record
+ *
+ * All numbers are stored little-endian, regardless of the platform.
+ */
+#define DBBIN_MAGIC "\211FBDB\r\n\032"  /**< Identifies a binary database */
+#define DBBIN_MAGIC_LEN 8               /**< Length of DBBIN_MAGIC */
+#define DBBIN_VERSION 1                 /**< Current binary format version */
+#define DBBIN_HEADER_SIZE 64            /**< Size of the fixed header */
+
+/*
+ * A delta log is a series of segments appended after a full dump, each
+ * holding the objects that changed since the dump before it.  Segments
+ * are tied to their full dump by the generation in SYS_DUMPGEN_PROP, so
+ * a log left over from an older full dump is ignored.
+ */
+#define DBBIN_DELTA_MAGIC "\211FBDL\r\n\032"    /**< Starts a delta segment */
+#define DBBIN_DELTA_HEADER_SIZE 64              /**< Size of a segment header */
+
+/**
+ * A growable byte buffer, used to build records before they are written.
+ */
+struct dbbin_buf {
+    unsigned char *data;    /**< The bytes in the buffer */
+    size_t len;             /**< Number of bytes used */
+    size_t size;            /**< Number of bytes allocated */
+};
+
+struct dbbin_file;
+
+/**
+ * A cursor over part of a binary database or other encoded data.
+ *
+ * Reads past 'end' set 'bad' and return zeroes, so a damaged record can
+ * be decoded to the end and rejected once, rather than checked per field.
+ * With no 'file', strings are read inline (see dbbin_put_str) rather than
+ * from a string table.
+ */
+struct dbbin_reader {
+    const unsigned char *p;     /**< Next byte to read */
+    const unsigned char *end;   /**< End of the readable bytes */
+    const struct dbbin_file *file;  /**< The file, for its string table */
+    int bad;                    /**< True if the data was damaged */
+};
+
+/**
+ * Append a little-endian integer to a buffer
+ *
+ * @param b the buffer
+ * @param v the integer
+ * @param n the size of the integer, in bytes
+ */
+void dbbin_put_int(struct dbbin_buf *b, uint64_t v, int n);
+
+/**
+ * Append a string to a buffer, inline
+ *
+ * The string is stored as its size including the terminating NUL (4
+ * bytes), then its bytes.  NULL is stored as the empty string.
+ *
+ * @param b the buffer
+ * @param s the string
+ */
+void dbbin_put_str(struct dbbin_buf *b, const char *s);
+
+/**
+ * Append an object's fields, but not its properties, to a buffer
+ *
+ * These are the same fields as a binary database record holds, with the
+ * strings inline.
+ *
+ * @param b the buffer
+ * @param i the object
+ */
+void dbbin_put_fields(struct dbbin_buf *b, dbref i);
+
+/**
+ * Append a whole property tree to a buffer
+ *
+ * This is laid out the same as the properties in a binary database
+ * record, with the strings inline.
+ *
+ * @param b the buffer
+ * @param p the AVL tree, which may be NULL
+ */
+void dbbin_put_proptree(struct dbbin_buf *b, PropPtr p);
+
+/**
+ * Append a single property's flags and value to a buffer
+ *
+ * An empty value is stored as a propdir, with no value.
+ *
+ * @param b the buffer
+ * @param p the property
+ */
+void dbbin_put_propnode(struct dbbin_buf *b, PropPtr p);
+
+/**
+ * Read a little-endian integer
+ *
+ * @param r the reader
+ * @param n the size of the integer, in bytes
+ * @return the integer, or 0 if there were not enough bytes left
+ */
+uint64_t dbbin_get_int(struct dbbin_reader *r, int n);
+
+/**
+ * Read a string
+ *
+ * @param r the reader
+ * @return the string, which points into the data being read
+ */
+const char *dbbin_get_str(struct dbbin_reader *r);
+
+/**
+ * Read an object's fields, as written by dbbin_put_fields
+ *
+ * The object is cleared first, so it should already have been freed.
+ * Its properties are left empty.
+ *
+ * @param r the reader
+ * @param objno the object to fill in
+ */
+void dbbin_get_fields(struct dbbin_reader *r, dbref objno);
+
+/**
+ * Read a property tree, as written by dbbin_put_proptree
+ *
+ * This replaces the object's properties, and updates its LISTENER flag.
+ *
+ * @param r the reader
+ * @param obj the object to load the properties onto
+ */
+void dbbin_get_proptree(struct dbbin_reader *r, dbref obj);
+
+/**
+ * Read a property's flags and value, as written by dbbin_put_propnode
+ *
+ * Strings in 'dat' point into the data being read, and a lock is parsed
+ * into a new boolexp, which follows the same rules as for set_property.
+ *
+ * @param r the reader
+ * @param dat the property data to fill in
+ */
+void dbbin_get_propnode(struct dbbin_reader *r, PData * dat);
+
+/**
+ * Check if a file handle holds a binary database
+ *
+ * This peeks at the start of the file and leaves the file position where
+ * it was.
+ *
+ * @param f the file handle to check
+ * @return boolean true if the file starts with DBBIN_MAGIC
+ */
+int dbbin_probe(FILE * f);
+
+/**
+ * Load a binary database from the given file handle
+ *
+ * This fills in the objects and loads the tune parameters; the caller is
+ * responsible for anything that is common to every database format, such
+ * as building the recyclable list.
+ *
+ * Object records are decoded in parallel when the platform supports it,
+ * up to DBBIN_LOAD_THREADS threads.  Anything that touches shared server
+ * state -- parsing locks and adding players to the player hash -- is done
+ * afterwards on the calling thread.
+ *
+ * @param f the file handle to load from
+ * @return the dbtop value or -1 if the database is damaged
+ */
+dbref dbbin_read(FILE * f);
+
+/**
+ * Write the database out to a given file handle in the binary format
+ *
+ * If there is an error writing, this abort()s the program, just like
+ * db_write.
+ *
+ * @see db_write
+ *
+ * @param f the file handle to write to
+ * @return db_top value
+ */
+dbref dbbin_write(FILE * f);
+
+/**
+ * Append the changed objects to a delta log
+ *
+ * Every object with OBJECT_CHANGED set is written, along with the tune
+ * parameters, and its OBJECT_CHANGED flag is cleared.  If there is an
+ * error writing, this abort()s the program, just like db_write.
+ *
+ * @param f the delta log, positioned at its end
+ * @return the number of objects written
+ */
+int dbbin_write_delta(FILE * f);
+
+/**
+ * Replay a delta log over a freshly loaded database
+ *
+ * Only the segments written after the full dump that was just loaded are
+ * applied, which is checked against the generation stored on #0.  The
+ * replay stops at the first damaged or unfinished segment.
+ *
+ * @param f the delta log
+ * @return the number of segments applied, or -1 if a record was damaged
+ */
+int dbbin_read_deltas(FILE * f);
+
+#endif /* !DBBIN_H */
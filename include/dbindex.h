@@ -0,0 +1,103 @@
+/** @file dbindex.h
+ *
+ * Header for the object indexes behind \@find, \@owned, \@entrances,
+ * recycling, and MUF searches like FINDNEXT and ENTRANCES_ARRAY.
+ *
+ * Four indexes are kept, each mapping a key to the sorted list of
+ * dbrefs that have it:
+ *
+ * - The owner of each object.
+ * - The type of each object.
+ * - Every three letter run (trigram) in each object's name, ignoring
+ *   case.
+ * - Every object each exit, player, thing or room links to: exit
+ *   destinations, homes and droptos.
+ *
+ * Searches use the shortest list that applies to them, so their cost
+ * grows with the number of possible matches rather than with the size of
+ * the database.  The lists only narrow a search down; callers must still
+ * check every object they get back.
+ *
+ * The indexes are built the first time they are needed.  Code that
+ * changes an object's owner, type, name or links calls dbindex_update
+ * afterwards; code that rewrites many objects at once, like \@sanfix,
+ * calls dbindex_clear so that they are rebuilt.
+ *
+ * Code that changes objects while searching restarts the search from
+ * just past the last object it got back, instead of calling
+ * dbindex_next.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#ifndef DBINDEX_H
+#define DBINDEX_H
+
+#include "config.h"
+
+/**
+ * The state of a search started by dbindex_first
+ *
+ * The indexes must not change while a search is in progress.
+ */
+struct dbindex_scan {
+    const dbref *refs;  /**< The candidates, or NULL to try every object */
+    int count;          /**< The number of candidates */
+    int pos;            /**< The next candidate, or the next dbref to try */
+};
+
+/**
+ * Throw away the indexes, so that they are rebuilt when next needed
+ */
+void dbindex_clear(void);
+
+/**
+ * Bring the indexes up to date after an object's owner, type, name or
+ * links have changed
+ *
+ * This does nothing if the indexes have not been built yet.
+ *
+ * @param obj the object that changed
+ */
+void dbindex_update(dbref obj);
+
+/**
+ * Start a search for objects
+ *
+ * This returns every object from 'from' on that could match the given
+ * owner, type and name pattern, in ascending order, along with some that
+ * may not.  The caller checks each object itself.
+ *
+ * @param scan the search state to set up
+ * @param owner the owner to look for, or NOTHING for any owner
+ * @param type the type to look for, or NOTYPE for any type
+ * @param pattern an equalstr name pattern, or NULL for any name
+ * @param from the lowest dbref to return
+ * @return the first candidate, or NOTHING if there are none
+ */
+dbref dbindex_first(struct dbindex_scan *scan, dbref owner, int type,
+                    const char *pattern, dbref from);
+
+/**
+ * Start a search for the objects linked to an object
+ *
+ * These are the exits that have it as a destination, and the players,
+ * things and rooms that have it as their home or dropto, in ascending
+ * order.
+ *
+ * @param scan the search state to set up
+ * @param dest the object the links lead to
+ * @param from the lowest dbref to return
+ * @return the first object, or NOTHING if there are none
+ */
+dbref dbindex_first_link(struct dbindex_scan *scan, dbref dest, dbref from);
+
+/**
+ * Continue a search started by dbindex_first or dbindex_first_link
+ *
+ * @param scan the search state
+ * @return the next candidate, or NOTHING if there are no more
+ */
+dbref dbindex_next(struct dbindex_scan *scan);
+
+#endif /* !DBINDEX_H */
@@ -0,0 +1,92 @@
+/** @file dbzip.h
+ *
+ * Header for compressed database dumps.
+ *
+ * A text dump can be compressed as it is written, by handing db_write a
+ * stream from dbzip_open instead of the dump file itself.  The data is
+ * compressed with zlib in independent blocks, each carrying a CRC-32 of
+ * its uncompressed bytes, so damage is caught and reported by block
+ * rather than turning up as a confusing parse error further on.
+ *
+ * At startup, dbzip_probe tells compressed dumps apart from plain ones,
+ * and dbzip_inflate unpacks them for the loader.
+ *
+ * Compression needs zlib.  Writing also needs fopencookie or funopen, to
+ * put a stdio stream in front of the compressor.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#ifndef DBZIP_H
+#define DBZIP_H
+
+#include <stdio.h>
+
+#include "config.h"
+
+#ifdef HAVE_LIBZ
+
+/*
+ * A compressed dump is a fixed DBZIP_HEADER_SIZE byte header (DBZIP_MAGIC,
+ * then the format version and the block size in 4 bytes each) followed by
+ * blocks.  Each block is its uncompressed size, its compressed size, and
+ * the CRC-32 of its uncompressed bytes (4 bytes each), then the zlib data.
+ *
+ * The last block has both sizes 0, and the CRC-32 of the whole dump, so
+ * that a truncated file is not mistaken for a complete one.  All numbers
+ * are little-endian.
+ */
+#define DBZIP_MAGIC "\211FBZP\r\n\032"  /**< Identifies a compressed dump */
+#define DBZIP_MAGIC_LEN 8               /**< Length of DBZIP_MAGIC */
+#define DBZIP_VERSION 1                 /**< Current compressed version */
+#define DBZIP_HEADER_SIZE 16            /**< Size of the file header */
+
+/*
+ * Uncompressed bytes per block.  Bigger blocks compress a little better;
+ * smaller ones narrow down where damage is.
+ */
+#ifndef DBZIP_BLOCK_SIZE
+#define DBZIP_BLOCK_SIZE (256 * 1024)
+#endif
+
+/**
+ * Check if a file handle holds a compressed dump
+ *
+ * This peeks at the start of the file and leaves the file position where
+ * it was.
+ *
+ * @param f the file handle to check
+ * @return boolean true if the file starts with DBZIP_MAGIC
+ */
+int dbzip_probe(FILE * f);
+
+/**
+ * Open a stream that compresses everything written to it into a file
+ *
+ * Closing the stream writes the last block and the end marker, but leaves
+ * 'f' open, so that the caller can flush it to disk.  fclose on the
+ * stream fails if anything could not be written.
+ *
+ * @param f the file to write the compressed dump to
+ * @param level the zlib compression level, 1 to 9
+ * @return the stream, or NULL if compression is not available
+ */
+FILE *dbzip_open(FILE * f, int level);
+
+/**
+ * Unpack a compressed dump for loading
+ *
+ * The dump is unpacked into a scratch file next to 'path', which is
+ * removed as soon as it is open, so the space is given back when the
+ * returned file is closed.  Every block is checked against its CRC-32;
+ * if one does not match, the block is logged and NULL is returned.
+ *
+ * @param f the compressed dump, positioned at its start
+ * @param path the name of the dump, used to place the scratch file
+ * @return the unpacked dump, positioned at its start, or NULL on error
+ */
+FILE *dbzip_inflate(FILE * f, const char *path);
+
+#endif /* HAVE_LIBZ */
+
+#endif /* !DBZIP_H */
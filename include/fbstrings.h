@@ -36,6 +36,27 @@
  */
 struct shared_string *alloc_prog_string(const char * s);
 
+/**
+ * Append to a shared string
+ *
+ * This uses up the caller's link to ss, and returns a string with a link
+ * for the caller.  If nothing else links to ss, the text is appended where
+ * it is, growing the string to about twice its length (but no longer than
+ * the longest MUF string) when it runs out of room, so that a string built
+ * up a piece at a time is not copied each time.  Otherwise, ss is left
+ * alone and a new string is made.
+ *
+ * This will abort() if malloc fails.  The caller must make sure the
+ * result is no longer than BUFFER_LEN - 1.
+ *
+ * @param ss the string to append to, which must not be NULL
+ * @param s the string to append
+ * @param len the length of s
+ * @return the string with s appended
+ */
+struct shared_string *append_prog_string(struct shared_string *ss,
+                                         const char *s, size_t len);
+
 /**
  * Create a copy of the given string.  If the string is NULL or empty,
  * return NULL.
@@ -86,6 +86,9 @@
  *
  */
 
+/** Generation of the last full dump, for matching up delta dumps */
+#define SYS_DUMPGEN_PROP        SYSTEM_PROPDIR_PROTECT2 "/dumpgen"
+
 /** Dump interval */
 #define SYS_DUMPINTERVAL_PROP   SYSTEM_PROPDIR_PROTECT2 "/dumpinterval"
 
@@ -155,9 +158,9 @@ extern int force_level;
 
 /**
  * @var forked_dump_process_flag
- *      boolean value - if true, we are the dump child process.  This is
- *      set immediately after the fork and should be false for the parent
- *      (actual MUCK) process.
+ *      boolean value - if true, we are a forked dump or sanity check child
+ *      process.  This is set immediately after the fork and should be false
+ *      for the parent (actual MUCK) process.
  */
 extern int forked_dump_process_flag;
 
@@ -186,6 +189,25 @@ void cleanup_game(void);
  */
 void dump_database(void);
 
+/**
+ * Wrap up a forked dump once it has exited
+ *
+ * This picks up the dumper's last report, so that \@dump can show how
+ * the dump went.
+ */
+void dump_finished(void);
+
+/**
+ * Note how far along a dump is
+ *
+ * This is called by the database writers as they go.  In a forked dumper,
+ * it holds the dump to tp_dump_io_limit bytes per second, and reports
+ * progress to the server about once a second.  Otherwise it does nothing.
+ *
+ * @param done the number of objects written so far
+ */
+void dump_progress(int done);
+
 /**
  * Perform a dump operation, forking a new process if it is supported
  *
@@ -193,7 +215,9 @@ void dump_database(void);
  * forked and the database is dumped "inline".
  *
  * Otherwise, a process is forked, its nice level is set to NICELEVEL
- * if defined, and the database is dumped to disk.
+ * if defined, and the database is dumped to disk.  The forked dumper
+ * reports its progress back over a pipe, and may be given a lower disk
+ * priority and a limit on how fast it writes.  @see dump_progress
  *
  * You probably don't want to call this function.  You likely should
  * call dump_db_now instead as it does additional book-keeping.
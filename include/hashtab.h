@@ -35,6 +35,9 @@ typedef hash_entry *hash_tab;           /**< A hash table itself */
 #define PLAYER_HASH_SIZE   (1024)       /**< Table for player lookups */
 #define COMP_HASH_SIZE     (256)        /**< Table for compiler keywords */
 #define DEFHASHSIZE        (256)        /**< Table for compiler $defines */
+#define PUBLIC_HASH_SIZE   (64)         /**< Table for a program's publics */
+#define SAMPLER_HASH_SIZE  (1024)       /**< Table for profiler samples */
+#define TRIGRAM_HASH_SIZE  (16384)      /**< Table for object name trigrams */
 
 /**
  * Add a string to a hash table
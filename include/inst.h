@@ -37,6 +37,7 @@ struct line {
  */
 struct shared_string {
     int links;                  /**< number of pointers to this struct */
+    int room;                   /**< unused space after data, for appends */
     size_t length;              /**< length of string data */
     char data[1];               /**< shared string data */
 };
@@ -99,6 +100,30 @@ struct muf_proc_data {
 #define PROG_LVAR_AT_CLEAR 23   /**< \@ for local vars, with var clear optim */
 #define PROG_LVAR_BANG   24     /**< ! shortcut for local vars */
 
+/*
+ * Superinstructions.  These only ever appear in a compiled program, in
+ * place of the type of the first instruction of a common sequence; see
+ * fuse_program.  The instruction keeps its data, and the rest of the
+ * sequence is left as it was, so the interpreter can always run it the
+ * plain way instead.  The comments give the sequence each one stands for.
+ */
+#define PROG_NOT_IF      25     /**< NOT IF */
+#define PROG_DUP_IF      26     /**< DUP IF */
+#define PROG_EQ_IF       27     /**< = IF, for integers */
+#define PROG_NE_IF       28     /**< != IF, for integers */
+#define PROG_LT_IF       29     /**< < IF, for integers */
+#define PROG_LE_IF       30     /**< <= IF, for integers */
+#define PROG_GT_IF       31     /**< > IF, for integers */
+#define PROG_GE_IF       32     /**< >= IF, for integers */
+#define PROG_FORITER_IF  33     /**< FORITER IF, the top of a FOR loop */
+#define PROG_LVAR_INCR   34     /**< v \@ ++ v !, for a local variable */
+#define PROG_LVAR_DECR   35     /**< v \@ -- v !, for a local variable */
+#define PROG_SVAR_INCR   36     /**< v \@ ++ v !, for a scoped variable */
+#define PROG_SVAR_DECR   37     /**< v \@ -- v !, for a scoped variable */
+
+#define PROG_FIRST_FUSED PROG_NOT_IF    /**< The first superinstruction */
+#define PROG_LAST_FUSED  PROG_SVAR_DECR /**< The last superinstruction */
+
 #define MAX_VAR         54      /**< maximum number of variables including the
                                  *  basic ME, LOC, TRIGGER, and COMMAND vars
                                  */
@@ -223,6 +223,30 @@ extern short global_dumpdone;
  *      PID of the forked dump process - unused for DISKBASE - 0 if not running
  */
 extern pid_t global_dumper_pid;
+
+/**
+ * @var global_dump_failed
+ *      Boolean, true if the last forked dump process failed
+ */
+extern short global_dump_failed;
+
+/**
+ * @var global_sanitydone
+ *      Boolean, true if the forked sanity check has exited
+ */
+extern short global_sanitydone;
+
+/**
+ * @var global_sanity_pid
+ *      PID of the forked sanity check - unused for DISKBASE - 0 if not running
+ */
+extern pid_t global_sanity_pid;
+
+/**
+ * @var global_sanity_status
+ *      The exit status of the forked sanity check, once it is done
+ */
+extern int global_sanity_status;
 #endif
 
 /**
@@ -897,6 +921,22 @@ void queue_write_max(struct descriptor_data *d, const char *b, size_t n,
  */
 void san_main(void);
 
+/**
+ * Finish up a background sanity check started by do_sanity_fork
+ *
+ * This sends the check's output to the player that started it, and sets
+ * sanity_violated from its result.  It is called from the main loop once
+ * the forked process has been reaped.
+ *
+ * This is defined in sanity.c, but there is no sanity.h, so this lives
+ * here.
+ *
+ * @see do_sanity_fork
+ *
+ * @param status the exit status of the forked process
+ */
+void sanity_fork_done(int status);
+
 #ifdef SPAWN_HOST_RESOLVER
 /**
  * Spawn the host resolver.
@@ -328,6 +328,31 @@ struct publics {
     struct publics *next;   /**< Next item on the linked list */
 };
 
+/**
+ * A pair of instructions counted while the muf_pair_stats tune is on
+ *
+ * Each instruction is given as a key: a primitive is its primitive number,
+ * and anything else is -1 minus its instruction type.  muf_pair_name turns
+ * a key back into something readable.
+ */
+struct muf_pair {
+    int first;              /**< Key of the instruction run first */
+    int second;             /**< Key of the instruction run right after */
+    unsigned long count;    /**< How many times the pair has been run */
+};
+
+/**
+ * A primitive or instruction type counted while the muf_prim_stats tune is
+ * on
+ *
+ * The key is as for struct muf_pair.
+ */
+struct muf_inst_stat {
+    int key;                    /**< The primitive or instruction type */
+    unsigned long count;        /**< How many times it has been run */
+    unsigned long long nsec;    /**< How long it took, in nanoseconds */
+};
+
 #ifdef DEBUG
 /**
  * If DEBUG is set, we'll do a little extra tracking of the pop.
@@ -901,13 +926,14 @@ struct frame *interp(int descr, dbref player, dbref location, dbref program,
  * difficult to sum up into a little sound bite.  Here's the highlights:
  *
  * A PREEMPT or BOUND program runs until a certain number of instructions
- * (at which point it hard stops), until it has gotten too many nested
- * interpreter calls, or until it finishes completely.
+ * or milliseconds (at which point it hard stops), until it has gotten too
+ * many nested interpreter calls, or until it finishes completely.
  *
  * Otherwise, a program runs for awhile until it either blocks for input
  * or sleep, or it gets forcibly "0 sleep" injected to make it yield.  This
- * is called a slice.  All these numbers are tunable with \@tune but the
- * defaults are pretty much always used.
+ * is called a slice, and may be limited in instructions or milliseconds.
+ * All these numbers are tunable with \@tune but the defaults are pretty much
+ * always used.
  *
  * This will parse the instructions using a godawful switch statement.
  *
@@ -921,6 +947,16 @@ struct frame *interp(int descr, dbref player, dbref location, dbref program,
 struct inst *interp_loop(dbref player, dbref program, struct frame *fr,
                          int rettyp);
 
+/**
+ * Note that a primitive may have taken a while
+ *
+ * The interpreter only looks at the clock every so many instructions, to
+ * see if the instr_slice_msec or max_preempt_msec limits are up.  Primitives
+ * that can do a lot of work in one go, such as sorting a big array, call
+ * this so that the clock is looked at again right after them.
+ */
+void interp_slow_primitive(void);
+
 /**
  * Is the given instruction a ref to the special 'HOME' ref?
  *
@@ -949,6 +985,53 @@ void localvar_dupall(struct frame *fr, struct frame *oldfr);
  */
 struct localvars *localvars_get(struct frame *fr, dbref prog);
 
+/**
+ * Throw away the primitive statistics gathered so far
+ */
+void muf_inst_stats_reset(void);
+
+/**
+ * Get the primitives and instruction types that took the most time
+ *
+ * These are only counted and timed while the muf_prim_stats tune is on.
+ * They are given longest first.
+ *
+ * @param list where to put the statistics
+ * @param count the most statistics to put in list
+ * @param total set to the time taken by everything counted, in nanoseconds
+ * @return the number of statistics put in list
+ */
+int muf_inst_stats_top(struct muf_inst_stat *list, int count,
+                       unsigned long long *total);
+
+/**
+ * Get a readable name for an instruction key from the pair statistics
+ *
+ * @see struct muf_pair
+ *
+ * @param key the instruction key
+ * @return the primitive's name, or a description of the instruction type
+ */
+const char *muf_pair_name(int key);
+
+/**
+ * Throw away the instruction pair statistics gathered so far
+ */
+void muf_pairs_reset(void);
+
+/**
+ * Get the most often run instruction pairs
+ *
+ * Pairs are only counted while the muf_pair_stats tune is on.  The pairs
+ * are given busiest first.
+ *
+ * @param list where to put the pairs
+ * @param count the most pairs to put in list
+ * @param total set to the number of pairs counted altogether
+ * @return the number of pairs put in list
+ */
+int muf_pairs_top(struct muf_pair *list, int count, unsigned long *total);
+
 /**
  * Check to see if 'player' has ownership of 'thing'
  *
@@ -0,0 +1,155 @@
+/** @file journal.h
+ *
+ * Header for the write-ahead journal.
+ *
+ * The journal records changes to the database as they happen, so that a
+ * crash between dumps loses at most the last few seconds of work instead
+ * of everything since the last dump.  Property changes are recorded as
+ * they are made; changes to an object's other fields are picked up from
+ * DBDIRTY, through JOURNAL_CHANGED, and recorded when the journal is next
+ * written to disk.
+ *
+ * Records are gathered in memory and written out together (and fsync()ed)
+ * every tp_journal_fsync_interval seconds.  Each dump leaves a marker in
+ * the journal; at startup, everything after the marker for the database
+ * that was loaded is replayed.  Once a dump is known to be safely on disk,
+ * the journal is cut back to start at its marker.
+ *
+ * The journal is not available with DISKBASE, which already writes most
+ * changes straight to the database file.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+
+#include "config.h"
+
+#ifndef DISKBASE
+
+/*
+ * A journal is a fixed JOURNAL_HEADER_SIZE byte header (JOURNAL_MAGIC,
+ * then the format version in 4 bytes, then 4 unused bytes) followed by
+ * batches.  Each batch is its payload size and an FNV-1a checksum of the
+ * payload (4 bytes each), then the payload: a series of records.
+ *
+ * Each record is its kind (1 byte), the object (4 bytes), and the size of
+ * the rest of the record (4 bytes).  All numbers are little-endian.
+ */
+#define JOURNAL_MAGIC "\211FBJL\r\n\032"    /**< Identifies a journal */
+#define JOURNAL_MAGIC_LEN 8                 /**< Length of JOURNAL_MAGIC */
+#define JOURNAL_VERSION 1                   /**< Current journal version */
+#define JOURNAL_HEADER_SIZE 16              /**< Size of the file header */
+
+#define JOURNAL_MARK   1    /**< A dump: generation and delta count */
+#define JOURNAL_FIELDS 2    /**< An object's fields, see dbbin_put_fields */
+#define JOURNAL_PROPS  3    /**< An object's whole property tree */
+#define JOURNAL_PROP   4    /**< A property was set: name, flags, value */
+#define JOURNAL_REMOVE 5    /**< A property was removed: name */
+
+/**
+ * Record that a property was set
+ *
+ * The property's current value is recorded, so this is called after the
+ * change.  If the property no longer exists, its removal is recorded
+ * instead.  Nothing is recorded if the journal is not open.
+ *
+ * @param obj the object the property is on
+ * @param name the property name; anything after a ':' is ignored
+ */
+void journal_prop(dbref obj, const char *name);
+
+/**
+ * Record that a property was removed
+ *
+ * @param obj the object the property was on
+ * @param name the property name, as given to remove_property
+ */
+void journal_remove(dbref obj, const char *name);
+
+/**
+ * Record an object's whole property tree
+ *
+ * This is for changes that replace or copy the properties wholesale,
+ * such as creating, cloning, or recycling an object.
+ *
+ * @param obj the object
+ */
+void journal_props(dbref obj);
+
+/**
+ * Write the pending records to the journal
+ *
+ * The fields of every object changed since the last commit are recorded
+ * first.  Unless 'force' is set, nothing is done until
+ * tp_journal_fsync_interval has passed since the last commit.  This is
+ * called from the main loop.
+ *
+ * @param force if true, commit regardless of the interval
+ */
+void journal_commit(int force);
+
+/**
+ * Mark the start of a dump in the journal
+ *
+ * Everything pending is committed, and then a marker for the dump is
+ * written, naming the generation on #0 and the delta dump count.  This
+ * opens the journal if tp_journal is set and it is not open yet.
+ *
+ * @param seq the number of delta dumps since the last full dump,
+ *            counting this one
+ */
+void journal_checkpoint(int seq);
+
+/**
+ * Finish up after a dump
+ *
+ * If the dump succeeded, everything before its marker is dropped from
+ * the journal.  If tp_journal has been turned off, the journal is closed
+ * and removed instead.
+ *
+ * @param ok boolean true if the dump was saved
+ */
+void journal_dump_done(int ok);
+
+/**
+ * Replay a journal over a freshly loaded database
+ *
+ * Only what follows the marker for the dump that was just loaded is
+ * replayed, and the replay stops at the first damaged or unfinished
+ * batch.  The replayed batches are kept to carry over into the journal
+ * opened by journal_open.
+ *
+ * @param f the journal, or NULL if there is none
+ * @param seq the number of delta dumps that were applied
+ * @return the number of batches replayed, or -1 if a record was damaged
+ */
+int journal_replay(FILE * f, int seq);
+
+/**
+ * Start journaling after the database has been loaded
+ *
+ * If tp_journal is set or something was replayed, this writes a fresh
+ * journal for the dump file, starting with what was replayed, and opens
+ * it.  Otherwise the journal is opened at the next dump.
+ *
+ * @param outfile the file the database will be dumped to
+ */
+void journal_open(const char *outfile);
+
+#else
+
+#define journal_prop(obj, name)
+#define journal_remove(obj, name)
+#define journal_props(obj)
+#define journal_commit(force)
+#define journal_checkpoint(seq)
+#define journal_dump_done(ok)
+#define journal_open(outfile)
+
+#endif /* !DISKBASE */
+
+#endif /* !JOURNAL_H */
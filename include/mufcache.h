@@ -0,0 +1,143 @@
+/** @file mufcache.h
+ *
+ * Header for the compiled MUF cache.
+ *
+ * When a program compiles, its code is saved next to its text as
+ * muf/<dbref>.mc.  The next time the program has to be compiled because
+ * nothing ran it since the server started, or since it was uncompiled to
+ * save memory, the saved code is loaded instead, as long as a compile
+ * would still produce the same thing.  That is checked with:
+ *
+ * - A fingerprint of the server version and its primitives, so that a
+ *   different server never loads code it did not compile.
+ * - A hash of the program text, read straight from the disk without
+ *   building the line list a compile needs.
+ * - The tune parameters that change how programs compile.
+ * - Everything else the compile looked at: the _defs/ directories it
+ *   included, the objects that $include and $ifver matched, the macros
+ *   it expanded, and the properties it read or set.  These are stored
+ *   with a hash of what they held, and compared with the database.
+ *
+ * Programs that use $ifcancall are never saved, since the answer depends
+ * on whether another program compiled.
+ *
+ * After the database loads, the most used programs by use count are
+ * compiled or loaded a few at a time, between commands, so that the first
+ * players to use them after a restart do not wait for them to compile.
+ *
+ * The cache is not available with DISKBASE, which shares the encoding
+ * helpers of the binary database.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#ifndef MUFCACHE_H
+#define MUFCACHE_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "inst.h"
+#include "interp.h"
+
+#define MUFCACHE_DEFS       1   /**< The _defs/ directory of an object */
+#define MUFCACHE_PROP       2   /**< A single property of an object */
+#define MUFCACHE_MATCH      3   /**< A directive's match, without "me" */
+#define MUFCACHE_MATCH_ME   4   /**< A directive's match, with "me" */
+#define MUFCACHE_MACRO      5   /**< A global editor macro */
+
+/**
+ * One thing a compile depended on.
+ */
+struct mufcache_dep {
+    int kind;           /**< One of the MUFCACHE_ kinds */
+    dbref ref;          /**< The object, or the player for a match */
+    char *name;         /**< The property, match or macro name, or NULL */
+    uint64_t value;     /**< A hash of what it held */
+    int read;           /**< True if the compile read it, not only set it */
+};
+
+/**
+ * Everything a compile depended on, gathered as it runs.
+ */
+struct mufcache_deps {
+    struct mufcache_dep *list;  /**< The dependencies */
+    int count;                  /**< The number of dependencies */
+    int size;                   /**< The number there is room for */
+    int uncacheable;            /**< True if the code must not be saved */
+};
+
+/**
+ * Record something a compile depended on
+ *
+ * Reads are hashed right away.  Things the compile only sets are hashed
+ * when the code is saved, once the compile has finished setting them.
+ *
+ * @param deps the dependencies of the compile
+ * @param kind one of the MUFCACHE_ kinds
+ * @param ref the object, or the player for a match
+ * @param name the property, match or macro name, or NULL for MUFCACHE_DEFS
+ * @param read true if the compile reads it, false if it only sets it
+ */
+void mufcache_note(struct mufcache_deps *deps, int kind, dbref ref,
+                   const char *name, int read);
+
+/**
+ * Free the dependencies of a compile
+ *
+ * @param deps the dependencies, which are left empty
+ */
+void mufcache_free_deps(struct mufcache_deps *deps);
+
+/**
+ * Save a program's newly compiled code
+ *
+ * Nothing is saved if the cache is turned off, the compile cannot be
+ * repeated, the program was compiled by someone other than its owner, or
+ * something the compile read changed before it finished.
+ *
+ * @param program the program
+ * @param player the player who compiled it
+ * @param deps everything the compile depended on
+ */
+void mufcache_save(dbref program, dbref player, struct mufcache_deps *deps);
+
+/**
+ * Load a program's saved code, if a compile would still produce it
+ *
+ * The program itself is not changed; on success the caller installs the
+ * code in place of whatever it had.
+ *
+ * @param program the program
+ * @param player the player who would compile it
+ * @param code set to the instructions
+ * @param siz set to the number of instructions
+ * @param start set to the index of the entry point
+ * @param pubs set to the public functions
+ * @return true if the code was loaded
+ */
+int mufcache_load(dbref program, dbref player, struct inst **code, int *siz,
+                  int *start, struct publics **pubs);
+
+/**
+ * Delete a program's saved code
+ *
+ * @param program the program
+ */
+void mufcache_remove(dbref program);
+
+/**
+ * Pick the programs to compile after the database loads
+ *
+ * These are the tp_muf_warmup most used programs that are not compiled.
+ */
+void mufcache_warmup_start(void);
+
+/**
+ * Compile or load the next program picked by mufcache_warmup_start
+ *
+ * @return true if there are more programs left to do
+ */
+int mufcache_warmup_step(void);
+
+#endif /* !MUFCACHE_H */
@@ -719,7 +719,12 @@ void prim_array_get_proplist(PRIM_PROTOTYPE);
  * Consumes a dbref and a dictionary.  Uses the dictionary keys as prop names
  * and sets those props to the corresponding values.  Permissions are respected.
  *
+ * All the permission checks are done before anything is set, so either all
+ * of the props are set or none are.  The props are then set as one batch
+ * so the propdir is only located once.
+ *
  * @see prop_write_perms
+ * @see set_property_batch
  *
  * @param player the player running the MUF program
  * @param program the program being run
@@ -731,6 +736,56 @@ void prim_array_get_proplist(PRIM_PROTOTYPE);
  */
 void prim_array_put_propvals(PRIM_PROTOTYPE);
 
+/**
+ * Implementation of MUF ARRAY_FETCH_PROPVALS
+ *
+ * Consumes a dbref, a string containing a propdir, and a list array of
+ * prop names within that propdir.  Puts a dictionary on the stack mapping
+ * each of those prop names that has a value to its value.  Props that
+ * are unset, have no value of their own, or that the program can't read
+ * are left out.
+ *
+ * This is the batched equivalent of a loop of GETPROPs; the propdir is
+ * located once for the whole list.  Only up to tp_max_propfetch names may
+ * be given.
+ *
+ * @see prop_read_perms
+ * @see get_property_batch
+ *
+ * @param player the player running the MUF program
+ * @param program the program being run
+ * @param mlev the effective MUCKER level
+ * @param pc the program counter pointer
+ * @param arg the argument stack
+ * @param top the top-most item of the stack
+ * @param fr the program frame
+ */
+void prim_array_fetch_propvals(PRIM_PROTOTYPE);
+
+/**
+ * Implementation of MUF ARRAY_DEL_PROPVALS
+ *
+ * Consumes a dbref, a string containing a propdir, and a list array of
+ * prop names within that propdir, and removes all of those props.  As with
+ * REMOVE_PROP, removing a propdir removes everything under it.
+ *
+ * All the permission checks are done before anything is removed, so
+ * either all of the props are removed or none are.  The props are then
+ * removed as one batch so the propdir is only located once.
+ *
+ * @see prop_write_perms
+ * @see remove_property_batch
+ *
+ * @param player the player running the MUF program
+ * @param program the program being run
+ * @param mlev the effective MUCKER level
+ * @param pc the program counter pointer
+ * @param arg the argument stack
+ * @param top the top-most item of the stack
+ * @param fr the program frame
+ */
+void prim_array_del_propvals(PRIM_PROTOTYPE);
+
 /**
  * Implementation of MUF ARRAY_PUT_PROPLIST
  *
@@ -1009,7 +1064,8 @@ void prim_array_notify_secure(PRIM_PROTOTYPE);
         prim_array_pin, prim_array_unpin, prim_array_get_ignorelist, \
         prim_array_nested_get, prim_array_nested_set, prim_array_nested_del, \
         prim_array_filter_flags, prim_array_interpret, prim_array_notify_secure, \
-        prim_array_default_pinning, prim_array_filter_lock
+        prim_array_default_pinning, prim_array_filter_lock, \
+        prim_array_fetch_propvals, prim_array_del_propvals
 
 /**
  * Array primitive function names
@@ -1032,6 +1088,7 @@ void prim_array_notify_secure(PRIM_PROTOTYPE);
         "ARRAY_PIN", "ARRAY_UNPIN", "ARRAY_GET_IGNORELIST", \
         "ARRAY_NESTED_GET", "ARRAY_NESTED_SET", "ARRAY_NESTED_DEL", \
         "ARRAY_FILTER_FLAGS", "ARRAY_INTERPRET", "ARRAY_NOTIFY_SECURE", \
-        "ARRAY_DEFAULT_PINNING", "ARRAY_FILTER_LOCK"
+        "ARRAY_DEFAULT_PINNING", "ARRAY_FILTER_LOCK", \
+        "ARRAY_FETCH_PROPVALS", "ARRAY_DEL_PROPVALS"
 
 #endif /* !P_ARRAY_H */
@@ -50,6 +50,7 @@ typedef struct pdata PData; /**< Data struct for setting data */
 struct plist {
     unsigned short flags;   /**< Flags */
     short height;           /**< AVL book-keeping  */
+    unsigned int dirsize;   /**< Bytes used by the props in this propdir */
     union pdata_u data;     /**< The different kinds of types */
     struct plist *left;     /**< Left node */
     struct plist *right;    /**< Right node */
@@ -114,6 +115,26 @@ typedef struct plist *PropPtr;
  */
 #define PropDir(x) ((x)->dir)
 
+/**
+ * Set the cached size of a prop's directory
+ *
+ * @param x the property
+ * @param y the number of bytes used by the props in the directory
+ */
+#define SetPDirSize(x,y) {(x)->dirsize = y;}
+
+/**
+ * Get the cached size of a prop's directory
+ *
+ * This is the number of bytes used by every property below 'x', kept up
+ * to date as properties are added and removed so the property tree does
+ * not have to be walked to find it.
+ *
+ * @param x the property to fetch a directory size for
+ * @return the number of bytes used by the props in the directory
+ */
+#define PropDirSize(x) ((x)->dirsize)
+
 /**
  * These set the different kinds of property values.
  *
@@ -313,6 +334,9 @@ void clear_propnode(PropPtr p);
  * It is used, for example, by \@clone and COPYOBJ to copy all the
  * properties on an object. Always copies "system" properties.
  *
+ * The cached propdir sizes of the copy are not set up; the caller should
+ * use resize_proplist once the copy has been attached to its new object.
+ *
  * @param old DBREF of original object.
  * @param copy_hidden_props if true, this copies hidden properties
  * @return a struct plist that is a copy of all properties on 'old'.
@@ -623,6 +647,27 @@ void free_propnode(PropPtr node);
  */
 PropPtr get_property(dbref player, const char *pname);
 
+/**
+ * Get several properties from the same propdir in one call.
+ *
+ * This is the batched version of get_property.  The propdir is fetched
+ * from the diskbase and located once, after which each name only costs
+ * a descent of the propdir's own tree.  Names may contain further
+ * propdirs, in which case they are looked up relative to 'dir'.
+ *
+ * For each name, the corresponding slot in 'out' is set to the found
+ * property or NULL if it does not exist.  Property values are fetched
+ * from the diskbase so they are ready to use.
+ *
+ * @param player the object to look for the properties on
+ * @param dir the propdir to look in; "" or "/" for the root
+ * @param names the property names relative to dir
+ * @param count the number of names
+ * @param out array of at least 'count' PropPtrs to store results in
+ */
+void get_property_batch(dbref player, const char *dir, const char **names,
+                        int count, PropPtr * out);
+
 /**
  * The name of this call is a little bit of a misnomer; this actually
  * returns the STRING property value of a given property name.  If the property
@@ -904,18 +949,23 @@ void parse_oprop(int descr, dbref player, dbref dest, dbref exit,
  * nothing.  If you delete a propdir, it will delete all child properties
  * within the propdir.
  *
+ * The cached sizes of the propdirs along the path are updated, and if
+ * 'freed' is not NULL, the number of bytes removed from the tree (including
+ * any propdirs removed for being left empty) is added to it.
+ *
  * This is something of a low-level call; you may rather use remove_property
  *
  * @see remove_property
  *
  * @param root The root property node to start your search
  * @param path the path you are searching for to delete.
+ * @param freed if not NULL, incremented by the number of bytes removed
  *
  * @return the updated root node with the property removed.  Because this
  *         mutates the passed structure, this is equivalent to the 'root'
  *         parameter.
  */
-PropPtr propdir_delete_elem(PropPtr root, char *path);
+PropPtr propdir_delete_elem(PropPtr root, char *path, size_t *freed);
 
 /**
  * This gets the first element of a propdir given a certain path.
@@ -984,16 +1034,23 @@ const char *propdir_name(const char *name);
  * particular offers the same flexibility as this call but operates with
  * dbrefs and lets you set a value in one call.
  *
+ * The cached sizes of the propdirs along the path are updated for any
+ * nodes that get created, and if 'added' is not NULL, the number of bytes
+ * added to the tree is added to it.  Changing the value of the returned
+ * node afterwards is up to the caller to account for.
+ *
  * @see add_property
  * @see set_property
+ * @see propdir_resize_elem
  *
  * @param root The root of the property directory structure.
  * @param path The path to create.
+ * @param added if not NULL, incremented by the number of bytes created
  *
  * @return the newly created node, or the existing node at the given path,
  *         or NULL on error
  */
-PropPtr propdir_new_elem(PropPtr * root, char *path);
+PropPtr propdir_new_elem(PropPtr * root, char *path, size_t *added);
 
 /**
  * Returns pointer to the next property after the given one in the given
@@ -1009,6 +1066,21 @@ PropPtr propdir_new_elem(PropPtr * root, char *path);
  */
 PropPtr propdir_next_elem(PropPtr root, char *path);
 
+/**
+ * Adjust the cached size of every propdir along a path.
+ *
+ * This is used to keep propdir sizes up to date when a property value
+ * changes size.  'delta' is applied to each propdir named in 'path',
+ * including the last one; propdirs that do not exist are skipped.
+ *
+ * @see propdir_name
+ *
+ * @param root The root of the property directory structure.
+ * @param path The path of the propdir that changed (will be modified).
+ * @param delta the number of bytes to add, or a negative number to remove.
+ */
+void propdir_resize_elem(PropPtr root, char *path, long delta);
+
 /**
  * Returns the path of the first unloaded propdir in a given path,
  * or NULL if all the propdirs to the path are loaded.  You will
@@ -1037,6 +1109,9 @@ const char *propdir_unloaded(PropPtr root, const char *path);
  * the end of the reflist.  This method does not allow refs to be
  * duplicate.
  *
+ * Reflists are parsed into a cached, sorted index, so checking if the
+ * ref is already on the list does not rescan the string.
+ *
  * @param obj The object to operate on
  * @param propname the property name for our reflist
  * @param toadd the ref to add to the reflist
@@ -1066,7 +1141,8 @@ void reflist_del(dbref obj, const char *propname, dbref todel);
  * #123 is position 1, #345 is position 2, and #678 is position 3.
  *
  * This method is in support of the REFLIST_FIND primitive which is why
- * the odd return value.
+ * the odd return value.  The reflist's cached index is binary searched,
+ * so repeated finds on the same list do not rescan the string.
  *
  * @param obj The object to work on
  * @param propname The reflist property name
@@ -1077,6 +1153,16 @@ void reflist_del(dbref obj, const char *propname, dbref todel);
  */
 int reflist_find(dbref obj, const char *propname, dbref tofind);
 
+/**
+ * Drop the cached reflist index for a property node, if there is one.
+ *
+ * This must be called whenever a property's value is changed or freed.
+ * clear_propnode and free_propnode take care of this.
+ *
+ * @param p the property node that is changing
+ */
+void reflist_forget(PropPtr p);
+
 /**
  * This removes a property from a given object, with diskbase handling.
  *
@@ -1085,6 +1171,22 @@ int reflist_find(dbref obj, const char *propname, dbref tofind);
  */
 void remove_property(dbref player, const char *pname);
 
+/**
+ * Remove several properties from the same propdir in one call.
+ *
+ * This is the batched version of remove_property.  As with that call,
+ * removing a propdir removes everything in it.  The propdir is fetched
+ * and located once and is itself removed if it is left empty.  The dirty
+ * state is updated once at the end; timestamps are left to the caller.
+ *
+ * @param player the object to remove the properties from
+ * @param dir the propdir the properties are in; "" or "/" for the root
+ * @param names the property names relative to dir
+ * @param count the number of properties to remove
+ */
+void remove_property_batch(dbref player, const char *dir, const char **names,
+                           int count);
+
 /**
  * This call is to remove ALL properties on an object; it is used
  * for \@set whatever=:clear exclusively at the time of this writing.
@@ -1112,6 +1214,20 @@ void remove_property_list(dbref player, int all);
  */
 void remove_property_nofetch(dbref player, const char *type);
 
+/**
+ * Recalculate the cached propdir sizes of a property AVL list.
+ *
+ * This walks the entire structure, setting the cached size of every
+ * propdir in it, and returns the total.  It is used after operations that
+ * build or rearrange a whole tree at once, such as copying properties.
+ *
+ * @see size_proplist
+ *
+ * @param avl the Property directory AVL to recalculate
+ * @return the size of the loaded properties in memory
+ */
+size_t resize_proplist(PropPtr avl);
+
 /**
  * This command is the underpinning of \@lock, \@flock, \@linklock and \@chlock.
  * Please note that part of this function's functionality relies on the
@@ -1211,6 +1327,28 @@ void set_standard_property(int descr, dbref player, const char *objname,
  */
 void set_property(dbref player, const char *pname, PData * dat);
 
+/**
+ * Set several properties in the same propdir in one call.
+ *
+ * This is the batched version of set_property, and 'dats' follows exactly
+ * the same rules as the 'dat' parameter there -- including the rule that
+ * locks are NOT copied and become owned by the property, and that setting
+ * an empty value removes the property.
+ *
+ * The propdir is fetched, located and created (if needed) once.  The
+ * object's diskbase dirty state and DBDIRTY are updated once at the end
+ * rather than once per property.  Timestamps are left to the caller, so it
+ * can call ts_modifyobject once for the whole batch.
+ *
+ * @param player the object to set the properties on
+ * @param dir the propdir to set the properties in; "" or "/" for the root
+ * @param names the property names relative to dir
+ * @param dats the property data for each name
+ * @param count the number of properties to set
+ */
+void set_property_batch(dbref player, const char *dir, const char **names,
+                        PData * dats, int count);
+
 /**
  * Sets the provided flags on a property named 'type' on object 'player'.
  *
@@ -1273,6 +1411,9 @@ void set_property_nofetch(dbref player, const char *pname, PData * dat);
  * size; this will give an accurate depiction of the total size, though
  * load = 0 will tell you the size of what is currently loaded in memory.
  *
+ * The size is kept as a running total as properties are set and removed,
+ * so this does not walk the property tree.
+ *
  * @param player The object to check
  * @param load a boolean who's use is described above.
  *
@@ -1283,7 +1424,8 @@ size_t size_properties(dbref player, int load);
 /**
  * Calculates the size of the given property directory AVL list.  This
  * will iterate over the entire structure to give the entire size.  It
- * is the low level equivalent of size_properties.
+ * is the low level equivalent of size_properties, and does not rely on
+ * the cached propdir sizes, so it can be used to check them.
  *
  * @see size_properties
  *
@@ -1293,6 +1435,16 @@ size_t size_properties(dbref player, int load);
  */
 size_t size_proplist(PropPtr avl);
 
+/**
+ * Calculates the size of a single property node: the node itself, its
+ * name and its loaded value.  Anything in the node's propdir is not
+ * included.
+ *
+ * @param p the property node to check
+ * @return the size of the node in memory
+ */
+size_t size_propnode(PropPtr p);
+
 /**
  * This function is a progressive iteration over the entire database,
  * keeping track of its last position with a static variable.  It will
@@ -0,0 +1,134 @@
+/** @file sampler.h
+ *
+ * Header for the sampling profiler for MUF and MPI.
+ *
+ * While the profile_sample_rate tune is set, a timer goes off that many
+ * times a second of CPU time the server uses.  The timer only sets a flag.
+ * The next time the MUF interpreter or the MPI parser gets to a safe place
+ * to look, it records where it is: the stack of programs and words that
+ * MUF is in, with the line it is on, or the stack of MPI functions.  Each
+ * distinct stack is counted in memory, and \@tops samples can show them or
+ * save them in the "folded" format that flame graph tools read.
+ *
+ * Samples due while neither MUF nor MPI is running are counted against
+ * a "[server]" stack, so that the counts show how the server's time is
+ * split as well as which words are busy.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <signal.h>
+
+#include "config.h"
+#include "inst.h"
+#include "interp.h"
+
+/**
+ * A stack that was sampled, and how many times
+ */
+struct sampled_stack {
+    const char *stack;      /**< The frames, outermost first, split by ; */
+    int count;              /**< The number of samples */
+};
+
+/**
+ * @var sampler_due
+ *      set by the timer when a sample should be taken, and cleared when it
+ *      is recorded
+ */
+extern volatile sig_atomic_t sampler_due;
+
+/**
+ * Note the MPI function being run at a level of MPI nesting
+ *
+ * The MPI parser calls this when it starts on a function's arguments, and
+ * again just before it runs the function, since the arguments may have
+ * run other functions more deeply nested.
+ *
+ * @param depth the MPI nesting level, starting at 1
+ * @param what the object whose MPI it is
+ * @param name the function name, which must stay valid
+ */
+void sampler_mpi_enter(int depth, dbref what, const char *name);
+
+/**
+ * Note that MPI has gone back to a level of nesting
+ *
+ * @param depth the MPI nesting level now, or 0 if no MPI is running
+ */
+void sampler_mpi_leave(int depth);
+
+/**
+ * Record a sample of the MPI functions being run
+ *
+ * This clears sampler_due.
+ *
+ * @param depth the MPI nesting level of the innermost function
+ */
+void sampler_mpi_sample(int depth);
+
+/**
+ * Record a sample of a running MUF program
+ *
+ * Each word that is running is a frame, innermost last, followed by a
+ * frame for the line being run.  If the program was run by MPI, the MPI
+ * functions come first.  This clears sampler_due.
+ *
+ * @param sys the program's system stack
+ * @param stop the top of the system stack
+ * @param program the program being run
+ * @param pc the instruction about to be run
+ */
+void sampler_muf_sample(struct stack_addr *sys, int stop, dbref program,
+                        struct inst *pc);
+
+/**
+ * Forget all the samples taken
+ */
+void sampler_reset(void);
+
+/**
+ * Save the samples in the folded stack format
+ *
+ * Each stack goes on a line of its own, followed by a space and the
+ * number of times it was sampled, which is what flame graph tools read.
+ *
+ * @param filename the file to write
+ * @return the number of stacks saved, or -1 if the file couldn't be written
+ */
+int sampler_save(const char *filename);
+
+/**
+ * Record a sample of the server when no MUF is running
+ *
+ * This is a sample of the MPI functions being run if there are any, or
+ * else of the "[server]" stack.  It clears sampler_due.
+ */
+void sampler_server(void);
+
+/**
+ * Get the most often sampled stacks
+ *
+ * The stacks are given busiest first.  They are only good until the next
+ * sample is taken or the samples are reset.
+ *
+ * @param list where to put the stacks
+ * @param count the most stacks to put in list
+ * @param total set to the number of samples taken altogether
+ * @return the number of stacks put in list
+ */
+int sampler_top(struct sampled_stack *list, int count, unsigned long *total);
+
+/**
+ * Start, stop or change the sampling timer to match profile_sample_rate
+ *
+ * This is cheap when nothing changed, and is called each time around the
+ * main loop and before each MUF program runs, so that a change to the tune
+ * takes effect right away.
+ */
+void sampler_update(void);
+
+#endif /* !SAMPLER_H */
@@ -109,11 +109,17 @@ extern const char *tp_create_fail_mesg;         /**< Tune variable */
 extern bool        tp_dark_sleepers;            /**< Tune variable */
 extern bool        tp_dbdump_warning;           /**< Tune variable */
 extern dbref       tp_default_room_parent;      /**< Tune variable */
+extern int         tp_delta_dumps_per_full;     /**< Tune variable */
 extern const char *tp_description_default;      /**< Tune variable */
 extern bool        tp_diskbase_propvals;        /**< Tune variable */
 extern bool        tp_do_mpi_parsing;           /**< Tune variable */
 extern bool        tp_do_welcome_parsing;       /**< Tune variable */
+extern bool        tp_dump_binary;              /**< Tune variable */
+extern int         tp_dump_compress_level;      /**< Tune variable */
+extern bool        tp_dump_delta;               /**< Tune variable */
 extern int         tp_dump_interval;            /**< Tune variable */
+extern int         tp_dump_io_limit;            /**< Tune variable */
+extern bool        tp_dump_ionice;              /**< Tune variable */
 extern int         tp_dump_warntime;            /**< Tune variable */
 extern const char *tp_dumpdone_mesg;            /**< Tune variable */
 extern bool        tp_dumpdone_warning;         /**< Tune variable */
@@ -149,6 +155,7 @@ extern const char *tp_file_mpihelp;             /**< Tune variable */
 extern const char *tp_file_mpihelp_dir;         /**< Tune variable */
 extern const char *tp_file_news;                /**< Tune variable */
 extern const char *tp_file_news_dir;            /**< Tune variable */
+extern const char *tp_file_profile_samples;     /**< Tune variable */
 extern const char *tp_file_welcome_screen;      /**< Tune variable */
 extern bool        tp_force_mlev1_name_notify;  /**< Tune variable */
 extern int         tp_free_frames_pool;         /**< Tune variable */
@@ -162,6 +169,9 @@ extern bool        tp_ieee_bounds_handling;     /**< Tune variable */
 extern bool        tp_ignore_bidirectional;     /**< Tune variable */
 extern bool        tp_ignore_support;           /**< Tune variable */
 extern int         tp_instr_slice;              /**< Tune variable */
+extern int         tp_instr_slice_msec;         /**< Tune variable */
+extern bool        tp_journal;                  /**< Tune variable */
+extern int         tp_journal_fsync_interval;   /**< Tune variable */
 extern const char *tp_leave_mesg;               /**< Tune variable */
 extern int         tp_link_cost;                /**< Tune variable */
 extern int         tp_listen_mlev;              /**< Tune variable */
@@ -184,6 +194,7 @@ extern int         tp_max_object_endowment;     /**< Tune variable */
 extern int         tp_max_output;               /**< Tune variable */
 extern int         tp_max_pennies;              /**< Tune variable */
 extern int         tp_max_plyr_processes;       /**< Tune variable */
+extern int         tp_max_preempt_msec;         /**< Tune variable */
 extern int         tp_max_process_limit;        /**< Tune variable */
 extern int         tp_max_propfetch;            /**< Tune variable */
 extern int         tp_maxidle;                  /**< Tune variable */
@@ -192,7 +203,11 @@ extern int         tp_movepennies_muf_mlev;     /**< Tune variable */
 extern bool        tp_mpi_continue_after_logout;    /**< Tune variable */
 extern int         tp_mpi_max_commands;         /**< Tune variable */
 extern const char *tp_muckname;                 /**< Tune variable */
+extern bool        tp_muf_cache;                /**< Tune variable */
 extern bool        tp_muf_comments_strict;      /**< Tune variable */
+extern bool        tp_muf_pair_stats;           /**< Tune variable */
+extern bool        tp_muf_prim_stats;           /**< Tune variable */
+extern int         tp_muf_warmup;               /**< Tune variable */
 extern const char *tp_new_program_flags;        /**< Tune variable */
 extern int         tp_object_cost;              /**< Tune variable */
 extern bool        tp_optimize_muf;             /**< Tune variable */
@@ -212,6 +227,7 @@ extern const char *tp_playermax_warnmesg;       /**< Tune variable */
 extern bool        tp_pname_history_reporting;  /**< Tune variable */
 extern int         tp_pname_history_threshold;  /**< Tune variable */
 extern int         tp_process_timer_limit;      /**< Tune variable */
+extern int         tp_profile_sample_rate;      /**< Tune variable */
 extern bool        tp_quiet_moves;              /**< Tune variable */
 extern bool        tp_realms_control;           /**< Tune variable */
 extern bool        tp_recognize_null_command;   /**< Tune variable */
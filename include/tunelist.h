@@ -57,11 +57,17 @@ const char *tp_create_fail_mesg;                    /**> Described below */
 bool        tp_dark_sleepers;                       /**> Described below */
 bool        tp_dbdump_warning;                      /**> Described below */
 dbref       tp_default_room_parent;                 /**> Described below */
+int         tp_delta_dumps_per_full;                /**> Described below */
 const char *tp_description_default;                 /**> Described below */
 bool        tp_diskbase_propvals;                   /**> Described below */
 bool        tp_do_mpi_parsing;                      /**> Described below */
 bool        tp_do_welcome_parsing;                  /**> Described below */
+bool        tp_dump_binary;                         /**> Described below */
+int         tp_dump_compress_level;                 /**> Described below */
+bool        tp_dump_delta;                          /**> Described below */
 int         tp_dump_interval;                       /**> Described below */
+int         tp_dump_io_limit;                       /**> Described below */
+bool        tp_dump_ionice;                         /**> Described below */
 int         tp_dump_warntime;                       /**> Described below */
 const char *tp_dumpdone_mesg;                       /**> Described below */
 bool        tp_dumpdone_warning;                    /**> Described below */
@@ -97,6 +103,7 @@ const char *tp_file_mpihelp;                        /**> Described below */
 const char *tp_file_mpihelp_dir;                    /**> Described below */
 const char *tp_file_news;                           /**> Described below */
 const char *tp_file_news_dir;                       /**> Described below */
+const char *tp_file_profile_samples;                /**> Described below */
 const char *tp_file_welcome_screen;                 /**> Described below */
 bool        tp_force_mlev1_name_notify;             /**> Described below */
 int         tp_free_frames_pool;                    /**> Described below */
@@ -110,6 +117,9 @@ bool        tp_ieee_bounds_handling;                /**> Described below */
 bool        tp_ignore_bidirectional;                /**> Described below */
 bool        tp_ignore_support;                      /**> Described below */
 int         tp_instr_slice;                         /**> Described below */
+int         tp_instr_slice_msec;                    /**> Described below */
+bool        tp_journal;                             /**> Described below */
+int         tp_journal_fsync_interval;              /**> Described below */
 const char *tp_leave_mesg;                          /**> Described below */
 int         tp_link_cost;                           /**> Described below */
 int         tp_listen_mlev;                         /**> Described below */
@@ -132,6 +142,7 @@ int         tp_max_object_endowment;                /**> Described below */
 int         tp_max_output;                          /**> Described below */
 int         tp_max_pennies;                         /**> Described below */
 int         tp_max_plyr_processes;                  /**> Described below */
+int         tp_max_preempt_msec;                    /**> Described below */
 int         tp_max_process_limit;                   /**> Described below */
 int         tp_max_propfetch;                       /**> Described below */
 int         tp_maxidle;                             /**> Described below */
@@ -140,7 +151,11 @@ int         tp_movepennies_muf_mlev;                /**> Described below */
 bool        tp_mpi_continue_after_logout;           /**> Described below */
 int         tp_mpi_max_commands;                    /**> Described below */
 const char *tp_muckname;                            /**> Described below */
+bool        tp_muf_cache;                           /**> Described below */
 bool        tp_muf_comments_strict;                 /**> Described below */
+bool        tp_muf_pair_stats;                      /**> Described below */
+bool        tp_muf_prim_stats;                      /**> Described below */
+int         tp_muf_warmup;                          /**> Described below */
 const char *tp_new_program_flags;                   /**> Described below */
 int         tp_object_cost;                         /**> Described below */
 bool        tp_optimize_muf;                        /**> Described below */
@@ -160,6 +175,7 @@ const char *tp_playermax_warnmesg;                  /**> Described below */
 bool        tp_pname_history_reporting;             /**> Described below */
 int         tp_pname_history_threshold;             /**> Described below */
 int         tp_process_timer_limit;                 /**> Described below */
+int         tp_profile_sample_rate;                 /**> Described below */
 bool        tp_quiet_moves;                         /**> Described below */
 bool        tp_realms_control;                      /**> Described below */
 bool        tp_recognize_null_command;              /**> Described below */
@@ -529,6 +545,18 @@ struct tune_entry tune_list[] = {
         false,
         TYPE_ROOM
     },
+    {
+        "delta_dumps_per_full",
+        "Delta dumps to save between full dumps",
+        "DB Dumps",
+        "",
+        TP_TYPE_INTEGER,
+        .defaultval.n=12,
+        .currentval.n=&tp_delta_dumps_per_full,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "description_default",
         "Default description",
@@ -577,6 +605,42 @@ struct tune_entry tune_list[] = {
         MLEV_WIZARD,
         true
     },
+    {
+        "dump_binary",
+        "Save the database in the binary format (not with DISKBASE)",
+        "DB Dumps",
+        "",
+        TP_TYPE_BOOLEAN,
+        .defaultval.b=false,
+        .currentval.b=&tp_dump_binary,
+        0,
+        MLEV_WIZARD,
+        true
+    },
+    {
+        "dump_compress_level",
+        "Compression level for text dumps, 0 for none (not with DISKBASE)",
+        "DB Dumps",
+        "",
+        TP_TYPE_INTEGER,
+        .defaultval.n=0,
+        .currentval.n=&tp_dump_compress_level,
+        0,
+        MLEV_WIZARD,
+        true
+    },
+    {
+        "dump_delta",
+        "Only save changed objects between full dumps (not with DISKBASE)",
+        "DB Dumps",
+        "",
+        TP_TYPE_BOOLEAN,
+        .defaultval.b=false,
+        .currentval.b=&tp_dump_delta,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "dump_interval",
         "Interval between dumps",
@@ -589,6 +653,30 @@ struct tune_entry tune_list[] = {
         MLEV_WIZARD,
         true
     },
+    {
+        "dump_io_limit",
+        "Bytes per second a forked dump may write (0 for no limit)",
+        "DB Dumps",
+        "",
+        TP_TYPE_INTEGER,
+        .defaultval.n=0,
+        .currentval.n=&tp_dump_io_limit,
+        0,
+        MLEV_WIZARD,
+        true
+    },
+    {
+        "dump_ionice",
+        "Give forked dumps the lowest disk priority (Linux only)",
+        "DB Dumps",
+        "",
+        TP_TYPE_BOOLEAN,
+        .defaultval.b=false,
+        .currentval.b=&tp_dump_ionice,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "dump_warntime",
         "Interval between warning and dump",
@@ -1009,6 +1097,18 @@ struct tune_entry tune_list[] = {
         MLEV_GOD,
         true
     },
+    {
+        "file_profile_samples",
+        "Profiler samples saved by @tops samples save",
+        "Files",
+        "",
+        TP_TYPE_STRING,
+        .defaultval.s="logs/profile-samples",
+        .currentval.s=&tp_file_profile_samples,
+        MLEV_WIZARD,
+        MLEV_GOD,
+        true
+    },
     {
         "file_welcome_screen",
         "Opening screen",
@@ -1165,6 +1265,42 @@ struct tune_entry tune_list[] = {
         MLEV_WIZARD,
         true
     },
+    {
+        "instr_slice_msec",
+        "Max. milliseconds per timeslice, (0 = no limit)",
+        "MUF",
+        "",
+        TP_TYPE_INTEGER,
+        .defaultval.n=0,
+        .currentval.n=&tp_instr_slice_msec,
+        0,
+        MLEV_WIZARD,
+        true
+    },
+    {
+        "journal",
+        "Journal changes between dumps for crash recovery (not with DISKBASE)",
+        "DB Dumps",
+        "",
+        TP_TYPE_BOOLEAN,
+        .defaultval.b=false,
+        .currentval.b=&tp_journal,
+        0,
+        MLEV_WIZARD,
+        true
+    },
+    {
+        "journal_fsync_interval",
+        "Interval between journal writes to disk",
+        "DB Dumps",
+        "",
+        TP_TYPE_TIMESPAN,
+        .defaultval.t=1,
+        .currentval.t=&tp_journal_fsync_interval,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "leave_mesg",
         "Logoff message for QUIT",
@@ -1434,6 +1570,18 @@ struct tune_entry tune_list[] = {
         MLEV_WIZARD,
         true
     },
+    {
+        "max_preempt_msec",
+        "Max. MUF preempt run time in milliseconds below ML4, (0 = no limit)",
+        "MUF",
+        "",
+        TP_TYPE_INTEGER,
+        .defaultval.n=0,
+        .currentval.n=&tp_max_preempt_msec,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "max_process_limit",
         "Total concurrent processes allowed on system",
@@ -1530,6 +1678,18 @@ struct tune_entry tune_list[] = {
         MLEV_WIZARD,
         true
     },
+    {
+        "muf_cache",
+        "Save compiled MUF to disk and reuse it until it changes",
+        "MUF",
+        "",
+        TP_TYPE_BOOLEAN,
+        .defaultval.b=true,
+        .currentval.b=&tp_muf_cache,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "muf_comments_strict",
         "MUF comments are strict and not recursive",
@@ -1542,6 +1702,42 @@ struct tune_entry tune_list[] = {
         MLEV_WIZARD,
         true
     },
+    {
+        "muf_pair_stats",
+        "Count pairs of MUF instructions run, for @tops pairs",
+        "MUF",
+        "",
+        TP_TYPE_BOOLEAN,
+        .defaultval.b=false,
+        .currentval.b=&tp_muf_pair_stats,
+        0,
+        MLEV_WIZARD,
+        true
+    },
+    {
+        "muf_prim_stats",
+        "Count and time MUF primitives run, for @tops prims",
+        "MUF",
+        "",
+        TP_TYPE_BOOLEAN,
+        .defaultval.b=false,
+        .currentval.b=&tp_muf_prim_stats,
+        0,
+        MLEV_WIZARD,
+        true
+    },
+    {
+        "muf_warmup",
+        "Most used programs to compile in the background at startup",
+        "MUF",
+        "",
+        TP_TYPE_INTEGER,
+        .defaultval.n=100,
+        .currentval.n=&tp_muf_warmup,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "new_program_flags",
         "Initial flags for newly created programs",
@@ -1779,6 +1975,18 @@ struct tune_entry tune_list[] = {
         MLEV_WIZARD,
         true
     },
+    {
+        "profile_sample_rate",
+        "Times a second to sample running MUF and MPI, for @tops samples",
+        "Tuning",
+        "",
+        TP_TYPE_INTEGER,
+        .defaultval.n=0,
+        .currentval.n=&tp_profile_sample_rate,
+        0,
+        MLEV_WIZARD,
+        true
+    },
     {
         "quiet_moves",
         "Suppress basic arrive and depart notifications",
@@ -7,6 +7,7 @@
  */
 
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,10 +19,13 @@
 #include "boolexp.h"
 #include "fbmath.h"
 #include "fbstrings.h"
+#include "hashtab.h"
 #include "inst.h"
 #include "interface.h"
 #include "interp.h"
 
+#define ARRAY_MIN_CAPACITY  8   /**< Least room a growing packed array gets */
+
 /* This keeps track of all active arrays but its not clear to me exactly
  * how (or why) this is used
  *
@@ -499,6 +503,50 @@ array_tree_find(array_tree * avl, array_iter * key)
     return avl;
 }
 
+/**
+ * Get a node that no other tree shares, so that it may be changed
+ *
+ * If the node is shared, it is copied, and the copy takes its place in
+ * this tree.  The copy shares the node's children, so anything changing
+ * the tree calls this for each node on its way down.
+ *
+ * @private
+ * @param node the pointer to the node, which is updated if it is copied
+ * @return the node to change, or NULL if there is none
+ */
+static array_tree *
+array_tree_own(array_tree ** node)
+{
+    array_tree *nu;
+    array_tree *p = *node;
+
+    if (p == NULL || p->links < 2)
+        return p;
+
+    nu = malloc(sizeof(array_tree));
+    if (!nu) {
+        fprintf(stderr, "array_tree_own(): Out of Memory!\n");
+        abort();
+    }
+
+    nu->left = p->left;
+    nu->right = p->right;
+    nu->links = 1;
+    nu->height = p->height;
+    copyinst(&p->key, &nu->key);
+    copyinst(&p->data, &nu->data);
+
+    if (nu->left)
+        nu->left->links++;
+
+    if (nu->right)
+        nu->right->links++;
+
+    p->links--;
+    *node = nu;
+    return nu;
+}
+
 /**
  * Get the height of the given node
  *
@@ -560,7 +608,7 @@ array_tree_rotate_left_single(array_tree * a)
 {
     array_tree *b;
     assert(a != NULL);
-    b = a->right;
+    b = array_tree_own(&a->right);
 
     a->right = b->left;
     b->left = a;
@@ -583,10 +631,9 @@ array_tree_rotate_left_double(array_tree * a)
 {
     array_tree *b, *c;
     assert(a != NULL);
-    b = a->right;
-    c = b->left;
-
+    b = array_tree_own(&a->right);
     assert(b != NULL);
+    c = array_tree_own(&b->left);
     assert(c != NULL);
 
     a->right = c->left;
@@ -613,7 +660,7 @@ array_tree_rotate_right_single(array_tree * a)
 {
     array_tree *b;
     assert(a != NULL);
-    b = a->left;
+    b = array_tree_own(&a->left);
 
     a->left = b->right;
     b->right = a;
@@ -636,10 +683,9 @@ array_tree_rotate_right_double(array_tree * a)
 {
     array_tree *b, *c;
     assert(a != NULL);
-    b = a->left;
-    c = b->right;
-
+    b = array_tree_own(&a->left);
     assert(b != NULL);
+    c = array_tree_own(&b->right);
     assert(c != NULL);
 
     a->left = c->right;
@@ -714,6 +760,7 @@ array_tree_alloc_node(array_iter * key)
 
     new_node->left = NULL;
     new_node->right = NULL;
+    new_node->links = 1;
     new_node->height = 1;
 
     copyinst(key, &(new_node->key));
@@ -731,7 +778,8 @@ array_tree_alloc_node(array_iter * key)
  * inappropriately interfering with another.
  *
  * Note that if the pointer that avl points to is NULL, it will be replaced
- * with a valid node.
+ * with a valid node.  Any shared nodes on the way to the key are copied,
+ * so the node returned may be changed.
  *
  * @private
  * @param avl the AVL tree to work on.
@@ -742,13 +790,15 @@ static array_tree *
 array_tree_insert(array_tree ** avl, array_iter * key)
 {
     array_tree *ret;
-    array_tree *p = *avl;
+    array_tree *p;
     int cmp;
     static short balancep;
 
     assert(avl != NULL);
     assert(key != NULL);
 
+    p = array_tree_own(avl);
+
     if (p) {
         cmp = array_tree_compare(key, &(p->key), 0);
 
@@ -815,7 +865,7 @@ array_tree_remove_node(array_iter * key, array_tree ** root)
     assert(root != NULL);
     assert(*root != NULL);
     assert(key != NULL);
-    avl = *root;
+    avl = array_tree_own(root);
 
     save = avl;
 
@@ -896,6 +946,8 @@ array_tree_delete(array_iter * key, array_tree * avl)
 /**
  * Delete all the nodes in a tree, recursively.
  *
+ * Nodes that another tree still shares are left alone.
+ *
  * @private
  * @param p the tree to clear out
  */
@@ -905,6 +957,9 @@ array_tree_delete_all(array_tree * p)
     if (p == NULL)
         return;
 
+    if (--p->links > 0)
+        return;
+
     array_tree_delete_all(p->left);
     p->left = NULL;
     array_tree_delete_all(p->right);
@@ -1080,6 +1135,7 @@ new_array(int pin)
     nu->links = 1;
     nu->type = ARRAY_UNDEFINED;
     nu->items = 0;
+    nu->capacity = 0;
     nu->pinned = pin;
     nu->data.packed = NULL;
     nu->list_node.prev = nu->list_node.next = NULL;
@@ -1114,6 +1170,7 @@ new_array_packed(int size, int pin)
     if (size < 1)
         size = 1;
 
+    nu->capacity = size;
     nu->data.packed = malloc(sizeof(array_data) * (size_t)size);
 
     if (nu->data.packed == NULL) {
@@ -1147,6 +1204,95 @@ new_array_dictionary(int pin)
     return nu;
 }
 
+/**
+ * Change the number of items a packed array has room for
+ *
+ * @private
+ * @param arr the packed array
+ * @param capacity the number of items to make room for, at least 1
+ */
+static void
+array_packed_resize(stk_array * arr, int capacity)
+{
+    if (capacity < 1)
+        capacity = 1;
+
+    arr->data.packed = realloc(arr->data.packed,
+                               sizeof(array_data) * (size_t)capacity);
+
+    if (arr->data.packed == NULL) {
+        fprintf(stderr, "array_packed_resize(): Out of Memory!");
+        abort();
+    }
+
+    arr->capacity = capacity;
+}
+
+/**
+ * Make sure a packed array has room for a number of items
+ *
+ * When the array has to grow, it grows to at least twice the room it had,
+ * so that adding items one at a time takes only a few reallocs.
+ *
+ * @private
+ * @param arr the packed array
+ * @param items the number of items it needs room for
+ */
+static void
+array_packed_grow(stk_array * arr, int items)
+{
+    int capacity;
+
+    if (items <= arr->capacity)
+        return;
+
+    capacity = (arr->capacity > INT_MAX / 2) ? INT_MAX : arr->capacity * 2;
+
+    if (capacity < items)
+        capacity = items;
+
+    if (capacity < ARRAY_MIN_CAPACITY)
+        capacity = ARRAY_MIN_CAPACITY;
+
+    array_packed_resize(arr, capacity);
+}
+
+/**
+ * Make room in a packed array for a number of items
+ *
+ * This is for code that knows how many items it is about to add, so the
+ * array grows once to just the size needed.  It does nothing to a
+ * dictionary, or to an array that already has the room.
+ *
+ * @param arr the array
+ * @param items the number of items, including those already in the array
+ */
+void
+array_reserve(stk_array * arr, int items)
+{
+    if (!arr || arr->type != ARRAY_PACKED || items <= arr->capacity)
+        return;
+
+    array_packed_resize(arr, items);
+}
+
+/**
+ * Give back the unused room in a packed array
+ *
+ * This does nothing to a dictionary.
+ *
+ * @param arr the array
+ */
+void
+array_shrink(stk_array * arr)
+{
+    if (!arr || arr->type != ARRAY_PACKED || arr->capacity <= arr->items
+        || arr->capacity == 1)
+        return;
+
+    array_packed_resize(arr, arr->items);
+}
+
 /**
  * Make a "decoupled" copy of an array object
  *
@@ -1154,6 +1300,9 @@ new_array_dictionary(int pin)
  * The nomenclature of "decouple" is because it is most often used to
  * copy an unpinned array so that a copy may diverge from the original.
  *
+ * A dictionary's copy shares the original's tree, and each of them copies
+ * only the nodes it changes, as it changes them.
+ *
  * Most of the possible errors here are memory allocation related and will
  * result in an abort(...) call.
  *
@@ -1179,7 +1328,8 @@ array_decouple(stk_array * arr)
              * simple.  Allocate a new memory block then copy it.
              */
             nu->items = arr->items;
-            nu->data.packed = malloc(sizeof(array_data) * (size_t)arr->items);
+            nu->capacity = arr->items ? arr->items : 1;
+            nu->data.packed = malloc(sizeof(array_data) * (size_t)nu->capacity);
 
             if (nu->data.packed == NULL) {
                 fprintf(stderr, "array_decouple(): Out of Memory!");
@@ -1193,23 +1343,14 @@ array_decouple(stk_array * arr)
             return nu;
         }
 
-        case ARRAY_DICTIONARY:{
-            array_iter idx;
-            array_data *val;
+        case ARRAY_DICTIONARY:
+            nu->items = arr->items;
+            nu->data.dict = arr->data.dict;
 
-            /* When iterating over the dictionary, 'array_setitem' will
-             * make a copy of the item provided.
-             */
-            if (array_first(arr, &idx)) {
-                do {
-                    val = array_getitem(arr, &idx);
-                    assert(val != NULL);
-                    array_setitem(&nu, &idx, val);
-                } while (array_next(arr, &idx));
-            }
+            if (nu->data.dict)
+                nu->data.dict->links++;
 
             return nu;
-        }
 
         default:
             break;
@@ -1617,14 +1758,7 @@ array_setitem(stk_array ** harr, array_iter * idx, array_data * item)
                 /* @TODO : This code looks pretty similar to array_insertitem
                  *         We should probably converge the two.
                  */
-                arr->data.packed =
-                        realloc(arr->data.packed, sizeof(array_data) * (size_t)(arr->items + 1));
-
-                if (arr->data.packed == NULL) {
-                    fprintf(stderr, "array_setitem(): Out of Memory!");
-                    abort();
-                }
-
+                array_packed_grow(arr, arr->items + 1);
                 copyinst(item, &arr->data.packed[arr->items]);
                 return (++arr->items);
             } else {
@@ -1643,15 +1777,11 @@ array_setitem(stk_array ** harr, array_iter * idx, array_data * item)
                 arr = *harr = array_decouple(arr);
             }
 
-            p = array_tree_find(arr->data.dict, idx);
-
-            if (p) {
-                CLEAR(&p->data);
-            } else {
+            if (!array_tree_find(arr->data.dict, idx))
                 arr->items++;
-                p = array_tree_insert(&arr->data.dict, idx);
-            }
 
+            p = array_tree_insert(&arr->data.dict, idx);
+            CLEAR(&p->data);
             copyinst(item, &p->data);
             return arr->items;
         }
@@ -1707,19 +1837,12 @@ array_insertitem(stk_array ** harr, array_iter * idx, array_data * item)
                 arr = *harr = array_decouple(arr);
             }
 
-            arr->data.packed =
-                    realloc(arr->data.packed, sizeof(array_data) * (size_t)(arr->items + 1));
-
-            if (arr->data.packed == NULL) {
-                fprintf(stderr, "array_insertitem(): Out of Memory!");
-                abort();
-            }
-
-            for (i = arr->items++; i > idx->data.number; i--) {
-                copyinst(&arr->data.packed[i - 1], &arr->data.packed[i]);
-                CLEAR(&arr->data.packed[i - 1]);
-            }
+            array_packed_grow(arr, arr->items + 1);
 
+            /* Move the items after idx up to make space */
+            i = idx->data.number;
+            memmove(&arr->data.packed[i + 1], &arr->data.packed[i],
+                    sizeof(array_data) * (size_t)(arr->items++ - i));
             copyinst(item, &arr->data.packed[i]);
             return arr->items;
         }
@@ -1732,15 +1855,11 @@ array_insertitem(stk_array ** harr, array_iter * idx, array_data * item)
                 arr = *harr = array_decouple(arr);
             }
 
-            p = array_tree_find(arr->data.dict, idx);
-
-            if (p) {
-                CLEAR(&p->data);
-            } else {
+            if (!array_tree_find(arr->data.dict, idx))
                 arr->items++;
-                p = array_tree_insert(&arr->data.dict, idx);
-            }
 
+            p = array_tree_insert(&arr->data.dict, idx);
+            CLEAR(&p->data);
             copyinst(item, &p->data);
             return arr->items;
         }
@@ -1787,6 +1906,48 @@ array_appenditem(stk_array ** harr, array_data * item)
     return array_setitem(harr, &key, item);
 }
 
+/**
+ * Append a number of items to the end of an array
+ *
+ * This only works with ARRAY_PACKED arrays.  The items are copied, and the
+ * array grows just once to make room for them.
+ *
+ * @see array_appenditem
+ *
+ * @param harr Pointer to a pointer, the array you wish to operate on.
+ * @param items The items to add to the array.
+ * @param count The number of items.
+ * @return -1 on error, number of items in array on success
+ */
+int
+array_appenditems(stk_array ** harr, array_data * items, int count)
+{
+    stk_array *arr;
+
+    assert(harr != NULL);
+    assert(*harr != NULL);
+
+    if (!harr || !*harr || count < 0)
+        return -1;
+
+    arr = *harr;
+
+    if (arr->type != ARRAY_PACKED)
+        return -1;
+
+    if (arr->links > 1 && !arr->pinned) {
+        arr->links--;
+        arr = *harr = array_decouple(arr);
+    }
+
+    array_packed_grow(arr, arr->items + count);
+
+    for (int i = 0; i < count; i++)
+        copyinst(&items[i], &arr->data.packed[arr->items++]);
+
+    return arr->items;
+}
+
 /**
  * Return a range of values from an array, and returns it as a new array.
  *
@@ -1997,6 +2158,7 @@ array_setrange(stk_array ** harr, array_iter * start, stk_array * inarr)
              *        isn't very efficient.  Can we converge this code with
              *        array_insertset?
              */
+            array_packed_grow(arr, start->data.number + inarr->items);
 
             if (array_first(inarr, &idx)) {
                 do {
@@ -2060,7 +2222,6 @@ array_insertrange(stk_array ** harr, array_iter * start, stk_array * inarr)
     stk_array *arr;
     array_data *itm;
     array_iter idx;
-    array_iter didx;
     int copied_inarr = 0;
 
     assert(harr != NULL);
@@ -2113,27 +2274,14 @@ array_insertrange(stk_array ** harr, array_iter * start, stk_array * inarr)
                 arr = *harr = array_decouple(arr);
             }
 
-            arr->data.packed = realloc(arr->data.packed,
-                    sizeof(array_data) * (size_t)(arr->items + inarr->items));
-
-            if (arr->data.packed == NULL) {
-                fprintf(stderr, "array_insertrange: Out of Memory!");
-                abort();
-            }
-
-            copyinst(start, &idx);
-            copyinst(start, &didx);
-            idx.data.number = arr->items - 1;
-            didx.data.number = arr->items + inarr->items - 1;
+            array_packed_grow(arr, arr->items + inarr->items);
 
             /* Move existing items to make space */
-            while (idx.data.number >= start->data.number) {
-                itm = array_getitem(arr, &idx);
-                copyinst(itm, &arr->data.packed[didx.data.number]);
-                CLEAR(itm);
-                idx.data.number--;
-                didx.data.number--;
-            }
+            memmove(&arr->data.packed[start->data.number + inarr->items],
+                    &arr->data.packed[start->data.number],
+                    sizeof(array_data)
+                    * (size_t)(arr->items - start->data.number));
+            copyinst(start, &idx);
 
             /* Copy inarr into the space made. */
             idx.data.number = 0;
@@ -2193,11 +2341,8 @@ int
 array_delrange(stk_array ** harr, array_iter * start, array_iter * end)
 {
     stk_array *arr;
-    array_data *itm;
     int sidx, eidx;
-    size_t totsize;
     array_iter idx;
-    array_iter didx;
 
     assert(harr != NULL);
     assert(*harr != NULL);
@@ -2255,29 +2400,19 @@ array_delrange(stk_array ** harr, array_iter * start, array_iter * end)
 
             start->data.number = sidx;
             end->data.number = eidx;
-            copyinst(end, &idx);
-            copyinst(start, &didx);
-            idx.data.number += 1;
-
-            /* Shift items down in the array */
-            while (idx.data.number < arr->items) {
-                itm = array_getitem(arr, &idx);
-                copyinst(itm, &arr->data.packed[didx.data.number]);
-                CLEAR(itm);
-                idx.data.number++;
-                didx.data.number++;
+
+            /* Clear the deleted items, then shift the rest down over them */
+            for (int i = sidx; i <= eidx; i++) {
+                CLEAR(&arr->data.packed[i]);
             }
 
+            memmove(&arr->data.packed[sidx], &arr->data.packed[eidx + 1],
+                    sizeof(array_data) * (size_t)(arr->items - eidx - 1));
             arr->items -= (eidx - sidx + 1);
-            totsize = (size_t)((arr->items) ? arr->items : 1);
-
-            /* Shrink the packed data area */
-            arr->data.packed =
-                    realloc(arr->data.packed, sizeof(array_data) * totsize);
 
-            if (arr->data.packed == NULL) {
-                fprintf(stderr, "array_delrange(): Out of Memory!");
-                abort();
+            /* Give back most of the room once the array is mostly empty */
+            if (arr->items < arr->capacity / 4) {
+                array_packed_resize(arr, arr->items * 2);
             }
 
             return arr->items;
@@ -2489,6 +2624,169 @@ array_mash(stk_array * arr_in, stk_array ** mash, int value)
     }
 }
 
+/**
+ * A value being counted by array_mash_hashed()
+ */
+struct mash_entry {
+    array_data *val;    /**< The value, or NULL if the entry is unused */
+    int count;          /**< The total for the value so far */
+};
+
+/**
+ * Get the hash of a value for array_mash_hashed()
+ *
+ * @private
+ * @param val the value, an integer, dbref or string
+ * @param size the size of the hash table, a power of two
+ * @return the hash of the value, between 0 and size - 1
+ */
+static unsigned int
+array_mash_hash(array_data * val, unsigned int size)
+{
+    if (val->type == PROG_STRING)
+        return hash(DoNullInd(val->data.string), size);
+
+    return ((unsigned int) val->data.number * 2654435761U) & (size - 1);
+}
+
+/**
+ * Sort values for array_mash_hashed() into dictionary key order
+ *
+ * @private
+ * @param a the first value
+ * @param b the second value
+ * @return less than, equal to, or greater than 0 as for qsort
+ */
+static int
+array_mash_cmp(const void *a, const void *b)
+{
+    return array_tree_compare(*(array_data * const *) a,
+                              *(array_data * const *) b, 0);
+}
+
+/**
+ * Mash several arrays together and demote the result, using a hash table
+ *
+ * This gives the same list as calling array_mash() on each array in turn,
+ * with first_value for the first and value for the rest, and then
+ * array_demote_only() with the threshold.  Rather than building a
+ * dictionary, it counts the values in a hash table, and only sorts the
+ * values that are kept.  Strings are matched without regard to case, as
+ * dictionary keys are, and the first one seen is the one kept.
+ *
+ * It only works when every value in the arrays is an integer, every one
+ * is a dbref, or every one is a string.  Otherwise it returns NULL, and
+ * the caller should use array_mash() instead.
+ *
+ * @param arrs the arrays to mash
+ * @param count the number of arrays
+ * @param first_value the value to add for each item in the first array
+ * @param value the value to add for each item in the other arrays
+ * @param threshold the least total a value needs to be kept
+ * @param pin is pinning turned on?
+ * @return the packed array of values kept, or NULL if the values are not
+ *         all of one type that can be hashed
+ */
+stk_array *
+array_mash_hashed(stk_array ** arrs, int count, int first_value, int value,
+                  int threshold, int pin)
+{
+    struct mash_entry *table;
+    array_data **kept;
+    array_data *val;
+    array_iter idx;
+    stk_array *nu;
+    unsigned int size = 16;
+    int total = 0;
+    int nkept = 0;
+    int typ = PROG_INTEGER;
+
+    for (int i = 0; i < count; i++) {
+        if (!arrs[i])
+            return NULL;
+
+        if (!total && array_first(arrs[i], &idx)) {
+            typ = array_getitem(arrs[i], &idx)->type;
+            CLEAR(&idx);
+        }
+
+        total += array_count(arrs[i]);
+    }
+
+    if (typ != PROG_INTEGER && typ != PROG_OBJECT && typ != PROG_STRING)
+        return NULL;
+
+    for (int i = 0; i < count; i++) {
+        if (!array_is_homogenous(arrs[i], typ))
+            return NULL;
+    }
+
+    /* Keep the table at most half full */
+    while (size < (unsigned int) total * 2)
+        size *= 2;
+
+    if (!(table = calloc(size, sizeof(struct mash_entry)))) {
+        fprintf(stderr, "array_mash_hashed(): Out of Memory!");
+        abort();
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!array_first(arrs[i], &idx))
+            continue;
+
+        do {
+            struct mash_entry *e;
+
+            val = array_getitem(arrs[i], &idx);
+
+            for (unsigned int h = array_mash_hash(val, size);;
+                 h = (h + 1) & (size - 1)) {
+                e = &table[h];
+
+                if (!e->val)
+                    break;
+
+                if (typ == PROG_STRING
+                    ? !strcasecmp(DoNullInd(e->val->data.string),
+                                  DoNullInd(val->data.string))
+                    : e->val->data.number == val->data.number)
+                    break;
+            }
+
+            if (!e->val) {
+                e->val = val;
+                nkept++;
+            }
+
+            e->count += i ? value : first_value;
+        } while (array_next(arrs[i], &idx));
+    }
+
+    if (!(kept = malloc(sizeof(array_data *) * (size_t) (nkept ? nkept : 1)))) {
+        fprintf(stderr, "array_mash_hashed(): Out of Memory!");
+        abort();
+    }
+
+    nkept = 0;
+
+    for (unsigned int h = 0; h < size; h++) {
+        if (table[h].val && table[h].count >= threshold)
+            kept[nkept++] = table[h].val;
+    }
+
+    qsort(kept, (size_t) nkept, sizeof(array_data *), array_mash_cmp);
+
+    nu = new_array_packed(0, pin);
+    array_reserve(nu, nkept);
+
+    for (int i = 0; i < nkept; i++)
+        array_appenditem(&nu, kept[i]);
+
+    free(kept);
+    free(table);
+    return nu;
+}
+
 /**
  * Checks to see if an array only contains the given type
  *
@@ -2509,6 +2807,7 @@ array_is_homogenous(stk_array * arr, int typ)
             dat = array_getitem(arr, &idx);
 
             if (dat->type != typ) {
+                CLEAR(&idx);
                 return 0;
             }
         } while (array_next(arr, &idx));
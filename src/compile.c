@@ -29,6 +29,7 @@
 #include "log.h"
 #include "match.h"
 #include "mcp.h"
+#include "mufcache.h"
 #include "props.h"
 #include "timequeue.h"
 #include "tune.h"
@@ -67,6 +68,12 @@
  */
 #define ADDRLIST_ALLOC_CHUNK_SIZE 256
 
+/*
+ * Calls to procedures with at most this many instructions, not counting
+ * the EXIT at the end, may be replaced with a copy of the procedure.
+ */
+#define INLINE_MAX_SIZE 8
+
 #define abort_compile(ST,C) { do_abort_compile(ST,C); return 0; }
 #define v_abort_compile(ST,C) { do_abort_compile(ST,C); return; }
 #define free_prog(i) free_prog_real(i,__FILE__,__LINE__);
@@ -172,10 +179,18 @@ typedef struct COMPILE_STATE_T {
     int force_err_display;      /* If true, always show compiler errors. */
     struct INTERMEDIATE *nextinst;
     hash_tab defhash[DEFHASHSIZE];
+    struct mufcache_deps deps;  /* what the compile depended on */
+    int unreachable;            /* unreachable instructions optimized away */
+    int inline_procs;           /* If true, small procedures may be inlined */
 } COMPSTATE;
 
 /* These are globally available as externs */
 
+/**
+ * @var integer primitive ID for DEBUG_LINE primitive
+ */
+int IN_DEBUG_LINE;
+
 /**
  * @var integer primitive ID for FOR primitive
  */
@@ -201,6 +216,19 @@ int IN_FORPOP;
  */
 int IN_TRYPOP;
 
+/**
+ * @var changes whenever any program's code or publics are freed, so that
+ *      anything remembering a place in a program can tell it might be gone
+ */
+unsigned int program_code_generation = 0;
+
+/**
+ * @var the revision of the code this compiler generates, which is part of
+ *      the MUF cache fingerprint.  It must be bumped whenever a change to
+ *      the compiler changes the instructions it generates for a program.
+ */
+const int MUF_COMPILER_REVISION = 2;
+
 /* See definition for implementation details */
 static void free_prog_real(dbref, const char *, const int);
 
@@ -229,6 +257,77 @@ cleanpubs(struct publics *mypub)
     }
 }
 
+/**
+ * Replace a program's publics, hashing the new ones by name
+ *
+ * The old publics are freed.  If the same name is public more than once,
+ * the first in the list is the one found, as it always has been.
+ *
+ * @see find_public
+ *
+ * @private
+ * @param program the program to set the publics of
+ * @param pubs the new linked list of publics, which may be NULL
+ */
+static void
+set_pubs(dbref program, struct publics *pubs)
+{
+    hash_tab *pubtab = PROGRAM_PUBTAB(program);
+
+    if (pubtab) {
+        kill_hash(pubtab, PUBLIC_HASH_SIZE, 0);
+        free(pubtab);
+        pubtab = NULL;
+    }
+
+    if (PROGRAM_PUBS(program) != pubs)
+        cleanpubs(PROGRAM_PUBS(program));
+
+    if (pubs && (pubtab = calloc(PUBLIC_HASH_SIZE, sizeof(hash_tab)))) {
+        for (struct publics *pub = pubs; pub; pub = pub->next) {
+            hash_data hd;
+
+            if (find_hash(pub->subname, pubtab, PUBLIC_HASH_SIZE))
+                continue;
+
+            hd.pval = pub;
+            (void) add_hash(pub->subname, hd, pubtab, PUBLIC_HASH_SIZE);
+        }
+    }
+
+    PROGRAM_SET_PUBS(program, pubs);
+    PROGRAM_SET_PUBTAB(program, pubtab);
+    program_code_generation++;
+}
+
+/**
+ * Find a PUBLIC or WIZCALL function in a program by name
+ *
+ * This does not check whether the caller may call it.
+ *
+ * @param program the program, which must be compiled
+ * @param name the function name, which is not case sensitive
+ * @return the public function, or NULL if there is none by that name
+ */
+struct publics *
+find_public(dbref program, const char *name)
+{
+    hash_data *hd;
+
+    if (PROGRAM_PUBTAB(program)) {
+        hd = find_hash(name, PROGRAM_PUBTAB(program), PUBLIC_HASH_SIZE);
+        return hd ? hd->pval : NULL;
+    }
+
+    /* The table couldn't be allocated, so fall back to the list */
+    for (struct publics *pub = PROGRAM_PUBS(program); pub; pub = pub->next) {
+        if (!strcasecmp(name, pub->subname))
+            return pub;
+    }
+
+    return NULL;
+}
+
 /**
  * Free the memory of an intermediate node
  *
@@ -354,6 +453,8 @@ cleanup(COMPSTATE * cstat)
         free((void *) cstat->localvars[i]);
         cstat->localvars[i] = 0;
     }
+
+    mufcache_free_deps(&cstat->deps);
 }
 
 /**
@@ -429,8 +530,7 @@ do_abort_compile(COMPSTATE * cstat, const char *c)
     cleanpubs(cstat->currpubs);
     cstat->currpubs = NULL;
     free_prog(cstat->program);
-    cleanpubs(PROGRAM_PUBS(cstat->program));
-    PROGRAM_SET_PUBS(cstat->program, NULL);
+    set_pubs(cstat->program, NULL);
     clean_mcpbinds(PROGRAM_MCPBINDS(cstat->program));
     PROGRAM_SET_MCPBINDS(cstat->program, NULL);
     PROGRAM_SET_PROFTIME(cstat->program, 0, 0);
@@ -588,6 +688,7 @@ expand_def(COMPSTATE * cstat, const char *defname)
      */
     if (!exp) {
         if (*defname == BEGINMACRO) {
+            mufcache_note(&cstat->deps, MUFCACHE_MACRO, NOTHING, &defname[1], 1);
             return (macro_expansion(&defname[1]));
         } else {
             return (NULL);
@@ -677,6 +778,8 @@ include_defs(COMPSTATE * cstat, dbref i)
     const char *tmpptr;
     PropPtr j, pptr;
 
+    mufcache_note(&cstat->deps, MUFCACHE_DEFS, i, NULL, 1);
+
     snprintf(dirname, sizeof(dirname), "/%s/", DEFINES_PROPDIR);
     j = first_prop(i, dirname, &pptr, temp, sizeof(temp));
 
@@ -692,6 +795,61 @@ include_defs(COMPSTATE * cstat, dbref i)
     }
 }
 
+/**
+ * Match an object named by a compiler directive
+ *
+ * This matches registered names and dbrefs, and "me" if asked to, as
+ * $include, $ifver, $iflib and $ifcancall do.  The matcher's globals are
+ * left as they were.
+ *
+ * @param descr the descriptor of the person compiling
+ * @param player the player compiling
+ * @param name the name to match
+ * @param with_me true to also match "me"
+ * @return the object matched, or NOTHING, AMBIGUOUS or HOME
+ */
+dbref
+compile_match(int descr, dbref player, const char *name, int with_me)
+{
+    char tempa[BUFFER_LEN], tempb[BUFFER_LEN];
+    struct match_data md;
+    dbref result;
+
+    strcpyn(tempa, sizeof(tempa), match_args);
+    strcpyn(tempb, sizeof(tempb), match_cmdname);
+    init_match(descr, player, name, NOTYPE, &md);
+    match_registered(&md);
+    match_absolute(&md);
+
+    if (with_me)
+        match_me(&md);
+
+    result = match_result(&md);
+    strcpyn(match_args, sizeof(match_args), tempa);
+    strcpyn(match_cmdname, sizeof(match_cmdname), tempb);
+    return result;
+}
+
+/**
+ * Match an object named by a compiler directive, noting the match as
+ * something the compile depends on
+ *
+ * @see compile_match
+ *
+ * @private
+ * @param cstat the compile state
+ * @param name the name to match
+ * @param with_me true to also match "me"
+ * @return the object matched, or NOTHING, AMBIGUOUS or HOME
+ */
+static dbref
+match_directive(COMPSTATE * cstat, const char *name, int with_me)
+{
+    mufcache_note(&cstat->deps, with_me ? MUFCACHE_MATCH_ME : MUFCACHE_MATCH,
+                  cstat->player, name, 1);
+    return compile_match(cstat->descr, cstat->player, name, with_me);
+}
+
 /**
  * Include 'internal' defines.  These are the ones set by the compiler.
  *
@@ -877,8 +1035,7 @@ uncompile_program(dbref i)
     /* free program */
     (void) dequeue_prog(i, 1);
     free_prog(i);
-    cleanpubs(PROGRAM_PUBS(i));
-    PROGRAM_SET_PUBS(i, NULL);
+    set_pubs(i, NULL);
     clean_mcpbinds(PROGRAM_MCPBINDS(i));
     PROGRAM_SET_MCPBINDS(i, NULL);
     PROGRAM_SET_PROFTIME(i, 0, 0);
@@ -1278,6 +1435,25 @@ IntermediateIsString(struct INTERMEDIATE *ptr, const char *val)
     return 0;
 }
 
+/**
+ * Find the INTERMEDIATE a jump goes to
+ *
+ * @private
+ * @param cstat the compile state structure
+ * @param ptr the jump, which must be an IF, JMP or the like
+ * @return the INTERMEDIATE jumped to, or NULL if it is past the end
+ */
+static struct INTERMEDIATE *
+IntermediateJumpTarget(COMPSTATE * cstat, struct INTERMEDIATE *ptr)
+{
+    struct INTERMEDIATE *target = cstat->addrlist[ptr->in.data.number];
+
+    for (int i = cstat->addroffsets[ptr->in.data.number]; target && i > 0; i--)
+        target = target->next;
+
+    return target;
+}
+
 /**
  * Iterates over all the intermediates in a COMPSTATE and tries to optimize
  *
@@ -1287,8 +1463,20 @@ IntermediateIsString(struct INTERMEDIATE *ptr, const char *val)
  * simply "tell".  For older MUFs, this combination of operations is
  * incredibly common.
  *
+ * Arithmetic, comparisons and concatenation of constants are worked out
+ * here rather than every time the program runs, and an IF on a constant
+ * becomes either nothing or a plain jump.  Code that no jump goes to and
+ * that comes right after a jump can never run, so it is removed; this
+ * takes out the dead side of an IF on a constant, such as the ones a
+ * $define of 0 or 1 makes.  The count of these is added to
+ * cstat->unreachable.
+ *
  * This potentially modifies the intermediates list in cstat.
  *
+ * Bump MUF_COMPILER_REVISION whenever a change here changes the code
+ * generated for a program, or programs compiled by an older build will
+ * still be loaded from the MUF cache.
+ *
  * @private
  * @param cstat the compile state structure
  * @param force_err_display boolean if true, errors will be displayed
@@ -1323,6 +1511,14 @@ OptimizeIntermediate(COMPSTATE * cstat, int force_err_display)
     int MultNo = get_primitive("*");
     int DivNo = get_primitive("/");
     int ModNo = get_primitive("%");
+    int LessNo = get_primitive("<");
+    int GreaterNo = get_primitive(">");
+    int LesseqNo = get_primitive("<=");
+    int GreatereqNo = get_primitive(">=");
+    int BitorNo = get_primitive("bitor");
+    int BitandNo = get_primitive("bitand");
+    int BitxorNo = get_primitive("bitxor");
+    int StrcatNo = get_primitive("strcat");
     int DecrNo = get_primitive("--");
     int IncrNo = get_primitive("++");
     int NotequalsNo = get_primitive("!=");
@@ -1457,6 +1653,38 @@ OptimizeIntermediate(COMPSTATE * cstat, int force_err_display)
 
                 break;
             case PROG_STRING:
+                /* Str Str strcat  ==>  Str */
+                /* Str Str +  ==>  Str */
+                if (ContiguousIntermediates(Flags, curr->next, 2)) {
+                    if (curr->next->in.type == PROG_STRING &&
+                        (IntermediateIsPrimitive(curr->next->next, StrcatNo) ||
+                         IntermediateIsPrimitive(curr->next->next, PlusNo))) {
+                        struct shared_string *str1 = curr->in.data.string;
+                        struct shared_string *str2 = curr->next->in.data.string;
+                        int len1 = str1 ? str1->length : 0;
+                        int len2 = str2 ? str2->length : 0;
+
+                        /* Too long is left for the interpreter to abort on */
+                        if (len1 + len2 <= BUFFER_LEN - 1) {
+                            char buf[BUFFER_LEN];
+
+                            if (str1)
+                                memcpy(buf, str1->data, (size_t) len1);
+
+                            if (str2)
+                                memcpy(buf + len1, str2->data, (size_t) len2);
+
+                            buf[len1 + len2] = '\0';
+                            free(curr->in.data.string);
+                            curr->in.data.string = alloc_prog_string(buf);
+                            RemoveNextIntermediate(cstat, curr);
+                            RemoveNextIntermediate(cstat, curr);
+                            advance = 0;
+                            break;
+                        }
+                    }
+                }
+
                 if (IntermediateIsString(curr, "")) {
                     if (ContiguousIntermediates(Flags, curr->next, 3)) {
                         /* "" strcmp 0 =  ==>   not */
@@ -1594,6 +1822,95 @@ OptimizeIntermediate(COMPSTATE * cstat, int force_err_display)
 
                             break;
                         }
+
+                        /* Int Int <  ==>  Bool, and so on for > <= >= = != */
+                        /* Int Int bitor  ==>  Bits, and so on for bitand bitxor */
+                        if (curr->next->next->in.type == PROG_PRIMITIVE) {
+                            int val1 = curr->in.data.number;
+                            int val2 = curr->next->in.data.number;
+                            int prim = curr->next->next->in.data.number;
+                            int folded = 1;
+
+                            if (prim == LessNo)
+                                val1 = val1 < val2;
+                            else if (prim == GreaterNo)
+                                val1 = val1 > val2;
+                            else if (prim == LesseqNo)
+                                val1 = val1 <= val2;
+                            else if (prim == GreatereqNo)
+                                val1 = val1 >= val2;
+                            else if (prim == EqualsNo)
+                                val1 = val1 == val2;
+                            else if (prim == NotequalsNo)
+                                val1 = val1 != val2;
+                            else if (prim == BitorNo)
+                                val1 = val1 | val2;
+                            else if (prim == BitandNo)
+                                val1 = val1 & val2;
+                            else if (prim == BitxorNo)
+                                val1 = val1 ^ val2;
+                            else
+                                folded = 0;
+
+                            if (folded) {
+                                curr->in.data.number = val1;
+                                RemoveNextIntermediate(cstat, curr);
+                                RemoveNextIntermediate(cstat, curr);
+                                advance = 0;
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                if (ContiguousIntermediates(Flags, curr->next, 1)) {
+                    /* Int not  ==>  Bool */
+                    if (IntermediateIsPrimitive(curr->next, NotNo)) {
+                        curr->in.data.number = !curr->in.data.number;
+                        RemoveNextIntermediate(cstat, curr);
+                        advance = 0;
+                        break;
+                    }
+
+                    /* Int ++  ==>  Sum */
+                    if (IntermediateIsPrimitive(curr->next, IncrNo)) {
+                        curr->in.data.number++;
+                        RemoveNextIntermediate(cstat, curr);
+                        advance = 0;
+                        break;
+                    }
+
+                    /* Int --  ==>  Diff */
+                    if (IntermediateIsPrimitive(curr->next, DecrNo)) {
+                        curr->in.data.number--;
+                        RemoveNextIntermediate(cstat, curr);
+                        advance = 0;
+                        break;
+                    }
+
+                    /* 0 if  ==>  jmp */
+                    if (curr->next->in.type == PROG_IF && !curr->in.data.number) {
+                        curr->in.type = PROG_JMP;
+                        curr->in.data.number = curr->next->in.data.number;
+                        RemoveNextIntermediate(cstat, curr);
+                        advance = 0;
+                        break;
+                    }
+
+                    /* Int if  ==>  (nothing), for Int other than 0 */
+                    if (curr->next->in.type == PROG_IF) {
+                        RemoveNextIntermediate(cstat, curr);
+
+                        /* What went just past the if now goes to what replaces it */
+                        for (i = 0; i < cstat->addrcount; i++) {
+                            if (cstat->addrlist[i] == curr && cstat->addroffsets[i] == 1)
+                                cstat->addroffsets[i] = 0;
+                        }
+
+                        Flags[curr->no] |= Flags[curr->next->no];
+                        RemoveIntermediate(cstat, curr);
+                        advance = 0;
+                        break;
                     }
                 }
 
@@ -1707,6 +2024,30 @@ OptimizeIntermediate(COMPSTATE * cstat, int force_err_display)
                     }
                 }
 
+                break;
+            case PROG_JMP:
+                /* jmp to the next instruction  ==>  (nothing) */
+                if (curr->next && IntermediateJumpTarget(cstat, curr) == curr->next) {
+                    /* What went just past the jump now goes to what replaces it */
+                    for (i = 0; i < cstat->addrcount; i++) {
+                        if (cstat->addrlist[i] == curr && cstat->addroffsets[i] == 1)
+                            cstat->addroffsets[i] = 0;
+                    }
+
+                    Flags[curr->no] |= Flags[curr->next->no];
+                    RemoveIntermediate(cstat, curr);
+                    advance = 0;
+                    break;
+                }
+
+                /* jmp Unreachable  ==>  jmp */
+                while (curr->next && curr->next->in.type != PROG_FUNCTION &&
+                       !(Flags[curr->next->no] & IMMFLAG_REFERENCED)) {
+                    RemoveNextIntermediate(cstat, curr);
+                    cstat->unreachable++;
+                    advance = 0;
+                }
+
                 break;
             case PROG_PRIMITIVE:
                 /* rot rot swap  ==>  swap rot */
@@ -2208,12 +2549,115 @@ number_word(COMPSTATE * cstat, const char *token)
     return nu;
 }
 
+/**
+ * Can calls to a procedure be replaced with a copy of its code?
+ *
+ * Only small procedures that are already compiled, have no arguments or
+ * scoped variables, and do nothing but push values and run primitives are
+ * inlined.  As they can't call other procedures, jump, exit early or use
+ * TRY, they work the same wherever they are copied to.  This also means
+ * a procedure never inlines itself.
+ *
+ * @private
+ * @param cstat the compile state structure
+ * @param p the procedure being called
+ * @return boolean true if calls to p may be inlined
+ */
+static int
+can_inline(COMPSTATE * cstat, struct PROC_LIST *p)
+{
+    struct muf_proc_data *proc = p->code->in.data.mufproc;
+    int size = 0;
+
+    if (!cstat->inline_procs || p->code == cstat->curr_proc)
+        return 0;
+
+    if (proc->vars || proc->args)
+        return 0;
+
+    for (struct INTERMEDIATE *curr = p->code->next; curr; curr = curr->next) {
+        switch (curr->in.type) {
+            case PROG_PRIMITIVE:
+                /* Only the EXIT at the end may leave the procedure */
+                if (curr->in.data.number == IN_RET)
+                    return !curr->next || curr->next->in.type == PROG_FUNCTION;
+
+                if (curr->in.data.number == IN_JMP)
+                    return 0;
+
+                break;
+            case PROG_INTEGER:
+            case PROG_FLOAT:
+            case PROG_OBJECT:
+            case PROG_STRING:
+            case PROG_VAR:
+            case PROG_LVAR:
+                break;
+            default:
+                return 0;
+        }
+
+        if (++size > INLINE_MAX_SIZE)
+            return 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Return a copy of the code of a procedure to run in place of a call to it
+ *
+ * The copied instructions keep the line numbers of the procedure, so that
+ * errors and the debugger show where they came from.
+ *
+ * @private
+ * @see can_inline
+ *
+ * @param cstat the compile state structure
+ * @param p the procedure being called, which must be able to be inlined
+ * @return the first of the copied instructions, or NULL if there are none
+ */
+static struct INTERMEDIATE *
+inline_word(COMPSTATE * cstat, struct PROC_LIST *p)
+{
+    struct INTERMEDIATE *first = NULL;
+    struct INTERMEDIATE *last = NULL;
+    struct INTERMEDIATE *nu;
+
+    for (struct INTERMEDIATE *curr = p->code->next; curr->next &&
+         curr->next->in.type != PROG_FUNCTION; curr = curr->next) {
+        nu = new_inst(cstat);
+        nu->no = cstat->nowords++;
+        nu->in.type = curr->in.type;
+        nu->in.line = curr->in.line;
+        nu->in.data = curr->in.data;
+
+        if (curr->in.type == PROG_STRING && curr->in.data.string)
+            nu->in.data.string = alloc_prog_string(curr->in.data.string->data);
+
+        if (last)
+            last->next = nu;
+        else
+            first = nu;
+
+        last = nu;
+    }
+
+    return first;
+}
+
 /**
  * Return an INTERMEDIATE representing a subroutine call
  *
  * Do a subroutine call --- push address onto stack, then make a primitive
  * CALL.  Returns an INTERMEDIATE structure for the subroutine call.
  *
+ * Small procedures are copied in place of the call instead, when that can
+ * be done; see can_inline.
+ *
+ * Bump MUF_COMPILER_REVISION whenever a change here or in the inlining
+ * changes the code generated for a call.
+ *
  * @private
  * @param cstat the compile state structure
  * @param token the text containing the subroutine call we will be making here
@@ -2228,16 +2672,19 @@ call_word(COMPSTATE * cstat, const char *token)
     if (!cstat->curr_proc)
         abort_compile(cstat, "Procedure call outside procedure.");
 
-    nu = new_inst(cstat);
-    nu->no = cstat->nowords++;
-    nu->in.type = PROG_EXEC;
-    nu->in.line = cstat->lineno;
-
     /* Find the procedure to call */
     for (p = cstat->procs; p; p = p->next)
         if (!strcasecmp(p->name, token))
             break;
 
+    if (p && can_inline(cstat, p))
+        return inline_word(cstat, p);
+
+    nu = new_inst(cstat);
+    nu->no = cstat->nowords++;
+    nu->in.type = PROG_EXEC;
+    nu->in.line = cstat->lineno;
+
     /*
      * What happens if the procedure isn't found?  We get a PROG_EXEC
      * with no target?  Guess that never comes up.
@@ -2664,6 +3111,166 @@ next_word(COMPSTATE * cstat, const char *token)
     return new_word;
 }
 
+/**
+ * Get the plain instruction type a superinstruction stands in for
+ *
+ * @see fuse_program
+ *
+ * @param type the instruction type
+ * @return the type the instruction had before it was fused, or type itself
+ *         if it is not a superinstruction
+ */
+int
+unfused_type(int type)
+{
+    switch (type) {
+        case PROG_LVAR_INCR:
+        case PROG_LVAR_DECR:
+            return PROG_LVAR_AT_CLEAR;
+
+        case PROG_SVAR_INCR:
+        case PROG_SVAR_DECR:
+            return PROG_SVAR_AT_CLEAR;
+
+        default:
+            if (type >= PROG_FIRST_FUSED && type <= PROG_LAST_FUSED)
+                return PROG_PRIMITIVE;
+
+            return type;
+    }
+}
+
+/**
+ * Turn the common instruction sequences in a program into superinstructions
+ *
+ * Each sequence has its first instruction's type changed to one of the
+ * superinstruction types in inst.h, and is otherwise left alone.  The
+ * interpreter runs the whole sequence at once where it can, and falls back
+ * to running the plain instructions one at a time where it can't, such as
+ * when an argument has an unusual type.  This is why the code saved by the
+ * MUF cache, which is saved before this runs, never has them.
+ *
+ * The sequences were picked with the muf_pair_stats tune, as the pairs run
+ * most often by typical programs that the interpreter can do much more
+ * cheaply together.  A sequence is only fused if nothing jumps into the
+ * middle of it.
+ *
+ * @see unfuse_program
+ *
+ * @param program the program to fuse, which must be compiled
+ */
+void
+fuse_program(dbref program)
+{
+    struct inst *code = PROGRAM_CODE(program);
+    int siz = PROGRAM_SIZ(program);
+    char *target;
+
+    int NotNo = get_primitive("not");
+    int DupNo = get_primitive("dup");
+    int EqualsNo = get_primitive("=");
+    int NotequalsNo = get_primitive("!=");
+    int LessNo = get_primitive("<");
+    int LesseqNo = get_primitive("<=");
+    int GreaterNo = get_primitive(">");
+    int GreatereqNo = get_primitive(">=");
+    int IncrNo = get_primitive("++");
+    int DecrNo = get_primitive("--");
+
+    if (!code || siz < 2 || !(target = calloc((size_t) siz, 1)))
+        return;
+
+    /* Mark the instructions that can be jumped to */
+    for (int i = 0; i < siz; i++) {
+        struct inst *dest = NULL;
+
+        switch (code[i].type) {
+            case PROG_IF:
+            case PROG_JMP:
+            case PROG_EXEC:
+            case PROG_TRY:
+                dest = code[i].data.call;
+                break;
+
+            case PROG_ADD:
+                if (code[i].data.addr->progref == program)
+                    dest = code[i].data.addr->data;
+
+                break;
+        }
+
+        if (dest && dest >= code && dest < code + siz)
+            target[dest - code] = 1;
+    }
+
+    for (int i = 0; i < siz - 1; i++) {
+        struct inst *in = code + i;
+
+        if (target[i + 1])
+            continue;
+
+        if (in->type == PROG_PRIMITIVE && in[1].type == PROG_IF) {
+            int prim = in->data.number;
+
+            if (prim == NotNo)
+                in->type = PROG_NOT_IF;
+            else if (prim == DupNo)
+                in->type = PROG_DUP_IF;
+            else if (prim == EqualsNo)
+                in->type = PROG_EQ_IF;
+            else if (prim == NotequalsNo)
+                in->type = PROG_NE_IF;
+            else if (prim == LessNo)
+                in->type = PROG_LT_IF;
+            else if (prim == LesseqNo)
+                in->type = PROG_LE_IF;
+            else if (prim == GreaterNo)
+                in->type = PROG_GT_IF;
+            else if (prim == GreatereqNo)
+                in->type = PROG_GE_IF;
+            else if (prim == IN_FORITER)
+                in->type = PROG_FORITER_IF;
+        } else if ((in->type == PROG_LVAR_AT_CLEAR
+                    || in->type == PROG_SVAR_AT_CLEAR)
+                   && i + 2 < siz && !target[i + 2]
+                   && in[1].type == PROG_PRIMITIVE
+                   && (in[1].data.number == IncrNo
+                       || in[1].data.number == DecrNo)
+                   && in[2].type == (in->type == PROG_LVAR_AT_CLEAR
+                                     ? PROG_LVAR_BANG : PROG_SVAR_BANG)
+                   && in[2].data.number == in->data.number) {
+            int incr = in[1].data.number == IncrNo;
+
+            if (in->type == PROG_LVAR_AT_CLEAR)
+                in->type = incr ? PROG_LVAR_INCR : PROG_LVAR_DECR;
+            else
+                in->type = incr ? PROG_SVAR_INCR : PROG_SVAR_DECR;
+        }
+    }
+
+    free(target);
+}
+
+/**
+ * Turn a program's superinstructions back into plain instructions
+ *
+ * The interpreter does this when it has to see every instruction run, as
+ * when a program is being debugged.  The program stays this way until it
+ * is next compiled.
+ *
+ * @see fuse_program
+ *
+ * @param program the program to unfuse
+ */
+void
+unfuse_program(dbref program)
+{
+    struct inst *code = PROGRAM_CODE(program);
+
+    for (int i = PROGRAM_SIZ(program); i-- > 0;)
+        code[i].type = (short) unfused_type(code[i].type);
+}
+
 /**
  * Compile MUF code associated with a given dbref
  *
@@ -2727,6 +3334,8 @@ do_compile(int descr, dbref player_in, dbref program_in, int force_err_display)
     cstat.nested_trys = 0;
     cstat.addrcount = 0;
     cstat.addrmax = 0;
+    cstat.unreachable = 0;
+    cstat.inline_procs = tp_optimize_muf;
 
     for (int i = 0; i < MAX_VAR; i++) {
         cstat.variables[i] = NULL;
@@ -2760,6 +3369,10 @@ do_compile(int descr, dbref player_in, dbref program_in, int force_err_display)
     cstat.nextinst = NULL;
     cstat.addrlist = NULL;
     cstat.addroffsets = NULL;
+    cstat.deps.list = NULL;
+    cstat.deps.count = 0;
+    cstat.deps.size = 0;
+    cstat.deps.uncacheable = 0;
     init_defs(&cstat);
 
     cstat.variables[0] = "ME";
@@ -2770,14 +3383,15 @@ do_compile(int descr, dbref player_in, dbref program_in, int force_err_display)
     /* free old stuff */
     (void) dequeue_prog(cstat.program, 1);
     free_prog(cstat.program);
-    cleanpubs(PROGRAM_PUBS(cstat.program));
-    PROGRAM_SET_PUBS(cstat.program, NULL);
+    set_pubs(cstat.program, NULL);
     clean_mcpbinds(PROGRAM_MCPBINDS(cstat.program));
     PROGRAM_SET_MCPBINDS(cstat.program, NULL);
 
     PROGRAM_SET_PROFTIME(cstat.program, 0, 0);
     PROGRAM_SET_PROFSTART(cstat.program, time(NULL));
     PROGRAM_SET_PROF_USES(cstat.program, 0);
+    PROGRAM_SET_SLICE_YIELDS(cstat.program, 0);
+    PROGRAM_SET_TIME_YIELDS(cstat.program, 0);
 
     if (!cstat.curr_line)
         v_abort_compile(&cstat, "Missing program text.");
@@ -2835,6 +3449,11 @@ do_compile(int descr, dbref player_in, dbref program_in, int force_err_display)
             notifyf_nolisten(cstat.player,
                              "Program optimized by %d instructions in %d passes.", optimcount,
                              passcount);
+
+            if (cstat.unreachable > 0) {
+                notifyf_nolisten(cstat.player,
+                                 "%d of them were unreachable.", cstat.unreachable);
+            }
         }
     }
 
@@ -2842,7 +3461,7 @@ do_compile(int descr, dbref player_in, dbref program_in, int force_err_display)
     fix_addresses(&cstat);
     copy_program(&cstat);
     fixpubs(cstat.currpubs, PROGRAM_CODE(cstat.program));
-    PROGRAM_SET_PUBS(cstat.program, cstat.currpubs);
+    set_pubs(cstat.program, cstat.currpubs);
 
     if (cstat.nextinst) {
         struct INTERMEDIATE *ptr;
@@ -2860,6 +3479,11 @@ do_compile(int descr, dbref player_in, dbref program_in, int force_err_display)
         return;
 
     set_start(&cstat);
+    mufcache_save(cstat.program, cstat.player, &cstat.deps);
+
+    if (tp_optimize_muf)
+        fuse_program(cstat.program);
+
     cleanup(&cstat);
 
     /* Set PROGRAM_INSTANCES to zero (cuz they don't get set elsewhere) */
@@ -2877,6 +3501,67 @@ do_compile(int descr, dbref player_in, dbref program_in, int force_err_display)
 
 }
 
+/**
+ * Compile a program that is needed but not compiled
+ *
+ * This is what runs a program, or a call into one, does when it has no
+ * code.  The program's saved code is loaded if it is still good; if not,
+ * its text is read from disk and compiled as its owner, without showing
+ * any errors.  Either way, the text is not left in memory.
+ *
+ * @see mufcache_load
+ *
+ * @param descr the descriptor of the person who needs the program
+ * @param program the program to compile
+ */
+void
+compile_on_demand(int descr, dbref program)
+{
+    struct line *tmpline;
+    struct publics *pubs;
+    struct inst *code;
+    int siz, start;
+
+    if (PROGRAM_INSTANCES_IN_PRIMITIVE(program) <= 0
+        && mufcache_load(program, OWNER(program), &code, &siz, &start, &pubs)) {
+        /* Set things up just as a successful compile would. */
+        (void) dequeue_prog(program, 1);
+        free_prog(program);
+        set_pubs(program, NULL);
+        clean_mcpbinds(PROGRAM_MCPBINDS(program));
+        PROGRAM_SET_MCPBINDS(program, NULL);
+
+        PROGRAM_SET_PROFTIME(program, 0, 0);
+        PROGRAM_SET_PROFSTART(program, time(NULL));
+        PROGRAM_SET_PROF_USES(program, 0);
+        PROGRAM_SET_SLICE_YIELDS(program, 0);
+        PROGRAM_SET_TIME_YIELDS(program, 0);
+
+        PROGRAM_SET_CODE(program, code);
+        PROGRAM_SET_SIZ(program, siz);
+        PROGRAM_SET_START(program, code + start);
+        set_pubs(program, pubs);
+        PROGRAM_SET_INSTANCES(program, 0);
+
+        if (tp_optimize_muf)
+            fuse_program(program);
+
+        if ((FLAGS(program) & ABODE) && TrueWizard(OWNER(program))) {
+            add_muf_queue_event(-1, OWNER(program), NOTHING, NOTHING,
+                                program, "Startup", "Queued Event.", 0);
+            notify_nolisten(OWNER(program), "Program autostarted.", 1);
+        }
+
+        return;
+    }
+
+    tmpline = PROGRAM_FIRST(program);
+    PROGRAM_SET_FIRST(program, read_program(program));
+    do_compile(descr, OWNER(program), program, 0);
+    free_prog_text(PROGRAM_FIRST(program));
+    PROGRAM_SET_FIRST(program, tmpline);
+}
+
 /**
  * Little routine to do the line_copy handling right
  *
@@ -3529,6 +4214,7 @@ do_directive(COMPSTATE * cstat, char *direct)
         } else {
             if (!strcasecmp(tmpname, ":")) {
                 remove_property(cstat->program, DEFINES_PROPDIR);
+                mufcache_note(&cstat->deps, MUFCACHE_DEFS, cstat->program, NULL, 0);
             } else {
                 char defstr[BUFFER_LEN];
                 char propname[BUFFER_LEN];
@@ -3558,6 +4244,8 @@ do_directive(COMPSTATE * cstat, char *direct)
                         remove_property(cstat->program, propname);
                     }
                 }
+
+                mufcache_note(&cstat->deps, MUFCACHE_PROP, cstat->program, propname, 0);
             }
         }
 
@@ -3613,6 +4301,8 @@ do_directive(COMPSTATE * cstat, char *direct)
                     remove_property(cstat->program, propname);
                 }
             }
+
+            mufcache_note(&cstat->deps, MUFCACHE_PROP, cstat->program, propname, 0);
         }
 
         while (*cstat->next_char)
@@ -3622,27 +4312,12 @@ do_directive(COMPSTATE * cstat, char *direct)
 
         free(holder);
     } else if (!strcasecmp(temp, "include")) {
-        struct match_data md;
-
         tmpname = (char *) next_token_raw(cstat);
 
         if (!tmpname)
             v_abort_compile(cstat, "Unexpected end of file while doing $include.");
 
-        {
-            char tempa[BUFFER_LEN], tempb[BUFFER_LEN];
-
-            strcpyn(tempa, sizeof(tempa), match_args);
-            strcpyn(tempb, sizeof(tempb), match_cmdname);
-            init_match(cstat->descr, cstat->player, tmpname, NOTYPE, &md);
-            match_registered(&md);
-            match_absolute(&md);
-            match_me(&md);
-            i = (int) match_result(&md);
-            strcpyn(match_args, sizeof(match_args), tempa);
-            strcpyn(match_cmdname, sizeof(match_cmdname), tempb);
-        }
-
+        i = (int) match_directive(cstat, tmpname, 1);
         free(tmpname);
 
         if (!OkObj(i))
@@ -3682,6 +4357,7 @@ do_directive(COMPSTATE * cstat, char *direct)
         }
 
         add_property(cstat->program, MUF_VERSION_PROP, tmpname, 0);
+        mufcache_note(&cstat->deps, MUFCACHE_PROP, cstat->program, MUF_VERSION_PROP, 0);
 
         while (*cstat->next_char)
             cstat->next_char++;
@@ -3697,6 +4373,7 @@ do_directive(COMPSTATE * cstat, char *direct)
         }
 
         add_property(cstat->program, MUF_LIB_VERSION_PROP, tmpname, 0);
+        mufcache_note(&cstat->deps, MUFCACHE_PROP, cstat->program, MUF_LIB_VERSION_PROP, 0);
 
         while (*cstat->next_char)
             cstat->next_char++;
@@ -3708,18 +4385,21 @@ do_directive(COMPSTATE * cstat, char *direct)
         tmpname = (char *) cstat->next_char;
         skip_whitespace(&cstat->next_char);
         add_property(cstat->program, MUF_AUTHOR_PROP, tmpname, 0);
+        mufcache_note(&cstat->deps, MUFCACHE_PROP, cstat->program, MUF_AUTHOR_PROP, 0);
         advance_line(cstat);
     } else if (!strcasecmp(temp, "doccmd")) {
         skip_whitespace(&cstat->next_char);
         tmpname = next_char_special(cstat);
         skip_whitespace(&cstat->next_char);
         add_property(cstat->program, MUF_DOCCMD_PROP, tmpname, 0);
+        mufcache_note(&cstat->deps, MUFCACHE_PROP, cstat->program, MUF_DOCCMD_PROP, 0);
         advance_line(cstat);
     } else if (!strcasecmp(temp, "note")) {
         skip_whitespace(&cstat->next_char);
         tmpname = (char *) cstat->next_char;
         skip_whitespace(&cstat->next_char);
         add_property(cstat->program, MUF_NOTE_PROP, tmpname, 0);
+        mufcache_note(&cstat->deps, MUFCACHE_PROP, cstat->program, MUF_NOTE_PROP, 0);
         advance_line(cstat);
     } else if (!strcasecmp(temp, "ifdef") || !strcasecmp(temp, "ifndef")) {
         int invert_flag = !strcasecmp(temp, "ifndef");
@@ -3785,23 +4465,15 @@ do_directive(COMPSTATE * cstat, char *direct)
             free(tmpptr);
         }
     } else if (!strcasecmp(temp, "ifcancall") || !strcasecmp(temp, "ifncancall")) {
-        struct match_data md;
+        /* The answer depends on the other program, so never cache this. */
+        cstat->deps.uncacheable = 1;
 
         tmpname = (char *) next_token_raw(cstat);
 
         if (!tmpname)
             v_abort_compile(cstat, "Unexpected end of file for ifcancall.");
 
-        char tempa[BUFFER_LEN], tempb[BUFFER_LEN];
-
-        strcpyn(tempa, sizeof(tempa), match_args);
-        strcpyn(tempb, sizeof(tempb), match_cmdname);
-        init_match(cstat->descr, cstat->player, tmpname, NOTYPE, &md);
-        match_registered(&md);
-        match_absolute(&md);
-        i = (int) match_result(&md);
-        strcpyn(match_args, sizeof(match_args), tempa);
-        strcpyn(match_cmdname, sizeof(match_cmdname), tempb);
+        i = (int) match_directive(cstat, tmpname, 0);
         free(tmpname);
 
         if (!OkObj(i))
@@ -3825,29 +4497,14 @@ do_directive(COMPSTATE * cstat, char *direct)
 
         if (Typeof(i) == TYPE_PROGRAM) {
             if (!PROGRAM_CODE(i)) {
-                struct line *tmpline;
-
-                tmpline = PROGRAM_FIRST(i);
-                PROGRAM_SET_FIRST(i, read_program(i));
-                do_compile(cstat->descr, OWNER(i), i, 0);
-                free_prog_text(PROGRAM_FIRST(i));
-                PROGRAM_SET_FIRST(i, tmpline);
+                compile_on_demand(cstat->descr, i);
             }
 
             if (MLevel(OWNER(i)) > 0 &&
                 (MLevel(OWNER(cstat->program)) >= 4 || OWNER(i) == OWNER(cstat->program)
                 || Linkable(i))
             ) {
-                struct publics *pbs;
-
-                pbs = PROGRAM_PUBS(i);
-
-                while (pbs) {
-                    if (!strcasecmp(tmpname, pbs->subname))
-                        break;
-
-                    pbs = pbs->next;
-                }
+                struct publics *pbs = find_public(i, tmpname);
 
                 if (pbs && MLevel(OWNER(cstat->program)) >= pbs->mlev)
                     j = 1;
@@ -3882,7 +4539,7 @@ do_directive(COMPSTATE * cstat, char *direct)
         }
     } else if (!strcasecmp(temp, "ifver") || !strcasecmp(temp, "iflibver") ||
                !strcasecmp(temp, "ifnver") || !strcasecmp(temp, "ifnlibver")) {
-        struct match_data md;
+        const char *propname;
         double verflt = 0;
         double checkflt = 0;
         int needFree = 0;
@@ -3893,17 +4550,7 @@ do_directive(COMPSTATE * cstat, char *direct)
             v_abort_compile(cstat, "Unexpected end of file while doing $ifver.");
 
         if (strcasecmp(tmpname, "this")) {
-            char tempa[BUFFER_LEN], tempb[BUFFER_LEN];
-
-            strcpyn(tempa, sizeof(tempa), match_args);
-            strcpyn(tempb, sizeof(tempb), match_cmdname);
-            init_match(cstat->descr, cstat->player, tmpname, NOTYPE, &md);
-            match_registered(&md);
-            match_absolute(&md);
-            match_me(&md);
-            i = (int) match_result(&md);
-            strcpyn(match_args, sizeof(match_args), tempa);
-            strcpyn(match_cmdname, sizeof(match_cmdname), tempb);
+            i = (int) match_directive(cstat, tmpname, 1);
         } else {
             i = cstat->program;
         }
@@ -3915,11 +4562,14 @@ do_directive(COMPSTATE * cstat, char *direct)
                             "I don't understand what object you want to check with $ifver.");
 
         if (!strcasecmp(temp, "ifver") || !strcasecmp(temp, "ifnver")) {
-            tmpptr = (char *) get_property_class(i, MUF_VERSION_PROP);
+            propname = MUF_VERSION_PROP;
         } else {
-            tmpptr = (char *) get_property_class(i, MUF_LIB_VERSION_PROP);
+            propname = MUF_LIB_VERSION_PROP;
         }
 
+        mufcache_note(&cstat->deps, MUFCACHE_PROP, i, propname, 1);
+        tmpptr = (char *) get_property_class(i, propname);
+
         if (!tmpptr || !*tmpptr) {
             tmpptr = malloc(4 * sizeof(char));
             strcpyn(tmpptr, 4 * sizeof(char), "0.0");
@@ -3983,23 +4633,12 @@ do_directive(COMPSTATE * cstat, char *direct)
             free(tmpptr);
         }
     } else if (!strcasecmp(temp, "iflib") || !strcasecmp(temp, "ifnlib")) {
-        struct match_data md;
-        char tempa[BUFFER_LEN], tempb[BUFFER_LEN];
-
         tmpname = (char *) next_token_raw(cstat);
 
         if (!tmpname)
             v_abort_compile(cstat, "Unexpected end of file in $iflib/$ifnlib clause.");
 
-        strcpyn(tempa, sizeof(tempa), match_args);
-        strcpyn(tempb, sizeof(tempb), match_cmdname);
-        init_match(cstat->descr, cstat->player, tmpname, NOTYPE, &md);
-        match_registered(&md);
-        match_absolute(&md);
-        i = (int) match_result(&md);
-        strcpyn(match_args, sizeof(match_args), tempa);
-        strcpyn(match_cmdname, sizeof(match_cmdname), tempb);
-
+        i = (int) match_directive(cstat, tmpname, 0);
         free(tmpname);
 
         if (OkObj(i) && Typeof(i) == TYPE_PROGRAM) {
@@ -4073,6 +4712,9 @@ do_directive(COMPSTATE * cstat, char *direct)
                compile error.  Only throw an error if both fail.  This is
                the default mode. */
             cstat->force_comment = 0;
+        } else if (!strcasecmp(tmpptr, "noinline")) {
+            /* Always call procedures, even small ones */
+            cstat->inline_procs = 0;
         } else {
             /* If the pragma is not recognized, it is ignored, with a warning. */
             notifyf(cstat->player,
@@ -5530,6 +6172,14 @@ size_prog(dbref prog)
     }
 
     byts += size_pubs(PROGRAM_PUBS(prog));
+
+    if (PROGRAM_PUBTAB(prog)) {
+        byts += sizeof(hash_tab) * PUBLIC_HASH_SIZE;
+
+        for (struct publics *pub = PROGRAM_PUBS(prog); pub; pub = pub->next)
+            byts += sizeof(hash_entry) + strlen(pub->subname) + 1;
+    }
+
     return byts;
 }
 
@@ -5549,9 +6199,9 @@ clear_primitives(void)
  * currently in the primitive hash, then loads all the primitives from
  * base_inst into the hash.
  *
- * This also loads the value of variables IN_FORPOP, IN_FORITER, IN_FOR,
- * IN_FOREACH, and IN_TRYPOP.  The number of primitives is logged via
- * log_status
+ * This also loads the value of variables IN_DEBUG_LINE, IN_FORPOP,
+ * IN_FORITER, IN_FOR, IN_FOREACH, and IN_TRYPOP.  The number of primitives
+ * is logged via log_status
  *
  * @see log_status
  */
@@ -5570,6 +6220,7 @@ init_primitives(void)
             panic("Out of memory");
     }
 
+    IN_DEBUG_LINE = get_primitive("DEBUG_LINE");
     IN_FORPOP = get_primitive(" FORPOP");
     IN_FORITER = get_primitive(" FORITER");
     IN_FOR = get_primitive(" FOR");
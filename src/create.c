@@ -14,6 +14,7 @@
 #include "boolexp.h"
 #include "commands.h"
 #include "db.h"
+#include "dbindex.h"
 #ifdef DISKBASE
 #include "diskprop.h"
 #endif
@@ -105,6 +106,7 @@ do_open(int descr, dbref player, const char *direction, const char *linkto)
                     (DBFETCH(exit)->sp.exit.dest)[i] = good_dest[i];
                 }
 
+                dbindex_update(exit);
                 DBDIRTY(exit);
             }
         }
@@ -282,6 +284,7 @@ do_link(int descr, dbref player, const char *thing_name, const char *dest_name)
             break;
     }
 
+    dbindex_update(thing);
     DBDIRTY(thing);
     return;
 }
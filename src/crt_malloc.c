@@ -1138,6 +1138,7 @@ CrT_alloc_prog_string(const char *s, const char *file, int line)
         abort();
 
     ss->links = 1;
+    ss->room = 0;
     ss->length = length;
     memmove(ss->data, s, ss->length + 1);
     return (ss);
@@ -15,6 +15,8 @@
 #include "boolexp.h"
 #include "compile.h"
 #include "db.h"
+#include "dbbin.h"
+#include "dbindex.h"
 #ifdef DISKBASE
 #include "diskprop.h"
 #endif
@@ -24,8 +26,10 @@
 #include "fbtime.h"
 #include "game.h"
 #include "interface.h"
+#include "journal.h"
 #include "match.h"
 #include "log.h"
+#include "mufcache.h"
 #include "player.h"
 #include "predicates.h"
 #include "props.h"
@@ -36,6 +40,27 @@
  */
 struct object *db = 0;
 
+/**
+ * @var the flags of every object, indexed by dbref
+ */
+object_flag_type *db_flags = 0;
+
+/**
+ * @var the owner of every object, indexed by dbref
+ */
+dbref *db_owner = 0;
+
+/**
+ * @var the location of every object, indexed by dbref
+ */
+dbref *db_location = 0;
+
+/**
+ * @var the next object in every object's contents or exits list, indexed
+ *      by dbref
+ */
+dbref *db_next = 0;
+
 /**
  * @var the things currently being forced.
  */
@@ -46,6 +71,12 @@ objnode *forcelist = 0;
  */
 dbref db_top = 0;
 
+/**
+ * @private
+ * @var the number of objects the DB arrays have room for
+ */
+static dbref db_size = 0;
+
 /**
  * @var the head of the garbage dbref list -- recycle-able objects
  *      This may be NOTHING.
@@ -64,31 +95,52 @@ static int db_load_format = 0;
 #define DB_INITIAL_SIZE 10000
 #endif /* DB_INITIAL_SIZE */
 
+/**
+ * Resize one of the DB's arrays
+ *
+ * @private
+ * @param p the array, or NULL to allocate a new one
+ * @param count the number of elements it needs room for
+ * @param size the size of an element
+ * @return the resized array
+ */
+static void *
+db_resize(void *p, dbref count, size_t size)
+{
+    if ((p = realloc(p, (size_t)count * size)) == 0) {
+        abort();
+    }
+
+    return p;
+}
+
 /**
  * Grow the DB to a new size.
  *
  * 'newtop' will be the number of elements in the DB.  This won't let you
  * shrink the DB, 'newtop' must be greater than db_top
  *
- * @private
+ * The hot field arrays (@see db_flags) are grown along with it.  When
+ * they run out of room, they grow to at least twice their size, so that
+ * creating objects one at a time takes only a few reallocs.
+ *
  * @param newtop the new DB size
  */
-static void
+void
 db_grow(dbref newtop)
 {
     if (newtop > db_top) {
         db_top = newtop;
 
-        if (db) {
-            if ((db = realloc(db, (size_t)db_top * sizeof(struct object))) == 0) {
-                abort();
-            }
-        } else {
-            int startsize = MAX(newtop, DB_INITIAL_SIZE);
+        if (newtop > db_size) {
+            dbref size = MAX(newtop, MAX(db_size * 2, DB_INITIAL_SIZE));
 
-            if ((db = malloc((size_t)startsize * sizeof(struct object))) == 0) {
-                abort();
-            }
+            db = db_resize(db, size, sizeof(struct object));
+            db_flags = db_resize(db_flags, size, sizeof(object_flag_type));
+            db_owner = db_resize(db_owner, size, sizeof(dbref));
+            db_location = db_resize(db_location, size, sizeof(dbref));
+            db_next = db_resize(db_next, size, sizeof(dbref));
+            db_size = size;
         }
     }
 }
@@ -117,12 +169,15 @@ db_clear_object(dbref i)
     memset(o, 0, sizeof(struct object));
 
     NAME(i) = 0;
+    FLAGS(i) = 0;
+    OWNER(i) = 0;
     ts_newobject(i);
-    o->location = NOTHING;
+    LOCATION(i) = NOTHING;
     o->contents = NOTHING;
     o->exits = NOTHING;
-    o->next = NOTHING;
+    NEXTOBJ(i) = NOTHING;
     o->properties = 0;
+    o->propsize = 0;
 
 #ifdef DISKBASE
     o->propsfpos = 0;
@@ -167,6 +222,7 @@ new_object(bool isplayer)
 
     /* Make sure it is set dirty for diskbase purposes. */
     DBDIRTY(newobj);
+    journal_props(newobj);
 
     return newobj;
 }
@@ -191,6 +247,7 @@ create_object(const char *name, dbref owner, object_flag_type flags)
     NAME(newobj) = alloc_string(name);
     FLAGS(newobj) = flags;
     OWNER(newobj) = OWNER(owner);
+    dbindex_update(newobj);
 
     return newobj;
 }
@@ -337,6 +394,7 @@ create_thing(dbref player, const char *name, dbref location)
         THING_SET_HOME(newthing, player);
     }
 
+    dbindex_update(newthing);
     DBDIRTY(location);
 
     return newthing;
@@ -359,6 +417,8 @@ clone_thing(dbref thing, dbref player, int copy_hidden_props)
 
     struct object *o = DBFETCH(new_thing);
     o->properties = copy_prop(thing, copy_hidden_props);
+    o->propsize = resize_proplist(o->properties);
+    journal_props(new_thing);
 #ifdef DISKBASE
     o->propsfpos = 0;
     o->propsmode = PROPS_UNLOADED;
@@ -480,9 +540,9 @@ db_write_object(FILE * f, dbref i)
 #endif /* DISKBASE */
 
     putstring(f, NAME(i));
-    putref(f, o->location);
+    putref(f, LOCATION(i));
     putref(f, o->contents);
-    putref(f, o->next);
+    putref(f, NEXTOBJ(i));
 
     /*
      * @TODO This writes the flags as a signed integer even though
@@ -746,6 +806,7 @@ db_write(FILE * f)
 
         db_write_object(f, i);
         FLAGS(i) &= ~OBJECT_CHANGED;    /* clear changed flag */
+        dump_progress(db_top - i);
     }
 
     fseek(f, 0L, SEEK_END);
@@ -933,10 +994,20 @@ db_free(void)
             db_free_object(i);
 
         free(db);
+        free(db_flags);
+        free(db_owner);
+        free(db_location);
+        free(db_next);
         db = 0;
+        db_flags = 0;
+        db_owner = 0;
+        db_location = 0;
+        db_next = 0;
         db_top = 0;
+        db_size = 0;
     }
 
+    dbindex_clear();
     clear_players();
     clear_primitives();
     recyclable = NOTHING;
@@ -975,9 +1046,9 @@ db_read_object(FILE * f, dbref objno)
     NAME(objno) = getstring(f);
 
     o = DBFETCH(objno);
-    o->location = getref(f);
+    LOCATION(objno) = getref(f);
     o->contents = getref(f);
-    o->next = getref(f);
+    NEXTOBJ(objno) = getref(f);
 
     tmp = getref(f);    /* flags list */
     tmp &= ~DUMP_MASK;
@@ -1094,15 +1165,14 @@ db_read_object(FILE * f, dbref objno)
  * Autostart all programs set ABODE
  *
  * This autostarts by scanning the entire DB and compiling the ABODE
- * programs.  Compile will automatically queue up the programs.
+ * programs.  Compile will automatically queue up the programs.  Then the
+ * most used programs are picked to be compiled in the background.
  *
  * @private
  */
 static void
 autostart_progs(void)
 {
-    struct line *tmp;
-
     /* Don't do it if we're converting the DB */
     if (db_conversion_flag) {
         return;
@@ -1115,28 +1185,26 @@ autostart_progs(void)
                  * Pre-compile AUTOSTART programs.  They queue up when they
                  * finish compiling.
                  */
-                tmp = PROGRAM_FIRST(i);
-                PROGRAM_SET_FIRST(i, read_program(i));
-                do_compile(-1, OWNER(i), i, 0);
-                free_prog_text(PROGRAM_FIRST(i));
-                PROGRAM_SET_FIRST(i, tmp);
+                compile_on_demand(-1, i);
             }
         }
     }
+
+    mufcache_warmup_start();
 }
 
 /**
- * Read the FuzzBall DB from the given file handle.
+ * Read a text format database from the given file handle.
  *
- * Returns the dbtop value, or -1 if the header is invalid.  If
- * there is a problem loading the database, chances are it will trigger
- * an abort() as there is no gentle error handling in this process.
+ * This loads the objects and the tune parameters; everything that is
+ * shared between database formats is left to db_read.
  *
+ * @private
  * @param f the file handle to load from
  * @return the dbtop value or #-1 if the header is invalid
  */
-dbref
-db_read(FILE * f)
+static dbref
+db_read_text(FILE * f)
 {
     dbref grow;
     char *special;
@@ -1175,6 +1243,63 @@ db_read(FILE * f)
     getref(f);
     tune_load_parms_from_file(f, NOTHING, getref(f));
 
+    return db_top;
+}
+
+/**
+ * Read the FuzzBall DB from the given file handle.
+ *
+ * Returns the dbtop value, or -1 if the header is invalid.  If
+ * there is a problem loading the database, chances are it will trigger
+ * an abort() as there is no gentle error handling in this process.
+ *
+ * Both the text format and the binary format (@see dbbin_read) are
+ * understood; the format is detected from the start of the file.
+ *
+ * If a delta log is given, its changes are replayed over the database
+ * before the recyclable list is built, followed by the journal if one is
+ * given.  @see dbbin_read_deltas @see journal_replay
+ *
+ * @param f the file handle to load from
+ * @param deltas the delta log to replay, or NULL
+ * @param journal the journal to replay, or NULL
+ * @return the dbtop value or #-1 if the header is invalid
+ */
+dbref
+db_read(FILE * f, FILE * deltas, FILE * journal)
+{
+#ifndef DISKBASE
+    int applied = 0;
+    int replayed;
+#endif
+
+#ifndef DISKBASE
+    if (dbbin_probe(f)) {
+        if (dbbin_read(f) < 0)
+            return -1;
+    } else
+#endif
+    if (db_read_text(f) < 0) {
+        return -1;
+    }
+
+#ifndef DISKBASE
+    if (deltas) {
+        applied = dbbin_read_deltas(deltas);
+
+        if (applied < 0)
+            return -1;
+
+        log_status("LOADING: %d delta dump(s) applied.", applied);
+    }
+
+    if ((replayed = journal_replay(journal, applied)) < 0)
+        return -1;
+
+    if (journal)
+        log_status("LOADING: %d journal batch(es) replayed.", replayed);
+#endif
+
     for (dbref j = 0; j < db_top; j++) {
         if (Typeof(j) == TYPE_GARBAGE) {
             NEXTOBJ(j) = recyclable;
@@ -1446,7 +1571,8 @@ remove_first(dbref first, dbref what)
         /* have to find it */
         DOLIST(prev, first) {
             if (NEXTOBJ(prev) == what) {
-                DBSTORE(prev, next, NEXTOBJ(what));
+                NEXTOBJ(prev) = NEXTOBJ(what);
+                DBDIRTY(prev);
                 return first;
             }
         }
@@ -1529,7 +1655,7 @@ size_t
 size_object(dbref i, int load)
 {
     size_t byts;
-    byts = sizeof(struct object);
+    byts = sizeof(struct object) + sizeof(object_flag_type) + 3 * sizeof(dbref);
 
     if (NAME(i)) {
         byts += strlen(NAME(i)) + 1;
@@ -0,0 +1,1781 @@
+/** @file dbbin.c
+ *
+ * Implementation of the binary database format.  @see dbbin.h for an
+ * overview of the layout.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#include "config.h"
+
+#ifndef DISKBASE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(WIN32) && !defined(MALLOC_PROFILING)
+/*
+ * crt_malloc keeps unlocked global statistics, so profiling builds load
+ * on a single thread.
+ */
+#define DBBIN_THREADED
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "boolexp.h"
+#include "db.h"
+#include "dbbin.h"
+#include "fbstrings.h"
+#include "game.h"
+#include "log.h"
+#include "player.h"
+#include "props.h"
+#include "tune.h"
+
+/*
+ * Don't bother starting a thread for fewer objects than this.  Small
+ * databases load faster than a thread starts.
+ */
+#ifndef DBBIN_THREAD_MIN_OBJS
+#define DBBIN_THREAD_MIN_OBJS 4096
+#endif
+
+/*
+ * The smallest a property node can be in a record: a name, flags, and a
+ * child count.  Used to reject damaged counts before allocating for them.
+ */
+#define DBBIN_MIN_PROP_SIZE 10
+
+/**
+ * @private
+ * An entry in the string table's hash, used to find repeated strings.
+ */
+struct dbbin_strent {
+    struct dbbin_strent *next;  /**< Next entry in this bucket */
+    uint32_t hash;              /**< The full hash of the string */
+    uint32_t offset;            /**< Offset of the string in the table */
+};
+
+/**
+ * @private
+ * The string table being built while writing a database.
+ */
+struct dbbin_strtab {
+    struct dbbin_buf data;          /**< The table itself */
+    struct dbbin_strent **buckets;  /**< Hash of the strings in the table */
+    size_t nbuckets;                /**< Number of buckets, a power of 2 */
+    size_t count;                   /**< Number of strings in the table */
+};
+
+/**
+ * @private
+ * A binary database that has been read into memory.
+ */
+struct dbbin_file {
+    unsigned char *buf;         /**< The whole file */
+    size_t len;                 /**< Size of the file */
+    dbref top;                  /**< Number of objects */
+    int tune_count;             /**< Number of tune parameter lines */
+    uint64_t tune_off;          /**< Offset of the tune parameters */
+    uint64_t rec_off;           /**< Offset of the first object record */
+    const char *strtab;         /**< The string table */
+    size_t strtab_len;          /**< Size of the string table */
+    const unsigned char *index; /**< Record offsets, one per object */
+};
+
+/**
+ * @private
+ * A lock property whose text has not been parsed yet.
+ *
+ * parse_boolexp uses shared state, so loader threads leave locks for the
+ * main thread.
+ */
+struct dbbin_lock {
+    dbref obj;          /**< The object the property is on */
+    PropPtr node;       /**< The lock property */
+    const char *text;   /**< The unparsed lock, in the string table */
+};
+
+/**
+ * @private
+ * A range of objects to load, and the results of loading them.
+ */
+struct dbbin_worker {
+    const struct dbbin_file *file;  /**< The file being loaded */
+    dbref first;                    /**< First object to load */
+    dbref last;                     /**< One past the last object to load */
+    struct dbbin_lock *locks;       /**< Locks left to parse */
+    size_t nlocks;                  /**< Number of entries in 'locks' */
+    size_t locksize;                /**< Number of entries allocated */
+    int bad;                        /**< True if a record was damaged */
+    dbref badobj;                   /**< The object that was damaged */
+};
+
+/**
+ * Make sure a buffer has room for 'n' more bytes
+ *
+ * @private
+ * @param b the buffer
+ * @param n the number of bytes needed
+ */
+static void
+dbbin_reserve(struct dbbin_buf *b, size_t n)
+{
+    if (b->len + n <= b->size)
+        return;
+
+    while (b->len + n > b->size)
+        b->size = b->size ? b->size * 2 : 4096;
+
+    if (!(b->data = realloc(b->data, b->size))) {
+        fprintf(stderr, "dbbin_reserve(): Out of Memory!\n");
+        abort();
+    }
+}
+
+/**
+ * Append bytes to a buffer
+ *
+ * @private
+ * @param b the buffer
+ * @param src the bytes to append
+ * @param n the number of bytes
+ */
+static void
+dbbin_put_bytes(struct dbbin_buf *b, const void *src, size_t n)
+{
+    dbbin_reserve(b, n);
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+/**
+ * Store a little-endian integer at a position in a buffer
+ *
+ * @private
+ * @param dst where to store the integer
+ * @param v the integer
+ * @param n the size of the integer, in bytes
+ */
+static void
+dbbin_encode(unsigned char *dst, uint64_t v, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+/**
+ * Append a little-endian integer to a buffer
+ *
+ * @param b the buffer
+ * @param v the integer
+ * @param n the size of the integer, in bytes
+ */
+void
+dbbin_put_int(struct dbbin_buf *b, uint64_t v, int n)
+{
+    dbbin_reserve(b, (size_t) n);
+    dbbin_encode(b->data + b->len, v, n);
+    b->len += (size_t) n;
+}
+
+/**
+ * Append a string to a buffer, inline
+ *
+ * The string is stored as its size including the terminating NUL (4
+ * bytes), then its bytes.  NULL is stored as the empty string.
+ *
+ * @param b the buffer
+ * @param s the string
+ */
+void
+dbbin_put_str(struct dbbin_buf *b, const char *s)
+{
+    size_t len;
+
+    if (!s)
+        s = "";
+
+    len = strlen(s) + 1;
+    dbbin_put_int(b, len, 4);
+    dbbin_put_bytes(b, s, len);
+}
+
+/**
+ * Hash a string for the string table (FNV-1a)
+ *
+ * @private
+ * @param s the string
+ * @return the hash
+ */
+static uint32_t
+dbbin_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+/**
+ * Set up an empty string table
+ *
+ * Offset 0 always holds the empty string, which is also used for NULL.
+ *
+ * @private
+ * @param st the string table
+ */
+static void
+dbbin_strtab_init(struct dbbin_strtab *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->nbuckets = 4096;
+    st->buckets = calloc(st->nbuckets, sizeof(*st->buckets));
+
+    if (!st->buckets) {
+        fprintf(stderr, "dbbin_strtab_init(): Out of Memory!\n");
+        abort();
+    }
+
+    dbbin_put_bytes(&st->data, "", 1);
+}
+
+/**
+ * Double the number of buckets in the string table's hash
+ *
+ * @private
+ * @param st the string table
+ */
+static void
+dbbin_strtab_grow(struct dbbin_strtab *st)
+{
+    size_t nbuckets = st->nbuckets * 2;
+    struct dbbin_strent **buckets = calloc(nbuckets, sizeof(*buckets));
+
+    if (!buckets) {
+        fprintf(stderr, "dbbin_strtab_grow(): Out of Memory!\n");
+        abort();
+    }
+
+    for (size_t i = 0; i < st->nbuckets; i++) {
+        struct dbbin_strent *e, *next;
+
+        for (e = st->buckets[i]; e; e = next) {
+            next = e->next;
+            e->next = buckets[e->hash & (nbuckets - 1)];
+            buckets[e->hash & (nbuckets - 1)] = e;
+        }
+    }
+
+    free(st->buckets);
+    st->buckets = buckets;
+    st->nbuckets = nbuckets;
+}
+
+/**
+ * Find or add a string in the string table
+ *
+ * @private
+ * @param st the string table
+ * @param s the string, which may be NULL
+ * @return the offset of the string in the table
+ */
+static uint32_t
+dbbin_intern(struct dbbin_strtab *st, const char *s)
+{
+    struct dbbin_strent *e;
+    uint32_t h;
+
+    if (!s || !*s)
+        return 0;
+
+    h = dbbin_hash(s);
+
+    for (e = st->buckets[h & (st->nbuckets - 1)]; e; e = e->next) {
+        if (e->hash == h && !strcmp((char *) st->data.data + e->offset, s))
+            return e->offset;
+    }
+
+    if (st->data.len > UINT32_MAX - BUFFER_LEN) {
+        fprintf(stderr, "dbbin_intern(): String table is full!\n");
+        abort();
+    }
+
+    if (st->count >= st->nbuckets)
+        dbbin_strtab_grow(st);
+
+    if (!(e = malloc(sizeof(*e)))) {
+        fprintf(stderr, "dbbin_intern(): Out of Memory!\n");
+        abort();
+    }
+
+    e->hash = h;
+    e->offset = (uint32_t) st->data.len;
+    e->next = st->buckets[h & (st->nbuckets - 1)];
+    st->buckets[h & (st->nbuckets - 1)] = e;
+    st->count++;
+
+    dbbin_put_bytes(&st->data, s, strlen(s) + 1);
+    return e->offset;
+}
+
+/**
+ * Append a string to a buffer, through the string table if there is one
+ *
+ * @private
+ * @param b the buffer
+ * @param st the string table, or NULL to store the string inline
+ * @param s the string, which may be NULL
+ */
+static void
+dbbin_put_sref(struct dbbin_buf *b, struct dbbin_strtab *st, const char *s)
+{
+    if (st) {
+        dbbin_put_int(b, dbbin_intern(st, s), 4);
+    } else {
+        dbbin_put_str(b, s);
+    }
+}
+
+/**
+ * Free a string table
+ *
+ * @private
+ * @param st the string table
+ */
+static void
+dbbin_strtab_free(struct dbbin_strtab *st)
+{
+    for (size_t i = 0; i < st->nbuckets; i++) {
+        struct dbbin_strent *e, *next;
+
+        for (e = st->buckets[i]; e; e = next) {
+            next = e->next;
+            free(e);
+        }
+    }
+
+    free(st->buckets);
+    free(st->data.data);
+}
+
+/**
+ * Find the type a property will be written as
+ *
+ * Properties with an empty value are written as plain propdirs, or not at
+ * all if they have nothing in them, just as db_putprop skips them.
+ *
+ * @private
+ * @param p the property
+ * @return the PROP_*TYP to write
+ */
+static int
+dbbin_prop_type(PropPtr p)
+{
+    switch (PropType(p)) {
+        case PROP_STRTYP:
+            return (PropDataStr(p) && *PropDataStr(p)) ? PROP_STRTYP : PROP_DIRTYP;
+        case PROP_INTTYP:
+            return PropDataVal(p) ? PROP_INTTYP : PROP_DIRTYP;
+        case PROP_FLTTYP:
+            return PropDataFVal(p) != 0.0 ? PROP_FLTTYP : PROP_DIRTYP;
+        case PROP_REFTYP:
+            return PropDataRef(p) != NOTHING ? PROP_REFTYP : PROP_DIRTYP;
+        case PROP_LOKTYP:
+            return PropDataLok(p) != TRUE_BOOLEXP ? PROP_LOKTYP : PROP_DIRTYP;
+        default:
+            return PROP_DIRTYP;
+    }
+}
+
+/**
+ * Write a property's flags and value into a record
+ *
+ * @private
+ * @param b the record being built
+ * @param st the string table, or NULL to store strings inline
+ * @param p the property
+ * @param type the type to write it as, from dbbin_prop_type
+ */
+static void
+dbbin_put_value(struct dbbin_buf *b, struct dbbin_strtab *st, PropPtr p,
+                int type)
+{
+    uint64_t bits;
+
+    if (type == PROP_DIRTYP) {
+        dbbin_put_int(b, PROP_DIRTYP, 2);
+    } else {
+        dbbin_put_int(b, PropFlagsRaw(p) & ~(PROP_TOUCHED | PROP_ISUNLOADED | PROP_DIRUNLOADED), 2);
+    }
+
+    switch (type) {
+        case PROP_STRTYP:
+            dbbin_put_sref(b, st, PropDataStr(p));
+            break;
+        case PROP_INTTYP:
+            dbbin_put_int(b, (uint32_t) PropDataVal(p), 4);
+            break;
+        case PROP_FLTTYP:
+            memcpy(&bits, &PropDataFVal(p), sizeof(bits));
+            dbbin_put_int(b, bits, 8);
+            break;
+        case PROP_REFTYP:
+            dbbin_put_int(b, (uint32_t) PropDataRef(p), 4);
+            break;
+        case PROP_LOKTYP:
+            dbbin_put_sref(b, st, unparse_boolexp((dbref) 1, PropDataLok(p), 0));
+            break;
+    }
+}
+
+/**
+ * Write the properties of an AVL tree into a record
+ *
+ * Each property is written as its name, its flags, its value (depending
+ * on type), the number of properties in its propdir, and then those
+ * properties.  Properties are written in the order of the tree, which is
+ * what lets the loader rebuild the tree without searching it.
+ *
+ * @private
+ * @param b the record being built
+ * @param st the string table, or NULL to store strings inline
+ * @param p the AVL tree to write
+ * @return the number of properties written at this level
+ */
+static uint32_t
+dbbin_put_props(struct dbbin_buf *b, struct dbbin_strtab *st, PropPtr p)
+{
+    uint32_t count = 0;
+    uint32_t children;
+    size_t start, countpos;
+    int type;
+
+    if (!p)
+        return 0;
+
+    count += dbbin_put_props(b, st, p->left);
+
+    start = b->len;
+    type = dbbin_prop_type(p);
+
+    dbbin_put_sref(b, st, PropName(p));
+    dbbin_put_value(b, st, p, type);
+
+    countpos = b->len;
+    dbbin_put_int(b, 0, 4);
+    children = dbbin_put_props(b, st, PropDir(p));
+
+    if (type == PROP_DIRTYP && !children) {
+        b->len = start;
+    } else {
+        dbbin_encode(b->data + countpos, children, 4);
+        count++;
+    }
+
+    count += dbbin_put_props(b, st, p->right);
+
+    return count;
+}
+
+/**
+ * Write an object's fields, everything but its properties, into a record
+ *
+ * These are, in order: the name, location, contents, next, the
+ * non-internal flags, the created, last used, use count, and modified
+ * timestamps, and the type specific fields (the same ones db_write_object
+ * writes).
+ *
+ * @private
+ * @param b the buffer to build the record in
+ * @param st the string table, or NULL to store strings inline
+ * @param i the object to write
+ */
+static void
+dbbin_put_head(struct dbbin_buf *b, struct dbbin_strtab *st, dbref i)
+{
+    struct object *o = DBFETCH(i);
+
+    dbbin_put_sref(b, st, NAME(i));
+    dbbin_put_int(b, (uint32_t) LOCATION(i), 4);
+    dbbin_put_int(b, (uint32_t) o->contents, 4);
+    dbbin_put_int(b, (uint32_t) NEXTOBJ(i), 4);
+    dbbin_put_int(b, (uint32_t) (FLAGS(i) & ~DUMP_MASK), 4);
+    dbbin_put_int(b, (uint64_t) (int64_t) o->ts_created, 8);
+    dbbin_put_int(b, (uint64_t) (int64_t) o->ts_lastused, 8);
+    dbbin_put_int(b, (uint32_t) o->ts_usecount, 4);
+    dbbin_put_int(b, (uint64_t) (int64_t) o->ts_modified, 8);
+
+    switch (Typeof(i)) {
+        case TYPE_THING:
+            dbbin_put_int(b, (uint32_t) THING_HOME(i), 4);
+            dbbin_put_int(b, (uint32_t) o->exits, 4);
+            dbbin_put_int(b, (uint32_t) OWNER(i), 4);
+            break;
+
+        case TYPE_ROOM:
+            dbbin_put_int(b, (uint32_t) o->sp.room.dropto, 4);
+            dbbin_put_int(b, (uint32_t) o->exits, 4);
+            dbbin_put_int(b, (uint32_t) OWNER(i), 4);
+            break;
+
+        case TYPE_EXIT:
+            dbbin_put_int(b, (uint32_t) o->sp.exit.ndest, 4);
+
+            for (int j = 0; j < o->sp.exit.ndest; j++) {
+                dbbin_put_int(b, (uint32_t) (o->sp.exit.dest)[j], 4);
+            }
+
+            dbbin_put_int(b, (uint32_t) OWNER(i), 4);
+            break;
+
+        case TYPE_PLAYER:
+            dbbin_put_int(b, (uint32_t) PLAYER_HOME(i), 4);
+            dbbin_put_int(b, (uint32_t) o->exits, 4);
+            dbbin_put_sref(b, st, PLAYER_PASSWORD(i));
+            break;
+
+        case TYPE_PROGRAM:
+            dbbin_put_int(b, (uint32_t) OWNER(i), 4);
+            break;
+    }
+}
+
+/**
+ * Build the record for an object
+ *
+ * The record holds the object's fields (see dbbin_put_head), then the
+ * number of top level properties and the properties themselves.
+ *
+ * @private
+ * @param b the buffer to build the record in
+ * @param st the string table, or NULL to store strings inline
+ * @param i the object to write
+ */
+static void
+dbbin_put_object(struct dbbin_buf *b, struct dbbin_strtab *st, dbref i)
+{
+    size_t countpos;
+
+    dbbin_put_head(b, st, i);
+
+    countpos = b->len;
+    dbbin_put_int(b, 0, 4);
+    dbbin_encode(b->data + countpos,
+                 dbbin_put_props(b, st, DBFETCH(i)->properties), 4);
+}
+
+/**
+ * Append an object's fields, but not its properties, to a buffer
+ *
+ * These are the same fields as a binary database record holds, with the
+ * strings inline.
+ *
+ * @param b the buffer
+ * @param i the object
+ */
+void
+dbbin_put_fields(struct dbbin_buf *b, dbref i)
+{
+    dbbin_put_head(b, NULL, i);
+}
+
+/**
+ * Append a whole property tree to a buffer
+ *
+ * This is laid out the same as the properties in a binary database
+ * record, with the strings inline.
+ *
+ * @param b the buffer
+ * @param p the AVL tree, which may be NULL
+ */
+void
+dbbin_put_proptree(struct dbbin_buf *b, PropPtr p)
+{
+    size_t countpos = b->len;
+
+    dbbin_put_int(b, 0, 4);
+    dbbin_encode(b->data + countpos, dbbin_put_props(b, NULL, p), 4);
+}
+
+/**
+ * Append a single property's flags and value to a buffer
+ *
+ * An empty value is stored as a propdir, with no value.
+ *
+ * @param b the buffer
+ * @param p the property
+ */
+void
+dbbin_put_propnode(struct dbbin_buf *b, PropPtr p)
+{
+    dbbin_put_value(b, NULL, p, dbbin_prop_type(p));
+}
+
+/**
+ * Write bytes to the database file, aborting on failure
+ *
+ * @private
+ * @param f the file handle
+ * @param data the bytes to write
+ * @param len the number of bytes
+ */
+static void
+dbbin_fwrite(FILE * f, const void *data, size_t len)
+{
+    if (len && fwrite(data, 1, len, f) != len) {
+        abort();
+    }
+}
+
+/**
+ * Write the database out to a given file handle in the binary format
+ *
+ * If there is an error writing, this abort()s the program, just like
+ * db_write.
+ *
+ * The header is:
+ *
+ * * DBBIN_MAGIC
+ * * the format version (4 bytes)
+ * * the number of objects (4 bytes)
+ * * the number of tune parameter lines (4 bytes)
+ * * 4 unused bytes
+ * * the offset of the tune parameters (8 bytes)
+ * * the offset of the first object record (8 bytes)
+ * * the offset and the size of the string table (8 bytes each)
+ * * the offset of the index (8 bytes)
+ *
+ * Each record is preceded by its size (4 bytes); see dbbin_put_object for
+ * its contents.  Strings are stored as 4 byte string table offsets.
+ *
+ * @see db_write
+ *
+ * @param f the file handle to write to
+ * @return db_top value
+ */
+dbref
+dbbin_write(FILE * f)
+{
+    struct dbbin_strtab st;
+    struct dbbin_buf rec = { NULL, 0, 0 };
+    struct dbbin_buf hdr = { NULL, 0, 0 };
+    unsigned char lenbuf[4];
+    uint64_t *index;
+    uint64_t rec_off, pos;
+
+    if (!(index = malloc(sizeof(uint64_t) * (size_t) (db_top ? db_top : 1)))) {
+        fprintf(stderr, "dbbin_write(): Out of Memory!\n");
+        abort();
+    }
+
+    dbbin_strtab_init(&st);
+
+    /* Leave room for the header, which is filled in last. */
+    dbbin_reserve(&hdr, DBBIN_HEADER_SIZE);
+    memset(hdr.data, 0, DBBIN_HEADER_SIZE);
+    dbbin_fwrite(f, hdr.data, DBBIN_HEADER_SIZE);
+
+    tune_save_parms_to_file(f);
+    rec_off = pos = (uint64_t) ftell(f);
+
+    for (dbref i = 0; i < db_top; i++) {
+        index[i] = pos;
+
+        rec.len = 0;
+        dbbin_put_object(&rec, &st, i);
+
+        dbbin_encode(lenbuf, rec.len, 4);
+        dbbin_fwrite(f, lenbuf, sizeof(lenbuf));
+        dbbin_fwrite(f, rec.data, rec.len);
+        pos += sizeof(lenbuf) + rec.len;
+
+        FLAGS(i) &= ~OBJECT_CHANGED;    /* clear changed flag */
+        dump_progress(i + 1);
+    }
+
+    dbbin_fwrite(f, st.data.data, st.data.len);
+
+    rec.len = 0;
+    for (dbref i = 0; i < db_top; i++) {
+        dbbin_put_int(&rec, index[i], 8);
+    }
+
+    dbbin_fwrite(f, rec.data, rec.len);
+
+    hdr.len = 0;
+    dbbin_put_bytes(&hdr, DBBIN_MAGIC, DBBIN_MAGIC_LEN);
+    dbbin_put_int(&hdr, DBBIN_VERSION, 4);
+    dbbin_put_int(&hdr, (uint32_t) db_top, 4);
+    dbbin_put_int(&hdr, (uint32_t) tune_count_parms(), 4);
+    dbbin_put_int(&hdr, 0, 4);
+    dbbin_put_int(&hdr, DBBIN_HEADER_SIZE, 8);
+    dbbin_put_int(&hdr, rec_off, 8);
+    dbbin_put_int(&hdr, pos, 8);
+    dbbin_put_int(&hdr, st.data.len, 8);
+    dbbin_put_int(&hdr, pos + st.data.len, 8);
+
+    fseek(f, 0L, SEEK_SET);
+    dbbin_fwrite(f, hdr.data, DBBIN_HEADER_SIZE);
+    fseek(f, 0L, SEEK_END);
+    fflush(f);
+
+    free(index);
+    free(rec.data);
+    free(hdr.data);
+    dbbin_strtab_free(&st);
+
+    return db_top;
+}
+
+/**
+ * Check if a file handle holds a binary database
+ *
+ * This peeks at the start of the file and leaves the file position where
+ * it was.
+ *
+ * @param f the file handle to check
+ * @return boolean true if the file starts with DBBIN_MAGIC
+ */
+int
+dbbin_probe(FILE * f)
+{
+    char magic[DBBIN_MAGIC_LEN];
+    long pos = ftell(f);
+    int found;
+
+    found = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+            && !memcmp(magic, DBBIN_MAGIC, sizeof(magic));
+
+    fseek(f, pos, SEEK_SET);
+    return found;
+}
+
+/**
+ * Read a little-endian integer
+ *
+ * @param r the reader
+ * @param n the size of the integer, in bytes
+ * @return the integer, or 0 if there were not enough bytes left
+ */
+uint64_t
+dbbin_get_int(struct dbbin_reader *r, int n)
+{
+    uint64_t v = 0;
+
+    if (r->end - r->p < n) {
+        r->bad = 1;
+        r->p = r->end;
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        v |= (uint64_t) r->p[i] << (8 * i);
+    }
+
+    r->p += n;
+    return v;
+}
+
+/**
+ * Read a string
+ *
+ * This is a string table offset when reading a file, or an inline string
+ * (see dbbin_put_str) when the reader has no file.
+ *
+ * @param r the reader
+ * @return the string, which points into the data being read
+ */
+const char *
+dbbin_get_str(struct dbbin_reader *r)
+{
+    uint64_t off = dbbin_get_int(r, 4);
+    const char *s;
+
+    if (!r->file) {
+        if (off < 1 || off > (uint64_t) (r->end - r->p) || r->p[off - 1]) {
+            r->bad = 1;
+            r->p = r->end;
+            return "";
+        }
+
+        s = (const char *) r->p;
+        r->p += off;
+        return s;
+    }
+
+    if (off >= r->file->strtab_len) {
+        r->bad = 1;
+        return "";
+    }
+
+    return r->file->strtab + off;
+}
+
+/**
+ * Remember a lock property to parse once loading is done
+ *
+ * @private
+ * @param w the worker loading the property
+ * @param obj the object the property is on
+ * @param node the lock property
+ * @param text the unparsed lock
+ */
+static void
+dbbin_defer_lock(struct dbbin_worker *w, dbref obj, PropPtr node,
+                 const char *text)
+{
+    if (w->nlocks == w->locksize) {
+        w->locksize = w->locksize ? w->locksize * 2 : 64;
+
+        if (!(w->locks = realloc(w->locks, w->locksize * sizeof(*w->locks)))) {
+            fprintf(stderr, "dbbin_defer_lock(): Out of Memory!\n");
+            abort();
+        }
+    }
+
+    w->locks[w->nlocks].obj = obj;
+    w->locks[w->nlocks].node = node;
+    w->locks[w->nlocks].text = text;
+    w->nlocks++;
+}
+
+/**
+ * Link an array of sorted property nodes into a balanced AVL tree
+ *
+ * Splitting on the middle node keeps the two sides within one node of each
+ * other, so the result is a valid AVL tree without any rotations.
+ *
+ * @private
+ * @param nodes the nodes, in order
+ * @param count the number of nodes
+ * @return the root of the tree
+ */
+static PropPtr
+dbbin_balance(PropPtr * nodes, size_t count)
+{
+    PropPtr p;
+    size_t mid;
+    short lh, rh;
+
+    if (!count)
+        return NULL;
+
+    mid = count / 2;
+    p = nodes[mid];
+    p->left = dbbin_balance(nodes, mid);
+    p->right = dbbin_balance(nodes + mid + 1, count - mid - 1);
+
+    lh = p->left ? p->left->height : 0;
+    rh = p->right ? p->right->height : 0;
+    p->height = (short) (1 + (lh > rh ? lh : rh));
+
+    return p;
+}
+
+/**
+ * Read one level of properties, and everything under it
+ *
+ * This builds the tree directly instead of going through set_property,
+ * which keeps it free of shared state so it can run on a loader thread.
+ *
+ * @private
+ * @param r the reader
+ * @param w the worker doing the loading
+ * @param obj the object the properties are on
+ * @param top true if these are the object's top level properties
+ * @return the AVL tree
+ */
+static PropPtr
+dbbin_read_props(struct dbbin_reader *r, struct dbbin_worker *w, dbref obj,
+                 int top)
+{
+    uint64_t count = dbbin_get_int(r, 4);
+    uint64_t bits;
+    double fval;
+    PropPtr *nodes, p;
+    const char *name;
+
+    if (!count || r->bad)
+        return NULL;
+
+    if (count > (uint64_t) (r->end - r->p) / DBBIN_MIN_PROP_SIZE) {
+        r->bad = 1;
+        return NULL;
+    }
+
+    if (!(nodes = malloc(sizeof(PropPtr) * (size_t) count))) {
+        fprintf(stderr, "dbbin_read_props(): Out of Memory!\n");
+        abort();
+    }
+
+    for (uint64_t n = 0; n < count; n++) {
+        name = dbbin_get_str(r);
+
+        /* The loader relies on the properties being in tree order. */
+        if (!*name || (n && strcasecmp(PropName(nodes[n - 1]), name) >= 0)) {
+            r->bad = 1;
+            count = n;
+            break;
+        }
+
+        p = nodes[n] = alloc_propnode(name);
+        SetPFlagsRaw(p, dbbin_get_int(r, 2));
+
+        switch (PropType(p)) {
+            case PROP_STRTYP:
+                SetPDataStr(p, alloc_string(dbbin_get_str(r)));
+
+                if (!PropDataStr(p))
+                    r->bad = 1;
+
+                break;
+            case PROP_INTTYP:
+                SetPDataVal(p, (int) (int32_t) dbbin_get_int(r, 4));
+                break;
+            case PROP_FLTTYP:
+                bits = dbbin_get_int(r, 8);
+                memcpy(&fval, &bits, sizeof(fval));
+                SetPDataFVal(p, fval);
+                break;
+            case PROP_REFTYP:
+                SetPDataRef(p, (dbref) (int32_t) dbbin_get_int(r, 4));
+                break;
+            case PROP_LOKTYP:
+                SetPDataLok(p, TRUE_BOOLEXP);
+                dbbin_defer_lock(w, obj, p, dbbin_get_str(r));
+                break;
+            case PROP_DIRTYP:
+                break;
+            default:
+                r->bad = 1;
+                break;
+        }
+
+        /* See set_listener_flag */
+        if (top && (string_prefix(name, LISTEN_PROPQUEUE) ||
+                    string_prefix(name, WLISTEN_PROPQUEUE) ||
+                    string_prefix(name, WOLISTEN_PROPQUEUE))) {
+            FLAGS(obj) |= LISTENER;
+        }
+
+        SetPDir(p, dbbin_read_props(r, w, obj, 0));
+
+        if (PropType(p) == PROP_DIRTYP && !PropDir(p))
+            r->bad = 1;
+
+        if (r->bad) {
+            count = n + 1;
+            break;
+        }
+    }
+
+    p = dbbin_balance(nodes, (size_t) count);
+    free(nodes);
+
+    return p;
+}
+
+/**
+ * Read an object's fields, everything but its properties
+ *
+ * @see dbbin_put_head for the layout.
+ *
+ * @private
+ * @param r the reader
+ * @param objno the object being loaded
+ */
+static void
+dbbin_read_head(struct dbbin_reader *r, dbref objno)
+{
+    struct object *o;
+    uint64_t ndest;
+
+    db_clear_object(objno);
+
+    o = DBFETCH(objno);
+    NAME(objno) = alloc_string(dbbin_get_str(r));
+    LOCATION(objno) = (dbref) (int32_t) dbbin_get_int(r, 4);
+    o->contents = (dbref) (int32_t) dbbin_get_int(r, 4);
+    NEXTOBJ(objno) = (dbref) (int32_t) dbbin_get_int(r, 4);
+    FLAGS(objno) = (object_flag_type) dbbin_get_int(r, 4) & ~DUMP_MASK;
+    o->ts_created = (time_t) (int64_t) dbbin_get_int(r, 8);
+    o->ts_lastused = (time_t) (int64_t) dbbin_get_int(r, 8);
+    o->ts_usecount = (int) (int32_t) dbbin_get_int(r, 4);
+    o->ts_modified = (time_t) (int64_t) dbbin_get_int(r, 8);
+
+    switch (FLAGS(objno) & TYPE_MASK) {
+        case TYPE_THING:
+            ALLOC_THING_SP(objno);
+            THING_SET_HOME(objno, (dbref) (int32_t) dbbin_get_int(r, 4));
+            o->exits = (dbref) (int32_t) dbbin_get_int(r, 4);
+            OWNER(objno) = (dbref) (int32_t) dbbin_get_int(r, 4);
+            break;
+
+        case TYPE_ROOM:
+            o->sp.room.dropto = (dbref) (int32_t) dbbin_get_int(r, 4);
+            o->exits = (dbref) (int32_t) dbbin_get_int(r, 4);
+            OWNER(objno) = (dbref) (int32_t) dbbin_get_int(r, 4);
+            break;
+
+        case TYPE_EXIT:
+            ndest = dbbin_get_int(r, 4);
+
+            if (ndest > (uint64_t) (r->end - r->p) / 4) {
+                r->bad = 1;
+                return;
+            }
+
+            o->sp.exit.ndest = (int) ndest;
+
+            /* only allocate space for linked exits */
+            if (o->sp.exit.ndest > 0)
+                o->sp.exit.dest = malloc(sizeof(dbref) * (size_t) ndest);
+
+            for (int j = 0; j < o->sp.exit.ndest; j++) {
+                (o->sp.exit.dest)[j] = (dbref) (int32_t) dbbin_get_int(r, 4);
+            }
+
+            OWNER(objno) = (dbref) (int32_t) dbbin_get_int(r, 4);
+            break;
+
+        case TYPE_PLAYER:
+            ALLOC_PLAYER_SP(objno);
+            PLAYER_SET_HOME(objno, (dbref) (int32_t) dbbin_get_int(r, 4));
+            o->exits = (dbref) (int32_t) dbbin_get_int(r, 4);
+            set_password_raw(objno, alloc_string(dbbin_get_str(r)));
+            PLAYER_SET_CURR_PROG(objno, NOTHING);
+            PLAYER_SET_IGNORE_LAST(objno, NOTHING);
+            OWNER(objno) = objno;
+            break;
+
+        case TYPE_PROGRAM:
+            ALLOC_PROGRAM_SP(objno);
+            OWNER(objno) = (dbref) (int32_t) dbbin_get_int(r, 4);
+            FLAGS(objno) &= ~INTERNAL;
+            break;
+
+        case TYPE_GARBAGE:
+            break;
+    }
+}
+
+/**
+ * Read an object's record
+ *
+ * @see dbbin_put_object for the layout.  This mirrors db_read_object,
+ * except for adding players to the player hash, which is left for the
+ * main thread.
+ *
+ * @private
+ * @param r the reader, covering exactly the record
+ * @param w the worker doing the loading
+ * @param objno the object being loaded
+ */
+static void
+dbbin_read_object(struct dbbin_reader *r, struct dbbin_worker *w, dbref objno)
+{
+    struct object *o = DBFETCH(objno);
+
+    dbbin_read_head(r, objno);
+
+    o->properties = dbbin_read_props(r, w, objno, 1);
+    o->propsize = resize_proplist(o->properties);
+}
+
+/**
+ * Load a worker's range of objects
+ *
+ * This is the body of each loader thread.  It stops at the first damaged
+ * record, noting which object it was.
+ *
+ * @private
+ * @param arg the struct dbbin_worker to run
+ * @return NULL
+ */
+static void *
+dbbin_load_range(void *arg)
+{
+    struct dbbin_worker *w = arg;
+    const struct dbbin_file *file = w->file;
+    struct dbbin_reader r;
+    uint64_t off, len;
+
+    for (dbref i = w->first; i < w->last; i++) {
+        r.file = file;
+        r.bad = 0;
+        r.p = file->index + 8 * (size_t) i;
+        r.end = r.p + 8;
+        off = dbbin_get_int(&r, 8);
+
+        if (off < file->rec_off || off > file->len - 4) {
+            w->bad = 1;
+            w->badobj = i;
+            break;
+        }
+
+        r.p = file->buf + off;
+        r.end = file->buf + file->len;
+        len = dbbin_get_int(&r, 4);
+
+        if (len > (uint64_t) (r.end - r.p)) {
+            w->bad = 1;
+            w->badobj = i;
+            break;
+        }
+
+        r.end = r.p + len;
+        dbbin_read_object(&r, w, i);
+
+        if (r.bad || r.p != r.end) {
+            w->bad = 1;
+            w->badobj = i;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Read a binary database into memory and check its header
+ *
+ * @private
+ * @param f the file handle
+ * @param file the structure to fill in
+ * @return 0 on success, -1 if the file is not a usable binary database
+ */
+static int
+dbbin_load_file(FILE * f, struct dbbin_file *file)
+{
+    struct dbbin_reader r;
+    uint64_t top, strtab_off, strtab_len, index_off;
+    long size;
+
+    memset(file, 0, sizeof(*file));
+
+    if (fseek(f, 0L, SEEK_END) || (size = ftell(f)) < DBBIN_HEADER_SIZE
+        || fseek(f, 0L, SEEK_SET)) {
+        return -1;
+    }
+
+    file->len = (size_t) size;
+
+    if (!(file->buf = malloc(file->len))) {
+        fprintf(stderr, "dbbin_load_file(): Out of Memory!\n");
+        abort();
+    }
+
+    if (fread(file->buf, 1, file->len, f) != file->len) {
+        log_status("LOADING: Could not read the binary database.");
+        return -1;
+    }
+
+    r.file = file;
+    r.bad = 0;
+    r.p = file->buf + DBBIN_MAGIC_LEN;
+    r.end = file->buf + DBBIN_HEADER_SIZE;
+
+    if (dbbin_get_int(&r, 4) != DBBIN_VERSION) {
+        log_status("LOADING: Unknown binary database version.");
+        return -1;
+    }
+
+    top = dbbin_get_int(&r, 4);
+    file->tune_count = (int) dbbin_get_int(&r, 4);
+    dbbin_get_int(&r, 4);
+    file->tune_off = dbbin_get_int(&r, 8);
+    file->rec_off = dbbin_get_int(&r, 8);
+    strtab_off = dbbin_get_int(&r, 8);
+    strtab_len = dbbin_get_int(&r, 8);
+    index_off = dbbin_get_int(&r, 8);
+
+    if (top > INT32_MAX || file->tune_off > file->rec_off
+        || file->rec_off > strtab_off || strtab_off > file->len
+        || strtab_len < 1 || strtab_len > file->len - strtab_off
+        || index_off > file->len || top > (file->len - index_off) / 8
+        || file->buf[strtab_off + strtab_len - 1] != '\0') {
+        log_status("LOADING: The binary database header is damaged.");
+        return -1;
+    }
+
+    file->top = (dbref) top;
+    file->strtab = (const char *) file->buf + strtab_off;
+    file->strtab_len = (size_t) strtab_len;
+    file->index = file->buf + index_off;
+
+    return 0;
+}
+
+/**
+ * Decide how many threads to load a database with
+ *
+ * @private
+ * @param top the number of objects
+ * @return the number of threads, at least 1
+ */
+static int
+dbbin_thread_count(dbref top)
+{
+    long n = 1;
+
+#if defined(DBBIN_THREADED) && defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    if (n > DBBIN_LOAD_THREADS)
+        n = DBBIN_LOAD_THREADS;
+
+    if (n > top / DBBIN_THREAD_MIN_OBJS)
+        n = top / DBBIN_THREAD_MIN_OBJS;
+
+    return n < 1 ? 1 : (int) n;
+}
+
+/**
+ * Split the objects between workers
+ *
+ * The split is by record bytes rather than object count, since a few
+ * objects with lots of properties can make up most of a database.
+ *
+ * @private
+ * @param file the file being loaded
+ * @param workers the workers
+ * @param nworkers the number of workers
+ */
+static void
+dbbin_split(const struct dbbin_file *file, struct dbbin_worker *workers,
+            int nworkers)
+{
+    uint64_t span = (uint64_t) (file->strtab - (const char *) file->buf)
+                    - file->rec_off;
+    dbref first = 0;
+
+    for (int k = 0; k < nworkers; k++) {
+        dbref last = file->top;
+
+        if (k < nworkers - 1) {
+            uint64_t target = file->rec_off + span / (uint64_t) nworkers * (uint64_t) (k + 1);
+            dbref lo = first, hi = file->top;
+
+            /* Find the first object at or past the target offset. */
+            while (lo < hi) {
+                dbref mid = lo + (hi - lo) / 2;
+                struct dbbin_reader r;
+
+                r.file = file;
+                r.bad = 0;
+                r.p = file->index + 8 * (size_t) mid;
+                r.end = r.p + 8;
+
+                if (dbbin_get_int(&r, 8) < target)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            last = lo;
+        }
+
+        workers[k].file = file;
+        workers[k].first = first;
+        workers[k].last = last;
+        first = last;
+    }
+}
+
+/**
+ * Run the workers, on threads when possible
+ *
+ * The first worker always runs on the calling thread.  If a thread cannot
+ * be started, its worker is run on the calling thread as well.
+ *
+ * @private
+ * @param workers the workers
+ * @param nworkers the number of workers
+ */
+static void
+dbbin_run(struct dbbin_worker *workers, int nworkers)
+{
+#ifdef DBBIN_THREADED
+    pthread_t threads[DBBIN_LOAD_THREADS];
+    int started[DBBIN_LOAD_THREADS];
+
+    for (int k = 1; k < nworkers; k++) {
+        started[k] = !pthread_create(&threads[k], NULL, dbbin_load_range,
+                                     &workers[k]);
+    }
+
+    dbbin_load_range(&workers[0]);
+
+    for (int k = 1; k < nworkers; k++) {
+        if (started[k]) {
+            pthread_join(threads[k], NULL);
+        } else {
+            dbbin_load_range(&workers[k]);
+        }
+    }
+#else
+    for (int k = 0; k < nworkers; k++) {
+        dbbin_load_range(&workers[k]);
+    }
+#endif
+}
+
+/**
+ * Parse the locks a worker left for the main thread
+ *
+ * @private
+ * @param w the worker
+ */
+static void
+dbbin_parse_locks(struct dbbin_worker *w)
+{
+    for (size_t n = 0; n < w->nlocks; n++) {
+        SetPDataLok(w->locks[n].node,
+                    parse_boolexp(-1, (dbref) 1, w->locks[n].text, 32767));
+    }
+
+    /* The parsed locks change the size of the properties. */
+    for (size_t n = 0; n < w->nlocks; n++) {
+        if (!n || w->locks[n].obj != w->locks[n - 1].obj) {
+            DBFETCH(w->locks[n].obj)->propsize =
+                resize_proplist(DBFETCH(w->locks[n].obj)->properties);
+        }
+    }
+}
+
+/**
+ * Read an object's fields, as written by dbbin_put_fields
+ *
+ * The object is cleared first, so it should already have been freed.
+ * Its properties are left empty.
+ *
+ * @param r the reader
+ * @param objno the object to fill in
+ */
+void
+dbbin_get_fields(struct dbbin_reader *r, dbref objno)
+{
+    dbbin_read_head(r, objno);
+}
+
+/**
+ * Read a property tree, as written by dbbin_put_proptree
+ *
+ * This replaces the object's properties, and updates its LISTENER flag.
+ *
+ * @param r the reader
+ * @param obj the object to load the properties onto
+ */
+void
+dbbin_get_proptree(struct dbbin_reader *r, dbref obj)
+{
+    struct object *o = DBFETCH(obj);
+    struct dbbin_worker w;
+
+    memset(&w, 0, sizeof(w));
+
+    delete_proplist(o->properties);
+    FLAGS(obj) &= ~LISTENER;
+
+    o->properties = dbbin_read_props(r, &w, obj, 1);
+    o->propsize = resize_proplist(o->properties);
+
+    dbbin_parse_locks(&w);
+    free(w.locks);
+}
+
+/**
+ * Read a property's flags and value, as written by dbbin_put_propnode
+ *
+ * Strings in 'dat' point into the data being read, and a lock is parsed
+ * into a new boolexp, which follows the same rules as for set_property.
+ *
+ * @param r the reader
+ * @param dat the property data to fill in
+ */
+void
+dbbin_get_propnode(struct dbbin_reader *r, PData * dat)
+{
+    uint64_t bits;
+
+    dat->flags = (unsigned short) dbbin_get_int(r, 2);
+
+    switch (dat->flags & PROP_TYPMASK) {
+        case PROP_STRTYP:
+            dat->data.str = (char *) dbbin_get_str(r);
+            break;
+        case PROP_INTTYP:
+            dat->data.val = (int) (int32_t) dbbin_get_int(r, 4);
+            break;
+        case PROP_FLTTYP:
+            bits = dbbin_get_int(r, 8);
+            memcpy(&dat->data.fval, &bits, sizeof(bits));
+            break;
+        case PROP_REFTYP:
+            dat->data.ref = (dbref) (int32_t) dbbin_get_int(r, 4);
+            break;
+        case PROP_LOKTYP:
+            dat->data.lok = parse_boolexp(-1, (dbref) 1, dbbin_get_str(r), 32767);
+            break;
+        case PROP_DIRTYP:
+            dat->data.str = NULL;
+            break;
+        default:
+            r->bad = 1;
+            break;
+    }
+}
+
+/**
+ * Load a binary database from the given file handle
+ *
+ * This fills in the objects and loads the tune parameters; the caller is
+ * responsible for anything that is common to every database format, such
+ * as building the recyclable list.
+ *
+ * Object records are decoded in parallel when the platform supports it,
+ * up to DBBIN_LOAD_THREADS threads.  Anything that touches shared server
+ * state -- parsing locks and adding players to the player hash -- is done
+ * afterwards on the calling thread.
+ *
+ * @param f the file handle to load from
+ * @return the dbtop value or -1 if the database is damaged
+ */
+dbref
+dbbin_read(FILE * f)
+{
+    struct dbbin_file file;
+    struct dbbin_worker *workers;
+    int nworkers;
+    int ok = 1;
+
+    if (dbbin_load_file(f, &file) < 0) {
+        free(file.buf);
+        return -1;
+    }
+
+    db_grow(file.top);
+
+    nworkers = dbbin_thread_count(file.top);
+
+    if (!(workers = calloc((size_t) nworkers, sizeof(*workers)))) {
+        fprintf(stderr, "dbbin_read(): Out of Memory!\n");
+        abort();
+    }
+
+    dbbin_split(&file, workers, nworkers);
+    dbbin_run(workers, nworkers);
+
+    for (int k = 0; k < nworkers; k++) {
+        if (workers[k].bad) {
+            log_status("LOADING: The binary database record for #%d is damaged.",
+                       workers[k].badobj);
+            ok = 0;
+        }
+    }
+
+    if (ok) {
+        for (int k = 0; k < nworkers; k++) {
+            dbbin_parse_locks(&workers[k]);
+        }
+
+        /* Same order as a text database, in case of duplicate names. */
+        for (dbref i = db_top; i-- > 0;) {
+            if (Typeof(i) == TYPE_PLAYER) {
+                add_player(i);
+            }
+        }
+
+        fseek(f, (long) file.tune_off, SEEK_SET);
+        tune_load_parms_from_file(f, NOTHING, file.tune_count);
+    }
+
+    for (int k = 0; k < nworkers; k++) {
+        free(workers[k].locks);
+    }
+
+    free(workers);
+    free(file.buf);
+
+    return ok ? db_top : -1;
+}
+
+/**
+ * Append the changed objects to a delta log
+ *
+ * The segment header is:
+ *
+ * * DBBIN_DELTA_MAGIC
+ * * the format version (4 bytes)
+ * * the number of objects (4 bytes)
+ * * the generation of the full dump this follows (4 bytes)
+ * * the number of records (4 bytes)
+ * * the number of tune parameter lines (4 bytes)
+ * * 4 unused bytes
+ * * the size of the tune parameters, the records, and the string
+ *   table (8 bytes each)
+ *
+ * That is followed by the tune parameters, then the records, then the
+ * string table.  Each record is the object's dbref and the record size
+ * (4 bytes each) and then the same record dbbin_write uses.
+ *
+ * The header is written last, so a segment cut short by a crash is
+ * recognized as damaged and ends the replay.
+ *
+ * @param f the delta log, positioned at its end
+ * @return the number of objects written
+ */
+int
+dbbin_write_delta(FILE * f)
+{
+    struct dbbin_strtab st;
+    struct dbbin_buf rec = { NULL, 0, 0 };
+    struct dbbin_buf hdr = { NULL, 0, 0 };
+    uint64_t tune_len, rec_len = 0;
+    long start;
+    int count = 0;
+
+    dbbin_strtab_init(&st);
+
+    start = ftell(f);
+    dbbin_reserve(&hdr, DBBIN_DELTA_HEADER_SIZE);
+    memset(hdr.data, 0, DBBIN_DELTA_HEADER_SIZE);
+    dbbin_fwrite(f, hdr.data, DBBIN_DELTA_HEADER_SIZE);
+
+    tune_save_parms_to_file(f);
+    tune_len = (uint64_t) (ftell(f) - start - DBBIN_DELTA_HEADER_SIZE);
+
+    for (dbref i = 0; i < db_top; i++) {
+        if (!(FLAGS(i) & OBJECT_CHANGED))
+            continue;
+
+        rec.len = 0;
+        dbbin_put_int(&rec, (uint32_t) i, 4);
+        dbbin_put_int(&rec, 0, 4);
+        dbbin_put_object(&rec, &st, i);
+        dbbin_encode(rec.data + 4, rec.len - 8, 4);
+
+        dbbin_fwrite(f, rec.data, rec.len);
+        rec_len += rec.len;
+        count++;
+
+        FLAGS(i) &= ~OBJECT_CHANGED;    /* clear changed flag */
+        dump_progress(i + 1);
+    }
+
+    dbbin_fwrite(f, st.data.data, st.data.len);
+    fflush(f);
+
+    hdr.len = 0;
+    dbbin_put_bytes(&hdr, DBBIN_DELTA_MAGIC, DBBIN_MAGIC_LEN);
+    dbbin_put_int(&hdr, DBBIN_VERSION, 4);
+    dbbin_put_int(&hdr, (uint32_t) db_top, 4);
+    dbbin_put_int(&hdr, (uint32_t) get_property_value(0, SYS_DUMPGEN_PROP), 4);
+    dbbin_put_int(&hdr, (uint32_t) count, 4);
+    dbbin_put_int(&hdr, (uint32_t) tune_count_parms(), 4);
+    dbbin_put_int(&hdr, 0, 4);
+    dbbin_put_int(&hdr, tune_len, 8);
+    dbbin_put_int(&hdr, rec_len, 8);
+    dbbin_put_int(&hdr, st.data.len, 8);
+
+    fseek(f, start, SEEK_SET);
+    dbbin_fwrite(f, hdr.data, DBBIN_DELTA_HEADER_SIZE);
+    fseek(f, 0L, SEEK_END);
+    fflush(f);
+
+    free(rec.data);
+    free(hdr.data);
+    dbbin_strtab_free(&st);
+
+    return count;
+}
+
+/**
+ * Apply one delta log segment
+ *
+ * Each object in the segment replaces the one in memory, which is freed
+ * first.  Objects past the old db_top that the segment does not hold are
+ * left as garbage.
+ *
+ * @private
+ * @param file the segment; its buffer is the whole delta log
+ * @param rec_off the offset of the first record
+ * @param count the number of records
+ * @return 0 on success, -1 if a record was damaged
+ */
+static int
+dbbin_apply_delta(const struct dbbin_file *file, uint64_t rec_off, uint64_t count)
+{
+    struct dbbin_worker w;
+    struct dbbin_reader r, objr;
+    dbref oldtop = db_top;
+    dbref objno;
+    uint64_t len;
+
+    memset(&w, 0, sizeof(w));
+    w.file = file;
+
+    db_grow(file->top);
+
+    for (dbref i = oldtop; i < db_top; i++) {
+        db_clear_object(i);
+        NAME(i) = alloc_string("<garbage>");
+        FLAGS(i) = TYPE_GARBAGE;
+    }
+
+    r.file = file;
+    r.bad = 0;
+    r.p = file->buf + rec_off;
+    r.end = (const unsigned char *) file->strtab;
+
+    for (uint64_t n = 0; n < count && !r.bad; n++) {
+        objno = (dbref) (int32_t) dbbin_get_int(&r, 4);
+        len = dbbin_get_int(&r, 4);
+
+        if (r.bad || objno < 0 || objno >= db_top
+            || len > (uint64_t) (r.end - r.p)) {
+            log_status("LOADING: A delta dump record is damaged.");
+            r.bad = 1;
+            break;
+        }
+
+        if (Typeof(objno) == TYPE_PLAYER)
+            delete_player(objno);
+
+        db_free_object(objno);
+
+        objr = r;
+        objr.end = r.p + len;
+        dbbin_read_object(&objr, &w, objno);
+
+        if (objr.bad || objr.p != objr.end) {
+            log_status("LOADING: The delta dump record for #%d is damaged.",
+                       objno);
+            r.bad = 1;
+            break;
+        }
+
+        r.p = objr.end;
+
+        if (Typeof(objno) == TYPE_PLAYER)
+            add_player(objno);
+    }
+
+    if (!r.bad)
+        dbbin_parse_locks(&w);
+
+    free(w.locks);
+
+    return r.bad ? -1 : 0;
+}
+
+/**
+ * Replay a delta log over a freshly loaded database
+ *
+ * Only the segments written after the full dump that was just loaded are
+ * applied, which is checked against the generation stored on #0.  The
+ * replay stops at the first damaged or unfinished segment.
+ *
+ * @param f the delta log
+ * @return the number of segments applied, or -1 if a record was damaged
+ */
+int
+dbbin_read_deltas(FILE * f)
+{
+    struct dbbin_file file;
+    struct dbbin_reader r;
+    unsigned char *buf;
+    uint64_t tune_len, rec_len, str_len, count;
+    size_t len, pos = 0;
+    long size;
+    int generation = get_property_value(0, SYS_DUMPGEN_PROP);
+    int applied = 0;
+
+    if (fseek(f, 0L, SEEK_END) || (size = ftell(f)) < 0
+        || fseek(f, 0L, SEEK_SET)) {
+        return 0;
+    }
+
+    len = (size_t) size;
+
+    if (!(buf = malloc(len ? len : 1))) {
+        fprintf(stderr, "dbbin_read_deltas(): Out of Memory!\n");
+        abort();
+    }
+
+    if (fread(buf, 1, len, f) != len) {
+        log_status("LOADING: Could not read the delta dumps.");
+        free(buf);
+        return 0;
+    }
+
+    while (len - pos >= DBBIN_DELTA_HEADER_SIZE) {
+        memset(&file, 0, sizeof(file));
+        file.buf = buf;
+        file.len = len;
+
+        r.file = &file;
+        r.bad = 0;
+        r.p = buf + pos + DBBIN_MAGIC_LEN;
+        r.end = buf + pos + DBBIN_DELTA_HEADER_SIZE;
+
+        if (memcmp(buf + pos, DBBIN_DELTA_MAGIC, DBBIN_MAGIC_LEN)
+            || dbbin_get_int(&r, 4) != DBBIN_VERSION) {
+            log_status("LOADING: Ignoring a damaged delta dump.");
+            break;
+        }
+
+        file.top = (dbref) dbbin_get_int(&r, 4);
+
+        if (!generation || (int) (int32_t) dbbin_get_int(&r, 4) != generation) {
+            log_status("LOADING: Ignoring delta dumps from another full dump.");
+            break;
+        }
+
+        count = dbbin_get_int(&r, 4);
+        file.tune_count = (int) dbbin_get_int(&r, 4);
+        dbbin_get_int(&r, 4);
+        tune_len = dbbin_get_int(&r, 8);
+        rec_len = dbbin_get_int(&r, 8);
+        str_len = dbbin_get_int(&r, 8);
+
+        file.tune_off = pos + DBBIN_DELTA_HEADER_SIZE;
+        file.rec_off = file.tune_off + tune_len;
+
+        if (file.top < db_top || tune_len > len - file.tune_off
+            || rec_len > len - file.rec_off || str_len < 1
+            || str_len > len - file.rec_off - rec_len
+            || buf[file.rec_off + rec_len + str_len - 1] != '\0') {
+            log_status("LOADING: Ignoring a damaged delta dump.");
+            break;
+        }
+
+        file.strtab = (const char *) buf + file.rec_off + rec_len;
+        file.strtab_len = (size_t) str_len;
+
+        if (dbbin_apply_delta(&file, file.rec_off, count) < 0) {
+            free(buf);
+            return -1;
+        }
+
+        fseek(f, (long) file.tune_off, SEEK_SET);
+        tune_load_parms_from_file(f, NOTHING, file.tune_count);
+
+        pos = (size_t) (file.rec_off + rec_len + str_len);
+        applied++;
+    }
+
+    free(buf);
+
+    return applied;
+}
+#endif /* !DISKBASE */
@@ -0,0 +1,683 @@
+/** @file dbindex.c
+ *
+ * Implementation of the object indexes.  @see dbindex.h for an overview.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "db.h"
+#include "dbindex.h"
+#include "hashtab.h"
+
+/**
+ * @private
+ * A sorted list of dbrefs.  It is allocated in one piece, so that
+ * kill_hash can free the lists kept in the trigram table.
+ */
+struct dbindex_set {
+    int count;          /**< The number of dbrefs in the list */
+    int size;           /**< The number of dbrefs there is room for */
+    dbref refs[];       /**< The dbrefs, in ascending order */
+};
+
+/**
+ * @private
+ * What an object was last indexed under, so that it can be taken out of
+ * the right lists when it changes.
+ */
+struct dbindex_entry {
+    dbref owner;        /**< The owner, or NOTHING */
+    int type;           /**< The type, or NOTYPE */
+    char *name;         /**< The name in lower case, or NULL */
+    int nlinks;         /**< The number of links */
+    dbref link;         /**< The link, if there is just one */
+    dbref *links;       /**< The links, if there are more */
+};
+
+static int dbindex_built = 0;                   /**< Are the indexes built? */
+static struct dbindex_entry *dbindex_entries;   /**< Entries by dbref */
+static dbref dbindex_entries_size = 0;          /**< Size of dbindex_entries */
+static struct dbindex_set **dbindex_owners;     /**< Lists by owner */
+static dbref dbindex_owners_size = 0;           /**< Size of dbindex_owners */
+static struct dbindex_set **dbindex_links;      /**< Lists by link */
+static dbref dbindex_links_size = 0;            /**< Size of dbindex_links */
+static struct dbindex_set *dbindex_types[TYPE_MASK + 1];  /**< By type */
+static hash_tab dbindex_trigrams[TRIGRAM_HASH_SIZE];      /**< By trigram */
+
+/* Where searches that can have no results point. */
+static const dbref dbindex_none[1] = { NOTHING };
+
+/**
+ * Count the dbrefs in a list
+ *
+ * @private
+ * @param set the list, or NULL for an empty one
+ * @return the number of dbrefs in it
+ */
+static int
+dbindex_set_count(const struct dbindex_set *set)
+{
+    return set ? set->count : 0;
+}
+
+/**
+ * Find where a dbref is, or would go, in a list
+ *
+ * @private
+ * @param set the list, or NULL for an empty one
+ * @param ref the dbref to look for
+ * @return the position of the first dbref in the list not below 'ref'
+ */
+static int
+dbindex_set_find(const struct dbindex_set *set, dbref ref)
+{
+    int lo = 0;
+    int hi = dbindex_set_count(set);
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (set->refs[mid] < ref)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/**
+ * Add a dbref to a list, if it is not already there
+ *
+ * @private
+ * @param setp the list, which may be NULL and may be moved
+ * @param ref the dbref to add
+ */
+static void
+dbindex_set_add(struct dbindex_set **setp, dbref ref)
+{
+    struct dbindex_set *set = *setp;
+    int pos = dbindex_set_find(set, ref);
+
+    if (pos < dbindex_set_count(set) && set->refs[pos] == ref)
+        return;
+
+    if (dbindex_set_count(set) == (set ? set->size : 0)) {
+        int size = set ? set->size * 2 : 4;
+
+        set = realloc(set, sizeof(struct dbindex_set) + size * sizeof(dbref));
+
+        if (!set) {
+            fprintf(stderr, "dbindex_set_add(): Out of Memory!\n");
+            abort();
+        }
+
+        if (!*setp)
+            set->count = 0;
+
+        set->size = size;
+        *setp = set;
+    }
+
+    memmove(set->refs + pos + 1, set->refs + pos,
+            (size_t) (set->count - pos) * sizeof(dbref));
+    set->refs[pos] = ref;
+    set->count++;
+}
+
+/**
+ * Take a dbref out of a list, freeing the list once it is empty
+ *
+ * @private
+ * @param setp the list, which may be NULL and is set to NULL if freed
+ * @param ref the dbref to remove
+ */
+static void
+dbindex_set_remove(struct dbindex_set **setp, dbref ref)
+{
+    struct dbindex_set *set = *setp;
+    int pos = dbindex_set_find(set, ref);
+
+    if (pos >= dbindex_set_count(set) || set->refs[pos] != ref)
+        return;
+
+    set->count--;
+    memmove(set->refs + pos, set->refs + pos + 1,
+            (size_t) (set->count - pos) * sizeof(dbref));
+
+    if (!set->count) {
+        free(set);
+        *setp = NULL;
+    }
+}
+
+/**
+ * Add an object to, or take it out of, the list for each trigram of a name
+ *
+ * @private
+ * @param name the name, in lower case
+ * @param obj the object
+ * @param add true to add the object, false to remove it
+ */
+static void
+dbindex_trigrams_change(const char *name, dbref obj, int add)
+{
+    char key[4];
+    hash_data *hd;
+    struct dbindex_set *set;
+
+    key[3] = '\0';
+
+    for (const char *p = name; p[0] && p[1] && p[2]; p++) {
+        memcpy(key, p, 3);
+        hd = find_hash(key, dbindex_trigrams, TRIGRAM_HASH_SIZE);
+
+        if (add) {
+            if (!hd) {
+                hash_data empty;
+
+                empty.pval = NULL;
+                hd = &add_hash(key, empty, dbindex_trigrams,
+                               TRIGRAM_HASH_SIZE)->dat;
+            }
+
+            set = hd->pval;
+            dbindex_set_add(&set, obj);
+            hd->pval = set;
+        } else if (hd) {
+            set = hd->pval;
+            dbindex_set_remove(&set, obj);
+
+            if (set)
+                hd->pval = set;
+            else
+                free_hash(key, dbindex_trigrams, TRIGRAM_HASH_SIZE);
+        }
+    }
+}
+
+/**
+ * Make room for more entries, marking the new ones as not indexed
+ *
+ * @private
+ * @param count the number of entries needed
+ */
+static void
+dbindex_grow_entries(dbref count)
+{
+    dbref size = dbindex_entries_size ? dbindex_entries_size : 64;
+    struct dbindex_entry *entries;
+
+    while (size < count)
+        size *= 2;
+
+    if (size == dbindex_entries_size)
+        return;
+
+    entries = realloc(dbindex_entries, (size_t) size * sizeof(*entries));
+
+    if (!entries) {
+        fprintf(stderr, "dbindex_grow_entries(): Out of Memory!\n");
+        abort();
+    }
+
+    for (dbref i = dbindex_entries_size; i < size; i++) {
+        entries[i].owner = NOTHING;
+        entries[i].type = NOTYPE;
+        entries[i].name = NULL;
+        entries[i].nlinks = 0;
+        entries[i].links = NULL;
+    }
+
+    dbindex_entries = entries;
+    dbindex_entries_size = size;
+}
+
+/**
+ * Make room for more lists in a table of lists indexed by dbref
+ *
+ * @private
+ * @param sets the table, which may be moved
+ * @param sizep the size of the table, which is updated
+ * @param count the number of lists needed
+ */
+static void
+dbindex_grow_sets(struct dbindex_set ***sets, dbref *sizep, dbref count)
+{
+    dbref size = *sizep ? *sizep : 64;
+    struct dbindex_set **grown;
+
+    while (size < count)
+        size *= 2;
+
+    if (size == *sizep)
+        return;
+
+    grown = realloc(*sets, (size_t) size * sizeof(*grown));
+
+    if (!grown) {
+        fprintf(stderr, "dbindex_grow_sets(): Out of Memory!\n");
+        abort();
+    }
+
+    memset(grown + *sizep, 0, (size_t) (size - *sizep) * sizeof(*grown));
+
+    *sets = grown;
+    *sizep = size;
+}
+
+/**
+ * Find an object's links: an exit's destinations, or the home of a
+ * player or thing, or a room's dropto
+ *
+ * @private
+ * @param obj the object
+ * @param links set to the links, which belong to the object
+ * @return the number of links
+ */
+static int
+dbindex_links_of(dbref obj, const dbref **links)
+{
+    switch (Typeof(obj)) {
+        case TYPE_EXIT:
+            *links = DBFETCH(obj)->sp.exit.dest;
+            return *links ? DBFETCH(obj)->sp.exit.ndest : 0;
+
+        case TYPE_PLAYER:
+        case TYPE_THING:
+            if (!PLAYER_SP(obj))
+                return 0;
+
+            *links = &PLAYER_SP(obj)->home;
+            return 1;
+
+        case TYPE_ROOM:
+            *links = &DBFETCH(obj)->sp.room.dropto;
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Find the links an object was last indexed under
+ *
+ * @private
+ * @param e the object's entry
+ * @return the links
+ */
+static const dbref *
+dbindex_entry_links(const struct dbindex_entry *e)
+{
+    return e->nlinks > 1 ? e->links : &e->link;
+}
+
+/**
+ * Index an object under its current owner, type and name
+ *
+ * @private
+ * @param obj the object, which must not be indexed already
+ */
+static void
+dbindex_add(dbref obj)
+{
+    struct dbindex_entry *e = &dbindex_entries[obj];
+    const dbref *links;
+
+    e->owner = OWNER(obj);
+    e->type = Typeof(obj);
+    e->name = NULL;
+    e->links = NULL;
+    e->nlinks = dbindex_links_of(obj, &links);
+
+    if (e->owner >= 0) {
+        dbindex_grow_sets(&dbindex_owners, &dbindex_owners_size, e->owner + 1);
+        dbindex_set_add(&dbindex_owners[e->owner], obj);
+    }
+
+    if (e->nlinks == 1) {
+        e->link = links[0];
+    } else if (e->nlinks > 1) {
+        if (!(e->links = malloc((size_t) e->nlinks * sizeof(dbref)))) {
+            fprintf(stderr, "dbindex_add(): Out of Memory!\n");
+            abort();
+        }
+
+        memcpy(e->links, links, (size_t) e->nlinks * sizeof(dbref));
+    }
+
+    /* HOME, NIL and NOTHING are not indexed. */
+    for (int i = 0; i < e->nlinks; i++) {
+        if (links[i] >= 0) {
+            dbindex_grow_sets(&dbindex_links, &dbindex_links_size,
+                              links[i] + 1);
+            dbindex_set_add(&dbindex_links[links[i]], obj);
+        }
+    }
+
+    dbindex_set_add(&dbindex_types[e->type], obj);
+
+    if (NAME(obj)) {
+        if (!(e->name = strdup(NAME(obj)))) {
+            fprintf(stderr, "dbindex_add(): Out of Memory!\n");
+            abort();
+        }
+
+        for (char *p = e->name; *p; p++)
+            *p = (char) tolower((unsigned char) *p);
+
+        dbindex_trigrams_change(e->name, obj, 1);
+    }
+}
+
+/**
+ * Take an object out of the lists it was last indexed under
+ *
+ * @private
+ * @param obj the object
+ */
+static void
+dbindex_remove(dbref obj)
+{
+    struct dbindex_entry *e = &dbindex_entries[obj];
+    const dbref *links = dbindex_entry_links(e);
+
+    if (e->owner >= 0 && e->owner < dbindex_owners_size)
+        dbindex_set_remove(&dbindex_owners[e->owner], obj);
+
+    for (int i = 0; i < e->nlinks; i++) {
+        if (links[i] >= 0 && links[i] < dbindex_links_size)
+            dbindex_set_remove(&dbindex_links[links[i]], obj);
+    }
+
+    free(e->links);
+
+    dbindex_set_remove(&dbindex_types[e->type], obj);
+
+    if (e->name) {
+        dbindex_trigrams_change(e->name, obj, 0);
+        free(e->name);
+    }
+
+    e->owner = NOTHING;
+    e->type = NOTYPE;
+    e->name = NULL;
+    e->nlinks = 0;
+    e->links = NULL;
+}
+
+/**
+ * Build the indexes from scratch
+ *
+ * The objects are added in ascending order, so every addition is an
+ * append.
+ *
+ * @private
+ */
+static void
+dbindex_build(void)
+{
+    dbindex_grow_entries(db_top);
+
+    for (dbref i = 0; i < db_top; i++)
+        dbindex_add(i);
+
+    dbindex_built = 1;
+}
+
+/**
+ * Throw away the indexes, so that they are rebuilt when next needed
+ */
+void
+dbindex_clear(void)
+{
+    for (dbref i = 0; i < dbindex_entries_size; i++) {
+        free(dbindex_entries[i].name);
+        free(dbindex_entries[i].links);
+    }
+
+    for (dbref i = 0; i < dbindex_owners_size; i++)
+        free(dbindex_owners[i]);
+
+    for (dbref i = 0; i < dbindex_links_size; i++)
+        free(dbindex_links[i]);
+
+    for (int i = 0; i <= TYPE_MASK; i++) {
+        free(dbindex_types[i]);
+        dbindex_types[i] = NULL;
+    }
+
+    free(dbindex_entries);
+    free(dbindex_owners);
+    free(dbindex_links);
+    kill_hash(dbindex_trigrams, TRIGRAM_HASH_SIZE, 1);
+
+    dbindex_entries = NULL;
+    dbindex_entries_size = 0;
+    dbindex_owners = NULL;
+    dbindex_owners_size = 0;
+    dbindex_links = NULL;
+    dbindex_links_size = 0;
+    dbindex_built = 0;
+}
+
+/**
+ * Bring the indexes up to date after an object's owner, type, name or
+ * links have changed
+ *
+ * This does nothing if the indexes have not been built yet.
+ *
+ * @param obj the object that changed
+ */
+void
+dbindex_update(dbref obj)
+{
+    struct dbindex_entry *e;
+    const dbref *links;
+    int nlinks;
+
+    if (!dbindex_built || obj < 0)
+        return;
+
+    dbindex_grow_entries(obj + 1);
+    e = &dbindex_entries[obj];
+
+    if (obj < db_top && e->owner == OWNER(obj) && e->type == Typeof(obj)
+        && (e->name && NAME(obj) ? !strcasecmp(e->name, NAME(obj))
+                                 : !e->name && !NAME(obj))
+        && (nlinks = dbindex_links_of(obj, &links)) == e->nlinks
+        && !memcmp(links, dbindex_entry_links(e),
+                   (size_t) nlinks * sizeof(dbref)))
+        return;
+
+    dbindex_remove(obj);
+
+    if (obj < db_top)
+        dbindex_add(obj);
+}
+
+/**
+ * Find the shortest trigram list that every name matching a pattern is in
+ *
+ * Each run of plain characters in an equalstr pattern has to appear in a
+ * matching name, so the name has every trigram of the run.  Wildcards,
+ * character classes and word sets end a run.
+ *
+ * @private
+ * @param pattern the pattern
+ * @param best set to the shortest list, which may be NULL if it is empty
+ * @return true if the pattern had a trigram to look up, false if not
+ */
+static int
+dbindex_pattern(const char *pattern, struct dbindex_set **best)
+{
+    char key[4];
+    int len = 0;
+    int found = 0;
+
+    key[3] = '\0';
+
+    for (const char *p = pattern; *p; p++) {
+        hash_data *hd;
+        struct dbindex_set *set;
+        char close;
+
+        switch (*p) {
+            case '*':
+            case '?':
+                len = 0;
+                continue;
+
+            case '[':
+            case '{':
+                close = (*p == '[') ? ']' : '}';
+
+                for (p++; *p && *p != close; p++) {
+                    if (*p == '\\' && p[1])
+                        p++;
+                }
+
+                /* Without its closing bracket, the pattern matches nothing. */
+                if (!*p)
+                    return found;
+
+                len = 0;
+                continue;
+
+            case '\\':
+                if (!p[1])
+                    return found;
+
+                p++;
+                break;
+        }
+
+        key[0] = key[1];
+        key[1] = key[2];
+        key[2] = (char) tolower((unsigned char) *p);
+
+        if (++len < 3)
+            continue;
+
+        hd = find_hash(key, dbindex_trigrams, TRIGRAM_HASH_SIZE);
+        set = hd ? hd->pval : NULL;
+
+        if (!found || dbindex_set_count(set) < dbindex_set_count(*best)) {
+            *best = set;
+            found = 1;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Start a search for objects
+ *
+ * This returns every object from 'from' on that could match the given
+ * owner, type and name pattern, in ascending order, along with some that
+ * may not.  The caller checks each object itself.
+ *
+ * @param scan the search state to set up
+ * @param owner the owner to look for, or NOTHING for any owner
+ * @param type the type to look for, or NOTYPE for any type
+ * @param pattern an equalstr name pattern, or NULL for any name
+ * @param from the lowest dbref to return
+ * @return the first candidate, or NOTHING if there are none
+ */
+dbref
+dbindex_first(struct dbindex_scan *scan, dbref owner, int type,
+              const char *pattern, dbref from)
+{
+    struct dbindex_set *best = NULL;
+    struct dbindex_set *set = NULL;
+    int narrowed = 0;
+
+    if (!dbindex_built)
+        dbindex_build();
+
+    if (from < 0)
+        from = 0;
+
+    if (owner >= 0) {
+        best = owner < dbindex_owners_size ? dbindex_owners[owner] : NULL;
+        narrowed = 1;
+    }
+
+    if (type >= 0 && type < NOTYPE && (!narrowed
+        || dbindex_set_count(dbindex_types[type]) < dbindex_set_count(best))) {
+        best = dbindex_types[type];
+        narrowed = 1;
+    }
+
+    if (pattern && dbindex_pattern(pattern, &set) && (!narrowed
+        || dbindex_set_count(set) < dbindex_set_count(best))) {
+        best = set;
+        narrowed = 1;
+    }
+
+    if (narrowed) {
+        scan->refs = best ? best->refs : dbindex_none;
+        scan->count = dbindex_set_count(best);
+        scan->pos = dbindex_set_find(best, from);
+    } else {
+        scan->refs = NULL;
+        scan->count = db_top;
+        scan->pos = from;
+    }
+
+    return dbindex_next(scan);
+}
+
+/**
+ * Start a search for the objects linked to an object
+ *
+ * These are the exits that have it as a destination, and the players,
+ * things and rooms that have it as their home or dropto, in ascending
+ * order.
+ *
+ * @param scan the search state to set up
+ * @param dest the object the links lead to
+ * @param from the lowest dbref to return
+ * @return the first object, or NOTHING if there are none
+ */
+dbref
+dbindex_first_link(struct dbindex_scan *scan, dbref dest, dbref from)
+{
+    struct dbindex_set *set = NULL;
+
+    if (!dbindex_built)
+        dbindex_build();
+
+    if (dest >= 0 && dest < dbindex_links_size)
+        set = dbindex_links[dest];
+
+    scan->refs = set ? set->refs : dbindex_none;
+    scan->count = dbindex_set_count(set);
+    scan->pos = dbindex_set_find(set, from);
+
+    return dbindex_next(scan);
+}
+
+/**
+ * Continue a search started by dbindex_first or dbindex_first_link
+ *
+ * @param scan the search state
+ * @return the next candidate, or NOTHING if there are no more
+ */
+dbref
+dbindex_next(struct dbindex_scan *scan)
+{
+    if (scan->pos >= scan->count)
+        return NOTHING;
+
+    return scan->refs ? scan->refs[scan->pos++] : scan->pos++;
+}
@@ -0,0 +1,431 @@
+/** @file dbzip.c
+ *
+ * Implementation of compressed database dumps.  @see dbzip.h for an
+ * overview of the layout.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+/* For fopencookie */
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#ifdef HAVE_LIBZ
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include <zlib.h>
+
+#include "dbzip.h"
+#include "log.h"
+
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+#define DBZIP_WRITER
+#endif
+
+/* The size of a block's sizes and checksum. */
+#define DBZIP_BLOCK_HEADER 12
+
+/*
+ * The largest block size the loader accepts, so that a damaged header
+ * cannot make it allocate an absurd amount of memory.
+ */
+#define DBZIP_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+/**
+ * Store a little-endian 4 byte integer
+ *
+ * @private
+ * @param p where to store it
+ * @param v the integer
+ */
+static void
+dbzip_put32(unsigned char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+/**
+ * Load a little-endian 4 byte integer
+ *
+ * @private
+ * @param p where to load it from
+ * @return the integer
+ */
+static uint32_t
+dbzip_get32(const unsigned char *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8)
+           | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/**
+ * Check if a file handle holds a compressed dump
+ *
+ * This peeks at the start of the file and leaves the file position where
+ * it was.
+ *
+ * @param f the file handle to check
+ * @return boolean true if the file starts with DBZIP_MAGIC
+ */
+int
+dbzip_probe(FILE * f)
+{
+    char magic[DBZIP_MAGIC_LEN];
+    long pos = ftell(f);
+    int found;
+
+    found = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+            && !memcmp(magic, DBZIP_MAGIC, sizeof(magic));
+
+    fseek(f, pos, SEEK_SET);
+    return found;
+}
+
+#ifdef DBZIP_WRITER
+/**
+ * @private
+ * The state behind a stream returned by dbzip_open.
+ */
+struct dbzip_writer {
+    FILE *out;              /**< The compressed dump */
+    int level;              /**< The zlib compression level */
+    int bad;                /**< True once a write has failed */
+    uLong crc;              /**< CRC-32 of everything written so far */
+    size_t len;             /**< Bytes waiting in 'raw' */
+    uLong comp_size;        /**< Size of 'comp' */
+    unsigned char *raw;     /**< Uncompressed bytes of the current block */
+    unsigned char *comp;    /**< Compressed bytes of the current block */
+};
+
+/**
+ * Write a block header
+ *
+ * @private
+ * @param w the writer
+ * @param raw_len the block's uncompressed size
+ * @param comp_len the block's compressed size
+ * @param crc the checksum to store
+ * @return 0 on success, -1 on failure
+ */
+static int
+dbzip_put_header(struct dbzip_writer *w, uint32_t raw_len, uint32_t comp_len,
+                 uint32_t crc)
+{
+    unsigned char hdr[DBZIP_BLOCK_HEADER];
+
+    dbzip_put32(hdr, raw_len);
+    dbzip_put32(hdr + 4, comp_len);
+    dbzip_put32(hdr + 8, crc);
+
+    return fwrite(hdr, 1, sizeof(hdr), w->out) == sizeof(hdr) ? 0 : -1;
+}
+
+/**
+ * Compress and write out the current block
+ *
+ * @private
+ * @param w the writer
+ * @return 0 on success, -1 on failure
+ */
+static int
+dbzip_flush_block(struct dbzip_writer *w)
+{
+    uLongf comp_len = w->comp_size;
+
+    if (w->bad)
+        return -1;
+
+    if (!w->len)
+        return 0;
+
+    if (compress2(w->comp, &comp_len, w->raw, (uLong) w->len, w->level) != Z_OK
+        || dbzip_put_header(w, (uint32_t) w->len, (uint32_t) comp_len,
+                            (uint32_t) crc32(0L, w->raw, (uInt) w->len))
+        || fwrite(w->comp, 1, comp_len, w->out) != comp_len) {
+        w->bad = 1;
+        return -1;
+    }
+
+    w->crc = crc32(w->crc, w->raw, (uInt) w->len);
+    w->len = 0;
+    return 0;
+}
+
+/**
+ * Take bytes written to the stream, compressing each block as it fills
+ *
+ * @private
+ * @param cookie the writer
+ * @param buf the bytes
+ * @param size the number of bytes
+ * @return the number of bytes taken, or -1 on failure
+ */
+static long
+dbzip_write(void *cookie, const char *buf, size_t size)
+{
+    struct dbzip_writer *w = cookie;
+    size_t done = 0;
+
+    while (done < size) {
+        size_t n = DBZIP_BLOCK_SIZE - w->len;
+
+        if (n > size - done)
+            n = size - done;
+
+        memcpy(w->raw + w->len, buf + done, n);
+        w->len += n;
+        done += n;
+
+        if (w->len == DBZIP_BLOCK_SIZE && dbzip_flush_block(w))
+            return -1;
+    }
+
+    return (long) size;
+}
+
+/**
+ * Finish the compressed dump when the stream is closed
+ *
+ * @private
+ * @param cookie the writer
+ * @return 0 on success, -1 if anything could not be written
+ */
+static int
+dbzip_close(void *cookie)
+{
+    struct dbzip_writer *w = cookie;
+    int result = 0;
+
+    if (dbzip_flush_block(w) || dbzip_put_header(w, 0, 0, (uint32_t) w->crc))
+        result = -1;
+
+    free(w->raw);
+    free(w->comp);
+    free(w);
+
+    return result;
+}
+
+#ifdef HAVE_FOPENCOOKIE
+/**
+ * fopencookie's signature for dbzip_write
+ *
+ * @private
+ * @param cookie the writer
+ * @param buf the bytes
+ * @param size the number of bytes
+ * @return the number of bytes taken, or -1 on failure
+ */
+static ssize_t
+dbzip_cookie_write(void *cookie, const char *buf, size_t size)
+{
+    return (ssize_t) dbzip_write(cookie, buf, size);
+}
+#else
+/**
+ * funopen's signature for dbzip_write
+ *
+ * @private
+ * @param cookie the writer
+ * @param buf the bytes
+ * @param size the number of bytes
+ * @return the number of bytes taken, or -1 on failure
+ */
+static int
+dbzip_cookie_write(void *cookie, const char *buf, int size)
+{
+    return (int) dbzip_write(cookie, buf, (size_t) size);
+}
+#endif
+#endif /* DBZIP_WRITER */
+
+/**
+ * Open a stream that compresses everything written to it into a file
+ *
+ * Closing the stream writes the last block and the end marker, but leaves
+ * 'f' open, so that the caller can flush it to disk.  fclose on the
+ * stream fails if anything could not be written.
+ *
+ * @param f the file to write the compressed dump to
+ * @param level the zlib compression level, 1 to 9
+ * @return the stream, or NULL if compression is not available
+ */
+FILE *
+dbzip_open(FILE * f, int level)
+{
+#ifdef DBZIP_WRITER
+    unsigned char hdr[DBZIP_HEADER_SIZE];
+    struct dbzip_writer *w;
+    FILE *stream;
+
+#ifdef HAVE_FOPENCOOKIE
+    cookie_io_functions_t io = { NULL, dbzip_cookie_write, NULL, dbzip_close };
+#endif
+
+    memcpy(hdr, DBZIP_MAGIC, DBZIP_MAGIC_LEN);
+    dbzip_put32(hdr + DBZIP_MAGIC_LEN, DBZIP_VERSION);
+    dbzip_put32(hdr + DBZIP_MAGIC_LEN + 4, DBZIP_BLOCK_SIZE);
+
+    if (fwrite(hdr, 1, sizeof(hdr), f) != sizeof(hdr))
+        return NULL;
+
+    if ((w = calloc(1, sizeof(*w))) == NULL)
+        return NULL;
+
+    w->out = f;
+    w->level = level < 1 ? 1 : level > 9 ? 9 : level;
+    w->crc = crc32(0L, Z_NULL, 0);
+    w->comp_size = compressBound(DBZIP_BLOCK_SIZE);
+    w->raw = malloc(DBZIP_BLOCK_SIZE);
+    w->comp = malloc(w->comp_size);
+
+    if (!w->raw || !w->comp) {
+        free(w->raw);
+        free(w->comp);
+        free(w);
+        return NULL;
+    }
+
+#ifdef HAVE_FOPENCOOKIE
+    stream = fopencookie(w, "wb", io);
+#else
+    stream = funopen(w, NULL, dbzip_cookie_write, NULL, dbzip_close);
+#endif
+
+    if (!stream) {
+        free(w->raw);
+        free(w->comp);
+        free(w);
+        return NULL;
+    }
+
+    return stream;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Unpack a compressed dump for loading
+ *
+ * The dump is unpacked into a scratch file next to 'path', which is
+ * removed as soon as it is open, so the space is given back when the
+ * returned file is closed.  Every block is checked against its CRC-32;
+ * if one does not match, the block is logged and NULL is returned.
+ *
+ * @param f the compressed dump, positioned at its start
+ * @param path the name of the dump, used to place the scratch file
+ * @return the unpacked dump, positioned at its start, or NULL on error
+ */
+FILE *
+dbzip_inflate(FILE * f, const char *path)
+{
+    unsigned char hdr[DBZIP_HEADER_SIZE];
+    unsigned char *raw = NULL, *comp = NULL;
+    uint32_t block_size;
+    uLong comp_size, crc = crc32(0L, Z_NULL, 0);
+    FILE *out;
+    int ok = 0;
+
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr)
+        || memcmp(hdr, DBZIP_MAGIC, DBZIP_MAGIC_LEN)
+        || dbzip_get32(hdr + DBZIP_MAGIC_LEN) != DBZIP_VERSION) {
+        log_status("LOADING: Unsupported compressed database version.");
+        return NULL;
+    }
+
+    block_size = dbzip_get32(hdr + DBZIP_MAGIC_LEN + 4);
+
+    if (!block_size || block_size > DBZIP_MAX_BLOCK_SIZE) {
+        log_status("LOADING: Compressed database header is damaged.");
+        return NULL;
+    }
+
+#ifdef WIN32
+    out = tmpfile();
+#else
+    {
+        char tmpfile[2048];
+
+        snprintf(tmpfile, sizeof(tmpfile), "%s.#load#", path);
+
+        if ((out = fopen(tmpfile, "w+b")) != NULL)
+            (void) unlink(tmpfile);
+    }
+#endif
+
+    if (!out) {
+        log_status("LOADING: Could not unpack %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    comp_size = compressBound(block_size);
+    raw = malloc(block_size);
+    comp = malloc(comp_size);
+
+    for (int block = 1; raw && comp; block++) {
+        unsigned char bhdr[DBZIP_BLOCK_HEADER];
+        uint32_t raw_len, comp_len;
+        uLongf len;
+
+        if (fread(bhdr, 1, sizeof(bhdr), f) != sizeof(bhdr)) {
+            log_status("LOADING: Compressed database ends early, at block %d.",
+                       block);
+            break;
+        }
+
+        raw_len = dbzip_get32(bhdr);
+        comp_len = dbzip_get32(bhdr + 4);
+
+        if (!raw_len && !comp_len) {
+            if (dbzip_get32(bhdr + 8) == (uint32_t) crc)
+                ok = 1;
+            else
+                log_status("LOADING: Compressed database checksum mismatch.");
+
+            break;
+        }
+
+        len = raw_len;
+
+        if (raw_len > block_size || comp_len > comp_size
+            || fread(comp, 1, comp_len, f) != comp_len
+            || uncompress(raw, &len, comp, comp_len) != Z_OK
+            || len != raw_len
+            || (uint32_t) crc32(0L, raw, raw_len) != dbzip_get32(bhdr + 8)) {
+            log_status("LOADING: Compressed database block %d is damaged.",
+                       block);
+            break;
+        }
+
+        crc = crc32(crc, raw, raw_len);
+
+        if (fwrite(raw, 1, raw_len, out) != raw_len) {
+            log_status("LOADING: Could not unpack %s: %s", path,
+                       strerror(errno));
+            break;
+        }
+    }
+
+    free(raw);
+    free(comp);
+
+    if (!ok || fflush(out) || fseek(out, 0L, SEEK_SET)) {
+        fclose(out);
+        return NULL;
+    }
+
+    return out;
+}
+#endif /* HAVE_LIBZ */
@@ -658,6 +658,9 @@ unloadprops_with_prejudice(dbref obj)
         DBFETCH(obj)->properties = NULL;
     }
 
+    DBFETCH(obj)->propsize = 0;
+    DBFETCH(obj)->propsstale = 0;
+
     removeobj_ringqueue(obj);
     DBFETCH(obj)->propsmode = PROPS_UNLOADED;
     DBFETCH(obj)->propstime = 0;
@@ -908,6 +911,9 @@ propfetch(dbref obj, PropPtr p)
 
     if (PropFlags(p) & PROP_ISUNLOADED) {
         db_get_single_prop(input_file, obj, (long) PropDataVal(p), p, NULL);
+
+        /* The propdirs above 'p' are not known here */
+        DBFETCH(obj)->propsstale = 1;
         return 1;
     }
 
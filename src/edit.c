@@ -468,8 +468,10 @@ disassemble(dbref player, dbref program)
          * The type of the instruction determines how we display it.
          * There is a lot of redundant code here, but I'm not sure
          * it is terribly feasible to consolidate it.
+         *
+         * Superinstructions are shown as their first plain instruction.
          */
-        switch (curr->type) {
+        switch (unfused_type(curr->type)) {
             case PROG_PRIMITIVE:
                 if (curr->data.number >= 1 && curr->data.number <= prim_count)
                     snprintf(buf, sizeof(buf), "%d: (line %d) PRIMITIVE: %s", i,
@@ -585,6 +587,9 @@ disassemble(dbref player, dbref program)
                 snprintf(buf, sizeof(buf), "%d: (line ?) UNKNOWN INST", i);
         }
 
+        if (curr->type != unfused_type(curr->type))
+            strcatn(buf, sizeof(buf), " (fused)");
+
         notify(player, buf);
     }
 }
@@ -406,8 +406,17 @@ sig_reap(int i)
                 wall_wizards
                         ("# as soon as possible, and accept the data lost since the previous DB save.");
             }
+
+            /* Changes it did not save would be missing from delta dumps. */
+            if (status != 0)
+                global_dump_failed = 1;
+
             global_dumpdone = 1;
             global_dumper_pid = 0;
+        } else if (reapedpid == global_sanity_pid) {
+            global_sanity_status = status;
+            global_sanitydone = 1;
+            global_sanity_pid = 0;
 #endif
         } else if (reapedpid == -1) {
             log_status("waitpid() call from SIGCHLD handler returned errno=%d", errno);
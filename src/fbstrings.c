@@ -589,12 +589,72 @@ alloc_prog_string(const char *s)
         abort();
 
     ss->links = 1;
+    ss->room = 0;
     ss->length = length;
     memmove(ss->data, s, ss->length + 1);
     return (ss);
 }
 #endif
 
+/**
+ * Append to a shared string
+ *
+ * This uses up the caller's link to ss, and returns a string with a link
+ * for the caller.  If nothing else links to ss, the text is appended where
+ * it is, growing the string to about twice its length (but no longer than
+ * the longest MUF string) when it runs out of room, so that a string built
+ * up a piece at a time is not copied each time.  Otherwise, ss is left
+ * alone and a new string is made.
+ *
+ * This will abort() if malloc fails.  The caller must make sure the
+ * result is no longer than BUFFER_LEN - 1.
+ *
+ * @param ss the string to append to, which must not be NULL
+ * @param s the string to append
+ * @param len the length of s
+ * @return the string with s appended
+ */
+struct shared_string *
+append_prog_string(struct shared_string *ss, const char *s, size_t len)
+{
+    struct shared_string *nu;
+    size_t length = ss->length + len;
+
+    if (ss->links > 1) {
+        if ((nu = malloc(sizeof(struct shared_string) + length)) == NULL)
+            abort();
+
+        nu->links = 1;
+        nu->room = 0;
+        nu->length = length;
+        memcpy(nu->data, ss->data, ss->length);
+        memcpy(nu->data + ss->length, s, len);
+        nu->data[length] = '\0';
+        ss->links--;
+        return nu;
+    }
+
+    if ((size_t) ss->room < len) {
+        size_t room = 0;
+
+        if (length < BUFFER_LEN - 1)
+            room = (length < BUFFER_LEN - 1 - length)
+                   ? length : BUFFER_LEN - 1 - length;
+
+        if ((ss = realloc(ss, sizeof(struct shared_string) + length + room))
+            == NULL)
+            abort();
+
+        ss->room = (int) (room + len);
+    }
+
+    memcpy(ss->data + ss->length, s, len);
+    ss->room -= (int) len;
+    ss->length = length;
+    ss->data[length] = '\0';
+    return ss;
+}
+
 /**
  * Converts an integer to a string.
  *
@@ -18,9 +18,20 @@
 
 #include "config.h"
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 #include "commands.h"
 #include "compile.h"
 #include "db.h"
+#include "dbbin.h"
+#include "dbzip.h"
 #ifdef DISKBASE
 #include "diskprop.h"
 #endif
@@ -31,6 +42,7 @@
 #include "fbtime.h"
 #include "game.h"
 #include "interface.h"
+#include "journal.h"
 #include "log.h"
 #include "mpi.h"
 #include "predicates.h"
@@ -105,9 +117,83 @@ const char *dumpfile = 0;
 static int epoch = 0;
 
 /**
- * @var boolean value - if true, we are the dump child process.  This is
- *      set immediately after the fork and should be false for the parent
- *      (actual MUCK) process.
+ * @private
+ * @var the number of delta dumps since the last full dump, or -1 if the
+ *      next dump has to be a full one
+ */
+static int delta_dumps = -1;
+
+#ifdef SYS_ioprio_set
+/*
+ * The lowest best-effort I/O priority, for tp_dump_ionice.  There is no
+ * libc wrapper for ioprio_set, so these come from linux/ioprio.h.
+ */
+#define IOPRIO_WHO_PROCESS 1
+#define DUMP_IOPRIO ((2 << 13) | 7)
+#endif
+
+/*
+ * A dump's progress is checked every this many objects, to keep the clock
+ * and file position lookups out of the way.
+ */
+#define DUMP_PROGRESS_OBJECTS 64
+
+/**
+ * @private
+ * Progress of a dump.  A forked dumper sends these to the server over a
+ * pipe, about once a second and once more when it is done.
+ */
+struct dump_report {
+    int done;       /**< Objects written so far */
+    int total;      /**< Objects to write */
+    long bytes;     /**< Bytes written so far */
+    int msecs;      /**< Milliseconds since the dump started */
+    int saved;      /**< -1 while running, then boolean true if saved */
+};
+
+/**
+ * @private
+ * @var the latest progress of the running dump
+ */
+static struct dump_report dump_running;
+
+/**
+ * @private
+ * @var the last dump to finish; its total is 0 if there has been none
+ */
+static struct dump_report dump_last;
+
+/**
+ * @private
+ * @var the file the running dump is being written to, for its size
+ */
+static FILE *dump_out = NULL;
+
+/**
+ * @private
+ * @var where in dump_out the running dump started
+ */
+static long dump_base = 0;
+
+/**
+ * @private
+ * @var when the running dump started
+ */
+static struct timeval dump_began;
+
+#if !defined(DISKBASE) && !defined(WIN32)
+/**
+ * @private
+ * @var the pipe the forked dumper reports over: the write end in the
+ *      dumper, and the read end in the server
+ */
+static int dump_report_fd = -1;
+#endif
+
+/**
+ * @var boolean value - if true, we are a forked dump or sanity check child
+ *      process.  This is set immediately after the fork and should be false
+ *      for the parent (actual MUCK) process.
  */
 int forked_dump_process_flag = 0;
 
@@ -122,6 +208,167 @@ FILE *input_file;
  */
 static char *in_filename = NULL;
 
+/**
+ * Start keeping track of a new dump's progress
+ *
+ * @private
+ */
+static void
+dump_begin(void)
+{
+    gettimeofday(&dump_began, NULL);
+
+    dump_running.done = dump_running.msecs = 0;
+    dump_running.total = db_top;
+    dump_running.bytes = 0;
+    dump_running.saved = -1;
+}
+
+/**
+ * Bring the running dump's progress up to date
+ *
+ * @private
+ * @param done the number of objects written so far
+ */
+static void
+dump_measure(int done)
+{
+    struct timeval now;
+    long pos = dump_out ? ftell(dump_out) : -1;
+
+    gettimeofday(&now, NULL);
+
+    dump_running.done = done;
+
+    if (pos >= dump_base)
+        dump_running.bytes = pos - dump_base;
+
+    dump_running.msecs = msec_diff(now, dump_began);
+}
+
+/**
+ * Send the running dump's progress to the server, from a forked dumper
+ *
+ * @private
+ */
+static void
+dump_send_report(void)
+{
+#if !defined(DISKBASE) && !defined(WIN32)
+    if (dump_report_fd < 0)
+        return;
+
+    /* If the pipe is full, the server just gets a later report. */
+    if (write(dump_report_fd, &dump_running, sizeof(dump_running)) == -1
+        && errno != EAGAIN) {
+        close(dump_report_fd);
+        dump_report_fd = -1;
+    }
+#endif
+}
+
+/**
+ * Pick up the forked dumper's progress reports, in the server
+ *
+ * @private
+ */
+static void
+dump_read_reports(void)
+{
+#if !defined(DISKBASE) && !defined(WIN32)
+    struct dump_report r;
+
+    while (dump_report_fd >= 0 && read(dump_report_fd, &r, sizeof(r)) == sizeof(r))
+        dump_running = r;
+#endif
+}
+
+/**
+ * Note how far along a dump is
+ *
+ * This is called by the database writers as they go.  In a forked dumper,
+ * it holds the dump to tp_dump_io_limit bytes per second, and reports
+ * progress to the server about once a second.  Otherwise it does nothing.
+ *
+ * @param done the number of objects written so far
+ */
+void
+dump_progress(int done)
+{
+    int due, reported;
+
+    if (!forked_dump_process_flag || !dump_out || done % DUMP_PROGRESS_OBJECTS)
+        return;
+
+    reported = dump_running.msecs;
+    dump_measure(done);
+
+    if (tp_dump_io_limit > 0) {
+        due = (int) (dump_running.bytes * 1000.0 / tp_dump_io_limit);
+
+        if (due > dump_running.msecs) {
+            fb_usleep((unsigned int) (due - dump_running.msecs) * 1000);
+            dump_running.msecs = due;
+        }
+    }
+
+    if (dump_running.msecs / 1000 != reported / 1000)
+        dump_send_report();
+}
+
+/**
+ * Wrap up a forked dump once it has exited
+ *
+ * This picks up the dumper's last report, so that \@dump can show how
+ * the dump went.
+ */
+void
+dump_finished(void)
+{
+#if !defined(DISKBASE) && !defined(WIN32)
+    dump_read_reports();
+
+    if (dump_report_fd >= 0) {
+        close(dump_report_fd);
+        dump_report_fd = -1;
+    }
+
+    if (dump_running.saved >= 0)
+        dump_last = dump_running;
+#endif
+}
+
+#ifndef DISKBASE
+/**
+ * Show a player how far along the running dump is, and how the last went
+ *
+ * @private
+ * @param player the player to notify
+ */
+static void
+dump_notify_progress(dbref player)
+{
+    struct dump_report *r = &dump_running;
+
+    dump_read_reports();
+
+    if (r->done > 0 && r->saved < 0) {
+        notifyf(player, "Saved %d of %d objects (%ld bytes) in %d seconds, about %d seconds left.",
+                r->done, r->total, r->bytes, r->msecs / 1000,
+                (int) ((double) r->msecs * (r->total - r->done) / r->done / 1000));
+    }
+
+    r = &dump_last;
+
+    if (r->total > 0) {
+        notifyf(player, "The last dump %s %ld bytes in %d.%03d seconds (%ld bytes/sec).",
+                r->saved ? "saved" : "failed after", r->bytes, r->msecs / 1000,
+                r->msecs % 1000,
+                (long) (r->msecs ? r->bytes * 1000.0 / r->msecs : r->bytes));
+    }
+}
+#endif
+
 /**
  * Implementation of the \@dump command
  *
@@ -141,6 +388,7 @@ do_dump(dbref player, const char *newfile)
 #ifndef DISKBASE
     if (global_dumper_pid != 0) {
         notify(player, "Sorry, there is already a dump currently in progress.");
+        dump_notify_progress(player);
         return;
     }
 #endif
@@ -156,6 +404,7 @@ do_dump(dbref player, const char *newfile)
 #endif      /* GOD_PRIV */
         free((void *) dumpfile);
         dumpfile = alloc_string(newfile);
+        delta_dumps = -1;
         snprintf(buf, sizeof(buf), "Dumping to file %s...", dumpfile);
     } else {
         snprintf(buf, sizeof(buf), "Dumping...");
@@ -238,6 +487,175 @@ do_restart(dbref player)
     }
 }
 
+/**
+ * Flush a dump file and make sure it has reached the disk
+ *
+ * @private
+ * @param f the file
+ * @param path the name of the file, for the error message
+ * @return boolean true if the file was saved
+ */
+static int
+dump_sync(FILE * f, const char *path)
+{
+    if (fflush(f)) {
+        perror(path);
+        return 0;
+    }
+
+#ifndef WIN32
+    if (fsync(fileno(f))) {
+        perror(path);
+        return 0;
+    }
+#endif
+
+    return 1;
+}
+
+/**
+ * Make sure a rename into a directory has reached the disk
+ *
+ * This syncs the directory holding 'path', rather than every file on the
+ * system.
+ *
+ * @private
+ * @param path a file in the directory
+ */
+static void
+dump_sync_dir(const char *path)
+{
+#ifdef WIN32
+    sync();
+#else
+    char dir[2048];
+    char *slash;
+    int fd;
+
+    strcpyn(dir, sizeof(dir), path);
+
+    if ((slash = strrchr(dir, '/')) == NULL)
+        strcpyn(dir, sizeof(dir), ".");
+    else if (slash == dir)
+        dir[1] = '\0';
+    else
+        *slash = '\0';
+
+    if ((fd = open(dir, O_RDONLY)) < 0) {
+        perror(dir);
+        return;
+    }
+
+    if (fsync(fd))
+        perror(dir);
+
+    close(fd);
+#endif
+}
+
+#ifndef DISKBASE
+/**
+ * Append the changed objects to the delta log
+ *
+ * The delta log is the 'dumpfile' variable suffixed with '.delta'.  It is
+ * created if it does not exist yet.
+ *
+ * @see dbbin_write_delta
+ *
+ * @private
+ * @return boolean true if the delta was saved
+ */
+static int
+dump_delta_internal(void)
+{
+    char deltafile[2048];
+    FILE *f;
+
+    snprintf(deltafile, sizeof(deltafile), "%s.delta", dumpfile);
+
+    if ((f = fopen(deltafile, "r+b")) == NULL
+        && (errno != ENOENT || (f = fopen(deltafile, "w+b")) == NULL)) {
+        perror(deltafile);
+        return 0;
+    }
+
+    fseek(f, 0L, SEEK_END);
+    dump_out = f;
+    dump_base = ftell(f);
+
+    dbbin_write_delta(f);
+
+    dump_measure(db_top);
+    dump_out = NULL;
+
+    if (!dump_sync(f, deltafile)) {
+        fclose(f);
+        return 0;
+    }
+
+    if (fclose(f)) {
+        perror(deltafile);
+        return 0;
+    }
+
+    return 1;
+}
+#endif
+
+/**
+ * Decide whether the next dump can be a delta dump
+ *
+ * A full dump is needed when tp_dump_delta is off, for the first dump
+ * after startup or after the dump file changed, after a failed dump, while
+ * a forked dump is still running, and once every tp_delta_dumps_per_full
+ * dumps.  Before a full dump, the generation on #0 is bumped so that the
+ * loader will not replay an older delta log or journal over it.
+ *
+ * Either way, the dump is marked in the journal.  @see journal_checkpoint
+ *
+ * @private
+ * @return boolean true if only the changed objects should be saved
+ */
+static int
+dump_start(void)
+{
+#ifdef DISKBASE
+    return 0;
+#else
+    int gen;
+
+    /* A forked dump that is still running may be writing the delta log. */
+    if (global_dump_failed || global_dumper_pid != 0) {
+        global_dump_failed = 0;
+        delta_dumps = -1;
+    }
+
+    if (!tp_dump_delta) {
+        delta_dumps = -1;
+    } else if (delta_dumps >= 0 && delta_dumps < tp_delta_dumps_per_full) {
+        delta_dumps++;
+        journal_checkpoint(delta_dumps);
+        return 1;
+    }
+
+    if (tp_dump_delta || tp_journal) {
+        gen = (int) time(NULL);
+
+        if (gen <= get_property_value(0, SYS_DUMPGEN_PROP))
+            gen = get_property_value(0, SYS_DUMPGEN_PROP) + 1;
+
+        add_property((dbref) 0, SYS_DUMPGEN_PROP, NULL, gen);
+    }
+
+    if (tp_dump_delta)
+        delta_dumps = 0;
+
+    journal_checkpoint(0);
+
+    return 0;
+#endif
+}
+
 /**
  * Common code path for handling database dumps.
  *
@@ -247,28 +665,79 @@ do_restart(dbref player)
  * not set or incremented by this call, so it must be handled
  * by the caller.
  *
+ * The database is written in the binary format if tp_dump_binary is set,
+ * and as text otherwise; either can be loaded at startup.  Text dumps are
+ * compressed if tp_dump_compress_level is set.  @see dbzip_open
+ *
+ * Each file is fsync()ed before it is renamed into place, and the
+ * directories are synced afterwards.
+ *
  * If the DB writes successfully, it will replace the 'dumpfile' with
- * the written epoch file, and the epoch file is removed.
+ * the written epoch file, and the epoch file is removed.  Any delta log
+ * for the old 'dumpfile' is removed along with it.
+ *
+ * A delta dump instead appends the changed objects to the delta log.
+ * @see dump_delta_internal
  *
  * It also writes the macro file, using the same epoch suffix.  If
  * the macro file writes successfully, it replaces the original macro
  * file (MACRO_FILE)
  *
  * @private
+ * @param delta if true, only save the objects that changed
+ * @return boolean true if the database was saved
  */
-static void
-dump_database_internal(void)
+static int
+dump_database_internal(int delta)
 {
     char tmpfile[2048];
     FILE *f;
+    int ok = 0;
+
+    dump_begin();
 
     snprintf(tmpfile, sizeof(tmpfile), "%s.#%d#", dumpfile, epoch - 1);
     (void) unlink(tmpfile); /* nuke our predecessor */
 
     snprintf(tmpfile, sizeof(tmpfile), "%s.#%d#", dumpfile, epoch);
 
+#ifndef DISKBASE
+    if (delta) {
+        ok = dump_delta_internal();
+    } else
+#endif
     if ((f = fopen(tmpfile, "wb")) != NULL) {
+        int saved;
+
+        dump_out = f;
+        dump_base = 0;
+
+#ifndef DISKBASE
+        if (tp_dump_binary) {
+            dbbin_write(f);
+        } else {
+#ifdef HAVE_LIBZ
+            FILE *zf;
+
+            if (tp_dump_compress_level > 0
+                && (zf = dbzip_open(f, tp_dump_compress_level)) != NULL) {
+                db_write(zf);
+
+                if (fclose(zf)) {
+                    perror(tmpfile);
+                    abort();
+                }
+            } else
+#endif
+                db_write(f);
+        }
+#else
         db_write(f);
+#endif
+
+        saved = dump_sync(f, tmpfile);
+        dump_measure(db_top);
+        dump_out = NULL;
         fclose(f);
 
 #ifdef DISKBASE
@@ -279,8 +748,20 @@ dump_database_internal(void)
         (void) unlink(dumpfile); /* Delete old file before rename */
 #endif
 
-        if (rename(tmpfile, dumpfile) < 0)
+        if (!saved)
+            (void) unlink(tmpfile);
+        else if (rename(tmpfile, dumpfile) < 0)
             perror(tmpfile);
+        else
+            ok = 1;
+
+#ifndef DISKBASE
+        /* The new full dump has everything the delta log had. */
+        if (ok) {
+            snprintf(tmpfile, sizeof(tmpfile), "%s.delta", dumpfile);
+            (void) unlink(tmpfile);
+        }
+#endif
 
 #ifdef DISKBASE
             free(in_filename);
@@ -302,6 +783,7 @@ dump_database_internal(void)
 
     if ((f = fopen(tmpfile, "wb")) != NULL) {
         macrodump(macrotop, f);
+        (void) dump_sync(f, tmpfile);
         fclose(f);
 
 #ifdef WIN32
@@ -313,7 +795,21 @@ dump_database_internal(void)
         perror(tmpfile);
     }
 
-    sync();
+    /* Make the renames stick, too. */
+    dump_sync_dir(dumpfile);
+    dump_sync_dir(MACRO_FILE);
+
+    dump_measure(dump_running.done);
+    dump_running.saved = ok;
+    dump_last = dump_running;
+    dump_send_report();
+
+    log_status("CHECKPOINTING: %s %ld bytes in %d.%03d seconds (%ld bytes/sec)",
+               ok ? "Saved" : "Failed after", dump_running.bytes,
+               dump_running.msecs / 1000, dump_running.msecs % 1000,
+               (long) (dump_running.msecs
+                       ? dump_running.bytes * 1000.0 / dump_running.msecs
+                       : dump_running.bytes));
 
 #ifdef DISKBASE
     /*
@@ -343,6 +839,8 @@ dump_database_internal(void)
     propcache_hits = 0L;
     propcache_misses = 1L;
 #endif
+
+    return ok;
 }
 
 /**
@@ -354,10 +852,19 @@ dump_database_internal(void)
 void
 dump_database(void)
 {
+    int delta = dump_start();
+
     epoch++;
 
-    log_status("DUMPING: %s.#%d#", dumpfile, epoch);
-    dump_database_internal();
+    log_status("DUMPING: %s.#%d#%s", dumpfile, epoch, delta ? " (delta)" : "");
+
+    if (!dump_database_internal(delta)) {
+        delta_dumps = -1;
+        journal_dump_done(0);
+    } else {
+        journal_dump_done(1);
+    }
+
     log_status("DUMPING: %s.#%d# (done)", dumpfile, epoch);
 }
 
@@ -368,7 +875,9 @@ dump_database(void)
  * forked and the database is dumped "inline".
  *
  * Otherwise, a process is forked, its nice level is set to NICELEVEL
- * if defined, and the database is dumped to disk.
+ * if defined, and the database is dumped to disk.  The forked dumper
+ * reports its progress back over a pipe, and may be given a lower disk
+ * priority and a limit on how fast it writes.  @see dump_progress
  *
  * You probably don't want to call this function.  You likely should
  * call dump_db_now instead as it does additional book-keeping.
@@ -378,6 +887,8 @@ dump_database(void)
 void
 fork_and_dump(void)
 {
+    int delta;
+
     epoch++;
 
 #ifndef DISKBASE
@@ -387,7 +898,9 @@ fork_and_dump(void)
     }
 #endif
 
-    log_status("CHECKPOINTING: %s.#%d#", dumpfile, epoch);
+    delta = dump_start();
+
+    log_status("CHECKPOINTING: %s.#%d#%s", dumpfile, epoch, delta ? " (delta)" : "");
 
     if (tp_dbdump_warning)
         wall_and_flush(tp_dumping_mesg);
@@ -398,10 +911,43 @@ fork_and_dump(void)
      * a tangled mess I couldn't help but fix it. (tanabi)
      */
 #if defined(DISKBASE) || defined(WIN32)
-    dump_database_internal();
+    if (!dump_database_internal(delta)) {
+        delta_dumps = -1;
+        journal_dump_done(0);
+    } else {
+        journal_dump_done(1);
+    }
 
 #else
-    if ((global_dumper_pid = fork()) == 0) {
+    {
+        int fds[2];
+
+        /* A dump that finished but was not wrapped up yet. */
+        dump_finished();
+
+        if (pipe(fds) == 0) {
+            fcntl(fds[0], F_SETFL, O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        } else {
+            fds[0] = fds[1] = -1;
+        }
+
+        dump_begin();
+
+        if ((global_dumper_pid = fork()) != 0) {
+            if (fds[1] >= 0)
+                close(fds[1]);
+
+            dump_report_fd = fds[0];
+        } else {
+            if (fds[0] >= 0)
+                close(fds[0]);
+
+            dump_report_fd = fds[1];
+        }
+    }
+
+    if (global_dumper_pid == 0) {
         /* We are the child. */
         forked_dump_process_flag = 1;
 
@@ -416,15 +962,32 @@ fork_and_dump(void)
         }
 #  endif /* NICEVAL */
 
+#  ifdef DUMP_IOPRIO
+        if (tp_dump_ionice
+            && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, DUMP_IOPRIO) == -1) {
+            log_status("could not modify process I/O priority");
+        }
+#  endif /* DUMP_IOPRIO */
+
         set_dumper_signals();
-        dump_database_internal();
-        _exit(0);
+        _exit(dump_database_internal(delta) ? 0 : 1);
     }
 
     if (global_dumper_pid < 0) {
+        dump_finished();
         global_dumper_pid = 0;
+        delta_dumps = -1;
+        journal_dump_done(0);
         wall_wizards("## Could not fork for database dumping.  Possibly out of memory.");
         wall_wizards("## Please restart the server when next convenient.");
+    } else if (delta_dumps >= 0) {
+        /*
+         * The child is saving everything changed so far, so the next
+         * delta only needs what changes from here on.  If the child
+         * fails, the next dump is a full one.
+         */
+        for (dbref i = 0; i < db_top; i++)
+            FLAGS(i) &= ~OBJECT_CHANGED;
     }
 #endif
 }
@@ -435,12 +998,13 @@ fork_and_dump(void)
  * This does a series of important stuff:
  *
  * - Loads the macro file
- * - Opens th input file
+ * - Opens th input file, unpacking it if it is compressed
  * - Clears the DB in-memory structures (which initializes it)
  * - Initalize MUF primitives
  * - Initialize MPI
  * - Initialize random number generator
- * - Load DB
+ * - Load DB, replaying its delta log and journal if there are any
+ * - Start the journal
  * - Set the book-keeping ~sys properties on #0
  *
  * @param infile the path to the input database file
@@ -451,6 +1015,11 @@ int
 init_game(const char *infile, const char *outfile)
 {
     FILE *f;
+    FILE *deltas = NULL;
+    FILE *journal = NULL;
+#ifndef DISKBASE
+    char deltafile[2048];
+#endif
 
     if ((f = fopen(MACRO_FILE, "rb")) == NULL)
         log_status("INIT: Macro storage file %s is tweaked.", MACRO_FILE);
@@ -464,6 +1033,17 @@ init_game(const char *infile, const char *outfile)
     if ((input_file = fopen(infile, "rb")) == NULL)
         return -1;
 
+#ifdef HAVE_LIBZ
+    if (dbzip_probe(input_file)) {
+        FILE *unpacked = dbzip_inflate(input_file, infile);
+
+        fclose(input_file);
+
+        if ((input_file = unpacked) == NULL)
+            return -1;
+    }
+#endif
+
     db_free();
     init_primitives(); /* init muf compiler */
     mesg_init(); /* init mpi interpreter */
@@ -473,8 +1053,29 @@ init_game(const char *infile, const char *outfile)
     log_status("LOADING: %s", infile);
     fprintf(stderr, "LOADING: %s\n", infile);
 
-    if (db_read(input_file) < 0)
+#ifndef DISKBASE
+    snprintf(deltafile, sizeof(deltafile), "%s.delta", infile);
+    deltas = fopen(deltafile, "rb");
+
+    snprintf(deltafile, sizeof(deltafile), "%s.journal", infile);
+    journal = fopen(deltafile, "rb");
+#endif
+
+    if (db_read(input_file, deltas, journal) < 0) {
+        if (deltas)
+            fclose(deltas);
+
+        if (journal)
+            fclose(journal);
+
         return -1;
+    }
+
+    if (deltas)
+        fclose(deltas);
+
+    if (journal)
+        fclose(journal);
 
     log_status("LOADING: %s (done)", infile);
     fprintf(stderr, "LOADING: %s (done)\n", infile);
@@ -482,6 +1083,7 @@ init_game(const char *infile, const char *outfile)
     /* set up dumper */
     free((void *) dumpfile);
     dumpfile = alloc_string(outfile);
+    journal_open(outfile);
 
     if (!db_conversion_flag) {
         add_property((dbref) 0, SYS_STARTUPTIME_PROP, NULL, (int) time((time_t *) NULL));
@@ -1375,7 +1977,12 @@ process_command(int descr, dbref player, const char *command)
                             case 'A':
                                 if (!strcmp(command, "@sanity")) {
                                     GODONLY("@sanity", player);
-                                    do_sanity(player);
+
+                                    if (!strcasecmp(arg1, "background")) {
+                                        do_sanity_fork(player);
+                                    } else {
+                                        do_sanity(player);
+                                    }
                                 } else if (!strcmp(command, "@sanchange")) {
                                     GODONLY("@sanchange", player);
                                     NOFORCE("@sanchange", player);
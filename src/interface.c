@@ -33,6 +33,7 @@
 #include "game.h"
 #include "interface.h"
 #include "interp.h"
+#include "journal.h"
 #include "log.h"
 #include "look.h"
 #include "match.h"
@@ -41,10 +42,12 @@
 #include "mcpgui.h"
 #endif
 #include "mpi.h"
+#include "mufcache.h"
 #include "mufevent.h"
 #include "player.h"
 #include "predicates.h"
 #include "props.h"
+#include "sampler.h"
 #include "timequeue.h"
 #include "tune.h"
 
@@ -312,6 +315,26 @@ short global_dumpdone = 0;
  * @var PID of the forked dump process - unused for DISKBASE - 0 if not running
  */
 pid_t global_dumper_pid = 0;
+
+/**
+ * @var Boolean, true if the last forked dump process failed
+ */
+short global_dump_failed = 0;
+
+/**
+ * @var Boolean, true if the forked sanity check has exited
+ */
+short global_sanitydone = 0;
+
+/**
+ * @var PID of the forked sanity check - unused for DISKBASE - 0 if not running
+ */
+pid_t global_sanity_pid = 0;
+
+/**
+ * @var The exit status of the forked sanity check, once it is done
+ */
+int global_sanity_status = 0;
 #endif
 
 /**
@@ -395,6 +418,7 @@ show_program_usage(char *prog)
 "        -gamedir PATH    changes directory to PATH before starting up.\n"
 "        -parmfile PATH   replace the system parameters with those in PATH.\n"
 "        -convert         load the db, then save and quit.\n"
+"        -dbformat FORMAT save the db as 'text' or 'binary'; sets @tune dump_binary.\n"
 "        -nosanity        don't do db sanity checks at startup time.\n"
 "        -insanity        load db, then enter the interactive sanity editor.\n"
 "        -sanfix          attempt to auto-fix a corrupt db after loading.\n"
@@ -4187,6 +4211,7 @@ shovechars()
     struct descriptor_data *newd;
     struct timeval sel_in, sel_out;
     int avail_descriptors;
+    int warming_up;
 
     listen_bound_sockets();
 
@@ -4259,11 +4284,33 @@ shovechars()
                 global_dumper_player = -1;
             }
 
+#ifndef DISKBASE
+            /* Unless a new dump has already been started. */
+            if (!global_dumper_pid)
+                dump_finished();
+#endif
+
+            journal_dump_done(!global_dump_failed);
             global_dumpdone = 0;
         }
 
+#ifndef DISKBASE
+        if (global_sanitydone != 0) {
+            global_sanitydone = 0;
+            sanity_fork_done(global_sanity_status);
+        }
+#endif
+
+        journal_commit(0);
+
         purge_free_frames();
         untouchprops_incremental(1);
+        warming_up = mufcache_warmup_step();
+
+        sampler_update();
+
+        if (sampler_due)
+            sampler_server();
 
         if (shutdown_flag)
             break;
@@ -4361,6 +4408,21 @@ shovechars()
             timeout.tv_usec = (tp_pause_min % 1000) * 1000L;
         }
 
+#ifndef DISKBASE
+        /* Wake up in time to write out the journal. */
+        if (tp_journal && tp_journal_fsync_interval > 0
+            && timeout.tv_sec > tp_journal_fsync_interval) {
+            timeout.tv_sec = tp_journal_fsync_interval;
+            timeout.tv_usec = 0;
+        }
+#endif
+
+        /* Keep compiling the most used programs between commands. */
+        if (warming_up) {
+            timeout.tv_sec = 0;
+            timeout.tv_usec = 0;
+        }
+
         gettimeofday(&sel_in, NULL);
 
         /* Use the right select call for our system */
@@ -6651,6 +6713,7 @@ main(int argc, char **argv)
     char *infile_name;
     char *outfile_name;
     char *num_one_new_passwd = NULL;
+    char *dump_format = NULL;
     int nomore_options;
     int sanity_skip;
     int sanity_interactive;
@@ -6736,6 +6799,22 @@ main(int argc, char **argv)
                 }
 
                 outfile_name = argv[++i];
+            } else if (!strcmp(argv[i], "-dbformat")) {
+                if (i + 1 >= argc) {
+                    show_program_usage(*argv);
+                }
+
+                dump_format = argv[++i];
+
+                if (strcmp(dump_format, "text") && strcmp(dump_format, "binary")) {
+                    show_program_usage(*argv);
+                }
+#ifdef DISKBASE
+                if (!strcmp(dump_format, "binary")) {
+                    fprintf(stderr, "-dbformat: The binary format isn't available with DISKBASE.\n");
+                    exit(1);
+                }
+#endif
             } else if (!strcmp(argv[i], "-godpasswd")) {
                 if (i + 1 >= argc) {
                     show_program_usage(*argv);
@@ -7060,6 +7139,11 @@ main(int argc, char **argv)
         tune_load_parms_from_file(parmfile, NOTHING, -1);
     }
 
+    if (dump_format != NULL) {
+        tune_setparm((dbref) 1, "dump_binary",
+                     strcmp(dump_format, "binary") ? "no" : "yes", MLEV_GOD);
+    }
+
 #ifdef USE_SSL
     /*
      * This should be done after loading parms (from extra file or DB)
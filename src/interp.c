@@ -6,6 +6,7 @@
  * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,11 +34,22 @@
 #include "mufevent.h"
 #include "predicates.h"
 #include "props.h"
+#include "sampler.h"
 #include "timequeue.h"
 #include "tune.h"
 
 #define ERROR_DIE_NOW -1
 
+/*
+ * With GCC and the compilers that share its labels as values extension,
+ * the interpreter loop jumps straight to the code for each instruction
+ * type through a table of label addresses.  Elsewhere, or if
+ * NO_THREADED_DISPATCH is defined, it goes through the switch statement.
+ */
+#if defined(__GNUC__) && !defined(NO_THREADED_DISPATCH)
+#define INTERP_THREADED
+#endif
+
 /**
  * Placeholder "null" primitive implementation for pseudo-primitives.
  *
@@ -1330,6 +1342,7 @@ int deep_copyinst(struct inst *in, struct inst *out, int pinned) {
  * Calculate profile timing for a given program ref and frame
  *
  * Updates the execution time and total execution time for the given program.
+ * The frame's clock is then restarted, ready for the next program to run.
  *
  * @private
  * @param prog the program to update timings for
@@ -1344,14 +1357,16 @@ calc_profile_timing(dbref prog, struct frame *fr)
     struct timeval tv2;
 
     gettimeofday(&tv, NULL);
+    tv2 = fr->proftime;
+    fr->proftime = tv;
 
-    if (tv.tv_usec < fr->proftime.tv_usec) {
+    if (tv.tv_usec < tv2.tv_usec) {
         tv.tv_usec += 1000000;
         tv.tv_sec -= 1;
     }
 
-    tv.tv_usec -= fr->proftime.tv_usec;
-    tv.tv_sec -= fr->proftime.tv_sec;
+    tv.tv_usec -= tv2.tv_usec;
+    tv.tv_sec -= tv2.tv_sec;
     tv2 = PROGRAM_PROFTIME(prog);
     tv2.tv_sec += tv.tv_sec;
     tv2.tv_usec += tv.tv_usec;
@@ -1388,6 +1403,346 @@ static int interp_depth = 0;
  */
 static int nested_interp_loop_count = 0;
 
+/**
+ * @private
+ * @var the number of slots in the CALL site cache.  This must be a power
+ *      of two.
+ */
+#define CALL_CACHE_SLOTS 256
+
+/**
+ * A remembered PUBLIC lookup for a CALL with a constant function name
+ *
+ * An entry is only good while program_code_generation is unchanged, as
+ * until then neither the CALL nor the function it found can have moved.
+ *
+ * @private
+ */
+struct call_cache_entry {
+    struct inst *site;          /**< The CALL instruction */
+    unsigned int generation;    /**< program_code_generation when found */
+    dbref target;               /**< The program called */
+    struct publics *pub;        /**< The public function found */
+};
+
+/**
+ * @private
+ * @var the CALL site cache, indexed by the address of the CALL
+ */
+static struct call_cache_entry call_cache[CALL_CACHE_SLOTS];
+
+/**
+ * @private
+ * @var the number of slots in the instruction pair statistics table.  This
+ *      must be a power of two.
+ */
+#define MUF_PAIR_SLOTS 4096
+
+/**
+ * @private
+ * @var the instruction pair statistics, an open addressed hash table.  A
+ *      slot with a count of 0 is free.
+ */
+static struct muf_pair muf_pairs[MUF_PAIR_SLOTS];
+
+/**
+ * @private
+ * @var the number of instruction pairs counted, whether or not they had
+ *      room in the table
+ */
+static unsigned long muf_pairs_total = 0;
+
+/**
+ * @private
+ * @var the primitive and instruction type statistics, allocated when first
+ *      needed.  Instruction types come first, then primitives in order.
+ */
+static struct muf_inst_stat *muf_inst_stats = NULL;
+
+/**
+ * @private
+ * @var names for the instruction types, as used for pair statistics keys
+ */
+static const char *muf_type_names[] = {
+    "(cleared)", "(primitive)", "(integer)", "(float)", "(dbref)",
+    "(variable)", "(lvar)", "(svar)", "(unused)", "(string)", "(function)",
+    "(lock)", "(address)", "(if)", "(exec)", "(jmp)", "(array)", "(mark)",
+    "(svar @)", "(svar @ clear)", "(svar !)", "(try)", "(lvar @)",
+    "(lvar @ clear)", "(lvar !)"
+};
+
+/**
+ * Work out the pair statistics key for an instruction
+ *
+ * @see struct muf_pair
+ *
+ * @private
+ * @param pc the instruction
+ * @return the key for pc
+ */
+static inline int
+muf_pair_key(struct inst *pc)
+{
+    return pc->type == PROG_PRIMITIVE ? pc->data.number : -1 - pc->type;
+}
+
+/**
+ * Count one run of an instruction pair
+ *
+ * If the table is full, the pair is only added to the total.
+ *
+ * @private
+ * @param first the key of the instruction run first
+ * @param second the key of the instruction run right after
+ */
+static void
+muf_pair_note(int first, int second)
+{
+    unsigned int slot = ((unsigned int) first * 31 + (unsigned int) second)
+                        & (MUF_PAIR_SLOTS - 1);
+
+    muf_pairs_total++;
+
+    for (int probes = 0; probes < MUF_PAIR_SLOTS; probes++) {
+        struct muf_pair *p = &muf_pairs[slot];
+
+        if (!p->count) {
+            p->first = first;
+            p->second = second;
+            p->count = 1;
+            return;
+        }
+
+        if (p->first == first && p->second == second) {
+            p->count++;
+            return;
+        }
+
+        slot = (slot + 1) & (MUF_PAIR_SLOTS - 1);
+    }
+}
+
+/**
+ * Get a readable name for an instruction key from the pair statistics
+ *
+ * @see struct muf_pair
+ *
+ * @param key the instruction key
+ * @return the primitive's name, or a description of the instruction type
+ */
+const char *
+muf_pair_name(int key)
+{
+    if (key > 0 && key <= prim_count)
+        return base_inst[key - 1];
+
+    if (key < 0 && -1 - key < (int) ARRAYSIZE(muf_type_names))
+        return muf_type_names[-1 - key];
+
+    return "(unknown)";
+}
+
+/**
+ * Throw away the instruction pair statistics gathered so far
+ */
+void
+muf_pairs_reset(void)
+{
+    memset(muf_pairs, 0, sizeof(muf_pairs));
+    muf_pairs_total = 0;
+}
+
+/**
+ * Sort instruction pairs busiest first
+ *
+ * @private
+ * @param a the first pair
+ * @param b the second pair
+ * @return less than, equal to, or greater than 0 as for qsort
+ */
+static int
+muf_pair_cmp(const void *a, const void *b)
+{
+    unsigned long ca = ((const struct muf_pair *) a)->count;
+    unsigned long cb = ((const struct muf_pair *) b)->count;
+
+    return (ca < cb) - (ca > cb);
+}
+
+/**
+ * Get the most often run instruction pairs
+ *
+ * Pairs are only counted while the muf_pair_stats tune is on.  The pairs
+ * are given busiest first.
+ *
+ * @param list where to put the pairs
+ * @param count the most pairs to put in list
+ * @param total set to the number of pairs counted altogether
+ * @return the number of pairs put in list
+ */
+int
+muf_pairs_top(struct muf_pair *list, int count, unsigned long *total)
+{
+    struct muf_pair *sorted = malloc(sizeof(muf_pairs));
+    int used = 0;
+
+    *total = muf_pairs_total;
+
+    if (!sorted)
+        return 0;
+
+    for (int i = 0; i < MUF_PAIR_SLOTS; i++) {
+        if (muf_pairs[i].count)
+            sorted[used++] = muf_pairs[i];
+    }
+
+    qsort(sorted, (size_t) used, sizeof(*sorted), muf_pair_cmp);
+
+    if (count > used)
+        count = used;
+
+    memcpy(list, sorted, sizeof(*list) * (size_t) count);
+    free(sorted);
+    return count;
+}
+
+/**
+ * Get the time for the primitive statistics
+ *
+ * @private
+ * @return a count of nanoseconds from some fixed point
+ */
+static unsigned long long
+muf_inst_clock(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL
+           + (unsigned long long) ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (unsigned long long) tv.tv_sec * 1000000000ULL
+           + (unsigned long long) tv.tv_usec * 1000ULL;
+#endif
+}
+
+/**
+ * Count a run of an instruction, and time the one run before it
+ *
+ * The time an instruction took is the time until the next one starts in
+ * the same run of the interpreter loop, so the last instruction of each
+ * run, which is often one that waits, as READ and SLEEP do, is counted but
+ * not timed.
+ *
+ * @private
+ * @param pc the instruction about to be run
+ * @param prev the key of the instruction run before it in this run of the
+ *             loop, or 0 if there was none.  This is updated.
+ * @param started when that instruction started.  This is updated.
+ */
+static void
+muf_inst_note(struct inst *pc, int *prev, unsigned long long *started)
+{
+    unsigned long long now = muf_inst_clock();
+    int key = muf_pair_key(pc);
+
+    if (!muf_inst_stats) {
+        muf_inst_stats = calloc((size_t) (PROG_LAST_FUSED + 1 + prim_count),
+                                sizeof(*muf_inst_stats));
+
+        if (!muf_inst_stats)
+            return;
+    }
+
+    if (*prev) {
+        int slot = *prev > 0 ? PROG_LAST_FUSED + *prev : -1 - *prev;
+
+        muf_inst_stats[slot].nsec += now - *started;
+    }
+
+    muf_inst_stats[key > 0 ? PROG_LAST_FUSED + key : -1 - key].count++;
+    *prev = key;
+    *started = now;
+}
+
+/**
+ * Throw away the primitive statistics gathered so far
+ */
+void
+muf_inst_stats_reset(void)
+{
+    free(muf_inst_stats);
+    muf_inst_stats = NULL;
+}
+
+/**
+ * Sort primitive statistics by the time they took, longest first
+ *
+ * @private
+ * @param a the first statistic
+ * @param b the second statistic
+ * @return less than, equal to, or greater than 0 as for qsort
+ */
+static int
+muf_inst_stat_cmp(const void *a, const void *b)
+{
+    unsigned long long ta = ((const struct muf_inst_stat *) a)->nsec;
+    unsigned long long tb = ((const struct muf_inst_stat *) b)->nsec;
+
+    return (ta < tb) - (ta > tb);
+}
+
+/**
+ * Get the primitives and instruction types that took the most time
+ *
+ * These are only counted and timed while the muf_prim_stats tune is on.
+ * They are given longest first.
+ *
+ * @param list where to put the statistics
+ * @param count the most statistics to put in list
+ * @param total set to the time taken by everything counted, in nanoseconds
+ * @return the number of statistics put in list
+ */
+int
+muf_inst_stats_top(struct muf_inst_stat *list, int count,
+                   unsigned long long *total)
+{
+    int slots = PROG_LAST_FUSED + 1 + prim_count;
+    struct muf_inst_stat *sorted;
+    int used = 0;
+
+    *total = 0;
+
+    if (!muf_inst_stats)
+        return 0;
+
+    if (!(sorted = malloc(sizeof(*sorted) * (size_t) slots)))
+        return 0;
+
+    for (int i = 0; i < slots; i++) {
+        if (!muf_inst_stats[i].count)
+            continue;
+
+        sorted[used] = muf_inst_stats[i];
+        sorted[used++].key = i > PROG_LAST_FUSED ? i - PROG_LAST_FUSED
+                                                 : -1 - i;
+        *total += muf_inst_stats[i].nsec;
+    }
+
+    qsort(sorted, (size_t) used, sizeof(*sorted), muf_inst_stat_cmp);
+
+    if (count > used)
+        count = used;
+
+    memcpy(list, sorted, sizeof(*list) * (size_t) count);
+    free(sorted);
+    return count;
+}
+
 /**
  * Display an interpreter error
  *
@@ -1606,6 +1961,117 @@ do_abort_loop(dbref player, dbref program, const char *msg,
     return 0; \
 }
 
+/**
+ * Marks where the interpreter loop's dispatch table jumps to
+ *
+ * This is a plain label when the loop uses threaded dispatch, and nothing
+ * otherwise.
+ *
+ * @private
+ * @param L the name of the label
+ */
+#ifdef INTERP_THREADED
+#define DISPATCH_LABEL(L) L:
+#else
+#define DISPATCH_LABEL(L)
+#endif
+
+/**
+ * Does the interpreter loop have to look at debugging before an instruction?
+ *
+ * This is true if the player running the program is gone, the program is
+ * being debugged or is set DARK to dump the stack, the debugger was on
+ * for the previous instruction and has to be turned off, instruction
+ * pairs or primitives are being counted for the muf_pair_stats or
+ * muf_prim_stats tunes, or the profiler wants a sample.  None of that can change except in a primitive or when
+ * another program takes over, so the loop works this out again at those
+ * points rather than every instruction.  A sample that comes due in
+ * between waits for the next of them.
+ *
+ * @private
+ * @param player the player running the program
+ * @param program the program being run
+ * @param fr the frame for the running program
+ */
+#define INTERP_WATCHED(player, program, fr) \
+    (!OkObj(player) || (FLAGS(program) & (ZOMBIE | DARK)) \
+     || (fr)->brkpt.force_debugging || (fr)->brkpt.debugging \
+     || tp_muf_pair_stats || tp_muf_prim_stats || sampler_due)
+
+/**
+ * Does the interpreter loop count instructions against the PREEMPT limits?
+ *
+ * Like INTERP_WATCHED, this is worked out again after primitives and
+ * changes of program.
+ *
+ * @private
+ * @param program the program being run
+ * @param fr the frame for the running program
+ */
+#define INTERP_PREEMPT(program, fr) \
+    ((fr)->multitask == PREEMPT || (FLAGS(program) & BUILDER))
+
+/**
+ * How many instructions to run between looks at the clock
+ *
+ * The clock is only looked at while instr_slice_msec or max_preempt_msec
+ * might apply, and then right after any slow primitive as well.
+ *
+ * @private
+ */
+#define INTERP_CLOCK_INTERVAL 256
+
+/**
+ * @private
+ * @var set by interp_slow_primitive, so the clock is looked at right away
+ */
+static int slow_primitive = 0;
+
+/**
+ * Note that a primitive may have taken a while
+ *
+ * The interpreter only looks at the clock every so many instructions, to
+ * see if the instr_slice_msec or max_preempt_msec limits are up.  Primitives
+ * that can do a lot of work in one go, such as sorting a big array, call
+ * this so that the clock is looked at again right after them.
+ */
+void
+interp_slow_primitive(void)
+{
+    slow_primitive = 1;
+}
+
+/**
+ * Has a program used up the time it may run for?
+ *
+ * A FOREGROUND or BACKGROUND program has instr_slice_msec for each slice.
+ * A PREEMPT program below ML4 has max_preempt_msec altogether, since it
+ * doesn't yield.
+ *
+ * @private
+ * @param preempt true if the program is preempt
+ * @param mlev the program's MUCKER level
+ * @param start when the program started running this time
+ * @return true if it has run for longer than it may
+ */
+static int
+interp_over_time(int preempt, int mlev, struct timeval start)
+{
+    struct timeval now;
+    int limit;
+
+    if (preempt)
+        limit = (mlev < 4) ? tp_max_preempt_msec : 0;
+    else
+        limit = tp_instr_slice_msec;
+
+    if (limit <= 0)
+        return 0;
+
+    gettimeofday(&now, NULL);
+    return msec_diff(now, start) >= limit;
+}
+
 /**
  * The MUF interpreter loop - run a program until it completes or yields
  *
@@ -1613,15 +2079,21 @@ do_abort_loop(dbref player, dbref program, const char *msg,
  * difficult to sum up into a little sound bite.  Here's the highlights:
  *
  * A PREEMPT or BOUND program runs until a certain number of instructions
- * (at which point it hard stops), until it has gotten too many nested
- * interpreter calls, or until it finishes completely.
+ * or milliseconds (at which point it hard stops), until it has gotten too
+ * many nested interpreter calls, or until it finishes completely.
  *
  * Otherwise, a program runs for awhile until it either blocks for input
  * or sleep, or it gets forcibly "0 sleep" injected to make it yield.  This
- * is called a slice.  All these numbers are tunable with @tune but the
- * defaults are pretty much always used.
+ * is called a slice, and may be limited in instructions or milliseconds.
+ * All these numbers are tunable with @tune but the defaults are pretty much
+ * always used.
  *
- * This will parse the instructions using a godawful switch statement.
+ * This will parse the instructions using a godawful switch statement, or
+ * a jump table of labels inside it where the compiler allows.  The checks
+ * for debugging, breakpoints and the DARK stack dump are skipped entirely
+ * while none of them are in use; see INTERP_WATCHED.  Common sequences of
+ * instructions may have been fused into one by the compiler; see
+ * fuse_program.
  *
  * @param player the player running the program
  * @param program the program being run
@@ -1642,9 +2114,57 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
     int instr_count;
     int stop;
     int i = 0, tmp, writeonly, mlev;
+    int watched, preempt, optype;
+    int pair_prev = 0;
+    int stat_prev = 0;
+    int clock_countdown = INTERP_CLOCK_INTERVAL;
+    int over_time = 0;
+    struct timeval slice_start;
+    unsigned long long stat_started = 0;
     static struct inst retval;
     char dbuf[BUFFER_LEN];
-    int instno_debug_line = get_primitive("debug_line");
+#ifdef INTERP_THREADED
+    static void *dispatch[PROG_LAST_FUSED + 1] = {
+        [PROG_CLEARED] = &&op_cleared,
+        [PROG_PRIMITIVE] = &&op_primitive,
+        [PROG_INTEGER] = &&op_push,
+        [PROG_FLOAT] = &&op_push,
+        [PROG_OBJECT] = &&op_push,
+        [PROG_VAR] = &&op_push,
+        [PROG_LVAR] = &&op_push,
+        [PROG_SVAR] = &&op_push,
+        [8] = &&op_unknown,            /* Not used */
+        [PROG_STRING] = &&op_push,
+        [PROG_FUNCTION] = &&op_function,
+        [PROG_LOCK] = &&op_push,
+        [PROG_ADD] = &&op_push,
+        [PROG_IF] = &&op_if,
+        [PROG_EXEC] = &&op_exec,
+        [PROG_JMP] = &&op_jmp,
+        [PROG_ARRAY] = &&op_push,
+        [PROG_MARK] = &&op_push,
+        [PROG_SVAR_AT] = &&op_svar_at,
+        [PROG_SVAR_AT_CLEAR] = &&op_svar_at,
+        [PROG_SVAR_BANG] = &&op_svar_bang,
+        [PROG_TRY] = &&op_try,
+        [PROG_LVAR_AT] = &&op_lvar_at,
+        [PROG_LVAR_AT_CLEAR] = &&op_lvar_at,
+        [PROG_LVAR_BANG] = &&op_lvar_bang,
+        [PROG_NOT_IF] = &&op_test_if,
+        [PROG_DUP_IF] = &&op_test_if,
+        [PROG_EQ_IF] = &&op_compare_if,
+        [PROG_NE_IF] = &&op_compare_if,
+        [PROG_LT_IF] = &&op_compare_if,
+        [PROG_LE_IF] = &&op_compare_if,
+        [PROG_GT_IF] = &&op_compare_if,
+        [PROG_GE_IF] = &&op_compare_if,
+        [PROG_FORITER_IF] = &&op_foriter_if,
+        [PROG_LVAR_INCR] = &&op_lvar_incr,
+        [PROG_LVAR_DECR] = &&op_lvar_incr,
+        [PROG_SVAR_INCR] = &&op_svar_incr,
+        [PROG_SVAR_DECR] = &&op_svar_incr
+    };
+#endif
 
     /* Keep track of the depth */
     if (interp_depth == 0) {
@@ -1662,6 +2182,18 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
      */
     fr->level = ++interp_depth;
 
+    /*
+     * Catch the profiler up with its tune, in case it changed since the
+     * main loop last looked, and pass on any sample that came due before
+     * any MUF was running.
+     */
+    if (interp_depth == 1) {
+        sampler_update();
+
+        if (sampler_due)
+            sampler_server();
+    }
+
     /* Update active lists */
     fr->prev_array_active_list = stk_array_active_list;
     stk_array_active_list = &fr->array_active_list;
@@ -1677,13 +2209,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
     /* Try to compile it if we need to */
     if (!pc) {
-        struct line *tmpline;
-
-        tmpline = PROGRAM_FIRST(program);
-        PROGRAM_SET_FIRST(program, read_program(program));
-        do_compile(-1, OWNER(program), program, 0);
-        free_prog_text(PROGRAM_FIRST(program));
-        PROGRAM_SET_FIRST(program, tmpline);
+        compile_on_demand(-1, program);
         pc = fr->pc = PROGRAM_START(program);
 
         if (!pc) {
@@ -1704,12 +2230,16 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
     instr_count = 0;
     mlev = ProgMLevel(program);
+    watched = INTERP_WATCHED(player, program, fr);
+    preempt = INTERP_PREEMPT(program, fr);
     gettimeofday(&fr->proftime, NULL);
+    slice_start = fr->proftime;
+    slow_primitive = 0;
 
     /* This is the 'natural' way to exit a function */
     while (stop) {
         /* Abort program if player/thing running it is recycled */
-        if (!OkObj(player)) {
+        if (watched && !OkObj(player)) {
             reload(fr, atop, stop);
             prog_clean(fr);
             interp_depth--;
@@ -1721,11 +2251,16 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
         fr->instcnt++;
         instr_count++;
 
+        if (!--clock_countdown) {
+            clock_countdown = INTERP_CLOCK_INTERVAL;
+            over_time = interp_over_time(preempt, mlev, slice_start);
+        }
+
         /*
          * If it is pre-empt, check instruction count, nested loop count,
          * and all.
          */
-        if ((fr->multitask == PREEMPT) || (FLAGS(program) & BUILDER)) {
+        if (preempt) {
             if (mlev == 4) {
                 if (tp_max_ml4_preempt_count) {
                     if (instr_count >= tp_max_ml4_preempt_count)
@@ -1747,12 +2282,21 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 if (nested_interp_loop_count >= tp_max_nested_interp_loop_count)
                     abort_loop_hard("Maximum interp loop nested call count exceeded in preempt mode",
                                     NULL, NULL);
+
+                if (over_time)
+                    abort_loop_hard("Maximum preempt run time exceeded",
+                                    NULL, NULL);
             }
         } else {
             /* if in FOREGROUND or BACKGROUND mode, '0 sleep' every so often. */
             if (((fr->instcnt > tp_instr_slice * 4) && 
-                 (instr_count >= tp_instr_slice)) ||
+                 (instr_count >= tp_instr_slice)) || over_time ||
                  (nested_interp_loop_count > tp_max_nested_interp_loop_count)) {
+                PROGRAM_INC_SLICE_YIELDS(program);
+
+                if (over_time)
+                    PROGRAM_INC_TIME_YIELDS(program);
+
                 fr->pc = pc;
                 reload(fr, atop, stop);
                 PLAYER_SET_BLOCK(player, (!fr->been_background));
@@ -1765,111 +2309,140 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
             }
         }
 
-        /* Handle enter debug mode or not */
-        if (((FLAGS(program) & ZOMBIE) || fr->brkpt.force_debugging) &&
-            !fr->been_background && controls(player, program)) {
-            fr->brkpt.debugging = 1;
-        } else {
-            fr->brkpt.debugging = 0;
+        if (watched && sampler_due) {
+            sampler_muf_sample(sys, stop, program, pc);
+            watched = INTERP_WATCHED(player, program, fr);
         }
 
-        /* Handle debug (dump) mode */
-        if (FLAGS(program) & DARK ||
-            (fr->brkpt.debugging && fr->brkpt.showstack && !fr->brkpt.bypass)) {
-            if ((pc->type != PROG_PRIMITIVE) || 
-                (pc->data.number != instno_debug_line)) {
-                char *m =
-                    debug_inst(fr, 0, pc, fr->pid, arg, dbuf, sizeof(dbuf),
-                               atop, program);
-                notify_nolisten(player, m, 1);
+        if (watched) {
+            /* Everything below has to see each plain instruction */
+            if (pc->type >= PROG_FIRST_FUSED)
+                unfuse_program(program);
+
+            /* Handle enter debug mode or not */
+            if (((FLAGS(program) & ZOMBIE) || fr->brkpt.force_debugging) &&
+                !fr->been_background && controls(player, program)) {
+                fr->brkpt.debugging = 1;
+            } else {
+                fr->brkpt.debugging = 0;
             }
-        }
 
-        /* Breakpoint ? */
-        if (fr->brkpt.debugging) {
-            short breakflag = 0;
-
-            if (stop == 1 &&
-                !fr->brkpt.bypass && pc->type == PROG_PRIMITIVE &&
-                pc->data.number == IN_RET) {
-                /* Program is about to EXIT */
-                notify_nolisten(player, "Program is about to EXIT.", 1);
-                breakflag = 1;
-            } else if (fr->brkpt.count) {
-                for (i = 0; i < fr->brkpt.count; i++) {
-                    if ((!fr->brkpt.pc[i] || pc == fr->brkpt.pc[i]) &&
-                        /* pc matches */
-                        (fr->brkpt.line[i] == -1 ||
-                         (fr->brkpt.lastline != pc->line &&
-                          fr->brkpt.line[i] == pc->line)) &&
-                        /* line matches */
-                        (fr->brkpt.level[i] == -1 || stop <= fr->brkpt.level[i])
-                        &&
-                        /* level matches */
-                        (fr->brkpt.prog[i] == NOTHING ||
-                         fr->brkpt.prog[i] == program) &&
-                        /* program matches */
-                        (fr->brkpt.linecount[i] == -2 ||
-                         (fr->brkpt.lastline != pc->line &&
-                          fr->brkpt.linecount[i]-- <= 0)) &&
-                        /* line count matches */
-                        (fr->brkpt.pccount[i] == -2 ||
-                         (fr->brkpt.lastpc != pc && fr->brkpt.pccount[i]-- <= 0))
-                        /* pc count matches */
-                    ) {
-                        if (fr->brkpt.bypass) {
-                            if (fr->brkpt.pccount[i] == -1)
-                                fr->brkpt.pccount[i] = 0;
-
-                            if (fr->brkpt.linecount[i] == -1)
-                                fr->brkpt.linecount[i] = 0;
-                        } else {
-                            breakflag = 1;
-                            break;
+            /* Handle debug (dump) mode */
+            if (FLAGS(program) & DARK ||
+                (fr->brkpt.debugging && fr->brkpt.showstack &&
+                 !fr->brkpt.bypass)) {
+                if ((pc->type != PROG_PRIMITIVE) || 
+                    (pc->data.number != IN_DEBUG_LINE)) {
+                    char *m =
+                        debug_inst(fr, 0, pc, fr->pid, arg, dbuf, sizeof(dbuf),
+                                   atop, program);
+                    notify_nolisten(player, m, 1);
+                }
+            }
+
+            /* Breakpoint ? */
+            if (fr->brkpt.debugging) {
+                short breakflag = 0;
+
+                if (stop == 1 &&
+                    !fr->brkpt.bypass && pc->type == PROG_PRIMITIVE &&
+                    pc->data.number == IN_RET) {
+                    /* Program is about to EXIT */
+                    notify_nolisten(player, "Program is about to EXIT.", 1);
+                    breakflag = 1;
+                } else if (fr->brkpt.count) {
+                    for (i = 0; i < fr->brkpt.count; i++) {
+                        if ((!fr->brkpt.pc[i] || pc == fr->brkpt.pc[i]) &&
+                            /* pc matches */
+                            (fr->brkpt.line[i] == -1 ||
+                             (fr->brkpt.lastline != pc->line &&
+                              fr->brkpt.line[i] == pc->line)) &&
+                            /* line matches */
+                            (fr->brkpt.level[i] == -1 ||
+                             stop <= fr->brkpt.level[i]) &&
+                            /* level matches */
+                            (fr->brkpt.prog[i] == NOTHING ||
+                             fr->brkpt.prog[i] == program) &&
+                            /* program matches */
+                            (fr->brkpt.linecount[i] == -2 ||
+                             (fr->brkpt.lastline != pc->line &&
+                              fr->brkpt.linecount[i]-- <= 0)) &&
+                            /* line count matches */
+                            (fr->brkpt.pccount[i] == -2 ||
+                             (fr->brkpt.lastpc != pc &&
+                              fr->brkpt.pccount[i]-- <= 0))
+                            /* pc count matches */
+                        ) {
+                            if (fr->brkpt.bypass) {
+                                if (fr->brkpt.pccount[i] == -1)
+                                    fr->brkpt.pccount[i] = 0;
+
+                                if (fr->brkpt.linecount[i] == -1)
+                                    fr->brkpt.linecount[i] = 0;
+                            } else {
+                                breakflag = 1;
+                                break;
+                            }
                         }
                     }
                 }
-            }
 
-            if (breakflag) {
-                char *m;
+                if (breakflag) {
+                    char *m;
+
+                    if (fr->brkpt.dosyspop) {
+                        program = sys[--stop].progref;
+                        pc = sys[stop].offset;
+                    }
+
+                    add_muf_read_event(fr->descr, player, program, fr);
+                    reload(fr, atop, stop);
+                    fr->pc = pc;
+                    fr->brkpt.isread = 0;
+                    fr->brkpt.breaknum = i;
+                    fr->brkpt.lastlisted = 0;
+                    fr->brkpt.bypass = 0;
+                    fr->brkpt.dosyspop = 0;
+                    PLAYER_SET_CURR_PROG(player, program);
+                    PLAYER_SET_BLOCK(player, 0);
+                    record_exit_interp(program, fr);
+
+                    if (!fr->brkpt.showstack) {
+                        m = debug_inst(fr, 0, pc, fr->pid, arg, dbuf,
+                                       sizeof(dbuf), atop, program);
+                        notify_nolisten(player, m, 1);
+                    }
+
+                    if (pc <= PROGRAM_CODE(program) ||
+                        (pc - 1)->line != pc->line) {
+                        list_proglines(player, program, fr, pc->line, 0);
+                    } else {
+                        m = show_line_prims(program, pc, 15, 1);
+                        notifyf_nolisten(player, "     %s", m);
+                    }
 
-                if (fr->brkpt.dosyspop) {
-                    program = sys[--stop].progref;
-                    pc = sys[stop].offset;
+                    return NULL;
                 }
 
-                add_muf_read_event(fr->descr, player, program, fr);
-                reload(fr, atop, stop);
-                fr->pc = pc;
-                fr->brkpt.isread = 0;
-                fr->brkpt.breaknum = i;
-                fr->brkpt.lastlisted = 0;
+                fr->brkpt.lastline = pc->line;
+                fr->brkpt.lastpc = pc;
                 fr->brkpt.bypass = 0;
-                fr->brkpt.dosyspop = 0;
-                PLAYER_SET_CURR_PROG(player, program);
-                PLAYER_SET_BLOCK(player, 0);
-                record_exit_interp(program, fr);
+            }
 
-                if (!fr->brkpt.showstack) {
-                    m = debug_inst(fr, 0, pc, fr->pid, arg, dbuf, sizeof(dbuf),
-                                   atop, program);
-                    notify_nolisten(player, m, 1);
-                }
+            /* Count instruction pairs, not counting the first of each run */
+            if (tp_muf_pair_stats) {
+                int key = muf_pair_key(pc);
 
-                if (pc <= PROGRAM_CODE(program) || (pc - 1)->line != pc->line) {
-                    list_proglines(player, program, fr, pc->line, 0);
-                } else {
-                    m = show_line_prims(program, pc, 15, 1);
-                    notifyf_nolisten(player, "     %s", m);
-                }
+                if (pair_prev)
+                    muf_pair_note(pair_prev, key);
 
-                return NULL;
+                pair_prev = key;
             }
 
-            fr->brkpt.lastline = pc->line;
-            fr->brkpt.lastpc = pc;
-            fr->brkpt.bypass = 0;
+            if (tp_muf_prim_stats)
+                muf_inst_note(pc, &stat_prev, &stat_started);
+
+            watched = INTERP_WATCHED(player, program, fr);
         }
 
         /* Instruction count handling for MUCKER1 and MUCKER2 */
@@ -1879,8 +2452,20 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                                 NULL, NULL);
         }
 
+        optype = pc->type;
+
+        /*
+         * A superinstruction that can't take its fast path comes back here
+         * as the plain instruction it stands for.  See fuse_program.
+         */
+redispatch:
+#ifdef INTERP_THREADED
+        if ((unsigned short)optype < ARRAYSIZE(dispatch))
+            goto *dispatch[optype];
+#endif
+
         /* The giant switch to handle instruction types */
-        switch (pc->type) {
+        switch (optype) {
             case PROG_INTEGER: /* These all push something onto the stack */
             case PROG_FLOAT:
             case PROG_ADD:
@@ -1892,6 +2477,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
             case PROG_LOCK:
             case PROG_MARK:
             case PROG_ARRAY:
+            DISPATCH_LABEL(op_push)
                 if (atop >= STACK_SIZE)
                     abort_loop("Stack overflow.", NULL, NULL);
 
@@ -1902,6 +2488,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
             case PROG_LVAR_AT: /* Push local variable content onto stack */
             case PROG_LVAR_AT_CLEAR:
+            DISPATCH_LABEL(op_lvar_at)
                 {
                     struct inst *tmpvar;
                     struct localvars *lv;
@@ -1918,7 +2505,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
                     copyinst(tmpvar, arg + atop);
 
-                    if (pc->type == PROG_LVAR_AT_CLEAR) {
+                    if (optype == PROG_LVAR_AT_CLEAR) {
                         CLEAR(tmpvar);
                         tmpvar->type = PROG_INTEGER;
                         tmpvar->data.number = 0;
@@ -1931,6 +2518,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 break;
 
             case PROG_LVAR_BANG: /* Implementation ! for local variables */
+            DISPATCH_LABEL(op_lvar_bang)
                 {
                     struct inst *the_var;
                     struct localvars *lv;
@@ -1958,6 +2546,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
             case PROG_SVAR_AT: /* Push scoped var onto the stack */
             case PROG_SVAR_AT_CLEAR:
+            DISPATCH_LABEL(op_svar_at)
                 {
                     struct inst *tmpvar;
 
@@ -1972,7 +2561,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
                     copyinst(tmpvar, arg + atop);
 
-                    if (pc->type == PROG_SVAR_AT_CLEAR) {
+                    if (optype == PROG_SVAR_AT_CLEAR) {
                         CLEAR(tmpvar);
 
                         tmpvar->type = PROG_INTEGER;
@@ -1986,6 +2575,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 break;
 
             case PROG_SVAR_BANG: /* ! for scoped variables */
+            DISPATCH_LABEL(op_svar_bang)
                 {
                     struct inst *the_var;
 
@@ -2010,6 +2600,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 break;
 
             case PROG_FUNCTION: /* Call a function */
+            DISPATCH_LABEL(op_function)
                 {
                     int mufargs = pc->data.mufproc->args;
 
@@ -2045,6 +2636,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 break;
 
             case PROG_IF: /* Handle if */
+            DISPATCH_LABEL(op_if)
                 if (atop < 1)
                     abort_loop("Stack Underflow.", NULL, NULL);
 
@@ -2062,6 +2654,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 break;
 
             case PROG_EXEC: /* Call another program */
+            DISPATCH_LABEL(op_exec)
                 if (stop >= STACK_SIZE)
                     abort_loop("System Stack Overflow", NULL, NULL);
 
@@ -2072,12 +2665,14 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 break;
 
             case PROG_JMP: /* JMP implementation */
+            DISPATCH_LABEL(op_jmp)
                 /* Don't need to worry about skipping scoped var decls here. */
                 /* JMP to a function header can only happen in IN_JMP */
                 pc = pc->data.call;
                 break;
 
             case PROG_TRY: /* Start of a try block */
+            DISPATCH_LABEL(op_try)
                 if (atop < 1)
                     abort_loop("Stack Underflow.", NULL, NULL);
 
@@ -2112,6 +2707,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                                   * It's a primitive -- call the associated
                                   * primitive function.
                                   */
+            DISPATCH_LABEL(op_primitive)
                 /*
                  * All pc modifiers and stuff like that should stay here,
                  * everything else call with an independent dispatcher.
@@ -2179,6 +2775,8 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                             fr->caller.st[++fr->caller.top] = program;
                             mlev = ProgMLevel(program);
                             PROGRAM_INC_INSTANCES(program);
+                            watched = INTERP_WATCHED(player, program, fr);
+                            preempt = INTERP_PREEMPT(program, fr);
                         }
 
                         pc = temp1->data.addr->data;
@@ -2226,15 +2824,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                             abort_loop("Invalid object.", temp1, temp2);
 
                         if (!(PROGRAM_CODE(temp1->data.objref))) {
-                            struct line *tmpline;
-
-                            tmpline = PROGRAM_FIRST(temp1->data.objref);
-                            PROGRAM_SET_FIRST(temp1->data.objref,
-                                    read_program(temp1->data.objref));
-                            do_compile(-1, OWNER(temp1->data.objref),
-                                       temp1->data.objref, 0);
-                            free_prog_text(PROGRAM_FIRST(temp1->data.objref));
-                            PROGRAM_SET_FIRST(temp1->data.objref, tmpline);
+                            compile_on_demand(-1, temp1->data.objref);
 
                             if (!(PROGRAM_CODE(temp1->data.objref))) {
                                 char error_buf[BUFFER_LEN];
@@ -2261,20 +2851,36 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                         if (!temp2) {
                             pc = PROGRAM_START(temp1->data.objref);
                         } else {
-                            struct publics *pbs;
-                            int tmpint;
-
-                            pbs = PROGRAM_PUBS(temp1->data.objref);
+                            struct publics *pbs = NULL;
+                            struct call_cache_entry *cc = NULL;
 
-                            while (pbs) {
-                                tmpint = 
-                                        strcasecmp(temp2->data.string->data,
-                                                   pbs->subname);
+                            /*
+                             * A name pushed by the string constant just
+                             * before the CALL is always the same, so the
+                             * lookup is remembered until code changes.
+                             */
+                            if (pc > PROGRAM_CODE(program)
+                                && pc[-1].type == PROG_STRING
+                                && pc[-1].data.string == temp2->data.string) {
+                                cc = &call_cache[((uintptr_t) pc / sizeof(*pc))
+                                                 & (CALL_CACHE_SLOTS - 1)];
+
+                                if (cc->site == pc
+                                    && cc->target == temp1->data.objref
+                                    && cc->generation == program_code_generation)
+                                    pbs = cc->pub;
+                            }
 
-                                if (!tmpint)
-                                    break;
+                            if (!pbs) {
+                                pbs = find_public(temp1->data.objref,
+                                                  temp2->data.string->data);
 
-                                pbs = pbs->next;
+                                if (pbs && cc) {
+                                    cc->site = pc;
+                                    cc->target = temp1->data.objref;
+                                    cc->generation = program_code_generation;
+                                    cc->pub = pbs;
+                                }
                             }
 
                             if (!pbs)
@@ -2293,11 +2899,12 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
                         if (temp1->data.objref != program) {
                             calc_profile_timing(program, fr);
-                            gettimeofday(&fr->proftime, NULL);
                             program = temp1->data.objref;
                             fr->caller.st[++fr->caller.top] = program;
                             PROGRAM_INC_INSTANCES(program);
                             mlev = ProgMLevel(program);
+                            watched = INTERP_WATCHED(player, program, fr);
+                            preempt = INTERP_PREEMPT(program, fr);
                         }
 
                         PROGRAM_INC_PROF_USES(program);
@@ -2318,11 +2925,12 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                                                 "address.", NULL, NULL);
 
                             calc_profile_timing(program, fr);
-                            gettimeofday(&fr->proftime, NULL);
                             PROGRAM_DEC_INSTANCES(program);
                             program = sys[stop - 1].progref;
                             mlev = ProgMLevel(program);
                             fr->caller.top--;
+                            watched = INTERP_WATCHED(player, program, fr);
+                            preempt = INTERP_PREEMPT(program, fr);
                         }
 
                         scopedvar_poplevel(fr);
@@ -2541,12 +3149,181 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 #endif
                         atop = tmp;
                         pc++;
+                        watched = INTERP_WATCHED(player, program, fr);
+                        preempt = INTERP_PREEMPT(program, fr);
+
+                        if (slow_primitive) {
+                            slow_primitive = 0;
+                            clock_countdown = 1;
+                        }
+
                         break;
                 } /* switch */
 
                 break;
 
+            case PROG_NOT_IF: /* NOT IF and DUP IF, which only test the top */
+            case PROG_DUP_IF:
+            DISPATCH_LABEL(op_test_if)
+                if (atop < 1 || (optype == PROG_DUP_IF && atop >= STACK_SIZE)
+                    || (optype == PROG_NOT_IF && fr->trys.top
+                        && atop - fr->trys.st->depth < 1)) {
+                    optype = unfused_type(optype);
+                    goto redispatch;
+                }
+
+                temp1 = arg + atop - 1;
+
+                /* NOT IF branches if the item is true, DUP IF if it's false */
+                if (false_inst(temp1) == (optype == PROG_NOT_IF))
+                    pc += 2;
+                else
+                    pc = pc[1].data.call;
+
+                if (optype == PROG_NOT_IF) {
+                    CLEAR(temp1);
+                    atop--;
+                }
+
+                fr->instcnt++;
+                instr_count++;
+                break;
+
+            case PROG_EQ_IF: /* Integer comparison followed by IF */
+            case PROG_NE_IF:
+            case PROG_LT_IF:
+            case PROG_LE_IF:
+            case PROG_GT_IF:
+            case PROG_GE_IF:
+            DISPATCH_LABEL(op_compare_if)
+                {
+                    int a, b, result;
+
+                    if (atop < 2 || arg[atop - 2].type != PROG_INTEGER
+                        || arg[atop - 1].type != PROG_INTEGER
+                        || (fr->trys.top && atop - fr->trys.st->depth < 2)) {
+                        optype = unfused_type(optype);
+                        goto redispatch;
+                    }
+
+                    a = arg[atop - 2].data.number;
+                    b = arg[atop - 1].data.number;
+
+                    switch (optype) {
+                        case PROG_EQ_IF:
+                            result = a == b;
+                            break;
+                        case PROG_NE_IF:
+                            result = a != b;
+                            break;
+                        case PROG_LT_IF:
+                            result = a < b;
+                            break;
+                        case PROG_LE_IF:
+                            result = a <= b;
+                            break;
+                        case PROG_GT_IF:
+                            result = a > b;
+                            break;
+                        default:
+                            result = a >= b;
+                            break;
+                    }
+
+                    /* Integers have nothing to free, so aren't CLEAR()ed */
+                    atop -= 2;
+                    pc = result ? pc + 2 : pc[1].data.call;
+                    fr->instcnt++;
+                    instr_count++;
+                }
+
+                break;
+
+            case PROG_FORITER_IF: /* FORITER IF, at the top of a FOR loop */
+            DISPATCH_LABEL(op_foriter_if)
+                nargs = 0;
+#ifdef DEBUG
+                fr->expect_pop = fr->actual_pop = 0;
+                fr->expect_push_to = -1;
+#endif
+                reload(fr, atop, stop);
+                tmp = atop;
+                PROGRAM_INC_INSTANCES_IN_PRIMITIVE(program);
+                prim_func[pc->data.number - 1] (player, program, mlev, pc,
+                                                arg, &tmp, fr);
+                PROGRAM_DEC_INSTANCES_IN_PRIMITIVE(program);
+                atop = tmp;
+
+                if (err) {
+                    pc++;
+                    break;
+                }
+
+                /* FORITER always leaves an integer saying whether to loop */
+                pc = arg[--atop].data.number ? pc + 2 : pc[1].data.call;
+                fr->instcnt++;
+                instr_count++;
+                break;
+
+            case PROG_LVAR_INCR: /* v @ ++ v ! and v @ -- v ! */
+            case PROG_LVAR_DECR:
+            DISPATCH_LABEL(op_lvar_incr)
+                {
+                    struct inst *the_var;
+
+                    if (atop >= STACK_SIZE || pc->data.number >= MAX_VAR
+                        || pc->data.number < 0) {
+                        optype = unfused_type(optype);
+                        goto redispatch;
+                    }
+
+                    the_var = &(localvars_get(fr, program)->lvars[pc->data.number]);
+
+                    if (the_var->type != PROG_INTEGER) {
+                        optype = unfused_type(optype);
+                        goto redispatch;
+                    }
+
+                    if (optype == PROG_LVAR_INCR)
+                        the_var->data.number++;
+                    else
+                        the_var->data.number--;
+
+                    pc += 3;
+                    fr->instcnt += 2;
+                    instr_count += 2;
+                }
+
+                break;
+
+            case PROG_SVAR_INCR: /* v @ ++ v ! and v @ -- v ! */
+            case PROG_SVAR_DECR:
+            DISPATCH_LABEL(op_svar_incr)
+                {
+                    struct inst *the_var;
+
+                    the_var = scopedvar_get(fr, 0, pc->data.number);
+
+                    if (atop >= STACK_SIZE || !the_var
+                        || the_var->type != PROG_INTEGER) {
+                        optype = unfused_type(optype);
+                        goto redispatch;
+                    }
+
+                    if (optype == PROG_SVAR_INCR)
+                        the_var->data.number++;
+                    else
+                        the_var->data.number--;
+
+                    pc += 3;
+                    fr->instcnt += 2;
+                    instr_count += 2;
+                }
+
+                break;
+
             case PROG_CLEARED: /* Error condition */
+            DISPATCH_LABEL(op_cleared)
                 log_status("WARNING: attempt to execute instruction cleared "
                            "by %s:%hd in program %d", (char *) pc->data.addr,
                            pc->line, program);
@@ -2554,6 +3331,7 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                 abort_loop_hard("Program internal error. Program erroneously "
                                 "freed from memory.", NULL, NULL);
             default: /* Unknown instruction type */
+            DISPATCH_LABEL(op_unknown)
                 pc = NULL;
                 abort_loop_hard("Program internal error. Unknown instruction "
                                 "type.", NULL, NULL);
@@ -2569,7 +3347,6 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
                                             NULL, NULL);
 
                         calc_profile_timing(program, fr);
-                        gettimeofday(&fr->proftime, NULL);
                         PROGRAM_DEC_INSTANCES(program);
                         program = sys[stop - 1].progref;
                         mlev = ProgMLevel(program);
@@ -2582,6 +3359,8 @@ interp_loop(dbref player, dbref program, struct frame *fr, int rettyp)
 
                 pc = fr->trys.st->addr;
                 err = 0;
+                watched = INTERP_WATCHED(player, program, fr);
+                preempt = INTERP_PREEMPT(program, fr);
             } else {
                 reload(fr, atop, stop);
                 prog_clean(fr);
@@ -3051,7 +3830,7 @@ insttotext(struct frame *fr, int lev, struct inst *theinst, char *buffer,
 
     strmax = (strmax > buflen - 3) ? buflen - 3 : strmax;
 
-    switch (theinst->type) {
+    switch (unfused_type(theinst->type)) {
         case PROG_PRIMITIVE:
             if (theinst->data.number >= 1 && theinst->data.number <= prim_count) {
                 ptr = base_inst[theinst->data.number - 1];
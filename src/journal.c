@@ -0,0 +1,795 @@
+/** @file journal.c
+ *
+ * Implementation of the write-ahead journal.  @see journal.h for an
+ * overview.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#include "config.h"
+
+#ifndef DISKBASE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "boolexp.h"
+#include "db.h"
+#include "dbbin.h"
+#include "dbindex.h"
+#include "fbstrings.h"
+#include "game.h"
+#include "journal.h"
+#include "log.h"
+#include "player.h"
+#include "props.h"
+#include "tune.h"
+
+/* The size of a record's kind, object, and size. */
+#define JOURNAL_RECORD_HEADER 9
+
+/* The size of a batch's payload size and checksum. */
+#define JOURNAL_BATCH_HEADER 8
+
+static FILE *journal_file = NULL;           /**< The open journal, if any */
+static char journal_path[2048];             /**< The open journal's path */
+static struct dbbin_buf journal_batch;      /**< Records not yet written */
+static time_t journal_last_commit = 0;      /**< When the last commit was */
+static long journal_mark_off = -1;          /**< Marker of the running dump */
+static unsigned char *journal_carry = NULL; /**< Replayed batches to keep */
+static size_t journal_carry_len = 0;        /**< Size of journal_carry */
+static int journal_loaded_seq = 0;          /**< Delta dumps loaded */
+
+/**
+ * Checksum a batch's payload (FNV-1a)
+ *
+ * @private
+ * @param data the payload
+ * @param len the size of the payload
+ * @return the checksum
+ */
+static uint32_t
+journal_checksum(const unsigned char *data, size_t len)
+{
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+/**
+ * Start a record in the pending batch
+ *
+ * @private
+ * @param kind the JOURNAL_* record kind
+ * @param obj the object the record is about
+ * @return the position of the record, for journal_end
+ */
+static size_t
+journal_begin(int kind, dbref obj)
+{
+    size_t pos = journal_batch.len;
+
+    dbbin_put_int(&journal_batch, (uint64_t) kind, 1);
+    dbbin_put_int(&journal_batch, (uint32_t) obj, 4);
+    dbbin_put_int(&journal_batch, 0, 4);
+
+    return pos;
+}
+
+/**
+ * Finish a record, filling in its size
+ *
+ * @private
+ * @param pos the position returned by journal_begin
+ */
+static void
+journal_end(size_t pos)
+{
+    size_t len = journal_batch.len - pos - JOURNAL_RECORD_HEADER;
+
+    for (int i = 0; i < 4; i++) {
+        journal_batch.data[pos + 5 + i] = (unsigned char) (len >> (8 * i));
+    }
+}
+
+/**
+ * Flush a file and make sure it has reached the disk
+ *
+ * @private
+ * @param f the file
+ * @return 0 on success, -1 on failure
+ */
+static int
+journal_sync(FILE * f)
+{
+    if (fflush(f))
+        return -1;
+
+#ifndef WIN32
+    if (fsync(fileno(f)))
+        return -1;
+#endif
+
+    return 0;
+}
+
+/**
+ * Give up on the journal after an error
+ *
+ * The journal is closed, and reopened at the next dump.
+ *
+ * @private
+ * @param what what was being done
+ */
+static void
+journal_fail(const char *what)
+{
+    log_status("JOURNAL: Could not %s %s: %s", what, journal_path,
+               strerror(errno));
+
+    if (journal_file) {
+        fclose(journal_file);
+        journal_file = NULL;
+    }
+
+    journal_batch.len = 0;
+    journal_mark_off = -1;
+}
+
+/**
+ * Write the pending batch to the journal
+ *
+ * @private
+ * @return 0 on success, -1 on failure
+ */
+static int
+journal_write_batch(void)
+{
+    struct dbbin_buf hdr = { NULL, 0, 0 };
+    int ok;
+
+    if (!journal_batch.len)
+        return 0;
+
+    dbbin_put_int(&hdr, journal_batch.len, 4);
+    dbbin_put_int(&hdr, journal_checksum(journal_batch.data, journal_batch.len), 4);
+
+    ok = fwrite(hdr.data, 1, hdr.len, journal_file) == hdr.len
+         && fwrite(journal_batch.data, 1, journal_batch.len, journal_file)
+            == journal_batch.len
+         && !journal_sync(journal_file);
+
+    free(hdr.data);
+    journal_batch.len = 0;
+
+    if (!ok) {
+        journal_fail("write");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Replace the journal with a new one
+ *
+ * The new journal is written to a temporary file and renamed into place,
+ * so a crash leaves either the old journal or the new one.
+ *
+ * @private
+ * @param path the path of the journal
+ * @param data the batches to start the new journal with
+ * @param len the size of 'data'
+ * @return 0 on success, -1 on failure
+ */
+static int
+journal_create(const char *path, const unsigned char *data, size_t len)
+{
+    unsigned char hdr[JOURNAL_HEADER_SIZE];
+    char tmpfile[2048 + 8];
+    FILE *f;
+    int ok;
+
+    if (journal_file) {
+        fclose(journal_file);
+        journal_file = NULL;
+    }
+
+    strcpyn(journal_path, sizeof(journal_path), path);
+    snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", path);
+
+    if ((f = fopen(tmpfile, "wb")) == NULL) {
+        journal_fail("create");
+        return -1;
+    }
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN);
+    hdr[JOURNAL_MAGIC_LEN] = JOURNAL_VERSION;
+
+    ok = fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr)
+         && (!len || fwrite(data, 1, len, f) == len)
+         && !journal_sync(f);
+
+    if (fclose(f) || !ok) {
+        journal_fail("write");
+        (void) unlink(tmpfile);
+        return -1;
+    }
+
+#ifdef WIN32
+    (void) unlink(path); /* Delete old file before rename */
+#endif
+
+    if (rename(tmpfile, path) < 0) {
+        journal_fail("replace");
+        (void) unlink(tmpfile);
+        return -1;
+    }
+
+    if ((journal_file = fopen(path, "r+b")) == NULL
+        || fseek(journal_file, 0L, SEEK_END)) {
+        journal_fail("open");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Add a marker record for the current dump generation to the batch
+ *
+ * @private
+ * @param seq the number of delta dumps since the last full dump
+ */
+static void
+journal_put_mark(int seq)
+{
+    size_t pos = journal_begin(JOURNAL_MARK, (dbref) 0);
+
+    dbbin_put_int(&journal_batch,
+                  (uint32_t) get_property_value(0, SYS_DUMPGEN_PROP), 4);
+    dbbin_put_int(&journal_batch, (uint32_t) seq, 4);
+    journal_end(pos);
+}
+
+/**
+ * Record that a property was set
+ *
+ * The property's current value is recorded, so this is called after the
+ * change.  If the property no longer exists, its removal is recorded
+ * instead.  Nothing is recorded if the journal is not open.
+ *
+ * @param obj the object the property is on
+ * @param name the property name; anything after a ':' is ignored
+ */
+void
+journal_prop(dbref obj, const char *name)
+{
+    char buf[BUFFER_LEN];
+    char *n;
+    PropPtr p;
+    size_t pos;
+
+    if (!journal_file)
+        return;
+
+    strcpyn(buf, sizeof(buf), name);
+
+    if ((n = strchr(buf, PROP_DELIMITER)))
+        *n = '\0';
+
+    if (!(p = get_property(obj, buf))) {
+        journal_remove(obj, buf);
+        return;
+    }
+
+    pos = journal_begin(JOURNAL_PROP, obj);
+    dbbin_put_str(&journal_batch, buf);
+    dbbin_put_propnode(&journal_batch, p);
+    journal_end(pos);
+}
+
+/**
+ * Record that a property was removed
+ *
+ * @param obj the object the property was on
+ * @param name the property name, as given to remove_property
+ */
+void
+journal_remove(dbref obj, const char *name)
+{
+    size_t pos;
+
+    if (!journal_file)
+        return;
+
+    pos = journal_begin(JOURNAL_REMOVE, obj);
+    dbbin_put_str(&journal_batch, name);
+    journal_end(pos);
+}
+
+/**
+ * Record an object's whole property tree
+ *
+ * This is for changes that replace or copy the properties wholesale,
+ * such as creating, cloning, or recycling an object.
+ *
+ * @param obj the object
+ */
+void
+journal_props(dbref obj)
+{
+    size_t pos;
+
+    if (!journal_file)
+        return;
+
+    pos = journal_begin(JOURNAL_PROPS, obj);
+    dbbin_put_proptree(&journal_batch, DBFETCH(obj)->properties);
+    journal_end(pos);
+}
+
+/**
+ * Write the pending records to the journal
+ *
+ * The fields of every object changed since the last commit are recorded
+ * first.  Unless 'force' is set, nothing is done until
+ * tp_journal_fsync_interval has passed since the last commit.  This is
+ * called from the main loop.
+ *
+ * @param force if true, commit regardless of the interval
+ */
+void
+journal_commit(int force)
+{
+    time_t now;
+    size_t pos;
+
+    if (!journal_file)
+        return;
+
+    now = time(NULL);
+
+    if (!force && now - journal_last_commit < tp_journal_fsync_interval)
+        return;
+
+    journal_last_commit = now;
+
+    for (dbref i = 0; i < db_top; i++) {
+        if (FLAGS(i) & JOURNAL_CHANGED) {
+            FLAGS(i) &= ~JOURNAL_CHANGED;
+
+            pos = journal_begin(JOURNAL_FIELDS, i);
+            dbbin_put_fields(&journal_batch, i);
+            journal_end(pos);
+        }
+    }
+
+    journal_write_batch();
+}
+
+/**
+ * Mark the start of a dump in the journal
+ *
+ * Everything pending is committed, and then a marker for the dump is
+ * written, naming the generation on #0 and the delta dump count.  This
+ * opens the journal if tp_journal is set and it is not open yet.
+ *
+ * @param seq the number of delta dumps since the last full dump,
+ *            counting this one
+ */
+void
+journal_checkpoint(int seq)
+{
+    char path[2048];
+
+    journal_mark_off = -1;
+
+    snprintf(path, sizeof(path), "%s.journal", dumpfile);
+
+    /* The dump file changed, so start a journal to go with the new one. */
+    if (journal_file && strcmp(path, journal_path)) {
+        fclose(journal_file);
+        journal_file = NULL;
+    }
+
+    if (!journal_file) {
+        if (!tp_journal || !get_property_value(0, SYS_DUMPGEN_PROP))
+            return;
+
+        /* The dump will hold everything changed so far. */
+        for (dbref i = 0; i < db_top; i++)
+            FLAGS(i) &= ~JOURNAL_CHANGED;
+
+        journal_batch.len = 0;
+
+        if (journal_create(path, NULL, 0) < 0)
+            return;
+    } else {
+        journal_commit(1);
+
+        if (!journal_file)
+            return;
+    }
+
+    journal_mark_off = ftell(journal_file);
+    journal_put_mark(seq);
+
+    if (journal_write_batch() < 0)
+        journal_mark_off = -1;
+}
+
+/**
+ * Finish up after a dump
+ *
+ * If the dump succeeded, everything before its marker is dropped from
+ * the journal.  If tp_journal has been turned off, the journal is closed
+ * and removed instead.
+ *
+ * @param ok boolean true if the dump was saved
+ */
+void
+journal_dump_done(int ok)
+{
+    unsigned char *data;
+    long end;
+    size_t len;
+
+    if (!journal_file || journal_mark_off < 0 || !ok) {
+        journal_mark_off = -1;
+        return;
+    }
+
+    if (!tp_journal) {
+        fclose(journal_file);
+        journal_file = NULL;
+        journal_batch.len = 0;
+        journal_mark_off = -1;
+        (void) unlink(journal_path);
+        return;
+    }
+
+    if (fflush(journal_file) || (end = ftell(journal_file)) < journal_mark_off
+        || fseek(journal_file, journal_mark_off, SEEK_SET)) {
+        journal_fail("read");
+        return;
+    }
+
+    len = (size_t) (end - journal_mark_off);
+
+    if (!(data = malloc(len ? len : 1))) {
+        fprintf(stderr, "journal_dump_done(): Out of Memory!\n");
+        abort();
+    }
+
+    if (fread(data, 1, len, journal_file) != len) {
+        free(data);
+        journal_fail("read");
+        return;
+    }
+
+    journal_mark_off = -1;
+    journal_create(journal_path, data, len);
+    free(data);
+}
+
+/**
+ * Make sure an object exists, growing the database if needed
+ *
+ * New objects start out as garbage, as they would in a dump taken
+ * before they were created.
+ *
+ * @private
+ * @param obj the object
+ */
+static void
+journal_grow(dbref obj)
+{
+    dbref oldtop = db_top;
+
+    if (obj < db_top)
+        return;
+
+    db_grow(obj + 1);
+
+    for (dbref i = oldtop; i < db_top; i++) {
+        db_clear_object(i);
+        NAME(i) = alloc_string("<garbage>");
+        FLAGS(i) = TYPE_GARBAGE;
+    }
+}
+
+/**
+ * Replay one record
+ *
+ * @private
+ * @param kind the JOURNAL_* record kind
+ * @param obj the object the record is about
+ * @param r a reader covering exactly the rest of the record
+ */
+static void
+journal_apply(int kind, dbref obj, struct dbbin_reader *r)
+{
+    struct object *o;
+    PropPtr props;
+    unsigned long propsize;
+    object_flag_type listener;
+    const char *name;
+    PData dat;
+
+    if (obj < 0) {
+        r->bad = 1;
+        return;
+    }
+
+    journal_grow(obj);
+    o = DBFETCH(obj);
+
+    switch (kind) {
+        case JOURNAL_FIELDS:
+            /* The fields are replaced, but the properties are kept. */
+            props = o->properties;
+            propsize = o->propsize;
+            listener = FLAGS(obj) & LISTENER;
+            o->properties = NULL;
+
+            if (Typeof(obj) == TYPE_PLAYER)
+                delete_player(obj);
+
+            db_free_object(obj);
+            dbbin_get_fields(r, obj);
+
+            o->properties = props;
+            o->propsize = propsize;
+            FLAGS(obj) |= listener;
+
+            if (Typeof(obj) == TYPE_PLAYER)
+                add_player(obj);
+
+            dbindex_update(obj);
+            break;
+
+        case JOURNAL_PROPS:
+            dbbin_get_proptree(r, obj);
+            break;
+
+        case JOURNAL_PROP:
+            name = dbbin_get_str(r);
+            dbbin_get_propnode(r, &dat);
+
+            if (!r->bad) {
+                set_property(obj, name, &dat);
+            } else if ((dat.flags & PROP_TYPMASK) == PROP_LOKTYP) {
+                free_boolexp(dat.data.lok);
+            }
+
+            break;
+
+        case JOURNAL_REMOVE:
+            name = dbbin_get_str(r);
+
+            if (!r->bad)
+                remove_property(obj, name);
+
+            break;
+
+        default:
+            r->bad = 1;
+            break;
+    }
+}
+
+/**
+ * Check a batch and find its payload
+ *
+ * @private
+ * @param buf the journal
+ * @param len the size of the journal
+ * @param pos the offset of the batch
+ * @param payload set to the offset of the payload
+ * @param size set to the size of the payload
+ * @return boolean true if the batch is complete and undamaged
+ */
+static int
+journal_batch_ok(const unsigned char *buf, size_t len, size_t pos,
+                 size_t *payload, size_t *size)
+{
+    struct dbbin_reader r;
+    uint32_t sum;
+
+    if (len - pos < JOURNAL_BATCH_HEADER)
+        return 0;
+
+    r.p = buf + pos;
+    r.end = r.p + JOURNAL_BATCH_HEADER;
+    r.file = NULL;
+    r.bad = 0;
+
+    *size = (size_t) dbbin_get_int(&r, 4);
+    sum = (uint32_t) dbbin_get_int(&r, 4);
+    *payload = pos + JOURNAL_BATCH_HEADER;
+
+    return *size <= len - *payload
+           && journal_checksum(buf + *payload, *size) == sum;
+}
+
+/**
+ * Replay a journal over a freshly loaded database
+ *
+ * Only what follows the marker for the dump that was just loaded is
+ * replayed, and the replay stops at the first damaged or unfinished
+ * batch.  The replayed batches are kept to carry over into the journal
+ * opened by journal_open.
+ *
+ * @param f the journal, or NULL if there is none
+ * @param seq the number of delta dumps that were applied
+ * @return the number of batches replayed, or -1 if a record was damaged
+ */
+int
+journal_replay(FILE * f, int seq)
+{
+    struct dbbin_reader r, recr;
+    unsigned char *buf;
+    size_t len, pos, payload, size;
+    size_t start = 0;
+    long fsize;
+    int generation = get_property_value(0, SYS_DUMPGEN_PROP);
+    int found = 0, replayed = 0;
+    int kind;
+    dbref obj = NOTHING;
+    uint64_t reclen;
+
+    journal_loaded_seq = seq;
+
+    if (!f)
+        return 0;
+
+    if (fseek(f, 0L, SEEK_END) || (fsize = ftell(f)) < 0
+        || fseek(f, 0L, SEEK_SET)) {
+        return 0;
+    }
+
+    len = (size_t) fsize;
+
+    if (!(buf = malloc(len ? len : 1))) {
+        fprintf(stderr, "journal_replay(): Out of Memory!\n");
+        abort();
+    }
+
+    if (fread(buf, 1, len, f) != len || len < JOURNAL_HEADER_SIZE
+        || memcmp(buf, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN)
+        || buf[JOURNAL_MAGIC_LEN] != JOURNAL_VERSION) {
+        log_status("LOADING: Ignoring a damaged journal.");
+        free(buf);
+        return 0;
+    }
+
+    if (!generation) {
+        log_status("LOADING: Ignoring a journal from another dump.");
+        free(buf);
+        return 0;
+    }
+
+    for (pos = JOURNAL_HEADER_SIZE;
+         journal_batch_ok(buf, len, pos, &payload, &size);
+         pos = payload + size) {
+        r.p = buf + payload;
+        r.end = r.p + size;
+        r.file = NULL;
+        r.bad = 0;
+
+        while (r.p < r.end && !r.bad) {
+            kind = (int) dbbin_get_int(&r, 1);
+            obj = (dbref) (int32_t) dbbin_get_int(&r, 4);
+            reclen = dbbin_get_int(&r, 4);
+
+            if (r.bad || reclen > (uint64_t) (r.end - r.p)) {
+                r.bad = 1;
+                break;
+            }
+
+            recr = r;
+            recr.end = r.p + reclen;
+            r.p = recr.end;
+
+            if (kind == JOURNAL_MARK) {
+                if (!found && (int) (int32_t) dbbin_get_int(&recr, 4) == generation
+                    && (int) dbbin_get_int(&recr, 4) == seq) {
+                    found = 1;
+                    start = pos;
+                }
+
+                continue;
+            }
+
+            if (!found)
+                continue;
+
+            journal_apply(kind, obj, &recr);
+
+            if (recr.bad || recr.p != recr.end) {
+                r.bad = 1;
+                break;
+            }
+        }
+
+        if (r.bad) {
+            log_status("LOADING: A journal record for #%d is damaged.", obj);
+            free(buf);
+            return -1;
+        }
+
+        if (found)
+            replayed++;
+    }
+
+    if (!found) {
+        log_status("LOADING: Ignoring a journal from another dump.");
+        free(buf);
+        return 0;
+    }
+
+    /* The marker batch itself is not a change. */
+    replayed--;
+
+    journal_carry_len = pos - start;
+
+    if (!(journal_carry = malloc(journal_carry_len))) {
+        fprintf(stderr, "journal_replay(): Out of Memory!\n");
+        abort();
+    }
+
+    memcpy(journal_carry, buf + start, journal_carry_len);
+    free(buf);
+
+    return replayed;
+}
+
+/**
+ * Start journaling after the database has been loaded
+ *
+ * If tp_journal is set or something was replayed, this writes a fresh
+ * journal for the dump file, starting with what was replayed, and opens
+ * it.  Otherwise the journal is opened at the next dump.
+ *
+ * @param outfile the file the database will be dumped to
+ */
+void
+journal_open(const char *outfile)
+{
+    char path[2048];
+
+    /* Whatever was loaded is already on disk. */
+    for (dbref i = 0; i < db_top; i++)
+        FLAGS(i) &= ~JOURNAL_CHANGED;
+
+    snprintf(path, sizeof(path), "%s.journal", outfile);
+
+    if (journal_carry) {
+        journal_create(path, journal_carry, journal_carry_len);
+        free(journal_carry);
+        journal_carry = NULL;
+        journal_carry_len = 0;
+    } else if (tp_journal && get_property_value(0, SYS_DUMPGEN_PROP)) {
+        journal_put_mark(journal_loaded_seq);
+
+        if (journal_create(path, NULL, 0) == 0)
+            journal_write_batch();
+    }
+
+    journal_last_commit = time(NULL);
+}
+#endif /* !DISKBASE */
@@ -17,6 +17,7 @@
 #include "boolexp.h"
 #include "commands.h"
 #include "db.h"
+#include "dbindex.h"
 #ifdef DISKBASE
 #include "diskprop.h"
 #endif
@@ -964,6 +965,8 @@ do_examine(int descr, dbref player, const char *name, const char *dir)
                 notifyf(player, "Program compiled size: %d instructions", PROGRAM_SIZ(thing));
                 notifyf(player, "Cumulative runtime: %d.%06d seconds ", (int) tv.tv_sec,
                         (int) tv.tv_usec);
+                notifyf(player, "Forced yields: %u (%u for time)",
+                        PROGRAM_SLICE_YIELDS(thing), PROGRAM_TIME_YIELDS(thing));
             } else {
                 notify(player, "Program not compiled.");
             }
@@ -1555,9 +1558,10 @@ display_objinfo(dbref player, dbref obj, int output_type)
  *
  * @see init_checkflags
  *
- * Takes a search string to look for, and iterates over the entire
- * database to find it.  There is an option to charge players for
- * \@find's, probably since this is kind of nasty on the DB.
+ * Takes a search string to look for, and goes through the objects the
+ * indexes say could have that name, owner and type.  There is an option
+ * to charge players for \@find's, probably since this used to be kind of
+ * nasty on the DB.
  *
  * @param player the player doing the find
  * @param name the search criteria
@@ -1567,9 +1571,11 @@ void
 do_find(dbref player, const char *name, const char *flags)
 {
     struct flgchkdat check;
+    struct dbindex_scan scan;
     char buf[BUFFER_LEN + 2];
     int total = 0;
     int output_type = init_checkflags(player, flags, &check);
+    dbref owner = Wizard(OWNER(player)) ? NOTHING : OWNER(player);
 
     strcpyn(buf, sizeof(buf), "*");
     strcatn(buf, sizeof(buf), name);
@@ -1578,7 +1584,10 @@ do_find(dbref player, const char *name, const char *flags)
     if (!payfor(player, tp_lookup_cost)) {
         notifyf(player, "You don't have enough %s.", tp_pennies);
     } else {
-        for (dbref i = 0; i < db_top; i++) {
+        for (dbref i = dbindex_first(&scan, owner,
+                                     check.fortype ? check.istype : NOTYPE,
+                                     *name ? buf : NULL, 0);
+             i != NOTHING; i = dbindex_next(&scan)) {
             if (Typeof(i) == TYPE_GARBAGE) continue;
 
             if ((Wizard(OWNER(player)) || OWNER(i) == OWNER(player)) &&
@@ -1600,8 +1609,8 @@ do_find(dbref player, const char *name, const char *flags)
  * Like do_find, this is underpinned by the checkflags system.
  * For details of how the flags work, see init_checkflags
  *
- * This does do permission checks.  Like \@find, it iterates over the
- * entire database and supports a lookup cost.
+ * This does do permission checks.  Like \@find, it only looks at the
+ * objects the indexes list for the owner, and supports a lookup cost.
  *
  * @see init_checkflags
  * @see do_find
@@ -1615,6 +1624,7 @@ do_owned(dbref player, const char *name, const char *flags)
 {
     dbref victim;
     struct flgchkdat check;
+    struct dbindex_scan scan;
     int total = 0;
     int output_type = init_checkflags(player, flags, &check);
 
@@ -1631,7 +1641,9 @@ do_owned(dbref player, const char *name, const char *flags)
     } else
         victim = player;
 
-    for (dbref i = 0; i < db_top; i++) {
+    for (dbref i = dbindex_first(&scan, OWNER(victim),
+                                 check.fortype ? check.istype : NOTYPE, NULL, 0);
+         i != NOTHING; i = dbindex_next(&scan)) {
         if ((OWNER(i) == OWNER(victim)) && checkflags(i, check)) {
             display_objinfo(player, i, output_type);
             total++;
@@ -1709,6 +1721,7 @@ do_entrances(int descr, dbref player, const char *name, const char *flags)
     dbref thing;
     struct match_data md;
     struct flgchkdat check;
+    struct dbindex_scan scan;
     int total = 0;
     int output_type = init_checkflags(player, flags, &check);
 
@@ -1731,7 +1744,8 @@ do_entrances(int descr, dbref player, const char *name, const char *flags)
 
     init_checkflags(player, flags, &check);
 
-    for (dbref i = 0; i < db_top; i++) {
+    for (dbref i = dbindex_first_link(&scan, thing, 0); i != NOTHING;
+         i = dbindex_next(&scan)) {
         if (checkflags(i, check)) {
             switch (Typeof(i)) {
                 case TYPE_EXIT:
@@ -14,16 +14,19 @@
 #include "boolexp.h"
 #include "commands.h"
 #include "db.h"
+#include "dbindex.h"
 #include "edit.h"
 #include "fbstrings.h"
 #include "fbtime.h"
 #include "game.h"
 #include "interface.h"
 #include "interp.h"
+#include "journal.h"
 #include "look.h"
 #include "log.h"
 #include "match.h"
 #include "move.h"
+#include "mufcache.h"
 #include "predicates.h"
 #include "props.h"
 #include "timequeue.h"
@@ -289,7 +292,8 @@ moveto(dbref what, dbref where)
     /* test for special cases */
     switch (where) {
         case NOTHING:
-            DBSTORE(what, location, NOTHING);
+            LOCATION(what) = NOTHING;
+            DBDIRTY(what);
             return; /* NOTHING doesn't have contents */
 
         case HOME:
@@ -354,7 +358,8 @@ moveto(dbref what, dbref where)
     /* now put what in where */
     PUSH(what, CONTENTS(where));
     DBDIRTY(where);
-    DBSTORE(what, location, where);
+    LOCATION(what) = where;
+    DBDIRTY(what);
 }
 
 /**
@@ -378,7 +383,8 @@ send_contents(int descr, dbref loc, dbref dest)
 
     /* blast locations off everything in list */
     DOLIST(rest, first) {
-        DBSTORE(rest, location, NOTHING);
+        LOCATION(rest) = NOTHING;
+        DBDIRTY(rest);
     }
 
     while (first != NOTHING) {
@@ -1070,6 +1076,10 @@ do_drop(int descr, dbref player, const char *name, const char *obj)
  * Rooms and things have all their exits deleted.  Programs have their
  * filesystem file deleted.
  *
+ * Links to the object are removed and anything it owned is given to GOD;
+ * both are found through the object indexes (@see dbindex.h), so this
+ * does not have to look at every object in the database.
+ *
  * Then the fields are all nulled out as necessary and the object converted
  * to garbage.
  *
@@ -1085,6 +1095,7 @@ recycle(int descr, dbref player, dbref thing)
     dbref rest;
     char buf[2048];
     int looplimit;
+    struct dbindex_scan scan;
 
     depth++;
 
@@ -1145,10 +1156,16 @@ recycle(int descr, dbref player, dbref thing)
         case TYPE_PROGRAM:
             snprintf(buf, sizeof(buf), "muf/%d.m", (int) thing);
             unlink(buf);
+            mufcache_remove(thing);
             break;
     }
 
-    for (rest = 0; rest < db_top; rest++) {
+    /*
+     * Everything linked to the object loses the link.  Each change takes
+     * the object out of the index, so the search is restarted past it.
+     */
+    for (rest = dbindex_first_link(&scan, thing, 0); rest != NOTHING;
+         rest = dbindex_first_link(&scan, thing, rest + 1)) {
         switch (Typeof(rest)) {
             case TYPE_ROOM:
                 if (DBFETCH(rest)->sp.room.dropto == thing) {
@@ -1156,24 +1173,16 @@ recycle(int descr, dbref player, dbref thing)
                     DBDIRTY(rest);
                 }
 
-                if (EXITS(rest) == thing) {
-                    EXITS(rest) = NEXTOBJ(thing);
-                    DBDIRTY(rest);
-                }
-
-                if (OWNER(rest) == thing) {
-                    OWNER(rest) = GOD;
-                    DBDIRTY(rest);
-                }
-
                 break;
 
             case TYPE_THING:
                 if (THING_HOME(rest) == thing) {
                     dbref loc;
 
-                    if (PLAYER_HOME(OWNER(rest)) == thing)
+                    if (PLAYER_HOME(OWNER(rest)) == thing) {
                         PLAYER_SET_HOME(OWNER(rest), tp_player_start);
+                        dbindex_update(OWNER(rest));
+                    }
 
                     loc = PLAYER_HOME(OWNER(rest));
 
@@ -1189,16 +1198,6 @@ recycle(int descr, dbref player, dbref thing)
                     DBDIRTY(rest);
                 }
 
-                if (EXITS(rest) == thing) {
-                    EXITS(rest) = NEXTOBJ(thing);
-                    DBDIRTY(rest);
-                }
-
-                if (OWNER(rest) == thing) {
-                    OWNER(rest) = GOD;
-                    DBDIRTY(rest);
-                }
-
                 break;
 
             case TYPE_EXIT:
@@ -1220,65 +1219,96 @@ recycle(int descr, dbref player, dbref thing)
                     }
                 }
 
-                if (OWNER(rest) == thing) {
-                    OWNER(rest) = GOD;
-                    DBDIRTY(rest);
-                }
-
                 break;
 
             case TYPE_PLAYER:
-                if (Typeof(thing) == TYPE_PROGRAM
-                    && (FLAGS(rest) & INTERACTIVE)
-                    && (PLAYER_CURR_PROG(rest) == thing)) {
-                    if (FLAGS(rest) & READMODE) {
-                        notify(rest,
-                               "The program you were running has been "
-                               "recycled.  Aborting program.");
-                    } else {
-                        free_prog_text(PROGRAM_FIRST(thing));
-                        PROGRAM_SET_FIRST(thing, NULL);
-                        PLAYER_SET_INSERT_MODE(rest, 0);
-                        FLAGS(thing) &= ~INTERNAL;
-                        FLAGS(rest) &= ~INTERACTIVE;
-                        PLAYER_SET_CURR_PROG(rest, NOTHING);
-                        notify(rest,
-                               "The program you were editing has been "
-                               "recycled.  Exiting Editor.");
-                    }
-                }
-
                 if (PLAYER_HOME(rest) == thing) {
                     PLAYER_SET_HOME(rest, tp_player_start);
                     DBDIRTY(rest);
                 }
 
-                if (EXITS(rest) == thing) {
-                    EXITS(rest) = NEXTOBJ(thing);
-                    DBDIRTY(rest);
-                }
-
-                if (PLAYER_CURR_PROG(rest) == thing)
-                    PLAYER_SET_CURR_PROG(rest, 0);
-
                 break;
+        }
+
+        dbindex_update(rest);
+    }
 
+    /* Anything the object owned goes to GOD. */
+    for (rest = dbindex_first(&scan, thing, NOTYPE, NULL, 0); rest != NOTHING;
+         rest = dbindex_first(&scan, thing, NOTYPE, NULL, rest + 1)) {
+        switch (Typeof(rest)) {
+            case TYPE_ROOM:
+            case TYPE_THING:
+            case TYPE_EXIT:
             case TYPE_PROGRAM:
                 if (OWNER(rest) == thing) {
                     OWNER(rest) = GOD;
+                    dbindex_update(rest);
                     DBDIRTY(rest);
                 }
+
+                break;
+        }
+    }
+
+    /* Players editing or running a recycled program are stopped. */
+    if (Typeof(thing) == TYPE_PROGRAM) {
+        for (rest = dbindex_first(&scan, NOTHING, TYPE_PLAYER, NULL, 0);
+             rest != NOTHING;
+             rest = dbindex_first(&scan, NOTHING, TYPE_PLAYER, NULL, rest + 1)) {
+            if (Typeof(rest) != TYPE_PLAYER || PLAYER_CURR_PROG(rest) != thing)
+                continue;
+
+            if (FLAGS(rest) & INTERACTIVE) {
+                if (FLAGS(rest) & READMODE) {
+                    notify(rest,
+                           "The program you were running has been "
+                           "recycled.  Aborting program.");
+                } else {
+                    free_prog_text(PROGRAM_FIRST(thing));
+                    PROGRAM_SET_FIRST(thing, NULL);
+                    PLAYER_SET_INSERT_MODE(rest, 0);
+                    FLAGS(thing) &= ~INTERNAL;
+                    FLAGS(rest) &= ~INTERACTIVE;
+                    PLAYER_SET_CURR_PROG(rest, NOTHING);
+                    notify(rest,
+                           "The program you were editing has been "
+                           "recycled.  Exiting Editor.");
+                }
+            }
+
+            if (PLAYER_CURR_PROG(rest) == thing)
+                PLAYER_SET_CURR_PROG(rest, 0);
         }
+    }
 
-        /*
-         * if (LOCATION(rest) == thing)
-         *    DBSTORE(rest, location, NOTHING);
-         */
-        if (CONTENTS(rest) == thing)
-            DBSTORE(rest, contents, NEXTOBJ(thing));
+    /*
+     * Take the object out of the contents or exits list it is in.  Only
+     * its location's lists can hold it.
+     */
+    if ((rest = LOCATION(thing)) >= 0 && rest < db_top) {
+        dbref *lists[2] = { &CONTENTS(rest), NULL };
 
-        if (NEXTOBJ(rest) == thing)
-            DBSTORE(rest, next, NEXTOBJ(thing));
+        if (Typeof(rest) == TYPE_ROOM || Typeof(rest) == TYPE_THING
+            || Typeof(rest) == TYPE_PLAYER)
+            lists[1] = &EXITS(rest);
+
+        for (int i = 0; i < 2 && lists[i]; i++) {
+            if (*lists[i] == thing) {
+                *lists[i] = NEXTOBJ(thing);
+                DBDIRTY(rest);
+            }
+
+            looplimit = db_top;
+
+            for (first = *lists[i]; first != NOTHING && looplimit-- > 0;
+                 first = NEXTOBJ(first)) {
+                if (NEXTOBJ(first) == thing) {
+                    NEXTOBJ(first) = NEXTOBJ(thing);
+                    DBDIRTY(first);
+                }
+            }
+        }
     }
 
     looplimit = db_top;
@@ -1311,6 +1341,8 @@ recycle(int descr, dbref player, dbref thing)
     NAME(thing) = strdup("<garbage>");
     SETDESC(thing, "<recyclable>");
     FLAGS(thing) = TYPE_GARBAGE;
+    dbindex_update(thing);
+    journal_props(thing);
 
     NEXTOBJ(thing) = recyclable;
     recyclable = thing;
@@ -23,6 +23,7 @@
 #include "mfun.h"
 #include "mpi.h"
 #include "props.h"
+#include "sampler.h"
 #include "tune.h"
 
 /**
@@ -1463,6 +1464,8 @@ mesg_parse(int descr, dbref player, dbref what, dbref perms, const char *inbuf,
 
                     if (s) { /* If we found a function, process arguments */
                         s--;
+                        sampler_mpi_enter(mesg_rec_cnt, what,
+                                          mfun_list[s].name);
 
                         /*
                          * Clear out old arguments if argv already has
@@ -1724,10 +1727,15 @@ mesg_parse(int descr, dbref player, dbref what, dbref perms, const char *inbuf,
                             return NULL;
                         } else {
                             /* Good to go! */
+                            sampler_mpi_enter(mesg_rec_cnt, what,
+                                              mfun_list[s].name);
                             ptr = mfun_list[s].mfn(descr, player, what, perms,
                                                    argc, argv, buf, sizeof(buf),
                                                    mesgtyp);
 
+                            if (sampler_due)
+                                sampler_mpi_sample(mesg_rec_cnt);
+
                             if (!ptr) {
                                 outbuf[q] = '\0';
 
@@ -1978,6 +1986,7 @@ do_parse_mesg_2(int descr, dbref player, dbref what, dbref perms,
     free_mfuncs(mfunccnt);
     mesg_rec_cnt = tmprec_cnt;
     mesg_instr_cnt = tmpinst_cnt;
+    sampler_mpi_leave(mesg_rec_cnt);
 
     strcpyn(match_cmdname, sizeof(match_cmdname), tmpcmd);
     strcpyn(match_args, sizeof(match_args), tmparg);
@@ -0,0 +1,1038 @@
+/** @file mufcache.c
+ *
+ * Implementation of the compiled MUF cache.  @see mufcache.h for an
+ * overview.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compile.h"
+#include "db.h"
+#include "dbbin.h"
+#include "edit.h"
+#include "fbstrings.h"
+#include "game.h"
+#include "inst.h"
+#include "interp.h"
+#include "log.h"
+#include "mufcache.h"
+#include "props.h"
+#include "tune.h"
+
+/*
+ * The layout of a cache file is:
+ *
+ * * MUFCACHE_MAGIC, then the format version (4 bytes)
+ * * The compiler fingerprint, the text hash and the tune hash (8 bytes
+ *   each)
+ * * The compiling player, the owner and the owner's MUCKER level (4
+ *   bytes each)
+ * * The number of dependencies (4 bytes), then for each: its kind (1
+ *   byte), object (4 bytes), whether it has a name (1 byte), the name if
+ *   it has one, and its hash (8 bytes)
+ * * The number of instructions and the entry point (4 bytes each)
+ * * Each instruction: its type (2 bytes), line (4 bytes), and data
+ * * The number of publics (4 bytes), then for each: its name, MUCKER
+ *   level and instruction (4 bytes each)
+ *
+ * Numbers and strings are stored as in the binary database.
+ */
+#define MUFCACHE_MAGIC "\211FBMC\r\n\032"   /**< Identifies a cache file */
+#define MUFCACHE_MAGIC_LEN 8                /**< Length of MUFCACHE_MAGIC */
+#define MUFCACHE_VERSION 2                  /**< Current cache format */
+#define MUFCACHE_MIN_INST_SIZE 6            /**< Smallest instruction */
+
+#define MUFCACHE_FNV_BASIS 14695981039346656037ULL  /**< FNV-1a start */
+#define MUFCACHE_FNV_PRIME 1099511628211ULL         /**< FNV-1a prime */
+
+static dbref *warmup_list = NULL;   /**< Programs left to warm up */
+static int warmup_count = 0;        /**< Number of programs in the list */
+static int warmup_next = 0;         /**< The next one to do */
+
+/**
+ * Add bytes to a hash (64 bit FNV-1a)
+ *
+ * @private
+ * @param h the hash so far
+ * @param data the bytes
+ * @param len the number of bytes
+ * @return the new hash
+ */
+static uint64_t
+mufcache_hash(uint64_t h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len--) {
+        h ^= *p++;
+        h *= MUFCACHE_FNV_PRIME;
+    }
+
+    return h;
+}
+
+/**
+ * Add a string, with its terminating NUL, to a hash
+ *
+ * @private
+ * @param h the hash so far
+ * @param s the string
+ * @return the new hash
+ */
+static uint64_t
+mufcache_hash_str(uint64_t h, const char *s)
+{
+    return mufcache_hash(h, s, strlen(s) + 1);
+}
+
+/**
+ * Add an integer to a hash
+ *
+ * @private
+ * @param h the hash so far
+ * @param n the integer
+ * @return the new hash
+ */
+static uint64_t
+mufcache_hash_int(uint64_t h, int n)
+{
+    return mufcache_hash(h, &n, sizeof(n));
+}
+
+/**
+ * Work out what a dependency holds now
+ *
+ * @private
+ * @param kind one of the MUFCACHE_ kinds
+ * @param ref the object, or the player for a match
+ * @param name the property, match or macro name, or NULL
+ * @return a hash of what it holds, or 0 if there is no such thing
+ */
+static uint64_t
+mufcache_dep_value(int kind, dbref ref, const char *name)
+{
+    uint64_t h = MUFCACHE_FNV_BASIS;
+    const char *val;
+
+    switch (kind) {
+        case MUFCACHE_DEFS: {
+            char dir[BUFFER_LEN];
+            char propname[BUFFER_LEN];
+            PropPtr p, pptr;
+
+            if (!ObjExists(ref))
+                return 0;
+
+            snprintf(dir, sizeof(dir), "/%s/", DEFINES_PROPDIR);
+            p = first_prop(ref, dir, &pptr, propname, sizeof(propname));
+
+            while (p) {
+                snprintf(dir, sizeof(dir), "/%s/", DEFINES_PROPDIR);
+                strcatn(dir, sizeof(dir), propname);
+                val = get_property_class(ref, dir);
+                h = mufcache_hash_str(h, propname);
+                h = mufcache_hash_str(h, val ? val : "");
+                p = next_prop(pptr, p, propname, sizeof(propname));
+            }
+
+            break;
+        }
+
+        case MUFCACHE_PROP:
+            if (!ObjExists(ref) || !(val = get_property_class(ref, name)))
+                return 0;
+
+            h = mufcache_hash_str(h, val);
+            break;
+
+        case MUFCACHE_MATCH:
+        case MUFCACHE_MATCH_ME: {
+            dbref what;
+
+            if (!ObjExists(ref))
+                return 0;
+
+            what = compile_match(-1, ref, name, kind == MUFCACHE_MATCH_ME);
+            h = mufcache_hash_int(h, what);
+            h = mufcache_hash_int(h, OkObj(what) ? Typeof(what) : NOTYPE);
+            break;
+        }
+
+        case MUFCACHE_MACRO: {
+            char *exp = macro_expansion(name);
+
+            if (!exp)
+                return 0;
+
+            h = mufcache_hash_str(h, exp);
+            free(exp);
+            break;
+        }
+
+        default:
+            return 0;
+    }
+
+    return h;
+}
+
+/**
+ * Record something a compile depended on
+ *
+ * Reads are hashed right away.  Things the compile only sets are hashed
+ * when the code is saved, once the compile has finished setting them.
+ *
+ * @param deps the dependencies of the compile
+ * @param kind one of the MUFCACHE_ kinds
+ * @param ref the object, or the player for a match
+ * @param name the property, match or macro name, or NULL for MUFCACHE_DEFS
+ * @param read true if the compile reads it, false if it only sets it
+ */
+void
+mufcache_note(struct mufcache_deps *deps, int kind, dbref ref,
+              const char *name, int read)
+{
+    struct mufcache_dep *d;
+
+    for (int i = 0; i < deps->count; i++) {
+        d = &deps->list[i];
+
+        if (d->kind == kind && d->ref == ref
+            && !strcmp(d->name ? d->name : "", name ? name : "")) {
+            /* A read after a set sees what the compile set. */
+            if (read && !d->read) {
+                d->read = 1;
+                d->value = mufcache_dep_value(kind, ref, name);
+            }
+
+            return;
+        }
+    }
+
+    if (deps->count == deps->size) {
+        deps->size = deps->size ? deps->size * 2 : 16;
+        deps->list = realloc(deps->list, sizeof(struct mufcache_dep) * (size_t) deps->size);
+
+        if (!deps->list) {
+            fprintf(stderr, "mufcache_note(): Out of Memory!\n");
+            abort();
+        }
+    }
+
+    d = &deps->list[deps->count++];
+    d->kind = kind;
+    d->ref = ref;
+    d->name = name ? strdup(name) : NULL;
+    d->read = read;
+    d->value = read ? mufcache_dep_value(kind, ref, name) : 0;
+}
+
+/**
+ * Free the dependencies of a compile
+ *
+ * @param deps the dependencies, which are left empty
+ */
+void
+mufcache_free_deps(struct mufcache_deps *deps)
+{
+    for (int i = 0; i < deps->count; i++) {
+        free(deps->list[i].name);
+    }
+
+    free(deps->list);
+    deps->list = NULL;
+    deps->count = 0;
+    deps->size = 0;
+    deps->uncacheable = 0;
+}
+
+#ifndef DISKBASE
+/**
+ * Add a line of program text to a hash
+ *
+ * Empty lines count as a single space, as they do in read_program.
+ *
+ * @private
+ * @param h the hash so far
+ * @param line the line, without its line ending
+ * @return the new hash
+ */
+static uint64_t
+mufcache_hash_line(uint64_t h, const char *line)
+{
+    if (!*line)
+        line = " ";
+
+    h = mufcache_hash(h, line, strlen(line));
+    return mufcache_hash(h, "\n", 1);
+}
+
+/**
+ * Work out the fingerprint of this server's compiler
+ *
+ * This covers the server version and the compiler's own revision, which
+ * changes between releases whenever the generated code does.  Primitives
+ * are compiled to their position in base_inst, so any change to the list
+ * changes the fingerprint too.
+ *
+ * @private
+ * @return the fingerprint
+ */
+static uint64_t
+mufcache_fingerprint(void)
+{
+    static uint64_t fingerprint = 0;
+    uint64_t h;
+
+    if (fingerprint)
+        return fingerprint;
+
+    h = mufcache_hash_str(MUFCACHE_FNV_BASIS, VERSION);
+    h = mufcache_hash_int(h, MUFCACHE_VERSION);
+    h = mufcache_hash_int(h, MUF_COMPILER_REVISION);
+    h = mufcache_hash_int(h, (int) sizeof(struct inst));
+
+    for (int i = 0; i < prim_count; i++) {
+        h = mufcache_hash_str(h, base_inst[i]);
+    }
+
+    return fingerprint = h;
+}
+
+/**
+ * Hash the tune parameters that change how programs compile
+ *
+ * @private
+ * @return the hash
+ */
+static uint64_t
+mufcache_tune_hash(void)
+{
+    uint64_t h = mufcache_hash_str(MUFCACHE_FNV_BASIS, tp_muckname);
+
+    h = mufcache_hash_int(h, tp_optimize_muf);
+    return mufcache_hash_int(h, tp_muf_comments_strict);
+}
+
+/**
+ * Hash the text of a program as it is in memory
+ *
+ * @private
+ * @param first the first line
+ * @return the hash
+ */
+static uint64_t
+mufcache_text_hash(struct line *first)
+{
+    uint64_t h = MUFCACHE_FNV_BASIS;
+
+    for (struct line *l = first; l; l = l->next) {
+        h = mufcache_hash_line(h, l->this_line);
+    }
+
+    return h;
+}
+
+/**
+ * Hash the text of a program as it is on disk
+ *
+ * This reads the lines the same way read_program does, so that it gets
+ * the same hash as mufcache_text_hash would on what read_program returns.
+ *
+ * @private
+ * @param program the program
+ * @param hash set to the hash
+ * @return true if the text could be read
+ */
+static int
+mufcache_file_hash(dbref program, uint64_t *hash)
+{
+    char buf[BUFFER_LEN];
+    uint64_t h = MUFCACHE_FNV_BASIS;
+    size_t len;
+    FILE *f;
+
+    snprintf(buf, sizeof(buf), "muf/%d.m", (int) program);
+
+    if (!(f = fopen(buf, "rb")))
+        return 0;
+
+    while (fgets(buf, BUFFER_LEN, f)) {
+        len = strlen(buf);
+
+        if (len > 0 && buf[len - 1] == '\n')
+            buf[--len] = '\0';
+
+        if (len > 0 && buf[len - 1] == '\r')
+            buf[--len] = '\0';
+
+        h = mufcache_hash_line(h, buf);
+    }
+
+    fclose(f);
+    *hash = h;
+    return 1;
+}
+
+/**
+ * Append an instruction to a buffer
+ *
+ * @private
+ * @param b the buffer
+ * @param code the program's instructions
+ * @param in the instruction
+ * @return false if the instruction cannot be saved
+ */
+static int
+mufcache_put_inst(struct dbbin_buf *b, struct inst *code, struct inst *in)
+{
+    uint64_t bits;
+
+    dbbin_put_int(b, (uint16_t) in->type, 2);
+    dbbin_put_int(b, (uint32_t) in->line, 4);
+
+    switch (in->type) {
+        case PROG_PRIMITIVE:
+        case PROG_INTEGER:
+        case PROG_SVAR:
+        case PROG_SVAR_AT:
+        case PROG_SVAR_AT_CLEAR:
+        case PROG_SVAR_BANG:
+        case PROG_LVAR:
+        case PROG_LVAR_AT:
+        case PROG_LVAR_AT_CLEAR:
+        case PROG_LVAR_BANG:
+        case PROG_VAR:
+            dbbin_put_int(b, (uint32_t) in->data.number, 4);
+            break;
+        case PROG_FLOAT:
+            memcpy(&bits, &in->data.fnumber, sizeof(bits));
+            dbbin_put_int(b, bits, 8);
+            break;
+        case PROG_STRING:
+            dbbin_put_int(b, in->data.string != NULL, 1);
+
+            if (in->data.string)
+                dbbin_put_str(b, in->data.string->data);
+
+            break;
+        case PROG_FUNCTION:
+            dbbin_put_str(b, in->data.mufproc->procname);
+            dbbin_put_int(b, (uint32_t) in->data.mufproc->vars, 4);
+            dbbin_put_int(b, (uint32_t) in->data.mufproc->args, 4);
+            dbbin_put_int(b, in->data.mufproc->varnames != NULL, 1);
+
+            if (in->data.mufproc->varnames) {
+                for (int j = 0; j < in->data.mufproc->vars; j++) {
+                    dbbin_put_str(b, in->data.mufproc->varnames[j]);
+                }
+            }
+
+            break;
+        case PROG_OBJECT:
+            dbbin_put_int(b, (uint32_t) in->data.objref, 4);
+            break;
+        case PROG_ADD:
+            dbbin_put_int(b, (uint32_t) (in->data.addr->data - code), 4);
+            break;
+        case PROG_IF:
+        case PROG_JMP:
+        case PROG_EXEC:
+        case PROG_TRY:
+            dbbin_put_int(b, (uint32_t) (in->data.call - code), 4);
+            break;
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Save a program's newly compiled code
+ *
+ * Nothing is saved if the cache is turned off, the compile cannot be
+ * repeated, the program was compiled by someone other than its owner, or
+ * something the compile read changed before it finished.
+ *
+ * @param program the program
+ * @param player the player who compiled it
+ * @param deps everything the compile depended on
+ */
+void
+mufcache_save(dbref program, dbref player, struct mufcache_deps *deps)
+{
+    struct dbbin_buf b = { NULL, 0, 0 };
+    struct inst *code = PROGRAM_CODE(program);
+    char path[BUFFER_LEN];
+    char tmppath[BUFFER_LEN];
+    uint64_t value;
+    int npubs = 0;
+    FILE *f;
+
+    if (!tp_muf_cache || deps->uncacheable || player != OWNER(program)
+        || !code || !PROGRAM_FIRST(program))
+        return;
+
+    for (int i = 0; i < deps->count; i++) {
+        value = mufcache_dep_value(deps->list[i].kind, deps->list[i].ref,
+                                   deps->list[i].name);
+
+        if (deps->list[i].read && value != deps->list[i].value)
+            return;
+
+        deps->list[i].value = value;
+    }
+
+    for (int i = 0; i < MUFCACHE_MAGIC_LEN; i++) {
+        dbbin_put_int(&b, (unsigned char) MUFCACHE_MAGIC[i], 1);
+    }
+
+    dbbin_put_int(&b, MUFCACHE_VERSION, 4);
+    dbbin_put_int(&b, mufcache_fingerprint(), 8);
+    dbbin_put_int(&b, mufcache_text_hash(PROGRAM_FIRST(program)), 8);
+    dbbin_put_int(&b, mufcache_tune_hash(), 8);
+    dbbin_put_int(&b, (uint32_t) player, 4);
+    dbbin_put_int(&b, (uint32_t) OWNER(program), 4);
+    dbbin_put_int(&b, (uint32_t) MLevel(OWNER(program)), 4);
+
+    dbbin_put_int(&b, (uint32_t) deps->count, 4);
+
+    for (int i = 0; i < deps->count; i++) {
+        dbbin_put_int(&b, (uint32_t) deps->list[i].kind, 1);
+        dbbin_put_int(&b, (uint32_t) deps->list[i].ref, 4);
+        dbbin_put_int(&b, deps->list[i].name != NULL, 1);
+
+        if (deps->list[i].name)
+            dbbin_put_str(&b, deps->list[i].name);
+
+        dbbin_put_int(&b, deps->list[i].value, 8);
+    }
+
+    dbbin_put_int(&b, (uint32_t) PROGRAM_SIZ(program), 4);
+    dbbin_put_int(&b, (uint32_t) (PROGRAM_START(program) - code), 4);
+
+    for (int i = 0; i < PROGRAM_SIZ(program); i++) {
+        if (!mufcache_put_inst(&b, code, code + i)) {
+            free(b.data);
+            return;
+        }
+    }
+
+    for (struct publics *pub = PROGRAM_PUBS(program); pub; pub = pub->next) {
+        npubs++;
+    }
+
+    dbbin_put_int(&b, (uint32_t) npubs, 4);
+
+    for (struct publics *pub = PROGRAM_PUBS(program); pub; pub = pub->next) {
+        dbbin_put_str(&b, pub->subname);
+        dbbin_put_int(&b, (uint32_t) pub->mlev, 4);
+        dbbin_put_int(&b, (uint32_t) (pub->addr.ptr - code), 4);
+    }
+
+    /* Write the new file beside the old, so a crash never leaves half. */
+    snprintf(path, sizeof(path), "muf/%d.mc", (int) program);
+    snprintf(tmppath, sizeof(tmppath), "muf/%d.mc.new", (int) program);
+
+    if ((f = fopen(tmppath, "wb"))) {
+        size_t written = fwrite(b.data, 1, b.len, f);
+
+        if (fclose(f) || written != b.len || rename(tmppath, path)) {
+            log_status("MUF: Could not save the compiled code of #%d.", program);
+            unlink(tmppath);
+        }
+    }
+
+    free(b.data);
+}
+
+/**
+ * Free the instructions decoded so far
+ *
+ * @private
+ * @param code the instructions
+ * @param count how many of them to free
+ */
+static void
+mufcache_free_code(struct inst *code, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (code[i].type == PROG_ADD) {
+            free(code[i].data.addr);
+        } else {
+            CLEAR(code + i);
+        }
+    }
+
+    free(code);
+}
+
+/**
+ * Free a list of publics
+ *
+ * @private
+ * @param pubs the list
+ */
+static void
+mufcache_free_pubs(struct publics *pubs)
+{
+    struct publics *next;
+
+    for (; pubs; pubs = next) {
+        next = pubs->next;
+        free(pubs->subname);
+        free(pubs);
+    }
+}
+
+/**
+ * Read an instruction index, checking that it is within the program
+ *
+ * @private
+ * @param r the reader
+ * @param siz the number of instructions
+ * @return the index, or -1 if it is out of range
+ */
+static int
+mufcache_get_index(struct dbbin_reader *r, int siz)
+{
+    int n = (int) (int32_t) dbbin_get_int(r, 4);
+
+    if (n < 0 || n >= siz) {
+        r->bad = 1;
+        return -1;
+    }
+
+    return n;
+}
+
+/**
+ * Read an instruction
+ *
+ * However it goes, the instruction is left in a state that CLEAR, or
+ * free for PROG_ADD, can clean up.
+ *
+ * @private
+ * @param r the reader
+ * @param program the program the instructions belong to
+ * @param code the program's instructions
+ * @param siz the number of instructions
+ * @param in the instruction to fill in
+ * @return false if the data was damaged
+ */
+static int
+mufcache_get_inst(struct dbbin_reader *r, dbref program, struct inst *code,
+                  int siz, struct inst *in)
+{
+    uint64_t bits;
+    int n;
+
+    in->type = (short) dbbin_get_int(r, 2);
+    in->line = (int) (int32_t) dbbin_get_int(r, 4);
+
+    switch (in->type) {
+        case PROG_PRIMITIVE:
+        case PROG_INTEGER:
+        case PROG_SVAR:
+        case PROG_SVAR_AT:
+        case PROG_SVAR_AT_CLEAR:
+        case PROG_SVAR_BANG:
+        case PROG_LVAR:
+        case PROG_LVAR_AT:
+        case PROG_LVAR_AT_CLEAR:
+        case PROG_LVAR_BANG:
+        case PROG_VAR:
+            in->data.number = (int) (int32_t) dbbin_get_int(r, 4);
+
+            if (in->type == PROG_PRIMITIVE
+                && (in->data.number < 1 || in->data.number > prim_count))
+                r->bad = 1;
+
+            break;
+        case PROG_FLOAT:
+            bits = dbbin_get_int(r, 8);
+            memcpy(&in->data.fnumber, &bits, sizeof(bits));
+            break;
+        case PROG_STRING:
+            in->data.string = NULL;
+
+            if (dbbin_get_int(r, 1))
+                in->data.string = alloc_prog_string(dbbin_get_str(r));
+
+            break;
+        case PROG_FUNCTION:
+            if (!(in->data.mufproc = malloc(sizeof(struct muf_proc_data)))) {
+                fprintf(stderr, "mufcache_get_inst(): Out of Memory!\n");
+                abort();
+            }
+
+            in->data.mufproc->procname = strdup(dbbin_get_str(r));
+            in->data.mufproc->vars = (int) (int32_t) dbbin_get_int(r, 4);
+            in->data.mufproc->args = (int) (int32_t) dbbin_get_int(r, 4);
+            in->data.mufproc->varnames = NULL;
+
+            if (in->data.mufproc->vars < 0 || in->data.mufproc->vars > MAX_VAR) {
+                in->data.mufproc->vars = 0;
+                r->bad = 1;
+            }
+
+            if (dbbin_get_int(r, 1) && in->data.mufproc->vars) {
+                in->data.mufproc->varnames = calloc((size_t) in->data.mufproc->vars,
+                                                    sizeof(char *));
+
+                for (int j = 0; j < in->data.mufproc->vars; j++) {
+                    in->data.mufproc->varnames[j] = strdup(dbbin_get_str(r));
+                }
+            }
+
+            break;
+        case PROG_OBJECT:
+            in->data.objref = (dbref) (int32_t) dbbin_get_int(r, 4);
+            break;
+        case PROG_ADD:
+            if ((n = mufcache_get_index(r, siz)) < 0) {
+                in->type = PROG_INTEGER;
+                break;
+            }
+
+            if (!(in->data.addr = malloc(sizeof(struct prog_addr)))) {
+                fprintf(stderr, "mufcache_get_inst(): Out of Memory!\n");
+                abort();
+            }
+
+            in->data.addr->links = 1;
+            in->data.addr->progref = program;
+            in->data.addr->data = code + n;
+            break;
+        case PROG_IF:
+        case PROG_JMP:
+        case PROG_EXEC:
+        case PROG_TRY:
+            if ((n = mufcache_get_index(r, siz)) < 0) {
+                in->type = PROG_INTEGER;
+                break;
+            }
+
+            in->data.call = code + n;
+            break;
+        default:
+            in->type = PROG_INTEGER;
+            r->bad = 1;
+            break;
+    }
+
+    return !r->bad;
+}
+
+/**
+ * Read a whole file into memory
+ *
+ * @private
+ * @param path the file
+ * @param len set to the number of bytes read
+ * @return the bytes, or NULL if the file could not be read
+ */
+static unsigned char *
+mufcache_read_file(const char *path, size_t *len)
+{
+    unsigned char *data;
+    long size;
+    FILE *f;
+
+    if (!(f = fopen(path, "rb")))
+        return NULL;
+
+    if (fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET)) {
+        fclose(f);
+        return NULL;
+    }
+
+    if (!(data = malloc((size_t) size))) {
+        fprintf(stderr, "mufcache_read_file(): Out of Memory!\n");
+        abort();
+    }
+
+    if (fread(data, 1, (size_t) size, f) != (size_t) size) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(f);
+    *len = (size_t) size;
+    return data;
+}
+
+/**
+ * Load a program's saved code, if a compile would still produce it
+ *
+ * The program itself is not changed; on success the caller installs the
+ * code in place of whatever it had.
+ *
+ * @param program the program
+ * @param player the player who would compile it
+ * @param code set to the instructions
+ * @param siz set to the number of instructions
+ * @param start set to the index of the entry point
+ * @param pubs set to the public functions
+ * @return true if the code was loaded
+ */
+int
+mufcache_load(dbref program, dbref player, struct inst **code, int *siz,
+              int *start, struct publics **pubs)
+{
+    struct dbbin_reader r;
+    struct publics *first = NULL, **tail = &first;
+    struct inst *c = NULL;
+    unsigned char *data;
+    char path[BUFFER_LEN];
+    uint64_t texthash;
+    size_t len;
+    int count, kind, n = 0;
+    int decoded = 0;
+    dbref ref;
+    const char *name;
+
+    if (!tp_muf_cache)
+        return 0;
+
+    snprintf(path, sizeof(path), "muf/%d.mc", (int) program);
+
+    if (!(data = mufcache_read_file(path, &len)))
+        return 0;
+
+    r.p = data;
+    r.end = data + len;
+    r.file = NULL;
+    r.bad = 0;
+
+    if (len < MUFCACHE_MAGIC_LEN || memcmp(data, MUFCACHE_MAGIC, MUFCACHE_MAGIC_LEN))
+        goto fail;
+
+    r.p += MUFCACHE_MAGIC_LEN;
+
+    if (dbbin_get_int(&r, 4) != MUFCACHE_VERSION
+        || dbbin_get_int(&r, 8) != mufcache_fingerprint())
+        goto fail;
+
+    texthash = dbbin_get_int(&r, 8);
+
+    if (dbbin_get_int(&r, 8) != mufcache_tune_hash()
+        || (dbref) (int32_t) dbbin_get_int(&r, 4) != player
+        || (dbref) (int32_t) dbbin_get_int(&r, 4) != OWNER(program)
+        || (int) (int32_t) dbbin_get_int(&r, 4) != MLevel(OWNER(program))
+        || r.bad)
+        goto fail;
+
+    /* Only now read the text, the first check that costs much. */
+    {
+        uint64_t h;
+
+        if (!mufcache_file_hash(program, &h) || h != texthash)
+            goto fail;
+    }
+
+    count = (int) (int32_t) dbbin_get_int(&r, 4);
+
+    for (int i = 0; i < count && !r.bad; i++) {
+        kind = (int) dbbin_get_int(&r, 1);
+        ref = (dbref) (int32_t) dbbin_get_int(&r, 4);
+        name = dbbin_get_int(&r, 1) ? dbbin_get_str(&r) : NULL;
+
+        if (dbbin_get_int(&r, 8) != mufcache_dep_value(kind, ref, name))
+            goto fail;
+    }
+
+    *siz = (int) (int32_t) dbbin_get_int(&r, 4);
+
+    if (r.bad || *siz < 1
+        || (uint64_t) *siz > (uint64_t) (r.end - r.p) / MUFCACHE_MIN_INST_SIZE)
+        goto fail;
+
+    *start = mufcache_get_index(&r, *siz);
+
+    if (!(c = calloc((size_t) *siz + 1, sizeof(struct inst)))) {
+        fprintf(stderr, "mufcache_load(): Out of Memory!\n");
+        abort();
+    }
+
+    for (; decoded < *siz && !r.bad; decoded++) {
+        mufcache_get_inst(&r, program, c, *siz, c + decoded);
+    }
+
+    count = (int) (int32_t) dbbin_get_int(&r, 4);
+
+    for (int i = 0; i < count && !r.bad; i++) {
+        struct publics *pub;
+
+        if (!(pub = malloc(sizeof(struct publics)))) {
+            fprintf(stderr, "mufcache_load(): Out of Memory!\n");
+            abort();
+        }
+
+        pub->subname = strdup(dbbin_get_str(&r));
+        pub->mlev = (int) (int32_t) dbbin_get_int(&r, 4);
+        pub->addr.ptr = c;
+
+        if ((n = mufcache_get_index(&r, *siz)) >= 0)
+            pub->addr.ptr += n;
+
+        pub->next = NULL;
+        *tail = pub;
+        tail = &pub->next;
+    }
+
+    if (r.bad || r.p != r.end)
+        goto fail;
+
+    free(data);
+    *code = c;
+    *pubs = first;
+    return 1;
+
+fail:
+    if (c)
+        mufcache_free_code(c, decoded);
+
+    mufcache_free_pubs(first);
+    free(data);
+    return 0;
+}
+
+/**
+ * Delete a program's saved code
+ *
+ * @param program the program
+ */
+void
+mufcache_remove(dbref program)
+{
+    char buf[BUFFER_LEN];
+
+    snprintf(buf, sizeof(buf), "muf/%d.mc", (int) program);
+    unlink(buf);
+}
+#else
+/* Without the binary encoding there is nothing to save or load. */
+void
+mufcache_save(dbref program, dbref player, struct mufcache_deps *deps)
+{
+}
+
+int
+mufcache_load(dbref program, dbref player, struct inst **code, int *siz,
+              int *start, struct publics **pubs)
+{
+    return 0;
+}
+
+void
+mufcache_remove(dbref program)
+{
+}
+#endif /* !DISKBASE */
+
+/**
+ * Order programs from the most used to the least
+ *
+ * @private
+ * @param a a pointer to the first dbref
+ * @param b a pointer to the second dbref
+ * @return less than, equal to, or greater than 0, as for qsort
+ */
+static int
+mufcache_warmup_cmp(const void *a, const void *b)
+{
+    dbref x = *(const dbref *) a;
+    dbref y = *(const dbref *) b;
+
+    if (DBFETCH(x)->ts_usecount != DBFETCH(y)->ts_usecount)
+        return DBFETCH(x)->ts_usecount > DBFETCH(y)->ts_usecount ? -1 : 1;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Pick the programs to compile after the database loads
+ *
+ * These are the tp_muf_warmup most used programs that are not compiled.
+ */
+void
+mufcache_warmup_start(void)
+{
+    int count = 0;
+
+    free(warmup_list);
+    warmup_list = NULL;
+    warmup_count = warmup_next = 0;
+
+    if (tp_muf_warmup <= 0)
+        return;
+
+    for (dbref i = 0; i < db_top; i++) {
+        if (Typeof(i) == TYPE_PROGRAM && !PROGRAM_CODE(i)
+            && DBFETCH(i)->ts_usecount > 0)
+            count++;
+    }
+
+    if (!count)
+        return;
+
+    if (!(warmup_list = malloc(sizeof(dbref) * (size_t) count))) {
+        fprintf(stderr, "mufcache_warmup_start(): Out of Memory!\n");
+        abort();
+    }
+
+    for (dbref i = 0; i < db_top; i++) {
+        if (Typeof(i) == TYPE_PROGRAM && !PROGRAM_CODE(i)
+            && DBFETCH(i)->ts_usecount > 0)
+            warmup_list[warmup_count++] = i;
+    }
+
+    qsort(warmup_list, (size_t) warmup_count, sizeof(dbref), mufcache_warmup_cmp);
+
+    if (warmup_count > tp_muf_warmup)
+        warmup_count = tp_muf_warmup;
+
+    log_status("MUF: Warming up the %d most used program(s).", warmup_count);
+}
+
+/**
+ * Compile or load the next program picked by mufcache_warmup_start
+ *
+ * Programs that were compiled, or stopped being programs, since they
+ * were picked are skipped.
+ *
+ * @return true if there are more programs left to do
+ */
+int
+mufcache_warmup_step(void)
+{
+    dbref program;
+
+    while (warmup_next < warmup_count) {
+        program = warmup_list[warmup_next++];
+
+        if (ObjExists(program) && Typeof(program) == TYPE_PROGRAM
+            && !PROGRAM_CODE(program)) {
+            compile_on_demand(-1, program);
+            break;
+        }
+    }
+
+    if (warmup_next < warmup_count)
+        return 1;
+
+    free(warmup_list);
+    warmup_list = NULL;
+    warmup_count = warmup_next = 0;
+    return 0;
+}
@@ -19,6 +19,7 @@
 #include "diskprop.h"
 #endif
 #include "fbstrings.h"
+#include "fbtime.h"
 #include "game.h"
 #include "inst.h"
 #include "interface.h"
@@ -110,15 +111,12 @@ prim_array_make(PRIM_PROTOTYPE)
     if (*top < result)
         abort_interp("Stack underflow.");
 
-    temp1.type = PROG_INTEGER;
-    temp1.line = 0;
-    nu = new_array_packed(result, fr->pinning);
+    nu = new_array_packed(0, fr->pinning);
+    array_appenditems(&nu, &arg[*top - result], result);
 
     for (int i = result; i-- > 0;) {
-        temp1.data.number = i;
         CHECKOP(1);
         oper1 = POP();
-        array_setitem(&nu, &temp1, oper1);
         CLEAR(oper1);
     }
 
@@ -1023,6 +1021,49 @@ prim_array_cut(PRIM_PROTOTYPE)
     PushArrayRaw(nu2);
 }
 
+/**
+ * Do a set operation on a stackrange of arrays with array_mash_hashed()
+ *
+ * If it works, the arrays are popped off the stack.  If any of them is not
+ * an array, or their values can't be hashed, the stack is left alone for
+ * the caller to do it with array_mash(), which also reports the errors.
+ *
+ * @see array_mash_hashed
+ *
+ * @private
+ * @param arg the argument stack
+ * @param top the top-most item of the stack
+ * @param count the number of arrays on the stack
+ * @param first_value the value to add for each item in the topmost array
+ * @param value the value to add for each item in the other arrays
+ * @param threshold the least total a value needs to be kept
+ * @param pin is pinning turned on?
+ * @return the packed array of values kept, or NULL
+ */
+static stk_array *
+array_n_mash_hashed(struct inst *arg, int *top, int count, int first_value,
+                    int value, int threshold, int pin)
+{
+    stk_array *arrs[STACK_SIZE];
+    stk_array *nu;
+
+    for (int i = 0; i < count; i++) {
+        if (arg[*top - 1 - i].type != PROG_ARRAY)
+            return NULL;
+
+        arrs[i] = arg[*top - 1 - i].data.array;
+    }
+
+    if (!(nu = array_mash_hashed(arrs, count, first_value, value, threshold,
+                                 pin)))
+        return NULL;
+
+    while (count-- > 0)
+        CLEAR(arg + --(*top));
+
+    return nu;
+}
+
 /**
  * Implementation of MUF ARRAY_NUNION
  *
@@ -1062,7 +1103,10 @@ prim_array_n_union(PRIM_PROTOTYPE)
     if (*top < result)
         abort_interp("Stack underflow.");
 
-    if (result > 0) {
+    if (!result) {
+        new_union = new_array_packed(0, fr->pinning);
+    } else if (!(new_union = array_n_mash_hashed(arg, top, result, 1, 1, 1,
+                                                  fr->pinning))) {
         new_mash = new_array_dictionary(fr->pinning);
 
         for (int num_arrays = 0; num_arrays < result; num_arrays++) {
@@ -1080,8 +1124,6 @@ prim_array_n_union(PRIM_PROTOTYPE)
 
         new_union = array_demote_only(new_mash, 1, fr->pinning);
         array_free(new_mash);
-    } else {
-        new_union = new_array_packed(0, fr->pinning);
     }
 
     PushArrayRaw(new_union);
@@ -1125,7 +1167,10 @@ prim_array_n_intersection(PRIM_PROTOTYPE)
 
     EXPECT_POP_STACK(result);
 
-    if (result > 0) {
+    if (!result) {
+        new_union = new_array_packed(0, fr->pinning);
+    } else if (!(new_union = array_n_mash_hashed(arg, top, result, 1, 1, result,
+                                                  fr->pinning))) {
         new_mash = new_array_dictionary(fr->pinning);
 
         for (int num_arrays = 0; num_arrays < result; num_arrays++) {
@@ -1143,8 +1188,6 @@ prim_array_n_intersection(PRIM_PROTOTYPE)
 
         new_union = array_demote_only(new_mash, result, fr->pinning);
         array_free(new_mash);
-    } else {
-        new_union = new_array_packed(0, fr->pinning);
     }
 
     PushArrayRaw(new_union);
@@ -1187,7 +1230,10 @@ prim_array_n_difference(PRIM_PROTOTYPE)
 
     EXPECT_POP_STACK(result);
 
-    if (result > 0) {
+    if (!result) {
+        new_union = new_array_packed(0, fr->pinning);
+    } else if (!(new_union = array_n_mash_hashed(arg, top, result, 1, -1, 1,
+                                                  fr->pinning))) {
         new_mash = new_array_dictionary(fr->pinning);
 
         oper1 = POP();
@@ -1215,8 +1261,6 @@ prim_array_n_difference(PRIM_PROTOTYPE)
 
         new_union = array_demote_only(new_mash, 1, fr->pinning);
         array_free(new_mash);
-    } else {
-        new_union = new_array_packed(0, fr->pinning);
     }
 
     PushArrayRaw(new_union);
@@ -1467,6 +1511,8 @@ prim_array_sort(PRIM_PROTOTYPE)
     comparator_t comparator;
     struct inst **tmparr = NULL;
 
+    interp_slow_primitive();
+
     CHECKOP(2);
     oper2 = POP();  /* int  sort_type   */
     oper1 = POP();  /* arr  Array   */
@@ -1558,6 +1604,8 @@ prim_array_sort_indexed(PRIM_PROTOTYPE)
     comparator_t comparator;
     struct inst **tmparr = NULL;
 
+    interp_slow_primitive();
+
     CHECKOP(3);
     oper3 = POP();  /* idx  index_key   */
     oper2 = POP();  /* int  sort_type   */
@@ -1628,6 +1676,134 @@ prim_array_sort_indexed(PRIM_PROTOTYPE)
     PushArrayRaw(nu);
 }
 
+/**
+ * Convert a property's value into a stack item.
+ *
+ * The caller is responsible for CLEAR'ing the resulting item.  Diskbase
+ * values must already be fetched.  Props with no value of their own
+ * (pure propdirs) do not produce an item.
+ *
+ * @private
+ * @param prptr the property to convert
+ * @param out the stack item to load
+ * @return boolean true if 'out' was loaded, false if the prop has no value
+ */
+static int
+prop_to_inst(PropPtr prptr, struct inst *out)
+{
+    out->line = 0;
+
+    switch (PropType(prptr)) {
+        case PROP_STRTYP:
+            out->type = PROG_STRING;
+            out->data.string = alloc_prog_string(PropDataStr(prptr));
+            break;
+
+        case PROP_LOKTYP:
+            out->type = PROG_LOCK;
+
+            if (PropFlags(prptr) & PROP_ISUNLOADED) {
+                out->data.lock = TRUE_BOOLEXP;
+            } else {
+                out->data.lock = PropDataLok(prptr);
+
+                if (out->data.lock != TRUE_BOOLEXP) {
+                    out->data.lock = copy_bool(out->data.lock);
+                }
+            }
+
+            break;
+
+        case PROP_REFTYP:
+            out->type = PROG_OBJECT;
+            out->data.number = PropDataRef(prptr);
+            break;
+
+        case PROP_INTTYP:
+            out->type = PROG_INTEGER;
+            out->data.number = PropDataVal(prptr);
+            break;
+
+        case PROP_FLTTYP:
+            out->type = PROG_FLOAT;
+            out->data.fnumber = PropDataFVal(prptr);
+            break;
+
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Convert an array key into a property name relative to some propdir.
+ *
+ * String keys are used as-is, integers are printed in decimal and floats
+ * are printed so that they always look like floats.  Any other key type
+ * results in an empty name.
+ *
+ * @private
+ * @param key the array key to convert
+ * @param out the buffer to write the name to
+ * @param outlen the size of out
+ * @return out, for convenience
+ */
+static char *
+array_key_propname(struct inst *key, char *out, size_t outlen)
+{
+    switch (key->type) {
+        case PROG_STRING:
+            strcpyn(out, outlen, DoNullInd(key->data.string));
+            break;
+
+        case PROG_INTEGER:
+            snprintf(out, outlen, "%d", key->data.number);
+            break;
+
+        case PROG_FLOAT:
+            snprintf(out, outlen, "%.15g", key->data.fnumber);
+
+            if (!strchr(out, '.') && !strchr(out, 'n') && !strchr(out, 'e')) {
+                strcatn(out, outlen, ".0");
+            }
+
+            break;
+
+        default:
+            *out = '\0';
+    }
+
+    return out;
+}
+
+/**
+ * Free the names (and any copied locks) gathered for a property batch.
+ *
+ * This is used by the batch property primitives both to clean up after a
+ * successful batch, in which case 'dats' is NULL since the properties now
+ * own the locks, and to bail out before a batch is applied.
+ *
+ * @private
+ * @param names the allocated names, each freed and then the array itself
+ * @param dats the property data whose locks should be freed, or NULL
+ * @param count the number of entries in names and dats
+ */
+static void
+free_prop_batch(char **names, PData * dats, int count)
+{
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+
+        if (dats && (dats[i].flags & PROP_TYPMASK) == PROP_LOKTYP) {
+            free_boolexp(dats[i].data.lok);
+        }
+    }
+
+    free(names);
+    free(dats);
+}
+
 /**
  * Implementation of MUF ARRAY_GET_PROPDIRS
  *
@@ -1656,7 +1832,6 @@ prim_array_get_propdirs(PRIM_PROTOTYPE)
     char propname[BUFFER_LEN];
     char dir[BUFFER_LEN];
     PropPtr propadr, pptr;
-    PropPtr prptr;
     int count = 0;
     int len;
 
@@ -1694,35 +1869,22 @@ prim_array_get_propdirs(PRIM_PROTOTYPE)
     while (propadr) {
         snprintf(buf, sizeof(buf), "%s%c%s", dir, PROPDIR_DELIMITER, propname);
 
+        /*
+         * first_prop and next_prop hand us the node itself, so there is
+         * no need to look each one up again by its full path.
+         */
         if (prop_read_perms(ProgUID, ref, buf, mlev)) {
-            prptr = get_property(ref, buf);
-
-            if (prptr) {
-                /*
-                 * TODO: Okay ... so propfetch
-                 *
-                 *       This is a pretty low level kind of call, that
-                 *       requires intimate knowledge of the DB "driver".
-                 *
-                 *       Shouldn't this be handled in a lower level like
-                 *       PropDir?  Or maybe make the define more clever...
-                 *
-                 *       I'm not sure, I just feel like this doesn't
-                 *       belong here.  This is a widespread issue so maybe
-                 *       should be an issue instead.
-                 */
 #ifdef DISKBASE
-                propfetch(ref, prptr);
+            propfetch(ref, propadr);
 #endif
 
-                if (PropDir(prptr)) {
-                    if (count >= tp_max_propfetch) {
-                        array_free(nu);
-                        abort_interp("Too many propdirs to put in an array!");
-                    }
-
-                    array_set_intkey_strval(&nu, count++, propname);
+            if (PropDir(propadr)) {
+                if (count >= tp_max_propfetch) {
+                    array_free(nu);
+                    abort_interp("Too many propdirs to put in an array!");
                 }
+
+                array_set_intkey_strval(&nu, count++, propname);
             }
         }
 
@@ -1763,7 +1925,6 @@ prim_array_get_propvals(PRIM_PROTOTYPE)
     char propname[BUFFER_LEN];
     char dir[BUFFER_LEN];
     PropPtr propadr, pptr;
-    PropPtr prptr;
     int count = 0;
 
     /* dbref strPropDir -- array */
@@ -1795,88 +1956,27 @@ prim_array_get_propvals(PRIM_PROTOTYPE)
     while (propadr) {
         snprintf(buf, sizeof(buf), "%s%c%s", dir, PROPDIR_DELIMITER, propname);
 
+        /*
+         * first_prop and next_prop hand us the node itself, so there is
+         * no need to look each one up again by its full path.
+         */
         if (prop_read_perms(ProgUID, ref, buf, mlev)) {
-            prptr = get_property(ref, buf);
-
-            if (prptr) {
-                int goodflag = 1;
-
 #ifdef DISKBASE
-                propfetch(ref, prptr);
+            propfetch(ref, propadr);
 #endif
 
-                /*
-                 * TODO: a grep switch *.c | grep PropType will reveal this
-                 *       switch statement is done all over the place.
-                 *
-                 *       Some cases, this may be unavoidable, however I
-                 *       really feel like I have seen very similar code to
-                 *       this elsewhere .... not sure where though.
-                 *
-                 *       Is this something we can address with C++?  Properties
-                 *       can be a bit more intelligent and maybe centralize
-                 *       this kind of logic so we can automatically copy this
-                 *       kind of thing out.
-                 *
-                 *       I'm not sure :)  I feel like there's something to
-                 *       improve here but it may need more than just my brain
-                 *       churning on it.
-                 *
-                 *       - tanabi
-                 */
-                switch (PropType(prptr)) {
-                    case PROP_STRTYP:
-                        temp2.type = PROG_STRING;
-                        temp2.data.string = alloc_prog_string(PropDataStr(prptr));
-                        break;
-
-                    case PROP_LOKTYP:
-                        temp2.type = PROG_LOCK;
-
-                        if (PropFlags(prptr) & PROP_ISUNLOADED) {
-                            temp2.data.lock = TRUE_BOOLEXP;
-                        } else {
-                            temp2.data.lock = PropDataLok(prptr);
-
-                            if (temp2.data.lock != TRUE_BOOLEXP) {
-                                temp2.data.lock = copy_bool(temp2.data.lock);
-                            }
-                        }
-
-                        break;
-
-                    case PROP_REFTYP:
-                        temp2.type = PROG_OBJECT;
-                        temp2.data.number = PropDataRef(prptr);
-                        break;
-
-                    case PROP_INTTYP:
-                        temp2.type = PROG_INTEGER;
-                        temp2.data.number = PropDataVal(prptr);
-                        break;
-
-                    case PROP_FLTTYP:
-                        temp2.type = PROG_FLOAT;
-                        temp2.data.fnumber = PropDataFVal(prptr);
-                        break;
-
-                    default:
-                        goodflag = 0;
-                        break;
-                }
-
-                if (goodflag) {
-                    if (count++ >= tp_max_propfetch) {
-                        array_free(nu);
-                        abort_interp("Too many properties to put in an array!");
-                    }
-
-                    temp1.type = PROG_STRING;
-                    temp1.data.string = alloc_prog_string(propname);
-                    array_setitem(&nu, &temp1, &temp2);
-                    CLEAR(&temp1);
+            if (prop_to_inst(propadr, &temp2)) {
+                if (count++ >= tp_max_propfetch) {
                     CLEAR(&temp2);
+                    array_free(nu);
+                    abort_interp("Too many properties to put in an array!");
                 }
+
+                temp1.type = PROG_STRING;
+                temp1.data.string = alloc_prog_string(propname);
+                array_setitem(&nu, &temp1, &temp2);
+                CLEAR(&temp1);
+                CLEAR(&temp2);
             }
         }
 
@@ -2009,6 +2109,7 @@ prim_array_get_proplist(PRIM_PROTOTYPE)
      */
 
     nu = new_array_packed(0, fr->pinning);
+    array_reserve(nu, maxcount);
 
     while (maxcount > 0) {
         snprintf(propname, sizeof(propname), "%s#%c%d", dir, PROPDIR_DELIMITER, count);
@@ -2103,13 +2204,72 @@ prim_array_get_proplist(PRIM_PROTOTYPE)
     PushArrayRaw(nu);
 }
 
+/**
+ * Convert a stack item into property data for setting a property.
+ *
+ * Strings are NOT copied; the property data points into the stack item,
+ * so it must outlive the property data.  Locks ARE copied, and become the
+ * property's when the property data is used to set a property.
+ *
+ * @private
+ * @param val the stack item to convert
+ * @param propdat the property data to load
+ * @return boolean true if the item could be converted, false otherwise
+ */
+static int
+inst_to_propdat(struct inst *val, PData * propdat)
+{
+    /*
+     * TODO: I think this is also really commonly copied and pasted,
+     *       but it somewhat harder to grep for.  Another good
+     *       candidate for something to consider in C++, with
+     *       operator overloading between types perhaps.
+     */
+    switch (val->type) {
+        case PROG_STRING:
+            propdat->flags = PROP_STRTYP;
+            propdat->data.str = val->data.string ? val->data.string->data : 0;
+            break;
+
+        case PROG_INTEGER:
+            propdat->flags = PROP_INTTYP;
+            propdat->data.val = val->data.number;
+            break;
+
+        case PROG_FLOAT:
+            propdat->flags = PROP_FLTTYP;
+            propdat->data.fval = val->data.fnumber;
+            break;
+
+        case PROG_OBJECT:
+            propdat->flags = PROP_REFTYP;
+            propdat->data.ref = val->data.objref;
+            break;
+
+        case PROG_LOCK:
+            propdat->flags = PROP_LOKTYP;
+            propdat->data.lok = copy_bool(val->data.lock);
+            break;
+
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
 /**
  * Implementation of MUF ARRAY_PUT_PROPVALS
  *
  * Consumes a dbref and a dictionary.  Uses the dictionary keys as prop names
  * and sets those props to the corresponding values.  Permissions are respected.
  *
+ * All the permission checks are done before anything is set, so either all
+ * of the props are set or none are.  The props are then set as one batch
+ * so the propdir is only located once.
+ *
  * @see prop_write_perms
+ * @see set_property_batch
  *
  * @param player the player running the MUF program
  * @param program the program being run
@@ -2125,7 +2285,9 @@ prim_array_put_propvals(PRIM_PROTOTYPE)
     stk_array *arr;
     char propname[BUFFER_LEN];
     char dir[BUFFER_LEN];
-    PData propdat;
+    char **names;
+    PData *dats;
+    int count = 0;
 
     /* dbref strPropDir array -- */
     CHECKOP(3);
@@ -2149,82 +2311,240 @@ prim_array_put_propvals(PRIM_PROTOTYPE)
     strcpyn(dir, sizeof(dir), DoNullInd(oper2->data.string));
     arr = oper3->data.array;
 
+    names = malloc(sizeof(char *) * (size_t)(array_count(arr) + 1));
+    dats = malloc(sizeof(PData) * (size_t)(array_count(arr) + 1));
+
     if (array_first(arr, &temp1)) {
         do {
             oper4 = array_getitem(arr, &temp1);
 
-            switch (temp1.type) {
-                case PROG_STRING:
-                    snprintf(propname, sizeof(propname), "%s%c%s", dir,
-                             PROPDIR_DELIMITER, DoNullInd(temp1.data.string));
-                    break;
+            if (!*array_key_propname(&temp1, propname, sizeof(propname)))
+                continue;
 
-                case PROG_INTEGER:
-                    snprintf(propname, sizeof(propname), "%s%c%d", dir,
-                             PROPDIR_DELIMITER, temp1.data.number);
-                    break;
+            snprintf(buf, sizeof(buf), "%s%c%s", dir, PROPDIR_DELIMITER,
+                     propname);
 
-                case PROG_FLOAT:
-                    snprintf(propname, sizeof(propname), "%s%c%.15g", dir,
-                             PROPDIR_DELIMITER, temp1.data.fnumber);
+            if (!prop_write_perms(ProgUID, ref, buf, mlev)) {
+                CLEAR(&temp1);
+                free_prop_batch(names, dats, count);
+                abort_interp("Permission denied while trying to set "
+                             "protected property.");
+            }
 
-                    if (!strchr(propname, '.') && !strchr(propname, 'n')
-                        && !strchr(propname, 'e')) {
-                        strcatn(propname, sizeof(propname), ".0");
-                    }
+            if (inst_to_propdat(oper4, &dats[count])) {
+                names[count++] = strdup(propname);
+            }
+        } while (array_next(arr, &temp1));
+    }
 
-                    break;
+    set_property_batch(ref, dir, (const char **)names, dats, count);
 
-                default:
-                    *propname = '\0';
-            }
+    if (count) {
+        ts_modifyobject(ref);
+    }
 
-            if (!prop_write_perms(ProgUID, ref, propname, mlev))
-                abort_interp("Permission denied while trying to set "
-                             "protected property.");
+    /* The props own any locks now, so only free the names. */
+    free_prop_batch(names, NULL, count);
+    free(dats);
 
-            /*
-             * TODO: I think this is also really commonly copied and pasted,
-             *       but it somewhat harder to grep for.  Another good
-             *       candidate for something to consider in C++, with
-             *       operator overloading between types perhaps.
-             */
-            switch (oper4->type) {
-                case PROG_STRING:
-                    propdat.flags = PROP_STRTYP;
-                    propdat.data.str = oper4->data.string ? oper4->data.string->data : 0;
-                    break;
+    CLEAR(oper1);
+    CLEAR(oper2);
+    CLEAR(oper3);
+}
 
-                case PROG_INTEGER:
-                    propdat.flags = PROP_INTTYP;
-                    propdat.data.val = oper4->data.number;
-                    break;
+/**
+ * Implementation of MUF ARRAY_FETCH_PROPVALS
+ *
+ * Consumes a dbref, a string containing a propdir, and a list array of
+ * prop names within that propdir.  Puts a dictionary on the stack mapping
+ * each of those prop names that has a value to its value.  Props that
+ * are unset, have no value of their own, or that the program can't read
+ * are left out.
+ *
+ * This is the batched equivalent of a loop of GETPROPs; the propdir is
+ * located once for the whole list.  Only up to tp_max_propfetch names may
+ * be given.
+ *
+ * @see prop_read_perms
+ * @see get_property_batch
+ *
+ * @param player the player running the MUF program
+ * @param program the program being run
+ * @param mlev the effective MUCKER level
+ * @param pc the program counter pointer
+ * @param arg the argument stack
+ * @param top the top-most item of the stack
+ * @param fr the program frame
+ */
+void
+prim_array_fetch_propvals(PRIM_PROTOTYPE)
+{
+    stk_array *arr;
+    stk_array *nu;
+    char propname[BUFFER_LEN];
+    char dir[BUFFER_LEN];
+    char **names;
+    PropPtr *props;
+    int count = 0;
 
-                case PROG_FLOAT:
-                    propdat.flags = PROP_FLTTYP;
-                    propdat.data.fval = oper4->data.fnumber;
-                    break;
+    /* dbref strPropDir list -- dict */
+    CHECKOP(3);
+    oper3 = POP();
+    oper2 = POP();
+    oper1 = POP();
 
-                case PROG_OBJECT:
-                    propdat.flags = PROP_REFTYP;
-                    propdat.data.ref = oper4->data.objref;
-                    break;
+    if (!valid_object(oper1))
+        abort_interp("Invalid dbref. (1)");
 
-                case PROG_LOCK:
-                    propdat.flags = PROP_LOKTYP;
-                    propdat.data.lok = copy_bool(oper4->data.lock);
-                    break;
+    if (oper2->type != PROG_STRING)
+        abort_interp("String required. (2)");
 
-                default:
-                    *propname = '\0';
+    if (oper3->type != PROG_ARRAY)
+        abort_interp("Array required. (3)");
+
+    if (oper3->data.array && oper3->data.array->type != ARRAY_PACKED)
+        abort_interp("Argument must be a list type array. (3)");
+
+    ref = oper1->data.objref;
+
+    CHECKREMOTE(ref);
+
+    arr = oper3->data.array;
+
+    if (array_count(arr) > tp_max_propfetch)
+        abort_interp("Too many properties to fetch!");
+
+    strcpyn(dir, sizeof(dir), DoNullInd(oper2->data.string));
+
+    names = malloc(sizeof(char *) * (size_t)(array_count(arr) + 1));
+    props = malloc(sizeof(PropPtr) * (size_t)(array_count(arr) + 1));
+
+    if (array_first(arr, &temp1)) {
+        do {
+            oper4 = array_getitem(arr, &temp1);
+
+            if (!*array_key_propname(oper4, propname, sizeof(propname)))
+                continue;
+
+            snprintf(buf, sizeof(buf), "%s%c%s", dir, PROPDIR_DELIMITER,
+                     propname);
+
+            if (prop_read_perms(ProgUID, ref, buf, mlev)) {
+                names[count++] = strdup(propname);
             }
+        } while (array_next(arr, &temp1));
+    }
+
+    get_property_batch(ref, dir, (const char **)names, count, props);
+
+    nu = new_array_dictionary(fr->pinning);
+
+    for (int i = 0; i < count; i++) {
+        if (props[i] && prop_to_inst(props[i], &temp2)) {
+            temp1.type = PROG_STRING;
+            temp1.data.string = alloc_prog_string(names[i]);
+            array_setitem(&nu, &temp1, &temp2);
+            CLEAR(&temp1);
+            CLEAR(&temp2);
+        }
+    }
 
-            if (*propname) {
-                set_property(ref, propname, &propdat);
+    free_prop_batch(names, NULL, count);
+    free(props);
+
+    CLEAR(oper1);
+    CLEAR(oper2);
+    CLEAR(oper3);
+    PushArrayRaw(nu);
+}
+
+/**
+ * Implementation of MUF ARRAY_DEL_PROPVALS
+ *
+ * Consumes a dbref, a string containing a propdir, and a list array of
+ * prop names within that propdir, and removes all of those props.  As with
+ * REMOVE_PROP, removing a propdir removes everything under it.
+ *
+ * All the permission checks are done before anything is removed, so
+ * either all of the props are removed or none are.  The props are then
+ * removed as one batch so the propdir is only located once.
+ *
+ * @see prop_write_perms
+ * @see remove_property_batch
+ *
+ * @param player the player running the MUF program
+ * @param program the program being run
+ * @param mlev the effective MUCKER level
+ * @param pc the program counter pointer
+ * @param arg the argument stack
+ * @param top the top-most item of the stack
+ * @param fr the program frame
+ */
+void
+prim_array_del_propvals(PRIM_PROTOTYPE)
+{
+    stk_array *arr;
+    char propname[BUFFER_LEN];
+    char dir[BUFFER_LEN];
+    char **names;
+    int count = 0;
+
+    /* dbref strPropDir list -- */
+    CHECKOP(3);
+    oper3 = POP();
+    oper2 = POP();
+    oper1 = POP();
+
+    if (!valid_object(oper1))
+        abort_interp("Invalid dbref. (1)");
+
+    if (oper2->type != PROG_STRING)
+        abort_interp("String required. (2)");
+
+    if (oper3->type != PROG_ARRAY)
+        abort_interp("Array required. (3)");
+
+    if (oper3->data.array && oper3->data.array->type != ARRAY_PACKED)
+        abort_interp("Argument must be a list type array. (3)");
+
+    ref = oper1->data.objref;
+
+    CHECKREMOTE(ref);
+
+    arr = oper3->data.array;
+    strcpyn(dir, sizeof(dir), DoNullInd(oper2->data.string));
+
+    names = malloc(sizeof(char *) * (size_t)(array_count(arr) + 1));
+
+    if (array_first(arr, &temp1)) {
+        do {
+            oper4 = array_getitem(arr, &temp1);
+
+            if (!*array_key_propname(oper4, propname, sizeof(propname)))
+                continue;
+
+            snprintf(buf, sizeof(buf), "%s%c%s", dir, PROPDIR_DELIMITER,
+                     propname);
+
+            if (!prop_write_perms(ProgUID, ref, buf, mlev)) {
+                CLEAR(&temp1);
+                free_prop_batch(names, NULL, count);
+                abort_interp("Permission denied while trying to remove "
+                             "protected property.");
             }
+
+            names[count++] = strdup(propname);
         } while (array_next(arr, &temp1));
     }
 
+    remove_property_batch(ref, dir, (const char **)names, count);
+
+    if (count) {
+        ts_modifyobject(ref);
+    }
+
+    free_prop_batch(names, NULL, count);
+
     CLEAR(oper1);
     CLEAR(oper2);
     CLEAR(oper3);
@@ -3315,7 +3635,9 @@ prim_array_pin(PRIM_PROTOTYPE)
         nu = arr;
     }
 
+    /* Pinned arrays are shared as they are, so don't keep spare room */
     nu->pinned = 1;
+    array_shrink(nu);
 
     CLEAR(oper1);
     PushArrayRaw(nu);
@@ -3776,6 +4098,8 @@ prim_array_filter_flags(PRIM_PROTOTYPE)
     stk_array *nw, *arr;
     struct inst *in;
 
+    interp_slow_primitive();
+
     CHECKOP(2);
     oper2 = POP();  /* str:flags */
     oper1 = POP();  /* arr:refs */
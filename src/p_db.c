@@ -15,6 +15,7 @@
 #include "boolexp.h"
 #include "compile.h"
 #include "db.h"
+#include "dbindex.h"
 #ifdef DISKBASE
 #include "diskprop.h"
 #endif
@@ -608,6 +609,7 @@ prim_next(PRIM_PROTOTYPE)
 void
 prim_nextowned(PRIM_PROTOTYPE)
 {
+    struct dbindex_scan scan;
     dbref ownr;
 
     CHECKOP(1);
@@ -627,18 +629,11 @@ prim_nextowned(PRIM_PROTOTYPE)
 
     ownr = OWNER(ref);
 
-    if (Typeof(ref) == TYPE_PLAYER) {
-        ref = 0;
-    } else {
-        ref++;
-    }
+    ref = dbindex_first(&scan, ownr, NOTYPE, NULL,
+                        Typeof(ref) == TYPE_PLAYER ? 0 : ref + 1);
 
-    while (ref < db_top && (OWNER(ref) != ownr || ref == ownr))
-        ref++;
-
-    if (ref >= db_top) {
-        ref = NOTHING;
-    }
+    while (ref != NOTHING && (OWNER(ref) != ownr || ref == ownr))
+        ref = dbindex_next(&scan);
 
     CLEAR(oper1);
     PushObject(ref);
@@ -768,6 +763,7 @@ prim_setname(PRIM_PROTOTYPE)
 
             free((void *) NAME(ref));
             NAME(ref) = alloc_string(b);
+            dbindex_update(ref);
             ts_modifyobject(ref);
         }
     }
@@ -2020,6 +2016,8 @@ prim_setlink(PRIM_PROTOTYPE)
         }
     }
 
+    dbindex_update(ref);
+
     CLEAR(oper1);
     CLEAR(oper2);
 }
@@ -2092,6 +2090,7 @@ prim_setown(PRIM_PROTOTYPE)
     }
 
     OWNER(ref) = OWNER(oper1->data.objref);
+    dbindex_update(ref);
     DBDIRTY(ref);
 
     CLEAR(oper1);
@@ -2716,9 +2715,12 @@ void
 prim_findnext(PRIM_PROTOTYPE)
 {
     struct flgchkdat check;
+    struct dbindex_scan scan;
     dbref who, item, ref;
     const char *name;
 
+    interp_slow_primitive();
+
     CHECKOP(4);
     oper4 = POP();              /* str:flags */
     oper3 = POP();              /* str:namepattern */
@@ -2777,7 +2779,10 @@ prim_findnext(PRIM_PROTOTYPE)
 
     init_checkflags(player, DoNullInd(oper4->data.string), &check);
 
-    for (dbref i = item; i < db_top; i++) {
+    for (dbref i = dbindex_first(&scan, who,
+                                 check.fortype ? check.istype : NOTYPE,
+                                 *name ? buf : NULL, item);
+         i != NOTHING; i = dbindex_next(&scan)) {
         if ((who == NOTHING || OWNER(i) == who) &&
             checkflags(i, check) && NAME(i) && Typeof(i) != TYPE_GARBAGE &&
             (!*name || equalstr(buf, (char *) NAME(i)))) {
@@ -2812,6 +2817,7 @@ prim_findnext(PRIM_PROTOTYPE)
 void
 prim_nextentrance(PRIM_PROTOTYPE)
 {
+    struct dbindex_scan scan;
     dbref linkref, ref;
     int foundref = 0;
     int count;
@@ -2837,7 +2843,12 @@ prim_nextentrance(PRIM_PROTOTYPE)
 
     (void) ref++;
 
-    for (; ref < db_top; ref++) {
+    /* Only links to real objects are indexed. */
+    if (linkref >= 0)
+        ref = dbindex_first_link(&scan, linkref, ref);
+
+    for (; ref != NOTHING && ref < db_top;
+         ref = linkref >= 0 ? dbindex_next(&scan) : ref + 1) {
         oper2->data.objref = ref;
 
         if (valid_object(oper2)) {
@@ -2991,6 +3002,7 @@ prim_copyplayer(PRIM_PROTOTYPE)
     copy_properties_onto(ref, newplayer);
 
     PLAYER_SET_HOME(newplayer, PLAYER_HOME(ref));
+    dbindex_update(newplayer);
     SETVALUE(newplayer, GETVALUE(newplayer) + GETVALUE(ref));
     moveto(newplayer, PLAYER_HOME(ref));
 
@@ -3566,6 +3578,8 @@ prim_contents_array(PRIM_PROTOTYPE)
     stk_array *nw;
     int count = 0;
 
+    interp_slow_primitive();
+
     CHECKOP(1);
     oper1 = POP();
 
@@ -3615,6 +3629,8 @@ prim_exits_array(PRIM_PROTOTYPE)
     stk_array *nw;
     int count = 0;
 
+    interp_slow_primitive();
+
     CHECKOP(1);
     oper1 = POP();
 
@@ -3705,6 +3721,8 @@ array_getlinks(dbref obj, int pinned)
 void
 prim_getlinks_array(PRIM_PROTOTYPE)
 {
+    interp_slow_primitive();
+
     CHECKOP(1);
     oper1 = POP();
 
@@ -3739,8 +3757,11 @@ prim_entrances_array(PRIM_PROTOTYPE)
      * @TODO NEXTENTRANCE requires MUCKER levl 3. Should this?
      */
     stk_array *nw;
+    struct dbindex_scan scan;
     int count = 0;
 
+    interp_slow_primitive();
+
     CHECKOP(1);
     oper1 = POP();
 
@@ -3750,7 +3771,8 @@ prim_entrances_array(PRIM_PROTOTYPE)
     ref = oper1->data.objref;
     nw = new_array_packed(0, fr->pinning);
 
-    for (dbref i = 0; i < db_top; i++) {
+    for (dbref i = dbindex_first_link(&scan, ref, 0); i != NOTHING;
+         i = dbindex_next(&scan)) {
         switch (Typeof(i)) {
             case TYPE_EXIT:
                 for (dbref j = DBFETCH(i)->sp.exit.ndest; j--;) {
@@ -4207,6 +4229,7 @@ prim_setlinks_array(PRIM_PROTOTYPE)
         }
     }
 
+    dbindex_update(what);
     DBDIRTY(what);
 
     CLEAR(oper1);
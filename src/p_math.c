@@ -106,10 +106,10 @@ prim_add(PRIM_PROTOTYPE)
                    > (BUFFER_LEN) - 1) { /* Strings too long */
             abort_interp("Operation would result in overflow.");
         } else { /* Do the string concat */
-            memmove(buf, oper2->data.string->data, oper2->data.string->length);
-            memmove(buf + oper2->data.string->length, oper1->data.string->data,
-                    oper1->data.string->length + 1);
-            string = alloc_prog_string(buf);
+            string = append_prog_string(oper2->data.string,
+                                        oper1->data.string->data,
+                                        oper1->data.string->length);
+            oper2->data.string = NULL;
         }
 
         CLEAR(oper1);
@@ -866,6 +866,8 @@ prim_pid(PRIM_PROTOTYPE)
 void
 prim_stats(PRIM_PROTOTYPE)
 {
+    interp_slow_primitive();
+
     CHECKOP(1);
     oper1 = POP();
 
@@ -963,6 +965,8 @@ prim_stats_array(PRIM_PROTOTYPE)
     /**
      * @TODO The same comments for prim_stats apply here.
      */
+    interp_slow_primitive();
+
     CHECKOP(1);
     oper1 = POP();
 
@@ -1367,15 +1371,8 @@ prim_cancallp(PRIM_PROTOTYPE)
     if (ProgMLevel(oper1->data.objref) > 0 &&
             (mlev >= 4 || OWNER(oper1->data.objref) == ProgUID
             || Linkable(oper1->data.objref))) {
-        struct publics *pbs;
-
-        pbs = PROGRAM_PUBS(oper1->data.objref);
-
-        while (pbs) {
-            if (!strcasecmp(oper2->data.string->data, pbs->subname))
-                break;
-            pbs = pbs->next;
-        }
+        struct publics *pbs = find_public(oper1->data.objref,
+                                          oper2->data.string->data);
 
         if (pbs && mlev >= pbs->mlev)
             result = 1;
@@ -1474,6 +1474,8 @@ prim_array_filter_prop(PRIM_PROTOTYPE)
     char *prop;
     int len;
 
+    interp_slow_primitive();
+
     CHECKOP(3);
     oper3 = POP();  /* str     pattern */
     oper2 = POP();  /* str     propname */
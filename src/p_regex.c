@@ -220,6 +220,8 @@ prim_regexp(PRIM_PROTOTYPE)
     int matchcnt = 0;
     const char *errstr;
 
+    interp_slow_primitive();
+
     CHECKOP(3);
 
     oper3 = POP();  /* int:Flags */
@@ -377,6 +379,8 @@ prim_regsub(PRIM_PROTOTYPE)
     const char *errstr;
     int matchcnt, len;
 
+    interp_slow_primitive();
+
     CHECKOP(4);
 
     oper4 = POP();  /* int:Flags */
@@ -2067,10 +2067,29 @@ prim_strcut(PRIM_PROTOTYPE)
         PushNullStr;
         PushNullStr;
     } else {
-        if ((size_t)temp1.data.number > temp2.data.string->length) {
+        if ((size_t)temp1.data.number >= temp2.data.string->length) {
             temp2.data.string->links++;
             PushStrRaw(temp2.data.string);
             PushNullStr;
+        } else if (!temp1.data.number) {
+            PushNullStr;
+            temp2.data.string->links++;
+            PushStrRaw(temp2.data.string);
+        } else if (temp2.data.string->links == 1) {
+            /*
+             * Nothing else has the string, so it can be cut where it is,
+             * keeping the space after the cut for appending to.
+             */
+            struct shared_string *ss = temp2.data.string;
+
+            memmove(buf, ss->data + temp1.data.number,
+                    ss->length - (size_t)temp1.data.number + 1);
+            ss->room += (int) (ss->length - (size_t)temp1.data.number);
+            ss->length = (size_t)temp1.data.number;
+            ss->data[ss->length] = '\0';
+            ss->links++;
+            PushStrRaw(ss);
+            PushString(buf);
         } else {
             memmove(buf, temp2.data.string->data, temp1.data.number);
             buf[temp1.data.number] = '\0';
@@ -2159,10 +2178,10 @@ prim_strcat(PRIM_PROTOTYPE)
                > (BUFFER_LEN) - 1) {
         abort_interp("Operation would result in overflow.");
     } else {
-        memmove(buf, oper2->data.string->data, oper2->data.string->length);
-        memmove(buf + oper2->data.string->length, oper1->data.string->data,
-                oper1->data.string->length + 1);
-        string = alloc_prog_string(buf);
+        string = append_prog_string(oper2->data.string,
+                                    oper1->data.string->data,
+                                    oper1->data.string->length);
+        oper2->data.string = NULL;
     }
 
     CLEAR(oper1);
@@ -16,6 +16,7 @@
 
 #include "commands.h"
 #include "db.h"
+#include "dbindex.h"
 #include "edit.h"
 #include "fbmath.h"
 #include "fbstrings.h"
@@ -177,6 +178,7 @@ create_player(const char *name, const char *password)
     ALLOC_PLAYER_SP(player);
     PLAYER_SET_HOME(player, tp_player_start);
     EXITS(player) = NOTHING;
+    dbindex_update(player);
 
     SETVALUE(player, tp_start_pennies);
     set_password_raw(player, NULL);
@@ -234,6 +236,7 @@ toad_player(int descr, dbref player, dbref victim, dbref recipient)
                 case TYPE_THING:
                 case TYPE_EXIT:
                     OWNER(stuff) = recipient;
+                    dbindex_update(stuff);
                     DBDIRTY(stuff);
                     break;
             }
@@ -241,6 +244,7 @@ toad_player(int descr, dbref player, dbref victim, dbref recipient)
 
         if (Typeof(stuff) == TYPE_THING && THING_HOME(stuff) == victim) {
             THING_SET_HOME(stuff, tp_lost_and_found);
+            dbindex_update(stuff);
         }
     }
 
@@ -270,6 +274,7 @@ toad_player(int descr, dbref player, dbref victim, dbref recipient)
 
     FLAGS(victim) = TYPE_THING;
     OWNER(victim) = player;
+    dbindex_update(victim);
 
     if (tp_toad_recycle) {
         recycle(descr, player, victim);
@@ -524,5 +529,6 @@ change_player_name(dbref player, const char *name)
     free((void *) NAME(player));
 
     NAME(player) = alloc_string(name);
+    dbindex_update(player);
     ts_modifyobject(player);
 }
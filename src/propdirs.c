@@ -31,20 +31,28 @@
  * particular offers the same flexibility as this call but operates with
  * dbrefs and lets you set a value in one call.
  *
+ * The cached sizes of the propdirs along the path are updated for any
+ * nodes that get created, and if 'added' is not NULL, the number of bytes
+ * added to the tree is added to it.  Changing the value of the returned
+ * node afterwards is up to the caller to account for.
+ *
  * @see add_property
  * @see set_property
+ * @see propdir_resize_elem
  *
  * @param root The root of the property directory structure.
  * @param path The path to create.
+ * @param added if not NULL, incremented by the number of bytes created
  *
  * @return the newly created node, or the existing node at the given path,
  *         or NULL on error
  */
 PropPtr
-propdir_new_elem(PropPtr * root, char *path)
+propdir_new_elem(PropPtr * root, char *path, size_t *added)
 {
-    PropPtr p;
+    PropPtr p, elem;
     char *n;
+    size_t bytes = 0;
 
     /* @TODO: The original comments on this function say that this
      *        returns NULL "if the name given is bad".  The only check
@@ -62,15 +70,28 @@ propdir_new_elem(PropPtr * root, char *path)
     while (n && *n == PROPDIR_DELIMITER)
         *(n++) = '\0';
 
+    /* Look before creating, so we know what to count as new */
+    if (!(p = locate_prop(*root, path))) {
+        p = new_prop(root, path);
+        bytes = size_propnode(p);
+    }
+
     if (n && *n) {
         /* just another propdir in the path */
-        p = new_prop(root, path);
-        return (propdir_new_elem(&PropDir(p), n));
+        size_t below = 0;
+
+        elem = propdir_new_elem(&PropDir(p), n, &below);
+        SetPDirSize(p, PropDirSize(p) + below);
+        bytes += below;
     } else {
         /* aha, we are finally to the property itself. */
-        p = new_prop(root, path);
-        return (p);
+        elem = p;
     }
+
+    if (added)
+        *added += bytes;
+
+    return (elem);
 }
 
 /**
@@ -79,22 +100,28 @@ propdir_new_elem(PropPtr * root, char *path)
  * nothing.  If you delete a propdir, it will delete all child properties
  * within the propdir.
  *
+ * The cached sizes of the propdirs along the path are updated, and if
+ * 'freed' is not NULL, the number of bytes removed from the tree (including
+ * any propdirs removed for being left empty) is added to it.
+ *
  * This is something of a low-level call; you may rather use delete_prop
  *
  * @see delete_prop
  *
  * @param root The root property node to start your search
  * @param path the path you are searching for to delete.
+ * @param freed if not NULL, incremented by the number of bytes removed
  *
  * @return the updated root node with the property removed.  Because this
  *         mutates the passed structure, this is equivalent to the 'root'
  *         parameter.
  */
 PropPtr
-propdir_delete_elem(PropPtr root, char *path)
+propdir_delete_elem(PropPtr root, char *path, size_t *freed)
 {
     PropPtr p;
     char *n;
+    size_t bytes = 0;
 
     if (!root)
         return (NULL);
@@ -122,27 +149,34 @@ propdir_delete_elem(PropPtr root, char *path)
          */
         if (p && PropDir(p)) {
             /* yup, found the propdir */
-            SetPDir(p, propdir_delete_elem(PropDir(p), n));
+            SetPDir(p, propdir_delete_elem(PropDir(p), n, &bytes));
+            SetPDirSize(p, PropDirSize(p) - bytes);
 
             if (!PropDir(p) && PropType(p) == PROP_DIRTYP) {
+                bytes += size_propnode(p);
                 root = delete_prop(&root, PropName(p));
             }
         }
-
-        /* return the updated root pntr */
-        return (root);
     } else {
         /* aha, we are finally to the property itself. */
         p = locate_prop(root, path);
 
+        if (p) {
+            bytes = size_propnode(p) + PropDirSize(p);
+        }
+
         if (p && PropDir(p)) {
             delete_proplist(PropDir(p));
         }
 
         (void) delete_prop(&root, path);
-
-        return (root);
     }
+
+    if (freed)
+        *freed += bytes;
+
+    /* return the updated root pntr */
+    return (root);
 }
 
 /**
@@ -290,6 +324,45 @@ propdir_next_elem(PropPtr root, char *path)
     }
 }
 
+/**
+ * Adjust the cached size of every propdir along a path.
+ *
+ * This is used to keep propdir sizes up to date when a property value
+ * changes size.  'delta' is applied to each propdir named in 'path',
+ * including the last one; propdirs that do not exist are skipped.
+ *
+ * @see propdir_name
+ *
+ * @param root The root of the property directory structure.
+ * @param path The path of the propdir that changed (will be modified).
+ * @param delta the number of bytes to add, or a negative number to remove.
+ */
+void
+propdir_resize_elem(PropPtr root, char *path, long delta)
+{
+    PropPtr p;
+    char *n;
+
+    while (*path && *path == PROPDIR_DELIMITER)
+        path++;
+
+    if (!*path)
+        return;
+
+    n = strchr(path, PROPDIR_DELIMITER);
+    while (n && *n == PROPDIR_DELIMITER)
+        *(n++) = '\0';
+
+    if (!(p = locate_prop(root, path)))
+        return;
+
+    SetPDirSize(p, PropDirSize(p) + delta);
+
+    if (n && *n) {
+        propdir_resize_elem(PropDir(p), n, delta);
+    }
+}
+
 /**
  * This is basically the equivalent of the POSIX "dirname", which retrieves
  * the property directory path portion of a given propname.  Its primary
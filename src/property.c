@@ -9,6 +9,7 @@
  */
 
 #include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +27,7 @@
 #include "game.h"
 #include "interface.h"
 #include "interp.h"
+#include "journal.h"
 #include "log.h"
 #include "match.h"
 #include "mpi.h"
@@ -33,6 +35,173 @@
 #include "tune.h"
 
 
+/**
+ * If a property name is a listen prop, mark the object as a listener.
+ *
+ * I don't know the exact purpose of this, 'LISTENER' is not
+ * well documented from what I can tell.  Even after grep-ing around
+ * I'm not sure what this is for.
+ *
+ * @TODO: Document the purpose of this.
+ *
+ * @private
+ * @param player the object the property is being set on
+ * @param pname the property name, with leading / already trimmed
+ */
+static void
+set_listener_flag(dbref player, const char *pname)
+{
+    if ((!(FLAGS(player) & LISTENER)) &&
+        (string_prefix(pname, LISTEN_PROPQUEUE) ||
+         string_prefix(pname, WLISTEN_PROPQUEUE) ||
+         string_prefix(pname, WOLISTEN_PROPQUEUE))) {
+        FLAGS(player) |= LISTENER;
+    }
+}
+
+/**
+ * Load a property node with the data in 'dat', freeing any old value first.
+ *
+ * This is the shared guts of set_property_nofetch and set_property_batch.
+ * The node's flags are set from dat->flags; see set_property_nofetch for
+ * the details of how each type is handled, including the rule that locks
+ * are NOT copied and become owned by the property.
+ *
+ * If the value is considered empty ("" for string, 0 for int, 0.0 for
+ * float, NOTHING for a ref, or a PROP_DIRTYP) the node is turned into a
+ * plain propdir node.  It is up to the caller to delete the node when this
+ * returns true, as only the caller knows where the node lives.
+ *
+ * @private
+ * @param p the property node to load
+ * @param dat the data to load into the node
+ * @return boolean true if the node is now empty and should be removed
+ */
+static int
+set_propnode_data(PropPtr p, PData * dat)
+{
+    /* free up any old values, just in case this is an existing property */
+    clear_propnode(p);
+
+    SetPFlagsRaw(p, dat->flags);
+
+    if (PropFlags(p) & PROP_ISUNLOADED) {
+        /* If the prop is unloaded, we want to just copy the data over
+         * raw -- this ensures the position in the diskbase is preserved and
+         * no further action is required.
+         */
+        SetPDataUnion(p, dat->data);
+        return 0;
+    }
+
+    /* Since we're not dealing with an unloaded prop, we need to set
+     * the property data in the data union based on type.
+     */
+    switch (PropType(p)) {
+        case PROP_STRTYP:
+            /* If you try to set an empty string property value, we will
+             * instead delete the prop unless it is a propdir.
+             */
+            if (!dat->data.str || !*(dat->data.str)) {
+                SetPType(p, PROP_DIRTYP);
+                SetPDataStr(p, NULL);
+                return !PropDir(p);
+            }
+
+            SetPDataStr(p, alloc_string(dat->data.str));
+            break;
+        case PROP_INTTYP:
+            SetPDataVal(p, dat->data.val);
+
+            if (!dat->data.val) {
+                SetPType(p, PROP_DIRTYP);
+                return !PropDir(p);
+            }
+
+            break;
+        case PROP_FLTTYP:
+            SetPDataFVal(p, dat->data.fval);
+
+            if (dat->data.fval == 0.0) {
+                SetPType(p, PROP_DIRTYP);
+                return !PropDir(p);
+            }
+
+            break;
+        case PROP_REFTYP:
+            SetPDataRef(p, dat->data.ref);
+
+            if (dat->data.ref == NOTHING) {
+                SetPType(p, PROP_DIRTYP);
+                SetPDataRef(p, 0);
+                return !PropDir(p);
+            }
+
+            break;
+        case PROP_LOKTYP:
+            SetPDataLok(p, dat->data.lok);
+            break;
+        case PROP_DIRTYP:
+            SetPDataVal(p, 0);
+            return !PropDir(p);
+    }
+
+    return 0;
+}
+
+/**
+ * Add 'delta' bytes to the cached size of every propdir above a property.
+ *
+ * The property itself is left alone, as its own propdir did not change.
+ *
+ * @private
+ * @param root the tree the property name is relative to
+ * @param pname the property name (will be modified)
+ * @param delta the change in size, in bytes
+ */
+static void
+propdir_resize_parents(PropPtr root, char *pname, long delta)
+{
+    char *n;
+
+    if ((n = strchr(pname, PROP_DELIMITER)))
+        *n = '\0';
+
+    n = pname + strlen(pname);
+
+    while (n > pname && n[-1] == PROPDIR_DELIMITER)
+        *--n = '\0';
+
+    if ((n = strrchr(pname, PROPDIR_DELIMITER))) {
+        *n = '\0';
+        propdir_resize_elem(root, pname, delta);
+    }
+}
+
+/**
+ * Account for a property value that changed size.
+ *
+ * The change is applied to the object's running property total and to
+ * the cached size of every propdir above the property, which is what lets
+ * size_properties answer without walking the tree.  Nodes created or
+ * deleted along the way are accounted for by propdir_new_elem and
+ * propdir_delete_elem themselves.
+ *
+ * @private
+ * @param player the object the property is on
+ * @param pname the property name (will be modified)
+ * @param delta the change in size, in bytes
+ */
+static void
+propsize_adjust(dbref player, char *pname, long delta)
+{
+    if (!delta)
+        return;
+
+    DBFETCH(player)->propsize += delta;
+    propdir_resize_parents(DBFETCH(player)->properties, pname, delta);
+}
+
 /**
  * Set a property on an object (the 'player'), with name pname and
  * with property data 'dat'.  'sync' has to do with syncing gender
@@ -81,6 +250,9 @@ set_property_nofetch(dbref player, const char *pname, PData * dat)
     PropPtr p;
     char buf[BUFFER_LEN];
     char *n, *w;
+    size_t added = 0;
+    size_t oldsize;
+    int empty;
 
     /* Make sure that we are passed a valid property name */
     if (!pname)
@@ -90,20 +262,7 @@ set_property_nofetch(dbref player, const char *pname, PData * dat)
     while (*pname == PROPDIR_DELIMITER)
         pname++;
 
-    /* If it is a listen prop, mark the player as a listener.
-     *
-     * I don't know the exact purpose of this, 'LISTENER' is not
-     * well documented from what I can tell.  Even after grep-ing around
-     * I'm not sure what this is for.
-     *
-     * @TODO: Document the purpose of this.
-     */
-    if ((!(FLAGS(player) & LISTENER)) &&
-        (string_prefix(pname, LISTEN_PROPQUEUE) ||
-         string_prefix(pname, WLISTEN_PROPQUEUE) ||
-         string_prefix(pname, WOLISTEN_PROPQUEUE))) {
-        FLAGS(player) |= LISTENER;
-    }
+    set_listener_flag(player, pname);
 
     strcpyn(buf, sizeof(buf), pname);
     w =  buf;
@@ -122,90 +281,19 @@ set_property_nofetch(dbref player, const char *pname, PData * dat)
     /* Create a new element for our new property, or get an existing
      * property object if it already exists.
      */
-    p = propdir_new_elem(&(DBFETCH(player)->properties), w);
-
-    /* free up any old values, just in case this is an existing property */
-    clear_propnode(p);
-
-    SetPFlagsRaw(p, dat->flags);
-
-    if (PropFlags(p) & PROP_ISUNLOADED) {
-        /* If the prop is unloaded, we want to just copy the data over
-         * raw -- this ensures the position in the diskbase is preserved and
-         * no further action is required.
-         */
-        SetPDataUnion(p, dat->data);
-        return;
-    }
-
-    /* Since we're not dealing with an unloaded prop, we need to set
-     * the property data in the data union based on type.
-     */
-    switch (PropType(p)) {
-        case PROP_STRTYP:
-            /* If you try to set an empty string property value, we will
-             * instead delete the prop unless it is a propdir.
-             */
-            if (!dat->data.str || !*(dat->data.str)) {
-                SetPType(p, PROP_DIRTYP);
-                SetPDataStr(p, NULL);
-
-                if (!PropDir(p)) {
-                    remove_property_nofetch(player, pname);
-                }
-            } else {
-                SetPDataStr(p, alloc_string(dat->data.str));
-            }
-
-            break;
-        case PROP_INTTYP:
-            SetPDataVal(p, dat->data.val);
-
-            if (!dat->data.val) {
-                SetPType(p, PROP_DIRTYP);
-
-                if (!PropDir(p)) {
-                    remove_property_nofetch(player, pname);
-                }
-            }
-
-            break;
-        case PROP_FLTTYP:
-            SetPDataFVal(p, dat->data.fval);
-
-            if (dat->data.fval == 0.0) {
-                SetPType(p, PROP_DIRTYP);
-
-                if (!PropDir(p)) {
-                    remove_property_nofetch(player, pname);
-                }
-            }
-
-            break;
-        case PROP_REFTYP:
-            SetPDataRef(p, dat->data.ref);
-
-            if (dat->data.ref == NOTHING) {
-                SetPType(p, PROP_DIRTYP);
-                SetPDataRef(p, 0);
-
-                if (!PropDir(p)) {
-                    remove_property_nofetch(player, pname);
-                }
-            }
+    p = propdir_new_elem(&(DBFETCH(player)->properties), w, &added);
+    DBFETCH(player)->propsize += added;
 
-            break;
-        case PROP_LOKTYP:
-            SetPDataLok(p, dat->data.lok);
-            break;
-        case PROP_DIRTYP:
-            SetPDataVal(p, 0);
+    oldsize = size_propnode(p);
+    empty = set_propnode_data(p, dat);
 
-            if (!PropDir(p)) {
-                remove_property_nofetch(player, pname);
-            }
+    strcpyn(buf, sizeof(buf), pname);
+    propsize_adjust(player, buf, (long) size_propnode(p) - (long) oldsize);
 
-            break;
+    if (empty) {
+        remove_property_nofetch(player, pname);
+    } else {
+        journal_prop(player, pname);
     }
 }
 
@@ -424,14 +512,18 @@ remove_property_nofetch(dbref player, const char *pname)
     PropPtr l;
     char buf[BUFFER_LEN];
     char *w;
+    size_t freed = 0;
 
     strcpyn(buf, sizeof(buf), pname);
     w = buf;
 
     l = DBFETCH(player)->properties;
-    l = propdir_delete_elem(l, w);
+    l = propdir_delete_elem(l, w, &freed);
     DBFETCH(player)->properties = l;
+    DBFETCH(player)->propsize -= freed;
     DBDIRTY(player);
+
+    journal_remove(player, pname);
 }
 
 /**
@@ -467,22 +559,396 @@ remove_property(dbref player, const char *pname)
  *
  * @return a PropPtr object with the property, or NULL if not found.
  */
-PropPtr
-get_property(dbref player, const char *pname)
+PropPtr
+get_property(dbref player, const char *pname)
+{
+    PropPtr p;
+    char buf[BUFFER_LEN];
+    char *w;
+
+#ifdef DISKBASE
+    fetchprops(player, propdir_name(pname));
+#endif
+
+    strcpyn(buf, sizeof(buf), pname);
+    w =  buf;
+
+    p = propdir_get_elem(DBFETCH(player)->properties, w);
+    return (p);
+}
+
+/**
+ * Clean up a propdir name or a name relative to a propdir for use by the
+ * batch property calls.
+ *
+ * The name is copied into 'buf', leading / are trimmed off and the name is
+ * terminated at the first ':' (PROP_DELIMITER) the same way set_property
+ * does it.
+ *
+ * @private
+ * @param buf the buffer to copy the cleaned up name into
+ * @param buflen the size of buf
+ * @param name the name to clean up
+ * @return pointer to the cleaned up name inside buf; may be ""
+ */
+static char *
+batch_propname(char *buf, size_t buflen, const char *name)
+{
+    char *n;
+
+    while (*name == PROPDIR_DELIMITER)
+        name++;
+
+    strcpyn(buf, buflen, name);
+
+    if ((n = strchr(buf, PROP_DELIMITER)))
+        *n = '\0';
+
+    return buf;
+}
+
+/**
+ * Find the AVL tree that holds the immediate children of a propdir.
+ *
+ * An empty 'dir' refers to the root of the object's properties.  If
+ * 'create' is true, the propdir is created if it does not yet exist.
+ * This does not handle diskbase; the caller must have fetched the
+ * propdir already.
+ *
+ * The returned pointer refers to the tree root slot itself, so it can be
+ * handed to propdir_new_elem or assigned the result of propdir_delete_elem.
+ * It stays valid until the propdir node itself is deleted.
+ *
+ * @private
+ * @param player the object the propdir is on
+ * @param dir the cleaned up propdir name (see batch_propname)
+ * @param create boolean true to create the propdir if it is missing
+ * @return pointer to the propdir's child tree, or NULL if not found
+ */
+static PropPtr *
+batch_propdir_children(dbref player, const char *dir, int create)
+{
+    char buf[BUFFER_LEN];
+    PropPtr p;
+    size_t added = 0;
+
+    if (!*dir)
+        return &(DBFETCH(player)->properties);
+
+    strcpyn(buf, sizeof(buf), dir);
+
+    if (create) {
+        p = propdir_new_elem(&(DBFETCH(player)->properties), buf, &added);
+        DBFETCH(player)->propsize += added;
+    } else {
+        p = propdir_get_elem(DBFETCH(player)->properties, buf);
+    }
+
+    return p ? &PropDir(p) : NULL;
+}
+
+/**
+ * Account for a change in size made inside a propdir by one of the batch
+ * property calls.
+ *
+ * Changes below the propdir's own children have already been applied to
+ * the propdirs in between, so this only has to update the propdir itself,
+ * the propdirs above it and the object's running total.
+ *
+ * @private
+ * @param player the object the propdir is on
+ * @param dir the cleaned up propdir name (see batch_propname)
+ * @param delta the change in size, in bytes
+ */
+static void
+batch_propsize_adjust(dbref player, const char *dir, long delta)
+{
+    char buf[BUFFER_LEN];
+
+    if (!delta)
+        return;
+
+    DBFETCH(player)->propsize += delta;
+
+    strcpyn(buf, sizeof(buf), dir);
+    propdir_resize_elem(DBFETCH(player)->properties, buf, delta);
+}
+
+/**
+ * Remove a propdir left behind empty by one of the batch property calls.
+ *
+ * The propdir is only removed if it has no children and no value of its
+ * own, which is the same rule set_property uses for propdirs.
+ *
+ * @private
+ * @param player the object the propdir is on
+ * @param dir the cleaned up propdir name (see batch_propname)
+ */
+static void
+batch_propdir_prune(dbref player, const char *dir)
+{
+    PropPtr p;
+
+    if (!*dir)
+        return;
+
+    p = get_property(player, dir);
+
+    if (p && !PropDir(p) && PropType(p) == PROP_DIRTYP)
+        remove_property_nofetch(player, dir);
+}
+
+/**
+ * Record the properties changed by one of the batch property calls in
+ * the journal.
+ *
+ * @private
+ * @param player the object the properties are on
+ * @param dir the cleaned up propdir name (see batch_propname)
+ * @param names the property names relative to dir
+ * @param count the number of names
+ * @param removed boolean true if the properties were removed
+ */
+static void
+batch_journal(dbref player, const char *dir, const char **names, int count,
+              int removed)
+{
+    char buf[BUFFER_LEN];
+    char path[BUFFER_LEN];
+
+    for (int i = 0; i < count; i++) {
+        if (!*batch_propname(buf, sizeof(buf), names[i]))
+            continue;
+
+        if (*dir) {
+            snprintf(path, sizeof(path), "%s%c%s", dir, PROPDIR_DELIMITER, buf);
+        } else {
+            strcpyn(path, sizeof(path), buf);
+        }
+
+        if (removed) {
+            journal_remove(player, path);
+        } else {
+            journal_prop(player, path);
+        }
+    }
+}
+
+#ifdef DISKBASE
+/**
+ * Make sure everything the batch property calls will touch is loaded.
+ *
+ * The propdir itself is fetched once; names that reach into sub-propdirs
+ * need those sub-propdirs fetched as well.
+ *
+ * @private
+ * @param player the object the properties are on
+ * @param dir the cleaned up propdir name (see batch_propname)
+ * @param names the property names relative to dir
+ * @param count the number of names
+ */
+static void
+batch_fetchprops(dbref player, const char *dir, const char **names, int count)
+{
+    char buf[BUFFER_LEN];
+
+    snprintf(buf, sizeof(buf), "%c%s%c", PROPDIR_DELIMITER, dir,
+             PROPDIR_DELIMITER);
+    fetchprops(player, buf);
+
+    for (int i = 0; i < count; i++) {
+        if (strchr(names[i], PROPDIR_DELIMITER)) {
+            snprintf(buf, sizeof(buf), "%s%c%s", dir, PROPDIR_DELIMITER,
+                     names[i]);
+            fetchprops(player, propdir_name(buf));
+        }
+    }
+}
+#endif
+
+/**
+ * Get several properties from the same propdir in one call.
+ *
+ * This is the batched version of get_property.  The propdir is fetched
+ * from the diskbase and located once, after which each name only costs
+ * a descent of the propdir's own tree.  Names may contain further
+ * propdirs, in which case they are looked up relative to 'dir'.
+ *
+ * For each name, the corresponding slot in 'out' is set to the found
+ * property or NULL if it does not exist.  Property values are fetched
+ * from the diskbase so they are ready to use.
+ *
+ * @param player the object to look for the properties on
+ * @param dir the propdir to look in; "" or "/" for the root
+ * @param names the property names relative to dir
+ * @param count the number of names
+ * @param out array of at least 'count' PropPtrs to store results in
+ */
+void
+get_property_batch(dbref player, const char *dir, const char **names,
+                   int count, PropPtr * out)
+{
+    char dirbuf[BUFFER_LEN];
+    char buf[BUFFER_LEN];
+    PropPtr *list;
+
+    batch_propname(dirbuf, sizeof(dirbuf), dir);
+
+#ifdef DISKBASE
+    batch_fetchprops(player, dirbuf, names, count);
+#endif
+
+    list = batch_propdir_children(player, dirbuf, 0);
+
+    for (int i = 0; i < count; i++) {
+        if (!list) {
+            out[i] = NULL;
+            continue;
+        }
+
+        strcpyn(buf, sizeof(buf), names[i]);
+        out[i] = propdir_get_elem(*list, buf);
+
+#ifdef DISKBASE
+        propfetch(player, out[i]);
+#endif
+    }
+}
+
+/**
+ * Set several properties in the same propdir in one call.
+ *
+ * This is the batched version of set_property, and 'dats' follows exactly
+ * the same rules as the 'dat' parameter there -- including the rule that
+ * locks are NOT copied and become owned by the property, and that setting
+ * an empty value removes the property.
+ *
+ * The propdir is fetched, located and created (if needed) once.  The
+ * object's diskbase dirty state and DBDIRTY are updated once at the end
+ * rather than once per property.  Timestamps are left to the caller, so it
+ * can call ts_modifyobject once for the whole batch.
+ *
+ * @param player the object to set the properties on
+ * @param dir the propdir to set the properties in; "" or "/" for the root
+ * @param names the property names relative to dir
+ * @param dats the property data for each name
+ * @param count the number of properties to set
+ */
+void
+set_property_batch(dbref player, const char *dir, const char **names,
+                   PData * dats, int count)
+{
+    char dirbuf[BUFFER_LEN];
+    char buf[BUFFER_LEN];
+    PropPtr *list;
+    PropPtr p;
+    size_t bytes, oldsize;
+    long delta = 0, valdelta;
+    int empty;
+
+    batch_propname(dirbuf, sizeof(dirbuf), dir);
+
+#ifdef DISKBASE
+    batch_fetchprops(player, dirbuf, names, count);
+#endif
+
+    /* Listener props are only found at the top level, and none of the
+     * listener prefixes contain a delimiter, so checking the propdir once
+     * gives the same answer as checking each full path.
+     */
+    if (*dirbuf) {
+        set_listener_flag(player, dirbuf);
+    }
+
+    list = batch_propdir_children(player, dirbuf, 1);
+
+    for (int i = 0; list && i < count; i++) {
+        if (!*batch_propname(buf, sizeof(buf), names[i]))
+            continue;
+
+        if (!*dirbuf) {
+            set_listener_flag(player, buf);
+        }
+
+        bytes = 0;
+
+        if (!(p = propdir_new_elem(list, buf, &bytes)))
+            continue;
+
+        oldsize = size_propnode(p);
+        empty = set_propnode_data(p, &dats[i]);
+        valdelta = (long) size_propnode(p) - (long) oldsize;
+        delta += (long) bytes + valdelta;
+
+        if (valdelta) {
+            batch_propname(buf, sizeof(buf), names[i]);
+            propdir_resize_parents(*list, buf, valdelta);
+        }
+
+        if (empty) {
+            bytes = 0;
+            batch_propname(buf, sizeof(buf), names[i]);
+            *list = propdir_delete_elem(*list, buf, &bytes);
+            delta -= (long) bytes;
+        }
+    }
+
+    batch_propsize_adjust(player, dirbuf, delta);
+    batch_propdir_prune(player, dirbuf);
+
+#ifdef DISKBASE
+    dirtyprops(player);
+#endif
+
+    DBDIRTY(player);
+    batch_journal(player, dirbuf, names, count, 0);
+}
+
+/**
+ * Remove several properties from the same propdir in one call.
+ *
+ * This is the batched version of remove_property.  As with that call,
+ * removing a propdir removes everything in it.  The propdir is fetched
+ * and located once and is itself removed if it is left empty.  The dirty
+ * state is updated once at the end; timestamps are left to the caller.
+ *
+ * @param player the object to remove the properties from
+ * @param dir the propdir the properties are in; "" or "/" for the root
+ * @param names the property names relative to dir
+ * @param count the number of properties to remove
+ */
+void
+remove_property_batch(dbref player, const char *dir, const char **names,
+                      int count)
 {
-    PropPtr p;
+    char dirbuf[BUFFER_LEN];
     char buf[BUFFER_LEN];
-    char *w;
+    PropPtr *list;
+    size_t freed = 0;
+
+    batch_propname(dirbuf, sizeof(dirbuf), dir);
 
 #ifdef DISKBASE
-    fetchprops(player, propdir_name(pname));
+    batch_fetchprops(player, dirbuf, names, count);
 #endif
 
-    strcpyn(buf, sizeof(buf), pname);
-    w =  buf;
+    if (!(list = batch_propdir_children(player, dirbuf, 0)))
+        return;
 
-    p = propdir_get_elem(DBFETCH(player)->properties, w);
-    return (p);
+    for (int i = 0; i < count && *list; i++) {
+        strcpyn(buf, sizeof(buf), names[i]);
+        *list = propdir_delete_elem(*list, buf, &freed);
+    }
+
+    batch_propsize_adjust(player, dirbuf, -(long) freed);
+    batch_propdir_prune(player, dirbuf);
+
+#ifdef DISKBASE
+    dirtyprops(player);
+#endif
+
+    DBDIRTY(player);
+    batch_journal(player, dirbuf, names, count, 1);
 }
 
 /**
@@ -851,6 +1317,8 @@ clear_property_flags(dbref player, const char *pname, int flags)
 #ifdef DISKBASE
         dirtyprops(player);
 #endif
+        DBDIRTY(player);
+        journal_prop(player, pname);
     }
 }
 
@@ -876,6 +1344,8 @@ set_property_flags(dbref player, const char *pname, int flags)
 #ifdef DISKBASE
         dirtyprops(player);
 #endif
+        DBDIRTY(player);
+        journal_prop(player, pname);
     }
 }
 
@@ -884,6 +1354,9 @@ set_property_flags(dbref player, const char *pname, int flags)
  * It is used, for example, by \@clone and COPYOBJ to copy all the
  * properties on an object. Always copies "system" properties.
  *
+ * The cached propdir sizes of the copy are not set up; the caller should
+ * use resize_proplist once the copy has been attached to its new object.
+ *
  * @param old DBREF of original object.
  * @param copy_hidden_props if true, this copies hidden properties
  * @return a struct plist that is a copy of all properties on 'old'.
@@ -926,6 +1399,8 @@ copy_properties_onto(dbref from, dbref to)
     from_props = DBFETCH(from)->properties;
 
     copy_proplist(from, &DBFETCH(to)->properties, from_props, 1);
+    DBFETCH(to)->propsize = resize_proplist(DBFETCH(to)->properties);
+    journal_props(to);
 }
 
 /**
@@ -1153,6 +1628,9 @@ next_prop_name(dbref player, char *outbuf, size_t outbuflen, char *name)
  * size; this will give an accurate depiction of the total size, though
  * load = 0 will tell you the size of what is currently loaded in memory.
  *
+ * The size is kept as a running total as properties are set and removed,
+ * so this does not walk the property tree.
+ *
  * @param player The object to check
  * @param load a boolean who's use is described above.
  *
@@ -1166,9 +1644,15 @@ size_properties(dbref player, int load)
         fetchprops(player, NULL);
         fetch_propvals(player, (char[]){PROPDIR_DELIMITER,0});
     }
+
+    /* Diskbase loads and unloads values behind our back */
+    if (DBFETCH(player)->propsstale) {
+        DBFETCH(player)->propsize = resize_proplist(DBFETCH(player)->properties);
+        DBFETCH(player)->propsstale = 0;
+    }
 #endif
 
-    return size_proplist(DBFETCH(player)->properties);
+    return DBFETCH(player)->propsize;
 }
 
 /**
@@ -1769,6 +2253,7 @@ db_dump_props_rec(dbref obj, FILE * f, const char *dir, PropPtr p)
             clear_propnode(p);
             SetPFlagsRaw(p, flg);
             SetPDataVal(p, tpos);
+            DBFETCH(obj)->propsstale = 1;
         }
     }
 #endif
@@ -1877,6 +2362,452 @@ untouchprops_incremental(int limit)
 }
 
 
+/**
+ * One ref in a parsed reflist.
+ *
+ * The offsets allow the ref to be cut out of the string it came from
+ * without having to scan the string again.
+ */
+struct reflist_item {
+    dbref ref;      /**< The ref */
+    int pos;        /**< Position in the list, with the first ref being 1 */
+    size_t start;   /**< Offset of the ref's NUMBER_TOKEN in the string */
+    size_t end;     /**< Offset just past the ref in the string */
+};
+
+/**
+ * A parsed reflist.
+ *
+ * Reflists are parsed once into an array of refs sorted by ref (and then
+ * by position), which can be binary searched.  The index is kept in a
+ * small cache keyed by property node.  reflist_add and reflist_del update
+ * it in place along with the string they write; any other change to the
+ * node's value, or freeing the node, drops it through reflist_forget.
+ */
+struct reflist_index {
+    PropPtr prop;                   /**< The property that was parsed */
+    const char *str;                /**< The string value that was parsed */
+    int count;                      /**< Number of refs in 'items' */
+    int size;                       /**< Number of refs 'items' has room for */
+    int positions;                  /**< Number of positions in the list */
+    unsigned long used;             /**< When the index was last used */
+    struct reflist_item *items;     /**< Refs, sorted by ref then position */
+};
+
+/**
+ * The number of indexes a property node can be cached in.
+ */
+#define REFLIST_CACHE_WAYS 2
+
+/**
+ * The reflist index cache.  A property node can be in either of the
+ * REFLIST_CACHE_WAYS entries of its set; the one used least recently is
+ * replaced when neither holds it.
+ */
+static struct reflist_index reflist_cache[REFLIST_CACHE_ITEMS];
+
+/**
+ * Counts reflist index uses, for finding the one used least recently.
+ */
+static unsigned long reflist_clock = 0;
+
+/**
+ * Find the reflist cache set for a given property node.
+ *
+ * @private
+ * @param p the property node
+ * @return the first of the REFLIST_CACHE_WAYS entries that node may use
+ */
+static struct reflist_index *
+reflist_cache_set(PropPtr p)
+{
+    uintptr_t h = (uintptr_t) p;
+
+    h ^= h >> 12;
+    return &reflist_cache[((h >> 4) % (REFLIST_CACHE_ITEMS / REFLIST_CACHE_WAYS))
+                          * REFLIST_CACHE_WAYS];
+}
+
+/**
+ * Find the cached reflist index for a given property node.
+ *
+ * @private
+ * @param p the property node
+ * @return the index, or NULL if the node has none cached
+ */
+static struct reflist_index *
+reflist_cache_find(PropPtr p)
+{
+    struct reflist_index *set = reflist_cache_set(p);
+
+    for (int i = 0; i < REFLIST_CACHE_WAYS; i++) {
+        if (set[i].prop == p)
+            return &set[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Empty out a reflist cache entry.
+ *
+ * @private
+ * @param idx the cache entry
+ */
+static void
+reflist_index_clear(struct reflist_index *idx)
+{
+    free(idx->items);
+    memset(idx, 0, sizeof(struct reflist_index));
+}
+
+/**
+ * Get an empty reflist cache entry for a given property node.
+ *
+ * The entry of the node's set used least recently is emptied for it.
+ *
+ * @private
+ * @param p the property node
+ * @return the empty cache entry
+ */
+static struct reflist_index *
+reflist_cache_claim(PropPtr p)
+{
+    struct reflist_index *set = reflist_cache_set(p);
+    struct reflist_index *idx = set;
+
+    for (int i = 1; i < REFLIST_CACHE_WAYS; i++) {
+        if (set[i].used < idx->used)
+            idx = &set[i];
+    }
+
+    reflist_index_clear(idx);
+    return idx;
+}
+
+/**
+ * Drop the cached reflist index for a property node, if there is one.
+ *
+ * This must be called whenever a property's value is changed or freed.
+ * clear_propnode and free_propnode take care of this.
+ *
+ * @param p the property node that is changing
+ */
+void
+reflist_forget(PropPtr p)
+{
+    struct reflist_index *idx = reflist_cache_find(p);
+
+    if (idx)
+        reflist_index_clear(idx);
+}
+
+/**
+ * qsort comparator for reflist items: by ref, then by position.
+ *
+ * @private
+ * @param a the first reflist_item
+ * @param b the second reflist_item
+ * @return less than, equal to or greater than zero, as per qsort
+ */
+static int
+reflist_item_compare(const void *a, const void *b)
+{
+    const struct reflist_item *x = a;
+    const struct reflist_item *y = b;
+
+    if (x->ref != y->ref)
+        return (x->ref < y->ref) ? -1 : 1;
+
+    return x->pos - y->pos;
+}
+
+/**
+ * Get the parsed index for a reflist string property, building it if it
+ * is not already cached.
+ *
+ * Each NUMBER_TOKEN in the string starts a new position.  A ref only
+ * matches if it is written exactly as "#%d" would write it and is
+ * followed by a space or the end of the string, which is what the reflist
+ * calls have always accepted.  Anything else still takes up a position
+ * but can never be found.
+ *
+ * @private
+ * @param ptr the string property holding the reflist
+ * @return the index, or NULL if out of memory
+ */
+static struct reflist_index *
+reflist_index_get(PropPtr ptr)
+{
+    struct reflist_index *idx = reflist_cache_find(ptr);
+    const char *list = PropDataStr(ptr);
+    const char *temp;
+    char buf[BUFFER_LEN];
+    int count = 0;
+    int pos = 0;
+
+    if (idx && idx->str == list) {
+        idx->used = ++reflist_clock;
+        return idx;
+    }
+
+    if (idx)
+        reflist_index_clear(idx);
+    else
+        idx = reflist_cache_claim(ptr);
+
+    for (temp = list; *temp; temp++) {
+        if (*temp == NUMBER_TOKEN)
+            count++;
+    }
+
+    if (count && !(idx->items = malloc(sizeof(struct reflist_item) * (size_t)count)))
+        return NULL;
+
+    idx->size = count;
+    count = 0;
+
+    for (temp = list; *temp;) {
+        const char *end;
+        size_t len;
+
+        if (*temp++ != NUMBER_TOKEN)
+            continue;
+
+        pos++;
+
+        for (end = temp; *end && *end != ' ' && *end != NUMBER_TOKEN; end++) ;
+
+        len = (size_t)(end - temp);
+
+        if (*end != NUMBER_TOKEN && len && len < 12) {
+            dbref ref = (dbref) strtol(temp, NULL, 10);
+
+            snprintf(buf, sizeof(buf), "%d", ref);
+
+            if (strlen(buf) == len && !strncmp(buf, temp, len)) {
+                idx->items[count].ref = ref;
+                idx->items[count].pos = pos;
+                idx->items[count].start = (size_t)(temp - list) - 1;
+                idx->items[count].end = (size_t)(end - list);
+                count++;
+            }
+        }
+
+        temp = end;
+    }
+
+    if (count) {
+        qsort(idx->items, (size_t)count, sizeof(struct reflist_item),
+              reflist_item_compare);
+    }
+
+    idx->prop = ptr;
+    idx->str = list;
+    idx->count = count;
+    idx->positions = pos;
+    idx->used = ++reflist_clock;
+    return idx;
+}
+
+/**
+ * Find the first occurrence of a ref in a parsed reflist.
+ *
+ * @private
+ * @param idx the parsed reflist
+ * @param ref the ref to find
+ * @return the item for the ref's first position, or NULL if not found
+ */
+static struct reflist_item *
+reflist_index_find(struct reflist_index *idx, dbref ref)
+{
+    int top = 0;
+    int bottom = idx->count;
+
+    /* Find the lowest item that is not less than ref */
+    while (top < bottom) {
+        int middle = top + (bottom - top) / 2;
+
+        if (idx->items[middle].ref < ref)
+            top = middle + 1;
+        else
+            bottom = middle;
+    }
+
+    if (top < idx->count && idx->items[top].ref == ref)
+        return &idx->items[top];
+
+    return NULL;
+}
+
+/**
+ * Take a reflist index out of the cache, so that it survives the
+ * property being set.
+ *
+ * @see reflist_index_attach
+ *
+ * @private
+ * @param idx the cached index
+ * @param out the index is moved here
+ */
+static void
+reflist_index_detach(struct reflist_index *idx, struct reflist_index *out)
+{
+    *out = *idx;
+    memset(idx, 0, sizeof(struct reflist_index));
+}
+
+/**
+ * Put a detached reflist index back in the cache for a property that was
+ * just set.
+ *
+ * If the index is not valid, or the property is gone or is no longer a
+ * string, the index is freed instead.
+ *
+ * @private
+ * @param obj the object the property is on
+ * @param propname the property name
+ * @param keep the detached index, updated to match the new value
+ * @param valid boolean false if keep could not be updated
+ */
+static void
+reflist_index_attach(dbref obj, const char *propname,
+                     struct reflist_index *keep, int valid)
+{
+    PropPtr ptr = valid ? get_property(obj, propname) : NULL;
+    struct reflist_index *idx;
+
+    if (!ptr || PropType(ptr) != PROP_STRTYP) {
+        free(keep->items);
+        return;
+    }
+
+    if (!(idx = reflist_cache_find(ptr)))
+        idx = reflist_cache_claim(ptr);
+    else
+        reflist_index_clear(idx);
+
+    *idx = *keep;
+    idx->prop = ptr;
+    idx->str = PropDataStr(ptr);
+    idx->used = ++reflist_clock;
+}
+
+/**
+ * Update a reflist index for one of its refs being cut out by reflist_cut.
+ *
+ * Refs after it move back in the string and down a position.  This can
+ * only be done when the character cut along with the ref is a space, or
+ * the ref is at the start; otherwise taking it out could join what is on
+ * either side into a different ref.
+ *
+ * @private
+ * @param idx the index, which must be detached
+ * @param list the string the index was made from
+ * @param n the number of the item being cut in idx->items
+ * @return boolean false if the index could not be updated
+ */
+static int
+reflist_index_cut(struct reflist_index *idx, const char *list, int n)
+{
+    size_t start = idx->items[n].start ? idx->items[n].start - 1 : 0;
+    size_t len = idx->items[n].end - start;
+    int pos = idx->items[n].pos;
+
+    if (idx->items[n].start && list[start] != ' ')
+        return 0;
+
+    idx->count--;
+    memmove(&idx->items[n], &idx->items[n + 1],
+            sizeof(struct reflist_item) * (size_t)(idx->count - n));
+
+    for (int i = 0; i < idx->count; i++) {
+        if (idx->items[i].start > start) {
+            idx->items[i].start -= len;
+            idx->items[i].end -= len;
+        }
+
+        if (idx->items[i].pos > pos)
+            idx->items[i].pos--;
+    }
+
+    idx->positions--;
+    return 1;
+}
+
+/**
+ * Update a reflist index for a ref being appended to the end of the list.
+ *
+ * @private
+ * @param idx the index, which must be detached
+ * @param ref the ref appended
+ * @param start the offset of the ref's NUMBER_TOKEN in the new string
+ * @param len the length of the ref, NUMBER_TOKEN included
+ * @return boolean false if out of memory
+ */
+static int
+reflist_index_append(struct reflist_index *idx, dbref ref, size_t start,
+                     size_t len)
+{
+    struct reflist_item *items = idx->items;
+    int top = 0;
+    int bottom = idx->count;
+
+    if (idx->count == idx->size) {
+        int size = idx->size ? idx->size * 2 : 4;
+
+        if (!(items = realloc(items, sizeof(struct reflist_item) * (size_t)size)))
+            return 0;
+
+        idx->items = items;
+        idx->size = size;
+    }
+
+    /* It has the last position, so it goes after every item not past ref */
+    while (top < bottom) {
+        int middle = top + (bottom - top) / 2;
+
+        if (items[middle].ref <= ref)
+            top = middle + 1;
+        else
+            bottom = middle;
+    }
+
+    memmove(&items[top + 1], &items[top],
+            sizeof(struct reflist_item) * (size_t)(idx->count - top));
+    items[top].ref = ref;
+    items[top].pos = ++idx->positions;
+    items[top].start = start;
+    items[top].end = start + len;
+    idx->count++;
+    return 1;
+}
+
+/**
+ * Copy a reflist into a buffer with one ref cut out of it.
+ *
+ * The character just before the ref (normally the space separating it
+ * from the previous ref) is dropped along with it.
+ *
+ * @private
+ * @param list the reflist string
+ * @param item the ref to cut out
+ * @param outbuf the buffer to write to
+ * @param outbuflen the size of outbuf
+ */
+static void
+reflist_cut(const char *list, struct reflist_item *item, char *outbuf,
+            size_t outbuflen)
+{
+    *outbuf = '\0';
+
+    if (item->start > 0) {
+        strcpyn(outbuf, MIN(item->start, outbuflen), list);
+    }
+
+    strcatn(outbuf, outbuflen, list + item->end);
+}
+
 /**
  * A reflist is a space-delimited set of DBREFs in a string, each
  * ref starting with a hash mark, such as:
@@ -1893,6 +2824,10 @@ untouchprops_incremental(int limit)
  * the end of the reflist.  This method does not allow refs to be
  * duplicate.
  *
+ * Reflists are parsed into a cached, sorted index, so checking if the
+ * ref is already on the list does not rescan the string.  The index is
+ * updated along with the new string rather than parsed again.
+ *
  * @param obj The object to operate on
  * @param propname the property name for our reflist
  * @param toadd the ref to add to the reflist
@@ -1903,10 +2838,13 @@ reflist_add(dbref obj, const char *propname, dbref toadd)
     PropPtr ptr;
     const char *temp;
     const char *list;
-    int count = 0;
-    size_t charcount = 0;
+    struct reflist_index *idx;
+    struct reflist_index keep;
+    struct reflist_item *item;
     char buf[BUFFER_LEN];
     char outbuf[BUFFER_LEN];
+    size_t len;
+    int valid;
 
     ptr = get_property(obj, propname);
 
@@ -1914,100 +2852,58 @@ reflist_add(dbref obj, const char *propname, dbref toadd)
      * Otherwise, things get a little more complex.
      */
     if (ptr) {
-        const char *pat = NULL;
-
 #ifdef DISKBASE
         propfetch(obj, ptr);
 #endif
         switch (PropType(ptr)) {
             /* If it is a string, it may already be a reflist. */
             case PROP_STRTYP:
-                *outbuf = '\0';
-                list = temp = PropDataStr(ptr);
-                snprintf(buf, sizeof(buf), "%d", toadd);
-
-                /* Iterate over the existing string
-                 *
-                 * I'll be honest, this logic makes my head hurt.  However,
-                 * what it is doing is checking to see if the ref is already
-                 * in the reflist by doing a 'tandem iteration' process.
-                 * I describe this a lot better in reflist_del.
-                 *
-                 * If the ref is already in the string, it is first *removed*
-                 * and then re-added onto the end.
-                 *
-                 * @TODO: This is a lot of copypasta code from reflist_del.
-                 * Perhaps instead of all the copypasta, we should reflist_del
-                 * before trying to add.  The performance difference would
-                 * be marginal but it would confine this nightmare to one
-                 * function.  Its also copypasta'd on reflist find ... so
-                 * this is in 3 places.  We can do better!
-                 */
-                while (*temp) {
-                    if (*temp == NUMBER_TOKEN) {
-                        pat = buf; /* buf contains our new ref */
-                        count++;
-                        charcount = (size_t)(temp - list);
-                    } else if (pat) {
-                        if (!*pat) {
-                            if (!*temp || *temp == ' ') {
-                                /* This seems to mean we found our ref,
-                                 * because we are at the end of pat (our
-                                 * new ref) *and* we're either at the
-                                 * end of the overall string or we've
-                                 * found a space.
-                                 */
-                                break;
-                            }
-
-                            pat = NULL;
-                        } else if (*pat != *temp) {
-                            /* This seems to mean if we did not find our
-                             * ref
-                             */
-                            pat = NULL;
-                        } else {
-                            /* 'buf' and the number we've found (at this
-                             * juncture) match.
-                             */
-                            pat++;
-                        }
-                    }
+                list = PropDataStr(ptr);
 
-                    temp++;
-                }
+                if (!(idx = reflist_index_get(ptr)))
+                    break;
 
-                if (pat && !*pat) {
-                    /* We found the number *and* we got to the end of
-                     * the number still matching -- so basically our
-                     * ref is already on the reflist.
+                if ((item = reflist_index_find(idx, toadd))) {
+                    /* Our ref is already on the reflist; take it out so
+                     * it can be put back on the end.
                      */
-
-                    if (charcount > 0) {
-                        /* Copy whatever was before the ref I think ? */
-                        strcpyn(outbuf, charcount, list);
-                    }
-
-                    /* Copy what is after the ref */
-                    strcatn(outbuf, sizeof(outbuf), temp);
+                    reflist_cut(list, item, outbuf, sizeof(outbuf));
                 } else {
-                    /* Just copy the whole reflist into our buffer because
-                     * we did not find our ref on the list.
-                     */
                     strcpyn(outbuf, sizeof(outbuf), list);
                 }
 
                 /* Set up our string for concatenation */
                 snprintf(buf, sizeof(buf), " #%d", toadd);
+                len = strlen(outbuf);
 
-                if (strlen(outbuf) + strlen(buf) < BUFFER_LEN) {
+                if (len + strlen(buf) < BUFFER_LEN) {
                     /* If we have room, do the string concat and then
-                     * clean out the white spaces.  Finally, set the prop.
+                     * clean out the white spaces.  Finally, set the prop,
+                     * keeping the index in step with it.  A list too long
+                     * for outbuf was cut short, so its index is dropped.
                      */
+                    reflist_index_detach(idx, &keep);
+                    valid = strlen(list) < BUFFER_LEN
+                            && (!item || reflist_index_cut(&keep, list,
+                                                           (int) (item - keep.items)));
+
                     strcatn(outbuf, sizeof(outbuf), buf);
                     temp = outbuf;
                     skip_whitespace(&temp);
+
+                    if (valid && temp != outbuf) {
+                        for (int i = 0; i < keep.count; i++) {
+                            keep.items[i].start -= (size_t) (temp - outbuf);
+                            keep.items[i].end -= (size_t) (temp - outbuf);
+                        }
+                    }
+
+                    valid = valid
+                            && reflist_index_append(&keep, toadd,
+                                                    len + 1 - (size_t) (temp - outbuf),
+                                                    strlen(buf) - 1);
                     add_property(obj, propname, temp, 0);
+                    reflist_index_attach(obj, propname, &keep, valid);
                 }
 
                 break;
@@ -2051,87 +2947,33 @@ void
 reflist_del(dbref obj, const char *propname, dbref todel)
 {
     PropPtr ptr;
-    const char *temp;
     const char *list;
-    int count = 0;
-    size_t charcount = 0;
-    char buf[BUFFER_LEN];
+    struct reflist_index *idx;
+    struct reflist_index keep;
+    struct reflist_item *item;
     char outbuf[BUFFER_LEN];
+    int valid;
 
     ptr = get_property(obj, propname);
     if (ptr) {
-        const char *pat = NULL;
-
 #ifdef DISKBASE
         propfetch(obj, ptr);
 #endif
         switch (PropType(ptr)) {
-            /* This is largely copy/pasted from reflist_add */
             case PROP_STRTYP:
-                *outbuf = '\0';
-                list = temp = PropDataStr(ptr);
-                snprintf(buf, sizeof(buf), "%d", todel);
-
-                /* Iterate over the property */
-                while (*temp) {
-                    if (*temp == NUMBER_TOKEN) {
-                        pat = buf; /* We found a number token -- let's see
-                                    * if it is the number we want.
-                                    *
-                                    * Remember 'buf' has our ref in string
-                                    * format.
-                                    */
-                        count++;
-                        charcount = (size_t)(temp - list);
-                    } else if (pat) {
-                        /* If 'pat' is not NULL, then we are iterating
-                         * over 'pat' and 'temp in tandem, comparing along
-                         * the way to see if the numbers match.
-                         */
-                        if (!*pat) {
-                            /* If we have reached the end of 'pat', and
-                             * we have either reached the end of temp
-                             * or we have reached a space, then we have
-                             * found our number.
-                             */
-                            if (!*temp || *temp == ' ') {
-                                break;
-                            }
-
-                            /* Otherwise, this isn't our number */
-                            pat = NULL;
-                        } else if (*pat != *temp) {
-                            /* Pat and temp are no longer in sync -- this
-                             * isn't our number.
-                             */
-                            pat = NULL;
-                        } else {
-                            /* Still in sync with temp -- step pat forward */
-                            pat++;
-                        }
-                    }
-
-                    temp++;
-                }
+                list = PropDataStr(ptr);
 
-                /* If pat is not NULL and we reached the end of pat, then
-                 * we have a number match.
-                 */
-                if (pat && !*pat) {
-                    if (charcount > 0) {
-                        /* Copy whatever was in the reflist before our
-                         * number to our output buffer, if applicable.
-                         */
-                        strcpyn(outbuf, charcount, list);
-                    }
+                if ((idx = reflist_index_get(ptr))
+                    && (item = reflist_index_find(idx, todel))) {
+                    reflist_cut(list, item, outbuf, sizeof(outbuf));
 
-                    /* Concatinate in whatever was after our number
-                     * in the reflist to our output buffer, clean up
-                     * whitespace, and set.
-                     */
-                    strcatn(outbuf, sizeof(outbuf), temp);
-                    skip_whitespace(&temp);
+                    /* Keep the index in step with the new value. */
+                    reflist_index_detach(idx, &keep);
+                    valid = strlen(list) < BUFFER_LEN
+                            && reflist_index_cut(&keep, list,
+                                                 (int) (item - keep.items));
                     add_property(obj, propname, outbuf, 0);
+                    reflist_index_attach(obj, propname, &keep, valid);
                 }
 
                 break;
@@ -2160,7 +3002,8 @@ reflist_del(dbref obj, const char *propname, dbref todel)
  * #123 is position 1, #345 is position 2, and #678 is position 3.
  *
  * This method is in support of the REFLIST_FIND primitive which is why
- * the odd return value.
+ * the odd return value.  The reflist's cached index is binary searched,
+ * so repeated finds on the same list do not rescan the string.
  *
  * @param obj The object to work on
  * @param propname The reflist property name
@@ -2173,70 +3016,20 @@ int
 reflist_find(dbref obj, const char *propname, dbref tofind)
 {
     PropPtr ptr;
-    const char *temp;
+    struct reflist_index *idx;
+    struct reflist_item *item;
     int pos = 0;
-    int count = 0;
-    char buf[BUFFER_LEN];
 
     ptr = get_property(obj, propname);
     if (ptr) {
-        const char *pat = NULL;
-
 #ifdef DISKBASE
         propfetch(obj, ptr);
 #endif
         switch (PropType(ptr)) {
-            /* This is copy/pasta'd in reflist_add and reflist_del */
             case PROP_STRTYP:
-                temp = PropDataStr(ptr);
-                snprintf(buf, sizeof(buf), "%d", tofind);
-
-                while (*temp) {
-                    if (*temp == NUMBER_TOKEN) {
-                        pat = buf; /* We found a number token -- let's see
-                                    * if it is the number we want.
-                                    *
-                                    * Remember 'buf' has our ref in string
-                                    * format.
-                                    */
-                        count++;
-                    } else if (pat) {
-                        /* If 'pat' is not NULL, then we are iterating
-                         * over 'pat' and 'temp in tandem, comparing along
-                         * the way to see if the numbers match.
-                         */
-                        if (!*pat) {
-                            /* If we have reached the end of 'pat', and
-                             * we have either reached the end of temp
-                             * or we have reached a space, then we have
-                             * found our number.
-                             */
-                            if (!*temp || *temp == ' ') {
-                                break;
-                            }
-
-                            /* Otherwise, this isn't our number */
-                            pat = NULL;
-                        } else if (*pat != *temp) {
-                            /* Pat and temp are no longer in sync -- this
-                             * isn't our number.
-                             */
-                            pat = NULL;
-                        } else {
-                            /* Still in sync with temp -- step pat forward */
-                            pat++;
-                        }
-                    }
-
-                    temp++;
-                }
-
-                /* If pat is not NULL and we reached the end of pat, then
-                 * we have a number match.
-                 */
-                if (pat && !*pat) {
-                    pos = count;
-                }
+                if ((idx = reflist_index_get(ptr))
+                    && (item = reflist_index_find(idx, tofind)))
+                    pos = item->pos;
 
                 break;
             case PROP_REFTYP:
@@ -230,6 +230,7 @@ alloc_propnode(const char *name)
     new_node->left = NULL;
     new_node->right = NULL;
     new_node->height = 1;
+    SetPDirSize(new_node, 0);
 
     strcpyn(PropName(new_node), nlen + 1, name);
     SetPFlagsRaw(new_node, PROP_DIRTYP);
@@ -248,6 +249,8 @@ alloc_propnode(const char *name)
 void
 free_propnode(PropPtr p)
 {
+    reflist_forget(p);
+
     if (!(PropFlags(p) & PROP_ISUNLOADED)) {
         if (PropType(p) == PROP_STRTYP)
             free(PropDataStr(p));
@@ -282,6 +285,8 @@ free_propnode(PropPtr p)
 void
 clear_propnode(PropPtr p)
 {
+    reflist_forget(p);
+
     if (!(PropFlags(p) & PROP_ISUNLOADED)) {
         if (PropType(p) == PROP_STRTYP) {
             free(PropDataStr(p));
@@ -635,47 +640,93 @@ copy_proplist(dbref obj, PropPtr * nu, PropPtr old, int copy_hidden_props)
 }
 
 /**
- * Calculates the size of the given property directory AVL list.  This
- * will iterate over the entire structure to give the entire size.  It
- * is the low level equivalent of size_properties
+ * Calculates the size of a single property node: the node itself, its
+ * name and its loaded value.  Anything in the node's propdir is not
+ * included.
  *
- * @see size_properties
- *
- * @param avl the Property directory AVL to check
- * @return the size of the loaded properties in memory -- this does NOT
- *         do any diskbase loading.
+ * @param p the property node to check
+ * @return the size of the node in memory
  */
 size_t
-size_proplist(PropPtr avl)
+size_propnode(PropPtr p)
 {
     size_t bytes = 0;
 
-    if (!avl)
-        return 0;
-
     bytes += sizeof(struct plist);
 
-    bytes += strlen(PropName(avl));
+    bytes += strlen(PropName(p));
 
-    if (!(PropFlags(avl) & PROP_ISUNLOADED)) {
-        switch (PropType(avl)) {
+    if (!(PropFlags(p) & PROP_ISUNLOADED)) {
+        switch (PropType(p)) {
             case PROP_STRTYP:
-                bytes += strlen(PropDataStr(avl)) + 1;
+                bytes += strlen(PropDataStr(p)) + 1;
                 break;
             case PROP_LOKTYP:
-                bytes += size_boolexp(PropDataLok(avl));
+                bytes += size_boolexp(PropDataLok(p));
                 break;
             default:
                 break;
         }
     }
 
+    return bytes;
+}
+
+/**
+ * Calculates the size of the given property directory AVL list.  This
+ * will iterate over the entire structure to give the entire size.  It
+ * is the low level equivalent of size_properties, and does not rely on
+ * the cached propdir sizes, so it can be used to check them.
+ *
+ * @see size_properties
+ *
+ * @param avl the Property directory AVL to check
+ * @return the size of the loaded properties in memory -- this does NOT
+ *         do any diskbase loading.
+ */
+size_t
+size_proplist(PropPtr avl)
+{
+    size_t bytes = 0;
+
+    if (!avl)
+        return 0;
+
+    bytes += size_propnode(avl);
     bytes += size_proplist(avl->left);
     bytes += size_proplist(avl->right);
     bytes += size_proplist(PropDir(avl));
     return bytes;
 }
 
+/**
+ * Recalculate the cached propdir sizes of a property AVL list.
+ *
+ * This walks the entire structure, setting the cached size of every
+ * propdir in it, and returns the total.  It is used after operations that
+ * build or rearrange a whole tree at once, such as copying properties.
+ *
+ * @see size_proplist
+ *
+ * @param avl the Property directory AVL to recalculate
+ * @return the size of the loaded properties in memory
+ */
+size_t
+resize_proplist(PropPtr avl)
+{
+    size_t bytes = 0;
+
+    if (!avl)
+        return 0;
+
+    SetPDirSize(avl, resize_proplist(PropDir(avl)));
+
+    bytes += size_propnode(avl) + PropDirSize(avl);
+    bytes += resize_proplist(avl->left);
+    bytes += resize_proplist(avl->right);
+    return bytes;
+}
+
 /**
  * Check each segment of the property path and see if 'what' is the first
  * character of the segment.
@@ -0,0 +1,451 @@
+/** @file sampler.c
+ *
+ * Implementation of the sampling profiler for MUF and MPI.  @see sampler.h
+ * for an overview.
+ *
+ * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
+ */
+
+#include "config.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/time.h>
+#endif
+
+#include "db.h"
+#include "fbstrings.h"
+#include "hashtab.h"
+#include "inst.h"
+#include "interp.h"
+#include "mpi.h"
+#include "sampler.h"
+#include "tune.h"
+
+#define SAMPLER_MAX_RATE    1000    /**< Most samples a second */
+#define SAMPLER_MAX_STACKS  10000   /**< Most distinct stacks to keep */
+
+#define SAMPLER_OTHER_STACK  "[other]"  /**< Stacks past the limit */
+#define SAMPLER_SERVER_STACK "[server]" /**< Samples outside MUF and MPI */
+
+/**
+ * @var sampler_due
+ *      set by the timer when a sample should be taken, and cleared when it
+ *      is recorded
+ */
+volatile sig_atomic_t sampler_due = 0;
+
+/**
+ * @private
+ * @var the stacks sampled, with their counts in ival
+ */
+static hash_tab sampled[SAMPLER_HASH_SIZE];
+
+static int sampled_stacks = 0;          /**< Distinct stacks sampled */
+static unsigned long sample_total = 0;  /**< Samples taken altogether */
+static int timer_rate = 0;              /**< Samples a second being taken */
+
+/**
+ * @private
+ * @var the MPI function being run at each level of nesting
+ */
+static struct {
+    dbref what;         /**< The object whose MPI it is */
+    const char *name;   /**< The function name */
+} mpi_frames[MPI_RECURSION_LIMIT + 1];
+
+static int mpi_depth = 0;   /**< The MPI nesting level now */
+
+static char stack_buf[BUFFER_LEN];  /**< The stack being built */
+static size_t stack_len;            /**< Its length */
+
+/**
+ * Add a frame to the stack being built
+ *
+ * Semicolons in the frame, which split frames, are changed to colons.  A
+ * frame that does not fit is left off, as are any after it.
+ *
+ * @private
+ * @param frame the frame to add
+ */
+static void
+stack_push(const char *frame)
+{
+    size_t len = strlen(frame);
+    char *p;
+
+    if (stack_len >= sizeof(stack_buf)
+        || stack_len + len + 2 > sizeof(stack_buf)) {
+        stack_len = sizeof(stack_buf);
+        return;
+    }
+
+    p = stack_buf + stack_len;
+
+    if (stack_len)
+        *p++ = ';';
+
+    for (; *frame; frame++)
+        *p++ = (*frame == ';') ? ':' : *frame;
+
+    *p = '\0';
+    stack_len = (size_t) (p - stack_buf);
+}
+
+/**
+ * Add the frames of the MPI functions being run to the stack being built
+ *
+ * A frame naming the object comes before the first function, and before
+ * any function run for a different object than the last.
+ *
+ * @private
+ * @param depth the MPI nesting level of the innermost function
+ */
+static void
+stack_push_mpi(int depth)
+{
+    char buf[BUFFER_LEN];
+    dbref last = NOTHING;
+
+    if (depth > MPI_RECURSION_LIMIT)
+        depth = MPI_RECURSION_LIMIT;
+
+    for (int i = 1; i <= depth; i++) {
+        if (!mpi_frames[i].name)
+            continue;
+
+        if (mpi_frames[i].what != last && ObjExists(mpi_frames[i].what)) {
+            last = mpi_frames[i].what;
+            snprintf(buf, sizeof(buf), "%s(#%d)", NAME(last), last);
+            stack_push(buf);
+        }
+
+        snprintf(buf, sizeof(buf), "{%s}", mpi_frames[i].name);
+        stack_push(buf);
+    }
+}
+
+/**
+ * Add the frame of the MUF word an instruction is in
+ *
+ * @private
+ * @param program the program the instruction is in
+ * @param pc the instruction
+ */
+static void
+stack_push_word(dbref program, struct inst *pc)
+{
+    char buf[BUFFER_LEN];
+    struct inst *code = PROGRAM_CODE(program);
+    const char *word = "???";
+
+    if (code && pc >= code && pc < code + PROGRAM_SIZ(program)) {
+        while (pc > code && pc->type != PROG_FUNCTION)
+            pc--;
+
+        if (pc->type == PROG_FUNCTION && pc->data.mufproc)
+            word = pc->data.mufproc->procname;
+    }
+
+    snprintf(buf, sizeof(buf), "%s(#%d) %s", NAME(program), program, word);
+    stack_push(buf);
+}
+
+/**
+ * Count a sample of the stack that was built
+ *
+ * @private
+ */
+static void
+stack_record(void)
+{
+    hash_data *count;
+    hash_data data;
+
+    sampler_due = 0;
+    sample_total++;
+
+    if (!stack_len)
+        return;
+
+    if ((count = find_hash(stack_buf, sampled, SAMPLER_HASH_SIZE))) {
+        count->ival++;
+        return;
+    }
+
+    if (sampled_stacks >= SAMPLER_MAX_STACKS) {
+        if ((count = find_hash(SAMPLER_OTHER_STACK, sampled,
+                               SAMPLER_HASH_SIZE))) {
+            count->ival++;
+            return;
+        }
+
+        strcpyn(stack_buf, sizeof(stack_buf), SAMPLER_OTHER_STACK);
+    }
+
+    data.ival = 1;
+
+    if (add_hash(stack_buf, data, sampled, SAMPLER_HASH_SIZE))
+        sampled_stacks++;
+}
+
+/**
+ * Note the MPI function being run at a level of MPI nesting
+ *
+ * The MPI parser calls this when it starts on a function's arguments, and
+ * again just before it runs the function, since the arguments may have
+ * run other functions more deeply nested.
+ *
+ * @param depth the MPI nesting level, starting at 1
+ * @param what the object whose MPI it is
+ * @param name the function name, which must stay valid
+ */
+void
+sampler_mpi_enter(int depth, dbref what, const char *name)
+{
+    if (depth < 1 || depth > MPI_RECURSION_LIMIT)
+        return;
+
+    mpi_frames[depth].what = what;
+    mpi_frames[depth].name = name;
+    mpi_depth = depth;
+}
+
+/**
+ * Note that MPI has gone back to a level of nesting
+ *
+ * @param depth the MPI nesting level now, or 0 if no MPI is running
+ */
+void
+sampler_mpi_leave(int depth)
+{
+    mpi_depth = depth;
+}
+
+/**
+ * Record a sample of the MPI functions being run
+ *
+ * This clears sampler_due.
+ *
+ * @param depth the MPI nesting level of the innermost function
+ */
+void
+sampler_mpi_sample(int depth)
+{
+    mpi_depth = depth;
+    stack_len = 0;
+    stack_push_mpi(depth);
+    stack_record();
+}
+
+/**
+ * Record a sample of a running MUF program
+ *
+ * Each word that is running is a frame, innermost last, followed by a
+ * frame for the line being run.  If the program was run by MPI, the MPI
+ * functions come first.  This clears sampler_due.
+ *
+ * @param sys the program's system stack
+ * @param stop the top of the system stack
+ * @param program the program being run
+ * @param pc the instruction about to be run
+ */
+void
+sampler_muf_sample(struct stack_addr *sys, int stop, dbref program,
+                   struct inst *pc)
+{
+    char buf[32];
+
+    stack_len = 0;
+    stack_push_mpi(mpi_depth);
+
+    /* Each return address is just past the call in the word that made it */
+    for (int i = 1; i < stop; i++)
+        stack_push_word(sys[i].progref, sys[i].offset - 1);
+
+    stack_push_word(program, pc);
+    snprintf(buf, sizeof(buf), "line %d", pc->line);
+    stack_push(buf);
+    stack_record();
+}
+
+/**
+ * Forget all the samples taken
+ */
+void
+sampler_reset(void)
+{
+    kill_hash(sampled, SAMPLER_HASH_SIZE, 0);
+    sampled_stacks = 0;
+    sample_total = 0;
+}
+
+/**
+ * Save the samples in the folded stack format
+ *
+ * Each stack goes on a line of its own, followed by a space and the
+ * number of times it was sampled, which is what flame graph tools read.
+ *
+ * @param filename the file to write
+ * @return the number of stacks saved, or -1 if the file couldn't be written
+ */
+int
+sampler_save(const char *filename)
+{
+    FILE *f;
+    int saved = 0;
+
+    if (!(f = fopen(filename, "wb")))
+        return -1;
+
+    for (int i = 0; i < SAMPLER_HASH_SIZE; i++) {
+        for (hash_entry *hp = sampled[i]; hp; hp = hp->next) {
+            fprintf(f, "%s %d\n", hp->name, hp->dat.ival);
+            saved++;
+        }
+    }
+
+    if (fclose(f))
+        return -1;
+
+    return saved;
+}
+
+/**
+ * Record a sample of the server when no MUF is running
+ *
+ * This is a sample of the MPI functions being run if there are any, or
+ * else of the "[server]" stack.  It clears sampler_due.
+ */
+void
+sampler_server(void)
+{
+    stack_len = 0;
+
+    if (mpi_depth)
+        stack_push_mpi(mpi_depth);
+    else
+        stack_push(SAMPLER_SERVER_STACK);
+
+    stack_record();
+}
+
+/**
+ * Sort sampled stacks busiest first
+ *
+ * @private
+ * @param a the first stack
+ * @param b the second stack
+ * @return less than, equal to, or greater than 0 as for qsort
+ */
+static int
+sampled_stack_cmp(const void *a, const void *b)
+{
+    int ca = ((const struct sampled_stack *) a)->count;
+    int cb = ((const struct sampled_stack *) b)->count;
+
+    return (ca < cb) - (ca > cb);
+}
+
+/**
+ * Get the most often sampled stacks
+ *
+ * The stacks are given busiest first.  They are only good until the next
+ * sample is taken or the samples are reset.
+ *
+ * @param list where to put the stacks
+ * @param count the most stacks to put in list
+ * @param total set to the number of samples taken altogether
+ * @return the number of stacks put in list
+ */
+int
+sampler_top(struct sampled_stack *list, int count, unsigned long *total)
+{
+    struct sampled_stack *sorted;
+    int used = 0;
+
+    *total = sample_total;
+
+    if (!sampled_stacks)
+        return 0;
+
+    if (!(sorted = malloc(sizeof(*sorted) * (size_t) sampled_stacks)))
+        return 0;
+
+    for (int i = 0; i < SAMPLER_HASH_SIZE; i++) {
+        for (hash_entry *hp = sampled[i]; hp && used < sampled_stacks;
+             hp = hp->next) {
+            sorted[used].stack = hp->name;
+            sorted[used++].count = hp->dat.ival;
+        }
+    }
+
+    qsort(sorted, (size_t) used, sizeof(*sorted), sampled_stack_cmp);
+
+    if (count > used)
+        count = used;
+
+    memcpy(list, sorted, sizeof(*list) * (size_t) count);
+    free(sorted);
+    return count;
+}
+
+#if !defined(WIN32) && defined(ITIMER_PROF)
+/**
+ * Ask for a sample when the profiling timer goes off
+ *
+ * @private
+ * @param i the signal number (ignored)
+ */
+static void
+sig_sample(int i)
+{
+    sampler_due = 1;
+}
+#endif
+
+/**
+ * Start, stop or change the sampling timer to match profile_sample_rate
+ *
+ * This is cheap when nothing changed, and is called each time around the
+ * main loop and before each MUF program runs, so that a change to the tune
+ * takes effect right away.
+ */
+void
+sampler_update(void)
+{
+    int rate = tp_profile_sample_rate;
+
+    if (rate < 0)
+        rate = 0;
+
+    if (rate > SAMPLER_MAX_RATE)
+        rate = SAMPLER_MAX_RATE;
+
+    if (rate == timer_rate)
+        return;
+
+#if !defined(WIN32) && defined(ITIMER_PROF)
+    {
+        struct itimerval timer;
+        long usec = rate ? 1000000L / rate : 0;
+
+        if (rate)
+            signal(SIGPROF, sig_sample);
+
+        timer.it_interval.tv_sec = usec / 1000000L;
+        timer.it_interval.tv_usec = usec % 1000000L;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, NULL);
+    }
+#endif
+
+    timer_rate = rate;
+
+    if (!rate)
+        sampler_due = 0;
+}
@@ -4,7 +4,9 @@
  * finding and correcting database issues.
  *
  * This relies on a number of statics/globals, so is very much not threadsafe.
- * Not that any of Fuzzball really is, but can't hurt to point it out.
+ * Not that any of Fuzzball really is, but can't hurt to point it out.  The
+ * exception is the read-only checking done by \@sanity, which splits the
+ * database between threads that each keep their own report.
  *
  * This file is part of Fuzzball MUCK.  Please see LICENSE.md for details.
  */
@@ -17,13 +19,34 @@
 
 #include "config.h"
 
+#if !defined(WIN32) && !defined(DISKBASE)
+/*
+ * Diskbase loads properties while measuring them and keeps its database
+ * file open, so it checks on a single thread and never forks.  crt_malloc
+ * keeps unlocked global statistics, so profiling builds check on a single
+ * thread as well.
+ */
+#define SANITY_FORKED
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifndef MALLOC_PROFILING
+#define SANITY_THREADED
+#include <pthread.h>
+#endif
+#endif
+
 #include "boolexp.h"
 #include "commands.h"
 #include "db.h"
+#include "dbindex.h"
 #ifdef DISKBASE
 #include "diskprop.h"
 #endif
+#include "fbsignal.h"
 #include "fbstrings.h"
+#include "game.h"
 #include "interface.h"
 #include "log.h"
 #include "match.h"
@@ -31,6 +54,14 @@
 #include "props.h"
 #include "tune.h"
 
+/*
+ * Don't bother starting a thread for fewer objects than this.  Small
+ * databases are checked faster than a thread starts.
+ */
+#ifndef SANITY_THREAD_MIN_OBJS
+#define SANITY_THREAD_MIN_OBJS 4096
+#endif
+
 /**
  * Shortcut wrapper for logging a single unparsed reference to
  * the sanity fixed log.
@@ -77,6 +108,38 @@
 /* Has system sanity been violated? */
 int sanity_violated = 0;
 
+/**
+ * @private
+ * A problem found by a sanity check
+ */
+struct san_violation {
+    dbref checking;     /**< The object being checked when it was found */
+    dbref obj;          /**< The object with the problem */
+    const char *msg;    /**< What is wrong with it */
+};
+
+/**
+ * @private
+ * The problems found in one range of objects
+ *
+ * Each worker fills in its own report, and they are printed afterwards in
+ * object order, so the output is the same however many workers there are.
+ */
+struct san_report {
+    dbref first;                    /**< The first object to check */
+    dbref last;                     /**< One past the last object to check */
+    dbref checking;                 /**< The object being checked */
+    struct san_violation *found;    /**< The problems, in the order found */
+    int count;                      /**< The number of problems */
+    int size;                       /**< The room allocated in 'found' */
+};
+
+#ifdef SANITY_FORKED
+/* The player waiting on a background check, and where its output goes */
+static dbref san_fork_player = NOTHING;
+static FILE *san_fork_out = NULL;
+#endif
+
 /**
  * Flushes whatever data is queued for the given player's descriptors
  * to the player.
@@ -271,6 +334,39 @@ do_examine_sanity(int descr, dbref player, const char *arg)
     SanPrint(player, "Done.");
 }
 
+/**
+ * Record a sanity violation in a report
+ *
+ * This only touches the report, so workers can call it at the same time.
+ * The violation is displayed later by print_violation.
+ *
+ * @see print_violation
+ *
+ * @private
+ * @param report the report to add the problem to
+ * @param i the object which is violating sanity
+ * @param s a message explaining the problem.  Empty string would make no sense
+ */
+static void
+violate(struct san_report *report, dbref i, const char *s)
+{
+    if (report->count >= report->size) {
+        report->size = report->size ? report->size * 2 : 16;
+        report->found = realloc(report->found,
+                                (size_t) report->size * sizeof(*report->found));
+
+        if (!report->found) {
+            fprintf(stderr, "violate(): Out of Memory!\n");
+            abort();
+        }
+    }
+
+    report->found[report->count].checking = report->checking;
+    report->found[report->count].obj = i;
+    report->found[report->count].msg = s;
+    report->count++;
+}
+
 /**
  * Display a message regarding a sanity violation and mark the sanity_violated
  * global.
@@ -282,15 +378,14 @@ do_examine_sanity(int descr, dbref player, const char *arg)
  *
  * @private
  * @param player the player to notify, NOTHING, or AMBIGUOUS -- see SanPrint
- * @param i the object which is violating sanity
- * @param s a message explaining the problem.  Empty string would make no sense
+ * @param v the violation to display
  */
 static void
-violate(dbref player, dbref i, const char *s)
+print_violation(dbref player, struct san_violation *v)
 {
     char unparse_buf[16384];
-    unparse_object(NOTHING, i, unparse_buf, sizeof(unparse_buf));
-    SanPrint(player, "Object \"%s\" %s!", unparse_buf, s);
+    unparse_object(NOTHING, v->obj, unparse_buf, sizeof(unparse_buf));
+    SanPrint(player, "Object \"%s\" %s!", unparse_buf, v->msg);
     sanity_violated = 1;
 }
 
@@ -301,17 +396,13 @@ violate(dbref player, dbref i, const char *s)
  * the linked list, and makes sure all objects on the linked list are
  * OkRef (valid objects).
  *
- * This uses SanPrint under the hood which provides a number of nuances
- * regarding what 'player' can be used.
- *
- * @see SanPrint
  *
  * @private
- * @param player the player to notify of errors, NOTHING, or AMBIGUOUS
+ * @param report the report to add any problems to
  * @param obj the object to check.
  */
 static void
-check_next_chain(dbref player, dbref obj)
+check_next_chain(struct san_report *report, dbref obj)
 {
     dbref orig;
 
@@ -319,7 +410,7 @@ check_next_chain(dbref player, dbref obj)
     while (obj != NOTHING && OkRef(obj)) {
         for (dbref i = orig; i != NOTHING; i = NEXTOBJ(i)) {
             if (i == NEXTOBJ(obj)) {
-                violate(player, obj,
+                violate(report, obj,
                     "has a 'next' field that forms an illegal loop in an object chain");
                 return;
             }
@@ -333,7 +424,7 @@ check_next_chain(dbref player, dbref obj)
     }
 
     if (!OkRef(obj)) {
-        violate(player, obj, "has an invalid object in its 'next' chain");
+        violate(report, obj, "has an invalid object in its 'next' chain");
     }
 }
 
@@ -348,73 +439,63 @@ check_next_chain(dbref player, dbref obj)
  * another object's linked lists with the exception of #0.
  *
  * This also checks to see if an object shows up in multiple different
- * linked lists.  If that happens, then we have a corrupt DB.  There
- * is a SANEBIT which is used by this process; this should get set exactly
- * once on each object in the DB.  If we detect we are trying to set this
- * bit twice, then we know it is showing up in multiple places.
+ * linked lists.  If that happens, then we have a corrupt DB.  Each object
+ * should be marked as referred to exactly once.  If we detect we are
+ * trying to mark it twice, then we know it is showing up in multiple places.
  *
- * Under the hood, this uses SanPrint which has some nuances about how
- * 'player' can be used.
- *
- * @see SanPrint
+ * The marks are kept apart from the objects, so this leaves the database
+ * untouched.
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  */
 static void
-find_orphan_objects(dbref player)
+find_orphan_objects(struct san_report *report)
 {
-    SanPrint(player, "Searching for orphan objects...");
+    dbref refs[3];
+    char *seen;
 
-    for (dbref i = 0; i < db_top; i++) {
-        FLAGS(i) &= ~SANEBIT;
+    if (!(seen = calloc((size_t) db_top + 1, 1))) {
+        fprintf(stderr, "find_orphan_objects(): Out of Memory!\n");
+        abort();
     }
 
-    if (recyclable != NOTHING) {
-        FLAGS(recyclable) |= SANEBIT;
+    if (ObjExists(recyclable)) {
+        seen[recyclable] = 1;
     }
 
-    FLAGS(GLOBAL_ENVIRONMENT) |= SANEBIT;
+    seen[GLOBAL_ENVIRONMENT] = 1;
 
     for (dbref i = 0; i < db_top; i++) {
-        if (EXITS(i) != NOTHING) {
-            if (FLAGS(EXITS(i)) & SANEBIT) {
-                violate(player, EXITS(i),
-                    "is referred to by more than one object's Next, Contents, or Exits field");
-            } else {
-                FLAGS(EXITS(i)) |= SANEBIT;
+        report->checking = i;
+        refs[0] = EXITS(i);
+        refs[1] = CONTENTS(i);
+        refs[2] = NEXTOBJ(i);
+
+        for (int k = 0; k < 3; k++) {
+            /* Invalid references are reported by the list checks. */
+            if (!ObjExists(refs[k])) {
+                continue;
             }
-        }
 
-        if (CONTENTS(i) != NOTHING) {
-            if (FLAGS(CONTENTS(i)) & SANEBIT) {
-                violate(player, CONTENTS(i),
+            if (seen[refs[k]]) {
+                violate(report, refs[k],
                     "is referred to by more than one object's Next, Contents, or Exits field");
             } else {
-                FLAGS(CONTENTS(i)) |= SANEBIT;
-            }
-        }
-
-        if (NEXTOBJ(i) != NOTHING) {
-            if (FLAGS(NEXTOBJ(i)) & SANEBIT) {
-                violate(player, NEXTOBJ(i),
-                    "is referred to by more than one object's Next, Contents, or Exits field");
-            } else {
-                FLAGS(NEXTOBJ(i)) |= SANEBIT;
+                seen[refs[k]] = 1;
             }
         }
     }
 
     for (dbref i = 0; i < db_top; i++) {
-        if (!(FLAGS(i) & SANEBIT)) {
-            violate(player, i,
+        if (!seen[i]) {
+            report->checking = i;
+            violate(report, i,
                 "appears to be an orphan object, that is not referred to by any other object");
         }
     }
 
-    for (dbref i = 0; i < db_top; i++) {
-        FLAGS(i) &= ~SANEBIT;
-    }
+    free(seen);
 }
 
 /**
@@ -423,26 +504,22 @@ find_orphan_objects(dbref player)
  * This checking is mostly around the room's "dropto" reference, which
  * must be either HOME or a valid ROOM or THING.
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_room(dbref player, dbref obj)
+check_room(struct san_report *report, dbref obj)
 {
     dbref i;
 
     i = DBFETCH(obj)->sp.room.dropto;
 
     if (!OkRef(i) && i != HOME) {
-        violate(player, obj, "has its dropto set to an invalid object");
+        violate(report, obj, "has its dropto set to an invalid object");
     } else if (i >= 0 && Typeof(i) != TYPE_THING && Typeof(i) != TYPE_ROOM) {
-        violate(player, obj, "has its dropto set to a non-room, non-thing object");
+        violate(report, obj, "has its dropto set to a non-room, non-thing object");
     }
 }
 
@@ -452,26 +529,22 @@ check_room(dbref player, dbref obj)
  * This checking is mostly around the room's "home" reference, which
  * must be a valid ROOM, THING, or PLAYER.
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_thing(dbref player, dbref obj)
+check_thing(struct san_report *report, dbref obj)
 {
     dbref i;
 
     i = THING_HOME(obj);
 
     if (!OkObj(i)) {
-        violate(player, obj, "has its home set to an invalid object");
+        violate(report, obj, "has its home set to an invalid object");
     } else if (Typeof(i) != TYPE_ROOM && Typeof(i) != TYPE_THING && Typeof(i) != TYPE_PLAYER) {
-        violate(player, obj,
+        violate(report, obj,
             "has its home set to an object that is not a room, thing, or player");
     }
 }
@@ -482,26 +555,22 @@ check_thing(dbref player, dbref obj)
  * This checks the exit's link count (must be 0 or more), and checks all
  * objects in its link list to make sure they are valid targets.
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_exit(dbref player, dbref obj)
+check_exit(struct san_report *report, dbref obj)
 {
     if (DBFETCH(obj)->sp.exit.ndest < 0)
-        violate(player, obj, "has a negative link count.");
+        violate(report, obj, "has a negative link count.");
 
     for (int i = 0; i < DBFETCH(obj)->sp.exit.ndest; i++) {
         if (!OkRef((DBFETCH(obj)->sp.exit.dest)[i]) &&
             (DBFETCH(obj)->sp.exit.dest)[i] != HOME &&
             (DBFETCH(obj)->sp.exit.dest)[i] != NIL) {
-            violate(player, obj, "has an invalid object as one of its link destinations");
+            violate(report, obj, "has an invalid object as one of its link destinations");
         }
     }
 }
@@ -511,26 +580,22 @@ check_exit(dbref player, dbref obj)
  *
  * This checks to be sure a player's home is a valid ROOM object.
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_player(dbref player, dbref obj)
+check_player(struct san_report *report, dbref obj)
 {
     dbref i;
 
     i = PLAYER_HOME(obj);
 
     if (!OkObj(i)) {
-        violate(player, obj, "has its home set to an invalid object");
+        violate(report, obj, "has its home set to an invalid object");
     } else if (i >= 0 && Typeof(i) != TYPE_ROOM) {
-        violate(player, obj, "has its home set to a non-room object");
+        violate(report, obj, "has its home set to a non-room object");
     }
 }
 
@@ -540,20 +605,16 @@ check_player(dbref player, dbref obj)
  * Garbage can only have other objects of type GARBAGE on its 'next' list.
  * This does a check to ensure this is true.
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_garbage(dbref player, dbref obj)
+check_garbage(struct san_report *report, dbref obj)
 {
     if (NEXTOBJ(obj) != NOTHING && Typeof(NEXTOBJ(obj)) != TYPE_GARBAGE) {
-        violate(player, obj,
+        violate(report, obj,
             "has a non-garbage object as the 'next' object in the garbage chain");
     }
 }
@@ -570,17 +631,13 @@ check_garbage(dbref player, dbref obj)
  * and finally makes sure the object on the contents list has the
  * proper location set.
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_contents_list(dbref player, dbref obj)
+check_contents_list(struct san_report *report, dbref obj)
 {
     dbref i;
     int limit;
@@ -593,20 +650,20 @@ check_contents_list(dbref player, dbref obj)
 
         if (i != NOTHING) {
             if (!limit) {
-                check_next_chain(player, CONTENTS(obj));
-                violate(player, obj,
+                check_next_chain(report, CONTENTS(obj));
+                violate(report, obj,
                     "is the containing object, and has a loop in its contents chain");
             } else {
                 if (!OkObj(i)) {
-                    violate(player, obj, "has an invalid object in its contents list");
+                    violate(report, obj, "has an invalid object in its contents list");
                 } else {
                     if (Typeof(i) == TYPE_EXIT) {
-                        violate(player, obj,
+                        violate(report, obj,
                             "has an exit in its contents list (it shouldn't)");
                     }
 
                     if (LOCATION(i) != obj) {
-                        violate(player, obj,
+                        violate(report, obj,
                             "has an object in its contents lists that thinks it is located elsewhere");
                     }
                 }
@@ -615,11 +672,11 @@ check_contents_list(dbref player, dbref obj)
     } else {
         if (CONTENTS(obj) != NOTHING) {
             if (Typeof(obj) == TYPE_EXIT) {
-                violate(player, obj, "is an exit/action whose contents aren't #-1");
+                violate(report, obj, "is an exit/action whose contents aren't #-1");
             } else if (Typeof(obj) == TYPE_GARBAGE) {
-                violate(player, obj, "is a garbage object whose contents aren't #-1");
+                violate(report, obj, "is a garbage object whose contents aren't #-1");
             } else {
-                violate(player, obj, "is a program whose contents aren't #-1");
+                violate(report, obj, "is a program whose contents aren't #-1");
             }
         }
     }
@@ -637,17 +694,13 @@ check_contents_list(dbref player, dbref obj)
  * and finally makes sure the exit on the contents list has the
  * proper location set.
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_exits_list(dbref player, dbref obj)
+check_exits_list(struct san_report *report, dbref obj)
 {
     dbref i;
     int limit;
@@ -660,18 +713,18 @@ check_exits_list(dbref player, dbref obj)
 
         if (i != NOTHING) {
             if (!limit) {
-                check_next_chain(player, CONTENTS(obj));
-                violate(player, obj,
+                check_next_chain(report, CONTENTS(obj));
+                violate(report, obj,
                     "is the containing object, and has the loop in its exits chain");
             } else if (!OkObj(i)) {
-                violate(player, obj, "has an invalid object in its exits list");
+                violate(report, obj, "has an invalid object in its exits list");
             } else {
                 if (Typeof(i) != TYPE_EXIT) {
-                    violate(player, obj, "has a non-exit in its exits list");
+                    violate(report, obj, "has a non-exit in its exits list");
                 }
 
                 if (LOCATION(i) != obj) {
-                    violate(player, obj,
+                    violate(report, obj,
                         "has an exit in its exits lists that thinks it is located elsewhere");
                 }
             }
@@ -679,11 +732,11 @@ check_exits_list(dbref player, dbref obj)
     } else {
         if (EXITS(obj) != NOTHING) {
             if (Typeof(obj) == TYPE_EXIT) {
-                violate(player, obj, "is an exit/action whose exits list isn't #-1");
+                violate(report, obj, "is an exit/action whose exits list isn't #-1");
             } else if (Typeof(obj) == TYPE_GARBAGE) {
-                violate(player, obj, "is a garbage object whose exits list isn't #-1");
+                violate(report, obj, "is a garbage object whose exits list isn't #-1");
             } else {
-                violate(player, obj, "is a program whose exits list isn't #-1");
+                violate(report, obj, "is a program whose exits list isn't #-1");
             }
         }
     }
@@ -698,6 +751,7 @@ check_exits_list(dbref player, dbref obj)
  * * If not garbage, does it have a valid owner and location?
  * * Makes sure the object isn't located in a garbage, exit, or program
  * * Garbage can only be located in #-1
+ * * The running property size matches a full count of the properties
  * * Runs check_contents list and check_exits_list
  * * Runs additional checks based on type
  *
@@ -709,32 +763,28 @@ check_exits_list(dbref player, dbref obj)
  * @see check_exit
  * @see check_garbage
  *
- * This uses SanPrint under the hood, which has some nuances around what
- * 'player' can be.
- *
- * @see SanPrint
  *
  * @private
- * @param player to notify of any problems, NOTHING, or AMBIGUOUS per SanPrint
+ * @param report the report to add any problems to
  * @param obj object to check -- it is assumed to be the correct type
  */
 static void
-check_object(dbref player, dbref obj)
+check_object(struct san_report *report, dbref obj)
 {
     /*
      * Do we have a name?
      */
     if (!NAME(obj))
-        violate(player, obj, "doesn't have a name");
+        violate(report, obj, "doesn't have a name");
 
     /*
      * Check the ownership
      */
     if (Typeof(obj) != TYPE_GARBAGE) {
         if (!OkObj(OWNER(obj))) {
-            violate(player, obj, "has an invalid object as its owner.");
+            violate(report, obj, "has an invalid object as its owner.");
         } else if (Typeof(OWNER(obj)) != TYPE_PLAYER) {
-            violate(player, obj, "has a non-player object as its owner.");
+            violate(report, obj, "has a non-player object as its owner.");
         }
 
         /* 
@@ -742,7 +792,7 @@ check_object(dbref player, dbref obj)
          */
         if (!OkObj(LOCATION(obj)) && !(obj == GLOBAL_ENVIRONMENT &&
             LOCATION(obj) == NOTHING)) {
-            violate(player, obj, "has an invalid object as its location");
+            violate(report, obj, "has an invalid object as its location");
         }
     }
 
@@ -750,38 +800,128 @@ check_object(dbref player, dbref obj)
         (Typeof(LOCATION(obj)) == TYPE_GARBAGE ||
          Typeof(LOCATION(obj)) == TYPE_EXIT ||
          Typeof(LOCATION(obj)) == TYPE_PROGRAM))
-        violate(player, obj, "thinks it is located in a non-container object");
+        violate(report, obj, "thinks it is located in a non-container object");
 
     if ((Typeof(obj) == TYPE_GARBAGE) && (LOCATION(obj) != NOTHING))
-        violate(player, obj, "is a garbage object with a location that isn't #-1");
+        violate(report, obj, "is a garbage object with a location that isn't #-1");
+
+    /*
+     * Check the running property size against a full count
+     */
+    if (size_properties(obj, 0) != size_proplist(DBFETCH(obj)->properties))
+        violate(report, obj, "has an incorrect cached property size");
 
-    check_contents_list(player, obj);
-    check_exits_list(player, obj);
+    check_contents_list(report, obj);
+    check_exits_list(report, obj);
 
     switch (Typeof(obj)) {
         case TYPE_ROOM:
-            check_room(player, obj);
+            check_room(report, obj);
             break;
         case TYPE_THING:
-            check_thing(player, obj);
+            check_thing(report, obj);
             break;
         case TYPE_PLAYER:
-            check_player(player, obj);
+            check_player(report, obj);
             break;
         case TYPE_EXIT:
-            check_exit(player, obj);
+            check_exit(report, obj);
             break;
         case TYPE_PROGRAM:
             break;
         case TYPE_GARBAGE:
-            check_garbage(player, obj);
+            check_garbage(report, obj);
             break;
         default:
-            violate(player, obj, "has an unknown object type, and its flags may also be corrupt");
+            violate(report, obj, "has an unknown object type, and its flags may also be corrupt");
             break;
     }
 }
 
+/**
+ * Check a range of objects
+ *
+ * This is the body of each sanity worker.  It only reads the database, and
+ * only writes to its own report.
+ *
+ * @private
+ * @param arg the worker's report
+ * @return NULL
+ */
+static void *
+check_range(void *arg)
+{
+    struct san_report *report = arg;
+
+    for (dbref i = report->first; i < report->last; i++) {
+        report->checking = i;
+        check_object(report, i);
+    }
+
+    return NULL;
+}
+
+/**
+ * Decide how many threads to check the database with
+ *
+ * @private
+ * @return the number of threads, at least 1
+ */
+static int
+sanity_thread_count(void)
+{
+    long n = 1;
+
+#if defined(SANITY_THREADED) && defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    if (n > SANITY_THREADS)
+        n = SANITY_THREADS;
+
+    if (n > db_top / SANITY_THREAD_MIN_OBJS)
+        n = db_top / SANITY_THREAD_MIN_OBJS;
+
+    return n < 1 ? 1 : (int) n;
+}
+
+/**
+ * Run the workers, on threads when possible
+ *
+ * The first worker always runs on the calling thread.  If a thread cannot
+ * be started, its worker is run on the calling thread as well.
+ *
+ * @private
+ * @param reports the workers' reports
+ * @param nworkers the number of workers
+ */
+static void
+check_ranges(struct san_report *reports, int nworkers)
+{
+#ifdef SANITY_THREADED
+    pthread_t threads[SANITY_THREADS];
+    int started[SANITY_THREADS];
+
+    for (int k = 1; k < nworkers; k++) {
+        started[k] = !pthread_create(&threads[k], NULL, check_range, &reports[k]);
+    }
+
+    check_range(&reports[0]);
+
+    for (int k = 1; k < nworkers; k++) {
+        if (started[k]) {
+            pthread_join(threads[k], NULL);
+        } else {
+            check_range(&reports[k]);
+        }
+    }
+#else
+    for (int k = 0; k < nworkers; k++) {
+        check_range(&reports[k]);
+    }
+#endif
+}
+
 /**
  * Implementation of the \@sanity command
  *
@@ -793,7 +933,10 @@ check_object(dbref player, dbref obj)
  * various static methods in sanity.c -- this mostly involves reference
  * checking and other somewhat basic checks.
  *
- * Prints status for every 10,000 refs.
+ * The objects are split into ranges that are checked on up to
+ * SANITY_THREADS threads.  The problems are printed once all of them are
+ * done, in object order, so the output does not depend on the number of
+ * threads.  Prints status for every 10,000 refs.
  *
  * player can be NOTHING to output to log file, or AMBIGUOUS to output
  * to stderr.  Otherwise, output is sent to the indicated player dbref.
@@ -804,29 +947,199 @@ void
 do_sanity(dbref player)
 {
     const int increp = 10000;
+    struct san_report reports[SANITY_THREADS];
+    struct san_report orphans;
+    int nworkers;
+    int v;
     int j;
 
     sanity_violated = 0;
 
-    for (dbref i = 0; i < db_top; i++) {
-        if (!(i % increp)) {
-            j = i + increp - 1;
-            j = (j >= db_top) ? (db_top - 1) : j;
-            SanPrint(player, "Checking objects %d to %d...", i, j);
+    memset(reports, 0, sizeof(reports));
+    memset(&orphans, 0, sizeof(orphans));
+    nworkers = sanity_thread_count();
 
-            if (player >= 0) {
-                flush_user_output(player);
+    for (int k = 0; k < nworkers; k++) {
+        reports[k].first = (dbref) ((long long) db_top * k / nworkers);
+        reports[k].last = (dbref) ((long long) db_top * (k + 1) / nworkers);
+    }
+
+    check_ranges(reports, nworkers);
+
+    for (int k = 0; k < nworkers; k++) {
+        v = 0;
+
+        for (dbref i = reports[k].first; i < reports[k].last; i++) {
+            if (!(i % increp)) {
+                j = i + increp - 1;
+                j = (j >= db_top) ? (db_top - 1) : j;
+                SanPrint(player, "Checking objects %d to %d...", i, j);
+
+                if (player >= 0) {
+                    flush_user_output(player);
+                }
+            }
+
+            for (; v < reports[k].count && reports[k].found[v].checking == i; v++) {
+                print_violation(player, &reports[k].found[v]);
             }
         }
 
-        check_object(player, i);
+        free(reports[k].found);
+    }
+
+    SanPrint(player, "Searching for orphan objects...");
+    find_orphan_objects(&orphans);
+
+    for (v = 0; v < orphans.count; v++) {
+        print_violation(player, &orphans.found[v]);
     }
 
-    find_orphan_objects(player);
+    free(orphans.found);
 
     SanPrint(player, "Done.");
 }
 
+/**
+ * Implementation of the \@sanity background command
+ *
+ * This runs do_sanity in a forked copy of the server, so the game goes on
+ * while the database is checked.  The copy checks the database as it was
+ * when the command ran.  Its output is kept in a temporary file, and sent
+ * to the player by sanity_fork_done once it exits.
+ *
+ * Servers that do not fork for dumps, DISKBASE and Windows ones, say so and
+ * check the database right away instead.  No permission checks are done by
+ * this command.
+ *
+ * @see sanity_fork_done
+ *
+ * @param player the player doing the call
+ */
+void
+do_sanity_fork(dbref player)
+{
+#ifdef SANITY_FORKED
+    sigset_t mask;
+    sigset_t oldmask;
+    pid_t pid;
+
+    if (global_sanity_pid != 0) {
+        notify(player, "A background sanity check is already running.");
+        return;
+    }
+
+    if (!(san_fork_out = tmpfile())) {
+        notify(player, "Could not start a background sanity check.");
+        return;
+    }
+
+    /* Don't let the child be reaped before we know its pid. */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &oldmask);
+
+    fflush(stdout);
+
+    if ((pid = fork()) == 0) {
+        /* We are the child. */
+        forked_dump_process_flag = 1;
+        set_dumper_signals();
+        sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+#  ifdef NICEVAL
+        errno = 0;
+        if (nice(NICEVAL) == -1 && errno != 0) {
+            log_status("could not modify process priority");
+        }
+#  endif /* NICEVAL */
+
+        if (dup2(fileno(san_fork_out), STDOUT_FILENO) < 0) {
+            _exit(2);
+        }
+
+        do_sanity(NOTHING);
+        fflush(stdout);
+        _exit(sanity_violated ? 1 : 0);
+    }
+
+    if (pid > 0) {
+        global_sanity_pid = pid;
+        san_fork_player = player;
+    }
+
+    sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+    if (pid < 0) {
+        fclose(san_fork_out);
+        san_fork_out = NULL;
+        notify(player, "Could not start a background sanity check.");
+        return;
+    }
+
+    notify(player, "Checking the database in the background.");
+#else
+    notify(player, "Checking the database now, since this server can't do it in the background.");
+    do_sanity(player);
+#endif
+}
+
+/**
+ * Finish up a background sanity check started by do_sanity_fork
+ *
+ * This sends the check's output to the player that started it, and sets
+ * sanity_violated from its result.  It is called from the main loop once
+ * the forked process has been reaped.
+ *
+ * @see do_sanity_fork
+ *
+ * @param status the exit status of the forked process
+ */
+void
+sanity_fork_done(int status)
+{
+#ifdef SANITY_FORKED
+    char buf[16384];
+    char *p;
+    int finished;
+
+    log_status("forked sanity check exited with status %d", status);
+
+    finished = WIFEXITED(status) && WEXITSTATUS(status) <= 1;
+
+    if (finished) {
+        sanity_violated = WEXITSTATUS(status);
+    }
+
+    if (!OkObj(san_fork_player) || Typeof(san_fork_player) != TYPE_PLAYER) {
+        san_fork_player = NOTHING;
+    }
+
+    if (san_fork_out) {
+        rewind(san_fork_out);
+
+        while (fgets(buf, sizeof(buf), san_fork_out)) {
+            if ((p = strchr(buf, '\n'))) {
+                *p = '\0';
+            }
+
+            if (san_fork_player != NOTHING) {
+                SanPrint(san_fork_player, "%s", buf);
+            }
+        }
+
+        fclose(san_fork_out);
+        san_fork_out = NULL;
+    }
+
+    if (!finished && san_fork_player != NOTHING) {
+        SanPrint(san_fork_player, "## The background sanity check did not finish.");
+    }
+
+    san_fork_player = NOTHING;
+#endif
+}
+
 /**
  * Sends a formatted message to the sanity fix log
  *
@@ -1560,6 +1873,9 @@ do_sanfix(dbref player)
         FLAGS(loop) &= ~SANEBIT;
     }
 
+    /* The repairs above may have given objects new owners, types or names. */
+    dbindex_clear();
+
     if (player > NOTHING) {
         if (!sanity_violated) {
             notifyf_nolisten(player, "Database repair complete, please re-run"
@@ -1681,6 +1997,7 @@ do_sanchange(dbref player, const char *command)
     } else if (!strcasecmp(field, "owner")) {
         unparse_object(NOTHING, OWNER(d), buf2, sizeof(buf2));
         OWNER(d) = v;
+        dbindex_update(d);
         DBDIRTY(d);
         SanPrint(player, "## Setting #%d's owner to %s", d, unparse_buf);
     } else if (!strcasecmp(field, "home")) {
@@ -1699,6 +2016,7 @@ do_sanchange(dbref player, const char *command)
 
         unparse_object(NOTHING, *ip, buf2, sizeof(buf2));
         *ip = v;
+        dbindex_update(d);
         DBDIRTY(d);
         SanPrint(player, "## Setting #%d's home to: %s\n", d, unparse_buf);
     } else {
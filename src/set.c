@@ -16,6 +16,7 @@
 #include "boolexp.h"
 #include "commands.h"
 #include "db.h"
+#include "dbindex.h"
 #include "fbstrings.h"
 #include "fbtime.h"
 #include "game.h"
@@ -105,6 +106,7 @@ do_name(int descr, dbref player, const char *name, char *newname)
 
     ts_modifyobject(thing);
     NAME(thing) = alloc_string(newname);
+    dbindex_update(thing);
     notify(player, "Name set.");
     DBDIRTY(thing);
 }
@@ -203,6 +205,8 @@ _do_unlink(int descr, dbref player, const char *name, bool quiet)
                 notify(player, "You can't unlink that!");
                 break;
         }
+
+        dbindex_update(exit);
     }
 }
 
@@ -501,6 +505,8 @@ do_chown(int descr, dbref player, const char *name, const char *newowner)
             return;
     }
 
+    dbindex_update(thing);
+
     if (owner == player)
         notify(player, "Owner changed to you.");
     else {
@@ -17,12 +17,15 @@
 #include "boolexp.h"
 #include "commands.h"
 #include "db.h"
+#include "dbindex.h"
 #ifdef DISKBASE
 #include "diskprop.h"
 #endif
 #include "fbstrings.h"
 #include "game.h"
+#include "inst.h"
 #include "interface.h"
+#include "interp.h"
 #include "log.h"
 #include "match.h"
 #include "move.h"
@@ -30,6 +33,7 @@
 #include "player.h"
 #include "predicates.h"
 #include "props.h"
+#include "sampler.h"
 #include "tune.h"
 
 /**
@@ -616,7 +620,8 @@ do_force(int descr, dbref player, const char *what, char *command)
  * stats on what a given player owns.
  *
  * The stats returned are basic counts -- numbeer of rooms, objects, etc.
- * It loops over the entire DB to get this information.
+ * It loops over the entire DB to get this information, or just over the
+ * player's objects when a player is given.
  *
  * This does do permission checking
  *
@@ -640,6 +645,7 @@ do_stats(dbref player, const char *name)
 #endif
     time_t currtime = time(NULL);
     dbref owner = NOTHING;
+    struct dbindex_scan scan;
 
     if (!Wizard(OWNER(player)) && (!name || !*name)) {
         notifyf(player, "The universe contains %d objects.", db_top);
@@ -662,7 +668,8 @@ do_stats(dbref player, const char *name)
             return;
         }
 
-        for (dbref i = 0; i < db_top; i++) {
+        for (dbref i = dbindex_first(&scan, owner, NOTYPE, NULL, 0);
+             i != NOTHING; i = dbindex_next(&scan)) {
 
 #ifdef DISKBASE
             if ((OWNER(i) == owner) &&
@@ -1123,6 +1130,188 @@ add_to_proflist(struct profnode **tops, size_t limit, int *nodecount, dbref obj,
     }
 }
 
+/**
+ * Show or reset the MUF instruction pair statistics for \@tops pairs
+ *
+ * @see muf_pairs_top
+ *
+ * @private
+ * @param player the player doing the call
+ * @param option a string containing a number, the word "reset", or ""
+ */
+static void
+show_pair_stats(dbref player, const char *option)
+{
+    struct muf_pair *pairs;
+    unsigned long total;
+    int count;
+
+    if (!strcasecmp(option, "reset")) {
+        muf_pairs_reset();
+        notify(player, "Instruction pair statistics cleared.");
+        return;
+    }
+
+    count = atoi(option);
+    if (count < 0) {
+        notify_nolisten(player, "Count must be a positive number.", 1);
+        return;
+    }
+
+    if (count == 0) {
+        count = 10;
+    }
+
+    if (!(pairs = malloc(sizeof(*pairs) * (size_t) count))) {
+        notify_nolisten(player, "Out of memory.", 1);
+        return;
+    }
+
+    count = muf_pairs_top(pairs, count, &total);
+
+    notify_nolisten(player, "        Count      %  First -> Second", 1);
+
+    for (int i = 0; i < count; i++) {
+        notifyf_nolisten(player, "%13lu %6.2f  %s -> %s", pairs[i].count,
+                         pairs[i].count * 100.0 / (double) total,
+                         muf_pair_name(pairs[i].first),
+                         muf_pair_name(pairs[i].second));
+    }
+
+    free(pairs);
+
+    notifyf_nolisten(player, "Total pairs: %lu%s", total,
+                     tp_muf_pair_stats ? "" : "  (muf_pair_stats is off)");
+    notify_nolisten(player, "*Done*", 1);
+}
+
+/**
+ * Show or reset the MUF primitive statistics for \@tops prims
+ *
+ * @see muf_inst_stats_top
+ *
+ * @private
+ * @param player the player doing the call
+ * @param option a string containing a number, the word "reset", or ""
+ */
+static void
+show_prim_stats(dbref player, const char *option)
+{
+    struct muf_inst_stat *stats;
+    unsigned long long total;
+    int count;
+
+    if (!strcasecmp(option, "reset")) {
+        muf_inst_stats_reset();
+        notify(player, "Primitive statistics cleared.");
+        return;
+    }
+
+    count = atoi(option);
+    if (count < 0) {
+        notify_nolisten(player, "Count must be a positive number.", 1);
+        return;
+    }
+
+    if (count == 0) {
+        count = 10;
+    }
+
+    if (!(stats = malloc(sizeof(*stats) * (size_t) count))) {
+        notify_nolisten(player, "Out of memory.", 1);
+        return;
+    }
+
+    count = muf_inst_stats_top(stats, count, &total);
+
+    notify_nolisten(player,
+                    "        Count     TotalMS   ns/Each      %  Primitive", 1);
+
+    for (int i = 0; i < count; i++) {
+        notifyf_nolisten(player, "%13lu %11.3f %9.0f %6.2f  %s",
+                         stats[i].count, stats[i].nsec / 1000000.0,
+                         (double) stats[i].nsec / (double) stats[i].count,
+                         total ? stats[i].nsec * 100.0 / (double) total : 0.0,
+                         muf_pair_name(stats[i].key));
+    }
+
+    free(stats);
+
+    notifyf_nolisten(player, "Total time (ms): %.3f%s", total / 1000000.0,
+                     tp_muf_prim_stats ? "" : "  (muf_prim_stats is off)");
+    notify_nolisten(player, "*Done*", 1);
+}
+
+/**
+ * Show, save or reset the profiler's samples for \@tops samples
+ *
+ * @see sampler_top
+ *
+ * @private
+ * @param player the player doing the call
+ * @param option a string containing a number, the word "reset" or "save",
+ *               or ""
+ */
+static void
+show_samples(dbref player, const char *option)
+{
+    struct sampled_stack *stacks;
+    unsigned long total;
+    int count;
+
+    if (!strcasecmp(option, "reset")) {
+        sampler_reset();
+        notify(player, "Profiler samples cleared.");
+        return;
+    }
+
+    if (!strcasecmp(option, "save")) {
+        count = sampler_save(tp_file_profile_samples);
+
+        if (count < 0) {
+            notifyf_nolisten(player, "Couldn't write %s.",
+                             tp_file_profile_samples);
+        } else {
+            notifyf_nolisten(player, "Saved %d stacks to %s.", count,
+                             tp_file_profile_samples);
+        }
+
+        return;
+    }
+
+    count = atoi(option);
+    if (count < 0) {
+        notify_nolisten(player, "Count must be a positive number.", 1);
+        return;
+    }
+
+    if (count == 0) {
+        count = 10;
+    }
+
+    if (!(stacks = malloc(sizeof(*stacks) * (size_t) count))) {
+        notify_nolisten(player, "Out of memory.", 1);
+        return;
+    }
+
+    count = sampler_top(stacks, count, &total);
+
+    notify_nolisten(player, "    Count      %  Stack", 1);
+
+    for (int i = 0; i < count; i++) {
+        notifyf_nolisten(player, "%9d %6.2f  %s", stacks[i].count,
+                         stacks[i].count * 100.0 / (double) total,
+                         stacks[i].stack);
+    }
+
+    free(stacks);
+
+    notifyf_nolisten(player, "Total samples: %lu%s", total,
+                     tp_profile_sample_rate > 0 ? ""
+                     : "  (profile_sample_rate is 0)");
+    notify_nolisten(player, "*Done*", 1);
+}
+
 /**
  * Implementation of the \@tops command
  *
@@ -1130,6 +1319,13 @@ add_to_proflist(struct profnode **tops, size_t limit, int *nodecount, dbref obj,
  * statistics are shown for top 'arg1' number of programs.  The default
  * is '10'.  'reset' can also be passed to reset the statistic numbers.
  *
+ * 'pairs' shows the MUF instruction pairs run most often instead, as
+ * counted while the muf_pair_stats tune is on.  'prims' shows the
+ * primitives and other instructions that took the most time, as counted
+ * while the muf_prim_stats tune is on.  'samples' shows the stacks
+ * the profiler sampled most often while the profile_sample_rate tune is
+ * set, and 'samples save' saves them all for a flame graph.
+ *
  * This iterates over the entire DB and puts the programs in a
  * 'struct profnode' linked list.  For large numbers of 'arg1', this is
  * really inefficient since its sorting a linked list.
@@ -1157,6 +1353,15 @@ do_topprofs(dbref player, char *arg1)
         type = 0;
     } else if (!strcasecmp(arg1, "muf")) {
         type = 1;
+    } else if (!strcasecmp(arg1, "pairs")) {
+        show_pair_stats(player, option);
+        return;
+    } else if (!strcasecmp(arg1, "prims")) {
+        show_prim_stats(player, option);
+        return;
+    } else if (!strcasecmp(arg1, "samples")) {
+        show_samples(player, option);
+        return;
     } else {
         option = arg1;
     }
@@ -1173,6 +1378,8 @@ do_topprofs(dbref player, char *arg1)
                 PROGRAM_SET_PROFTIME(i, 0, 0);
                 PROGRAM_SET_PROFSTART(i, current_systime);
                 PROGRAM_SET_PROF_USES(i, 0);
+                PROGRAM_SET_SLICE_YIELDS(i, 0);
+                PROGRAM_SET_TIME_YIELDS(i, 0);
             }
         }
 
@@ -79,6 +79,9 @@ class ServerTestBase(unittest.TestCase):
     the tests wait until end-of-file."""
     finish_string = b'@shutdown\n'
 
+    """Name of the database the server saves in `self.game_dir`, passed as the last -dbout argument."""
+    saved_database = 'dbout'
+
     """@tune parameters to set via the -parmfile argument."""
     params = {}
 
@@ -154,7 +157,7 @@ class ServerTestBase(unittest.TestCase):
            '-dbin', self.input_database,
            '-dbout', self.output_database,
            '-gamedir', self.game_dir,
-           '-dbout', os.path.join(self.game_dir, 'dbout'),
+           '-dbout', self._saved_database(),
            '-console',
            '-parmfile', 'test_parm_file',
         ]
@@ -236,6 +239,46 @@ class ServerTestBase(unittest.TestCase):
         self._stderr_future = None
         self._process = None
 
+    """Kill the server as if it had crashed, without letting it save the database, and wait for
+    it to terminate.
+
+    Fills `self._current_stderr` with the output accumulated from the server's stderr."""
+    async def _kill(self):
+        self._process.send_signal(signal.SIGKILL)
+        await asyncio.gather(
+            self._read_to_eof(),
+            self._process.wait(),
+            self._stderr_future,
+        )
+        self._stderr_future = None
+        self._process = None
+
+    """Path to the database the server saves."""
+    def _saved_database(self):
+        return os.path.join(self.game_dir, self.saved_database)
+
+    """Make the database the server saved the input database of the next run, which saves
+    to `name` instead, since the server can't save over the file it loaded."""
+    def _reuse_saved_database(self, name):
+        self.input_database = self._saved_database()
+        self.saved_database = name
+
+    """Load the database the server saved with -convert and save it again in `format`
+    ('text' or 'binary')."""
+    def _convert(self, format):
+        self._reuse_saved_database('converted')
+        result = subprocess.run([
+            SERVER_PATH,
+            '-convert',
+            '-dbformat', format,
+            '-dbin', self.input_database,
+            '-dbout', self._saved_database(),
+            '-gamedir', self.game_dir,
+            '-parmfile', 'test_parm_file',
+        ], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        print("convert stderr:\n{}".format(_text(result.stderr)))
+        self.assertEqual(result.returncode, 0)
+
     """Start the server (with _start_server) and connect (using self._connect_string)
     and wait for connnecting to finish (with self._connect_prompt)."""
     async def _start_and_connect(self):
@@ -282,16 +325,74 @@ class CommandTestCase(ServerTestBase):
     """Default timeout for setup + command to complete in, in seconds."""
     default_timeout = 60
 
+    """Run the commands of a test that has a `restart` section, like `_run_command` does.
+
+    The test is skipped if the server was built with the compile option `skip_option`.  The
+    setup is sent first, and if `wait` is set, its text is awaited before the commands are
+    sent.  After the commands, the server is shut down, or if `crash` is set, killed (once
+    the text of `crash` has appeared, unless it is just true).  The database it saved is
+    converted if `convert` is set, then the server is started from it and sent the `restart`
+    commands.
+
+    Returns:
+       the output from the commands and the restart commands, starting at the end of the setup
+    """
+    async def _run_restart(self, info):
+        setup = info.get('setup', '').encode('UTF-8')
+        crash = info.get('crash')
+        try:
+            await self._start_and_connect()
+            if 'skip_option' in info:
+                version = await self._write_and_await_prompt(
+                    b'@version' + self.done_command_command,
+                    self.done_command_prompt,
+                )
+                if re.search(b'Options: (.* )?' + re.escape(info['skip_option'].encode('UTF-8')) + b' ',
+                             version):
+                    await self._finish()
+                    self.skipTest('server built with ' + info['skip_option'])
+            if 'wait' in info:
+                await self._write_and_await_prompt(setup, info['wait'].encode('UTF-8'))
+                setup = b''
+            output = await self._write_and_await_prompt(
+                setup + self.done_setup_command + info['commands'].encode('UTF-8') +
+                self.done_command_command,
+                self.done_command_prompt,
+            )
+            if crash:
+                if crash is not True and crash.encode('UTF-8') not in output:
+                    output += await self._read_to_prompt(crash.encode('UTF-8'))
+                await self._kill()
+            else:
+                await self._finish()
+            print("server stderr:\n{}".format(_text(self._current_stderr)))
+            if 'convert' in info:
+                self._convert(info['convert'])
+            self._reuse_saved_database('restarted')
+            output += await self._run_command(info['restart'].encode('UTF-8'))
+        finally:
+            if self._stderr_future:
+                try:
+                    await self._stderr_future
+                except:
+                    pass
+                print("server stderr:\n{}".format(_text(self._current_stderr)))
+        return output
+
     def _test_one(self, info):
         setup = info.get('setup', '')
         commands = info['commands']
         expect = info['expect']
         timeout = info.get('timeout', self.default_timeout)
-        output = _asyncio_run(_add_timeout(self._run_command(
-            setup.encode('UTF-8') +
-            self.done_setup_command +
-            commands.encode('UTF-8'),
-        ), timeout))
+        if 'restart' in info:
+            run = self._run_restart(info)
+        else:
+            run = self._run_command(
+                setup.encode('UTF-8') +
+                self.done_setup_command +
+                commands.encode('UTF-8'),
+            )
+        output = _asyncio_run(_add_timeout(run, timeout))
         output = output.decode('UTF-8', errors='replace')
         output = output.replace('\r\n', '\n')
         output = output.split(self.done_setup_prompt, 2)[1]
@@ -324,6 +425,15 @@ Each item in the YAML file can contain the following keys:
 *  expect: regular expression pattern or list of regular expression patterns
            to expect to find in the output of "commands". Matching is done after conversion
            to UTF-8 and replacing \r\n by \n
+*  restart: commands to run after the server is stopped and started again from the database
+            it saved. Their output is matched along with that of "commands"
+*  wait: with restart, text the setup must output before "commands" are sent
+*  crash: with restart, kill the server instead of shutting it down, after waiting for this
+          text to be output unless it is just true
+*  convert: with restart, run the saved database through -convert first, saving it in this
+            format ('text' or 'binary')
+*  skip_option: with restart, skip the test if the server was built with this compile
+                option, as listed by @version
 
 Args:
    * base_class: base class type, which must inherit from CommandTestCase